@@ -31,12 +31,15 @@ layout (std430, set = 1, binding = kModelMatricesBindingPos) buffer ModelMats {
   mat4 model_mats[];
 };
 
+// Direct draws push the ID of their mesh; indirect draws push 0 and carry it
+// in their first instance instead, so that one call can draw many meshes
 layout(push_constant) uniform PushConsts {
 	uint val;
-} mesh_id;
+} mesh_id_base;
 
 void main() {
-  mat4 model_view = view * model_mats[mesh_id.val];
+  uint mesh_id = mesh_id_base.val + uint(gl_InstanceIndex);
+  mat4 model_view = view * model_mats[mesh_id];
   pos_view = (model_view * vec4(pos, 1.f)).xyz;
   gl_Position = proj * vec4(pos_view, 1.f);
 
@@ -48,5 +51,5 @@ void main() {
 
   uv_fs = uv;
 
-  mesh_id_out = mesh_id.val;
+  mesh_id_out = mesh_id;
 }
@@ -0,0 +1,77 @@
+#version 440
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+#define kProjViewMatricesBindingPos 0
+#define kModelMatricesBindingPos 0
+
+// Positions are snorm16 within the mesh's bounds, which its model matrix
+// maps back; the tangent frame is a quaternion in snorm16 and the uvs are
+// halfs
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec4 tangent_frame;
+layout (location = 2) in vec2 uv;
+
+layout (location = 0) out vec3 pos_view;
+layout (location = 1) out vec3 norm_vs;
+layout (location = 2) out vec3 uv_fs;
+layout (location = 3) out vec3 bitangent_vs;
+layout (location = 4) out vec3 tangent_vs;
+layout (location = 5) flat out uint mesh_id_out;
+
+layout (std430, set = 0, binding = kProjViewMatricesBindingPos)
+    buffer MainStaticBuffer {
+  mat4 proj;
+  mat4 view;
+  mat4 inv_proj;
+  mat4 inv_view;
+};
+
+layout (std430, set = 1, binding = kModelMatricesBindingPos) buffer ModelMats {
+  mat4 model_mats[];
+};
+
+// Direct draws push the ID of their mesh; indirect draws push 0 and carry it
+// in their first instance instead, so that one call can draw many meshes
+layout(push_constant) uniform PushConsts {
+	uint val;
+} mesh_id_base;
+
+// Columns of the rotation of a quaternion; the frame is right-handed, so
+// the bitangent is cross(normal, tangent)
+void DecodeTangentFrame(vec4 q, out vec3 normal, out vec3 tangent) {
+  q = normalize(q);
+  tangent = vec3(
+    1.f - 2.f * (q.y * q.y + q.z * q.z),
+    2.f * (q.x * q.y + q.w * q.z),
+    2.f * (q.x * q.z - q.w * q.y));
+  normal = vec3(
+    2.f * (q.x * q.z + q.w * q.y),
+    2.f * (q.y * q.z - q.w * q.x),
+    1.f - 2.f * (q.x * q.x + q.y * q.y));
+}
+
+void main() {
+  uint mesh_id = mesh_id_base.val + uint(gl_InstanceIndex);
+  mat4 model_view = view * model_mats[mesh_id];
+  pos_view = (model_view * vec4(pos, 1.f)).xyz;
+  gl_Position = proj * vec4(pos_view, 1.f);
+
+  vec3 norm;
+  vec3 tangent;
+  DecodeTangentFrame(tangent_frame, norm, tangent);
+  vec3 bitangent = cross(norm, tangent);
+
+  // The dequantization scale is uniform, so it only changes the length of
+  // the vectors, which get normalised by the fragment shader
+  mat3 transp_model_view = transpose(inverse(mat3(model_view)));
+  norm_vs = transp_model_view * norm;
+
+  tangent_vs = transp_model_view * tangent;
+  bitangent_vs = transp_model_view * bitangent;
+
+  uv_fs = vec3(uv, 0.f);
+
+  mesh_id_out = mesh_id;
+}
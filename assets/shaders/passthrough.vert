@@ -20,10 +20,13 @@ layout (std430, set = 1, binding = kModelMatricesBindingPos) buffer ModelMats {
   mat4 model_mats[];
 };
 
+// Direct draws push the ID of their mesh; indirect draws push 0 and carry it
+// in their first instance instead, so that one call can draw many meshes
 layout(push_constant) uniform PushConsts {
 	uint val;
-} mesh_id;
+} mesh_id_base;
 
 void main() {
-  gl_Position = proj * view * model_mats[mesh_id.val] * vec4(pos, 1.f);
+  uint mesh_id = mesh_id_base.val + uint(gl_InstanceIndex);
+  gl_Position = proj * view * model_mats[mesh_id] * vec4(pos, 1.f);
 }
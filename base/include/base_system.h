@@ -5,6 +5,11 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <vulkan_texture_manager.h>
+#include <vulkan_upload_manager.h>
+#include <vulkan_memory_tracker.h>
+#include <residency_manager.h>
+#include <memory_allocators.h>
+#include <worker_pool.h>
 #include <model_manager.h>
 #include <vulkan_base.h>
 #include <material_manager.h>
@@ -20,6 +25,19 @@ namespace vks {
   // Run a given application; init its modules, run it, then perform its shutdown
   void Run(Scene *scene);
   void Shutdown();
+  // Set up only what runs without a window or a device, ie. the frame arena
+  // and the worker pool, so that scenes which don't render can be run
+  // headless, eg. by tests; see WorkerPool::Init for worker_threads
+  void InitHeadless(uint32_t worker_threads = 0U);
+  void ShutdownHeadless();
+  // Run a scene for a number of frames, the same way Run does; returns the
+  // heap allocations the main thread made in the checked frames after the
+  // warm-up ones
+  uint64_t RunFrames(Scene *scene, uint32_t frames_count);
+  // Leave the current frame out of the heap allocations check, for work
+  // which happens once, such as registering a model or creating a model the
+  // app loads; evictions, reloads and re-recording are checked
+  void SkipFrameAllocationsCheck();
   // Signal engine to exit while running
   void Exit();
 
@@ -29,6 +47,12 @@ namespace vks {
   ModelManager *model_manager(); 
   MeshesHeapManager *meshes_heap_manager(); 
   VulkanTextureManager *texture_manager();
+  VulkanUploadManager *upload_manager();
+  VulkanMemoryTracker *memory_tracker();
+  ResidencyManager *residency_manager();
+  // Scratch memory for the current frame; reset at the start of every frame
+  LinearArena *frame_arena();
+  WorkerPool *worker_pool();
   LightsManager *lights_manager();
   szt::InputManager *input_manager();
 
@@ -0,0 +1,35 @@
+#ifndef VKS_BOUNDS
+#define VKS_BOUNDS
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace vks {
+
+// Bounding volumes and frustum planes, shared by the meshes, their meshlets
+// and the frustum tests
+
+// Ritter's approximate bounding sphere of positions stride bytes apart, as
+// centre (xyz) and radius (w)
+glm::vec4 ComputeBoundingSphere(
+    const float *positions,
+    uint32_t count,
+    uint32_t stride);
+
+// Axis aligned box of positions stride bytes apart; empty sets of positions
+// get a box of zero size at the origin
+void ComputeBoundingBox(
+    const float *positions,
+    uint32_t count,
+    uint32_t stride,
+    glm::vec3 *box_min,
+    glm::vec3 *box_max);
+
+// Planes of the frustum of a projection * view matrix with a [0, 1] depth
+// range, normalised and facing inwards, in left, right, bottom, top, near,
+// far order
+void ExtractFrustumPlanes(const glm::mat4 &view_proj, glm::vec4 *planes);
+
+} // namespace vks
+
+#endif
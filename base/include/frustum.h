@@ -1,8 +1,11 @@
 #ifndef VKS_FRUSTUM
 #define VKS_FRUSTUM
 
+#include <cstdint>
+#include <glm/vec4.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
+#include <glm/mat4x4.hpp>
 
 namespace szt {
 
@@ -21,6 +24,23 @@ class Frustum {
   float far() const { return far_; }
   float near() const { return near_; }
 
+  // Set the planes the tests are against from a projection * view matrix;
+  // see vks::ExtractFrustumPlanes. Until then everything passes them
+  void ExtractPlanes(const glm::mat4 &view_proj);
+  const glm::vec4 *planes() const { return planes_; }
+
+  // Write for each sphere, as centre (xyz) and radius (w), or box whether
+  // it is at least partly inside the planes, as 1 or 0
+  void TestSpheres(
+      const glm::vec4 *spheres,
+      uint32_t count,
+      uint8_t *visible) const;
+  void TestBoxes(
+      const glm::vec3 *boxes_min,
+      const glm::vec3 *boxes_max,
+      uint32_t count,
+      uint8_t *visible) const;
+
  private:
   glm::vec2 near_size_;
   glm::vec2 far_size_;
@@ -32,6 +52,10 @@ class Frustum {
   glm::vec3 ftr_;    
   glm::vec3 fbl_;    
   glm::vec3 fbr_;    
+  glm::vec4 planes_[6U];
+  // The planes' components one after the other, 4 planes to a group so that
+  // a volume is tested against a group at once; the 2 left over never cull
+  float packed_planes_[2U][4U][4U];
 
 }; // class Frustum
 
@@ -0,0 +1,142 @@
+#ifndef VKS_GEOMETRYARENA
+#define VKS_GEOMETRYARENA
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <EASTL/vector.h>
+#include <range_allocator.h>
+#include <vulkan_buffer.h>
+
+namespace vks {
+
+class VulkanDevice;
+class VertexSetup;
+
+// Identifies a range of vertices and indices in a geometry arena
+typedef uint32_t GeometryRangeId;
+extern const GeometryRangeId kNoGeometryRange;
+
+struct GeometryRange {
+  uint32_t first_vertex;
+  uint32_t vertices_count;
+  // In units of index_type, as draws count them
+  uint32_t first_index;
+  uint32_t indices_count;
+  VkIndexType index_type;
+}; // struct GeometryRange
+
+/**
+ * @brief One vertex buffer per stream of a layout and one index buffer,
+ *   shared by every model with that layout. Each model is given a range of
+ *   vertices and of indices, which its draws are offset by, so all of them
+ *   can be drawn with a single bind of the buffers.
+ *   16 and 32-bit indices share the index buffer, each aligned to its size,
+ *   so that binding the buffer with either type addresses them. The buffers
+ *   grow when a range doesn't fit, and can be compacted once freed ranges
+ *   fragment them; both move the data into new buffers and change
+ *   generation().
+ */
+class GeometryArena {
+ public:
+  GeometryArena();
+
+  void Init(
+      const VulkanDevice &device,
+      const VertexSetup &vertex_setup,
+      uint32_t vertices_capacity,
+      VkDeviceSize index_bytes_capacity);
+  void Shutdown(const VulkanDevice &device);
+
+  // Whether vertices of the layout can be stored here, ie. it has the same
+  // streams
+  bool IsCompatible(const VertexSetup &vertex_setup) const;
+
+  /**
+   * @brief Allocate a range, growing the buffers if it doesn't fit; its data
+   *   is then uploaded with WriteVertexStream and WriteIndices.
+   *
+   * @return ID of the range
+   */
+  GeometryRangeId Allocate(
+      const VulkanDevice &device,
+      uint32_t vertices_count,
+      uint32_t indices_count,
+      VkIndexType index_type);
+  // The range mustn't be in use by the GPU anymore; see
+  // ResidencyManager::RetireGeometry
+  void Free(GeometryRangeId id);
+
+  // Upload the whole stream or the indices of a range; the copies are
+  // batched by the upload manager
+  void WriteVertexStream(
+      const VulkanDevice &device,
+      GeometryRangeId id,
+      uint32_t stream,
+      const void *data);
+  void WriteIndices(
+      const VulkanDevice &device,
+      GeometryRangeId id,
+      const void *data);
+
+  const GeometryRange &range(GeometryRangeId id) const { return ranges_[id]; }
+  // Device memory a range takes
+  VkDeviceSize GetRangeSize(GeometryRangeId id) const;
+
+  void BindVertexBuffers(VkCommandBuffer cmd_buff) const;
+  // Bind only the stream holding the positions, at binding 0
+  void BindPositionBuffer(VkCommandBuffer cmd_buff) const;
+  void BindIndexBuffer(VkCommandBuffer cmd_buff, VkIndexType index_type) const;
+
+  /**
+   * @brief Move the ranges next to each other at the start of new buffers,
+   *   sized to them plus some room to grow, so that the memory of the freed
+   *   ranges is given back. Blocks until the copies have completed.
+   */
+  void Compact(const VulkanDevice &device);
+
+  // Changes whenever the data moves to new buffers, which commands
+  // recorded with the old ones have to be recorded again for
+  uint32_t generation() const { return generation_; }
+
+  uint32_t vertices_used() const {
+    return static_cast<uint32_t>(vertex_allocator_.used());
+  }
+  uint32_t vertices_capacity() const {
+    return static_cast<uint32_t>(vertex_allocator_.capacity());
+  }
+  VkDeviceSize index_bytes_used() const { return index_allocator_.used(); }
+  VkDeviceSize index_bytes_capacity() const {
+    return index_allocator_.capacity();
+  }
+
+ private:
+  void CreateBuffers(
+      const VulkanDevice &device,
+      uint32_t vertices_capacity,
+      VkDeviceSize index_bytes_capacity);
+  // Move every range into new buffers of the given capacities, placing them
+  // one after the other
+  void Relocate(
+      const VulkanDevice &device,
+      uint32_t vertices_capacity,
+      VkDeviceSize index_bytes_capacity);
+
+  eastl::vector<uint32_t> stream_strides_;
+  uint32_t position_stream_;
+  eastl::vector<VulkanBuffer> vertex_buffers_;
+  VulkanBuffer index_buffer_;
+  // In vertices
+  RangeAllocator vertex_allocator_;
+  // In bytes
+  RangeAllocator index_allocator_;
+  eastl::vector<GeometryRange> ranges_;
+  // Whether each of ranges_ is allocated, and the free IDs to reuse
+  eastl::vector<bool> ranges_used_;
+  eastl::vector<GeometryRangeId> free_ids_;
+  uint32_t generation_;
+
+}; // class GeometryArena
+
+} // namespace vks
+
+#endif
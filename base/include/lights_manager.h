@@ -3,6 +3,7 @@
 
 #include <light.h>
 #include <EASTL/vector.h>
+#include <memory_allocators.h>
 #include <glm/mat4x4.hpp>
 
 namespace vks {
@@ -17,7 +18,9 @@ class LightsManager {
   const eastl::vector<Light> &lights() const { return lights_; }
   uint32_t GetNumLights() const;
 
-  eastl::vector<Light> TransformLights(const glm::mat4 &transform);
+  // Write the lights transformed by the given matrix into transformed_lights
+  void TransformLights(const glm::mat4 &transform,
+                       FrameVector<Light> &transformed_lights) const;
 
  private:
   eastl::vector<Light> lights_;
@@ -0,0 +1,40 @@
+#ifndef VKS_MAPPEDFILE
+#define VKS_MAPPEDFILE
+
+#include <cstddef>
+#include <cstdint>
+#include <EASTL/string.h>
+#include <uncopyable.h>
+
+namespace vks {
+
+/**
+ * @brief Read-only memory mapping of a whole file; the mapping is released
+ *   when the object is closed or destroyed.
+ */
+class MappedFile : private szt::Uncopyable {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  // Returns false if the file doesn't exist or couldn't be mapped
+  bool Open(const eastl::string &filename);
+  void Close();
+
+  bool is_open() const { return data_ != nullptr; }
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t *data_;
+  size_t size_;
+#ifdef _WIN32
+  void *file_handle_;
+  void *mapping_handle_;
+#endif
+
+}; // class MappedFile
+
+} // namespace vks
+
+#endif
@@ -24,6 +24,10 @@ struct MaterialBuilderTexture {
   MatTextureType type; 
 }; // struct MaterialBuilderTexture
 
+// Format a material texture is loaded with, picked from the type of its file;
+// false if there is no texture or its type isn't supported
+bool GetMaterialTextureFormat(const eastl::string &name, VkFormat *format);
+
 class MaterialInstanceBuilder {
  public:
   MaterialInstanceBuilder(
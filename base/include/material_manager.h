@@ -4,6 +4,7 @@
 #include <EASTL/string.h>
 #include <EASTL/hash_map.h>
 #include <EASTL/vector.h>
+#include <memory_allocators.h>
 #include <unordered_map>
 #include <material.h>
 #include <material_instance.h>
@@ -46,7 +47,7 @@ class MaterialManager {
    */
   void GetDescriptorImageInfosByType(
       const MatTextureType texture_type,
-      eastl::vector<VkDescriptorImageInfo> &descs);
+      FrameVector<VkDescriptorImageInfo> &descs);
 
   void Shutdown(const VulkanDevice &device);
 
@@ -0,0 +1,179 @@
+#ifndef VKS_MEMORYALLOCATORS
+#define VKS_MEMORYALLOCATORS
+
+#include <cstddef>
+#include <cstdint>
+#include <EASTL/vector.h>
+#include <uncopyable.h>
+
+namespace vks {
+
+// Alignment of the blocks returned by the allocators below unless a bigger
+// one is requested; enough for SSE/NEON types
+const size_t kDefaultAllocAlignment = 16U;
+
+// Aligned allocation from the system heap; memory must be released with
+// AlignedFree (or, on platforms where it maps to free, operator delete)
+void *AlignedAlloc(size_t size, size_t alignment);
+void AlignedFree(void *ptr);
+
+// Count of the heap allocations made so far by the calling thread through
+// the global and EASTL operator new and AlignedAlloc; used to check that the
+// steady-state frame loop doesn't touch the heap
+void CountHeapAllocation();
+uint64_t heap_allocations_count();
+
+/**
+ * @brief Bump allocator over a fixed block of memory; individual allocations
+ *   cannot be freed, the whole arena is reset at once.
+ *   Not thread safe.
+ */
+class LinearArena : private szt::Uncopyable {
+ public:
+  LinearArena();
+  ~LinearArena();
+
+  void Init(size_t capacity);
+  void Shutdown();
+
+  // Returns nullptr when the arena is exhausted
+  void *Allocate(size_t size, size_t alignment = kDefaultAllocAlignment);
+  void Reset();
+
+  bool Owns(const void *ptr) const;
+  size_t capacity() const { return capacity_; }
+  size_t used() const { return offset_; }
+  size_t peak_used() const { return peak_used_; }
+
+ private:
+  uint8_t *memory_;
+  size_t capacity_;
+  size_t offset_;
+  size_t peak_used_;
+
+}; // class LinearArena
+
+/**
+ * @brief EASTL allocator which takes memory from the frame arena; everything
+ *   allocated through it is only valid until the end of the current frame.
+ *   If the arena is exhausted it falls back to the heap.
+ */
+class FrameAllocator {
+ public:
+  explicit FrameAllocator(const char *name = "vks frame");
+  FrameAllocator(const FrameAllocator &x, const char *name);
+
+  void *allocate(size_t n, int flags = 0);
+  void *allocate(size_t n, size_t alignment, size_t offset, int flags = 0);
+  void deallocate(void *p, size_t n);
+
+  const char *get_name() const { return name_; }
+  void set_name(const char *name) { name_ = name; }
+
+ private:
+  const char *name_;
+
+}; // class FrameAllocator
+
+inline bool operator==(const FrameAllocator &, const FrameAllocator &) {
+  return true;
+}
+inline bool operator!=(const FrameAllocator &, const FrameAllocator &) {
+  return false;
+}
+
+// Vector whose storage lives in the frame arena
+template <typename T>
+using FrameVector = eastl::vector<T, FrameAllocator>;
+
+// Called by PoolAllocator for blocks it can't align; exits, in release builds
+// too, rather than hand out a misaligned block
+void PoolAlignmentError(size_t alignment, size_t offset);
+
+/**
+ * @brief Pool of fixed-size blocks which grows by whole chunks and keeps
+ *   freed blocks in an intrusive free list. Not thread safe.
+ */
+class FixedSizePool : private szt::Uncopyable {
+ public:
+  FixedSizePool(size_t block_size, size_t blocks_per_chunk);
+  ~FixedSizePool();
+
+  void *Allocate();
+  void Free(void *ptr);
+
+  size_t block_size() const { return block_size_; }
+
+ private:
+  void AllocateChunk();
+
+  size_t block_size_;
+  size_t blocks_per_chunk_;
+  void *free_list_;
+  eastl::vector<void *> chunks_;
+
+}; // class FixedSizePool
+
+/**
+ * @brief EASTL allocator serving requests of up to the block size of a
+ *   FixedSizePool from it; bigger requests, such as hash table bucket arrays,
+ *   and all of them without a pool, go to the heap. The pool is owned by
+ *   whoever owns the container, and has to outlive it; like the pool, the
+ *   allocator is not thread safe.
+ */
+class PoolAllocator {
+ public:
+  explicit PoolAllocator(const char *name = "vks pool")
+      : pool_(nullptr),
+        name_(name) {}
+  explicit PoolAllocator(FixedSizePool *pool, const char *name = "vks pool")
+      : pool_(pool),
+        name_(name) {}
+  PoolAllocator(const PoolAllocator &x, const char *name)
+      : pool_(x.pool_),
+        name_(name) {}
+
+  void *allocate(size_t n, int flags = 0) {
+    return allocate(n, kDefaultAllocAlignment, 0U, flags);
+  }
+  void *allocate(size_t n, size_t alignment, size_t offset, int flags = 0) {
+    if (pool_ != nullptr && n <= pool_->block_size()) {
+      if (alignment > kDefaultAllocAlignment || offset != 0U) {
+        PoolAlignmentError(alignment, offset);
+      }
+      return pool_->Allocate();
+    }
+    return AlignedAlloc(n, alignment);
+  }
+  void deallocate(void *p, size_t n) {
+    if (p == nullptr) {
+      return;
+    }
+    if (pool_ != nullptr && n <= pool_->block_size()) {
+      pool_->Free(p);
+    }
+    else {
+      AlignedFree(p);
+    }
+  }
+
+  FixedSizePool *pool() const { return pool_; }
+  const char *get_name() const { return name_; }
+  void set_name(const char *name) { name_ = name; }
+
+ private:
+  FixedSizePool *pool_;
+  const char *name_;
+
+}; // class PoolAllocator
+
+inline bool operator==(const PoolAllocator &a, const PoolAllocator &b) {
+  return a.pool() == b.pool();
+}
+inline bool operator!=(const PoolAllocator &a, const PoolAllocator &b) {
+  return a.pool() != b.pool();
+}
+
+} // namespace vks
+
+#endif
@@ -20,9 +20,45 @@ class Mesh {
   uint32_t vertex_offset() const { return vertex_offset_; }
   uint32_t material_id() const { return material_id_; }
   const glm::mat4 &model_mat() const { return model_mat_; }
+  // Offset (xyz) and scale (w) of the mesh's quantized positions
+  const glm::vec4 &position_dequant() const { return position_dequant_; }
+  // Range of the mesh's meshlets in its model; meshes without any are drawn
+  // whole
+  uint32_t first_meshlet() const { return first_meshlet_; }
+  uint32_t meshlets_count() const { return meshlets_count_; }
+  // Range of the mesh's simplified versions in its model, finest first
+  uint32_t first_lod() const { return first_lod_; }
+  uint32_t lods_count() const { return lods_count_; }
+  // Centre (xyz) and radius (w) of the mesh's float positions
+  const glm::vec4 &bounding_sphere() const { return bounding_sphere_; }
+  // Axis aligned box of the same positions; meshes whose sphere has no
+  // radius have no bounds
+  const glm::vec3 &bounds_min() const { return bounds_min_; }
+  const glm::vec3 &bounds_max() const { return bounds_max_; }
 	uint32_t dynamic_ubo_offset() const { return dynamic_ubo_offset_; }
 
   void set_model_mat(const glm::mat4 &mat) { model_mat_ = mat; }
+  void set_vertex_offset(uint32_t vertex_offset) {
+    vertex_offset_ = vertex_offset;
+  }
+  void set_position_dequant(const glm::vec4 &position_dequant) {
+    position_dequant_ = position_dequant;
+  }
+  void set_meshlets(uint32_t first_meshlet, uint32_t meshlets_count) {
+    first_meshlet_ = first_meshlet;
+    meshlets_count_ = meshlets_count;
+  }
+  void set_lods(uint32_t first_lod, uint32_t lods_count) {
+    first_lod_ = first_lod;
+    lods_count_ = lods_count;
+  }
+  void set_bounding_sphere(const glm::vec4 &bounding_sphere) {
+    bounding_sphere_ = bounding_sphere;
+  }
+  void set_bounds(const glm::vec3 &bounds_min, const glm::vec3 &bounds_max) {
+    bounds_min_ = bounds_min;
+    bounds_max_ = bounds_max;
+  }
 	void set_dynamic_ubo_offset(const uint32_t offset) {
 		dynamic_ubo_offset_ = offset;
 	}
@@ -34,6 +70,14 @@ class Mesh {
   // ID of the material this mesh uses, as stored in the material manager 
   uint32_t material_id_;
   glm::mat4 model_mat_;
+  glm::vec4 position_dequant_;
+  uint32_t first_meshlet_;
+  uint32_t meshlets_count_;
+  uint32_t first_lod_;
+  uint32_t lods_count_;
+  glm::vec4 bounding_sphere_;
+  glm::vec3 bounds_min_;
+  glm::vec3 bounds_max_;
 	// The offset within the model's dynamic ubo for the model mat of this
 	// mesh
 	uint32_t dynamic_ubo_offset_;
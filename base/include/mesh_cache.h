@@ -0,0 +1,77 @@
+#ifndef VKS_MESHCACHE
+#define VKS_MESHCACHE
+
+#include <cstdint>
+#include <EASTL/string.h>
+#include <EASTL/vector.h>
+#include <mesh.h>
+#include <meshlets.h>
+#include <mesh_lods.h>
+#include <mapped_file.h>
+#include <material_constants.h>
+#include <material_instance.h>
+
+namespace vks {
+
+class ModelBuilder;
+class VertexSetup;
+
+// Bump whenever the layout of the cache files changes
+extern const uint32_t kMeshCacheVersion;
+
+// Material of a baked model, in a form which can be stored in the cache
+struct MeshCacheMaterial {
+  eastl::string name;
+  MaterialConstants consts;
+  eastl::vector<MaterialBuilderTexture> textures;
+}; // struct MeshCacheMaterial
+
+// Contents of a mesh cache; vertex and index data point inside the mapped
+// cache file, so they are only valid while it stays open
+struct MeshCacheContents {
+  eastl::vector<const void *> vertex_streams;
+  eastl::vector<uint32_t> vertex_streams_sizes;
+  const uint32_t *indices;
+  uint32_t indices_count;
+  eastl::vector<Mesh> meshes;
+  eastl::vector<Meshlet> meshlets;
+  eastl::vector<MeshLod> lods;
+  eastl::vector<MeshCacheMaterial> materials;
+}; // struct MeshCacheContents
+
+// Name of the cache file baked from the given model file
+eastl::string GetMeshCacheFilename(const eastl::string &model_filename);
+
+/**
+ * @brief Map the cache baked from a model file and read its contents.
+ *
+ * @param model_filename Source model; the cache is stale if it changed
+ * @param post_process_steps Import flags the cache must have been baked with
+ * @param vertex_setup Layout the cache's vertex streams must be in
+ * @param cache_file Mapping of the cache, which backs the contents
+ * @param contents Where the contents are returned
+ *
+ * @return False if the cache is missing, stale, or was baked with different
+ *   settings
+ */
+bool ReadMeshCache(
+    const eastl::string &model_filename,
+    uint32_t post_process_steps,
+    const VertexSetup &vertex_setup,
+    MappedFile &cache_file,
+    MeshCacheContents &contents);
+
+/**
+ * @brief Bake the packed data of a model into its cache file.
+ *
+ * @return False if the cache couldn't be written
+ */
+bool WriteMeshCache(
+    const eastl::string &model_filename,
+    uint32_t post_process_steps,
+    const ModelBuilder &model_builder,
+    const eastl::vector<MeshCacheMaterial> &materials);
+
+} // namespace vks
+
+#endif
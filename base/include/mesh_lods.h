@@ -0,0 +1,90 @@
+#ifndef VKS_MESHLODS
+#define VKS_MESHLODS
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <EASTL/vector.h>
+
+namespace vks {
+
+// Most simplified levels generated for a mesh, on top of the mesh itself
+extern const uint32_t kMaxMeshLods;
+
+// Simplified version of a mesh, drawn from the same vertices
+struct MeshLod {
+  // Range in the model's index buffer
+  uint32_t first_index;
+  uint32_t indices_count;
+  // Largest distance from the original surface, in the units of the mesh's
+  // float positions
+  float error;
+}; // struct MeshLod
+
+/**
+ * @brief Simplify a triangle list by collapsing edges in order of their
+ *   quadric error (Garland and Heckbert, 1997). Vertices are only merged
+ *   into each other, so the result indexes the same vertices; vertices on
+ *   borders, which include attribute seams, never move.
+ *
+ * @param indices Triangle list, indexing the positions
+ * @param indices_count Number of indices
+ * @param positions Vertex positions, as 3 floats each
+ * @param positions_stride Bytes between positions
+ * @param vertices_count Number of vertices
+ * @param target_indices_count Size to stop at
+ * @param max_error Error no collapse is allowed to exceed
+ * @param result Where the simplified list is returned
+ *
+ * @return Error of the simplified list, as in MeshLod
+ */
+float SimplifyMesh(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t positions_stride,
+    uint32_t vertices_count,
+    uint32_t target_indices_count,
+    float max_error,
+    eastl::vector<uint32_t> &result);
+
+/**
+ * @brief Build a chain of LODs of a mesh, each with about half the triangles
+ *   of the previous one, stopping early once simplifying stops paying off.
+ *
+ * @param lod_indices Where the triangle lists of all the LODs are returned
+ * @param lods Where the LODs are returned, finest first; their ranges are
+ *   within lod_indices
+ */
+void BuildMeshLods(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t positions_stride,
+    uint32_t vertices_count,
+    eastl::vector<uint32_t> &lod_indices,
+    eastl::vector<MeshLod> &lods);
+
+/**
+ * @brief Pick the coarsest LOD whose error projects to at most a pixel.
+ *
+ * @param lods LODs of the mesh, finest first
+ * @param lods_count Number of LODs
+ * @param model_mat Model matrix of the mesh, assumed to scale uniformly
+ * @param bounding_sphere Bounds of the mesh, in the space of its positions
+ * @param viewer_position World space position of the viewer
+ * @param pixels_per_unit Pixels a unit long object covers at a distance of
+ *   one unit from the viewer
+ *
+ * @return 0 for the mesh itself, i + 1 for lods[i]
+ */
+uint32_t SelectMeshLod(
+    const MeshLod *lods,
+    uint32_t lods_count,
+    const glm::mat4 &model_mat,
+    const glm::vec4 &bounding_sphere,
+    const glm::vec3 &viewer_position,
+    float pixels_per_unit);
+
+} // namespace vks
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef VKS_MESHOPTIMIZER
+#define VKS_MESHOPTIMIZER
+
+#include <cstdint>
+#include <EASTL/vector.h>
+
+namespace vks {
+
+// Post-transform cache size the optimizations and the analysis assume
+extern const uint32_t kVertexCacheSize;
+
+// Vertices transformed by a FIFO post-transform cache while drawing
+struct VertexCacheStats {
+  VertexCacheStats();
+
+  void Merge(const VertexCacheStats &other);
+  // Average cache miss ratio, transformed vertices per triangle
+  float GetACMR() const;
+  // Average transform to vertex ratio, 1 at best
+  float GetATVR() const;
+
+  uint32_t transformed_vertices_count;
+  uint32_t triangles_count;
+  uint32_t vertices_count;
+}; // struct VertexCacheStats
+
+// Simulate a FIFO cache of the given size over a triangle list
+VertexCacheStats AnalyzeVertexCache(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    uint32_t vertices_count,
+    uint32_t cache_size);
+
+/**
+ * @brief Reorder triangles for the post-transform cache, with Tipsify
+ *   (Sander et al., 2007).
+ *
+ * @param indices Triangle list to reorder in place
+ * @param indices_count Number of indices
+ * @param vertices_count Number of vertices referenced
+ * @param clusters Where the first triangle of each fan which restarted after
+ *   a dead end is returned, if not nullptr; they are the candidate
+ *   boundaries for OptimizeOverdraw
+ */
+void OptimizeVertexCache(
+    uint32_t *indices,
+    uint32_t indices_count,
+    uint32_t vertices_count,
+    eastl::vector<uint32_t> *clusters);
+
+/**
+ * @brief Reorder clusters of a cache optimised triangle list so that the
+ *   outer ones, which are likely to occlude the rest, are drawn first.
+ *
+ * @param indices Triangle list to reorder in place
+ * @param indices_count Number of indices
+ * @param positions Vertex positions, as 3 floats each
+ * @param positions_stride Bytes between positions
+ * @param vertices_count Number of vertices
+ * @param clusters Candidate boundaries, from OptimizeVertexCache
+ * @param threshold How much the ACMR may worsen for finer clusters
+ */
+void OptimizeOverdraw(
+    uint32_t *indices,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t positions_stride,
+    uint32_t vertices_count,
+    const eastl::vector<uint32_t> &clusters,
+    float threshold);
+
+/**
+ * @brief Order vertices by first use, so that fetching them walks memory
+ *   linearly; the indices are remapped in place.
+ *
+ * @param remap Where the new position of each vertex is returned; unused
+ *   vertices go last
+ */
+void OptimizeVertexFetch(
+    uint32_t *indices,
+    uint32_t indices_count,
+    uint32_t vertices_count,
+    eastl::vector<uint32_t> &remap);
+
+// Move vertices of stride bytes to their remapped positions, in place
+void RemapVertices(
+    uint8_t *vertices,
+    uint32_t vertices_count,
+    uint32_t stride,
+    const eastl::vector<uint32_t> &remap);
+
+} // namespace vks
+
+#endif
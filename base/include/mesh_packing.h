@@ -0,0 +1,117 @@
+#ifndef VKS_MESHPACKING
+#define VKS_MESHPACKING
+
+#include <cstdint>
+#include <EASTL/vector.h>
+#include <glm/glm.hpp>
+#include <meshlets.h>
+#include <mesh_lods.h>
+
+struct aiMesh;
+
+namespace vks {
+
+class VertexSetup;
+struct VertexCacheStats;
+struct VertexQuantizationError;
+
+// Where a mesh's vertices and indices go in the packed streams
+struct PackedMeshRange {
+  uint32_t first_vertex;
+  uint32_t vertices_count;
+  uint32_t first_index;
+  uint32_t indices_count;
+}; // struct PackedMeshRange
+
+// Data derived from a mesh's optimised triangles
+struct PackedMeshExtras {
+  // Ranges in the mesh's index range
+  eastl::vector<Meshlet> meshlets;
+  // Ranges in lod_indices, which are offset by the mesh's first vertex like
+  // its own indices
+  eastl::vector<MeshLod> lods;
+  eastl::vector<uint32_t> lod_indices;
+  // Bounds of the mesh's float positions
+  glm::vec4 bounding_sphere;
+  glm::vec3 bounds_min;
+  glm::vec3 bounds_max;
+}; // struct PackedMeshExtras
+
+/**
+ * @brief Prefix sum the vertex and index counts of consecutive meshes, so
+ *   that each of them can be packed independently.
+ *
+ * @param meshes Meshes to pack; all faces must be triangles
+ * @param meshes_count Number of meshes
+ * @param ranges Where the range of each mesh is returned
+ * @param total_vertices Where the total number of vertices is returned
+ * @param total_indices Where the total number of indices is returned
+ */
+void ComputePackedMeshRanges(
+    const aiMesh *const *meshes,
+    uint32_t meshes_count,
+    eastl::vector<PackedMeshRange> &ranges,
+    uint32_t *total_vertices,
+    uint32_t *total_indices);
+
+/**
+ * @brief Convert meshes into the given vertex layout, writing straight into
+ *   preallocated streams; meshes are processed in parallel on the worker pool.
+ *   Indices are offset by each mesh's first vertex.
+ *
+ * @param meshes Meshes to pack
+ * @param ranges Their ranges, from ComputePackedMeshRanges
+ * @param meshes_count Number of meshes
+ * @param post_process_steps Flags the meshes were imported with
+ * @param vertex_setup Layout of the vertex streams
+ * @param streams One buffer per stream of the vertex layout, large enough
+ *   for all the vertices
+ * @param indices Index stream, large enough for all the indices
+ * @param position_dequants Where the bounds of each mesh's quantized
+ *   positions are returned; can be nullptr if positions aren't quantized
+ * @param errors Where the quantization error of each element is accumulated;
+ *   can be nullptr
+ */
+void PackAssimpMeshes(
+    const aiMesh *const *meshes,
+    const PackedMeshRange *ranges,
+    uint32_t meshes_count,
+    uint32_t post_process_steps,
+    const VertexSetup &vertex_setup,
+    uint8_t *const *streams,
+    uint32_t *indices,
+    glm::vec4 *position_dequants,
+    VertexQuantizationError *errors);
+
+/**
+ * @brief Reorder the triangles of packed meshes for the post-transform cache
+ *   and overdraw, split them into meshlets and simplify them into LODs, then
+ *   reorder their vertices for fetching; meshes are processed in parallel on
+ *   the worker pool.
+ *
+ * @param meshes Meshes which were packed, for their float positions
+ * @param ranges Their ranges in the streams
+ * @param meshes_count Number of meshes
+ * @param vertex_setup Layout of the vertex streams
+ * @param streams One buffer per stream of the vertex layout
+ * @param indices Index stream
+ * @param stats_before Where the cache stats of the imported order are
+ *   accumulated; can be nullptr
+ * @param stats_after Same, for the optimised order; can be nullptr
+ * @param extras Where the meshlets, LODs and bounds of each mesh are
+ *   returned; can be nullptr to skip building them
+ */
+void OptimizePackedMeshes(
+    const aiMesh *const *meshes,
+    const PackedMeshRange *ranges,
+    uint32_t meshes_count,
+    const VertexSetup &vertex_setup,
+    uint8_t *const *streams,
+    uint32_t *indices,
+    VertexCacheStats *stats_before,
+    VertexCacheStats *stats_after,
+    PackedMeshExtras *extras);
+
+} // namespace vks
+
+#endif
@@ -39,15 +39,36 @@ class MeshesHeapBuilder {
   void AddMesh(
       uint32_t mat_id,
       uint32_t num_idxs);
+  // Add a mesh whose indices have already been allocated
+  void AddMesh(
+      uint32_t mat_id,
+      uint32_t start_idx,
+      uint32_t num_idxs);
 
   void AddIndex(uint32_t index);
   void AddVertex(const Vertex &vertex);
 
-  const eastl::vector<uint8_t> vertices_data(uint32_t i) const {
+  // Bulk versions of the above; each stream is grown once and then filled
+  // by the packer of its element type
+  void AddIndices(const uint32_t *indices, uint32_t count);
+  void AddVertices(const Vertex *vertices, uint32_t count);
+  void ReserveVertices(uint32_t num_vtxs);
+  void ReserveIndices(uint32_t num_idxs);
+
+  // Grow the streams by the given number of vertices/indices, which are
+  // then written in place; used to pack meshes in parallel
+  void ResizeVertices(uint32_t num_vtxs);
+  void ResizeIndices(uint32_t num_idxs);
+  uint8_t *GetVertexStreamWriteData(uint32_t i) {
+    return vertices_data_[i].data();
+  }
+  uint32_t *GetIndicesWriteData() { return indices_data_.data(); }
+
+  const eastl::vector<uint8_t> &vertices_data(uint32_t i) const {
     return vertices_data_[i];
   }
-  const eastl::vector<uint32_t> indices_data() const { return indices_data_; }
-  const eastl::vector<Mesh> meshes() const { return meshes_; }
+  const eastl::vector<uint32_t> &indices_data() const { return indices_data_; }
+  const eastl::vector<Mesh> &meshes() const { return meshes_; }
   uint32_t current_vertex() const { return current_vertex_; }
   const VertexSetup *vtx_setup() const { return vtx_setup_; }
   VkDescriptorPool desc_pool() const { return desc_pool_;  }
@@ -57,7 +78,8 @@ class MeshesHeapBuilder {
   eastl::vector<uint32_t> indices_data_;
   const VertexSetup *vtx_setup_;
   eastl::vector<Mesh> meshes_;
-  uint32_t size_;
+  // Element sizes of the layout, cached to avoid a lookup per vertex
+  eastl::vector<uint32_t> element_sizes_;
   uint32_t current_vertex_;
   VkDescriptorPool desc_pool_;
 
@@ -0,0 +1,63 @@
+#ifndef VKS_MESHLETS
+#define VKS_MESHLETS
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <EASTL/vector.h>
+
+namespace vks {
+
+// Limits of a meshlet, the ones mesh shading hardware favours
+extern const uint32_t kMeshletMaxVertices;
+extern const uint32_t kMeshletMaxTriangles;
+
+// Run of a mesh's triangles which is culled as a whole; its bounds are in
+// the space of the mesh's float positions, before any quantization
+struct Meshlet {
+  // Range in the model's index buffer
+  uint32_t first_index;
+  uint32_t indices_count;
+  // Centre (xyz) and radius (w)
+  glm::vec4 bounding_sphere;
+  // All the triangles face away from viewers for which
+  // dot(normalize(cone_apex - viewer), axis) >= cutoff; the axis is in xyz
+  // and the cutoff in w, and a cutoff of 1 never culls
+  glm::vec3 cone_apex;
+  glm::vec4 cone_axis_cutoff;
+}; // struct Meshlet
+
+/**
+ * @brief Split a triangle list into meshlets, scanning it in order; the
+ *   list should be optimised for the vertex cache first so that the
+ *   meshlets are compact.
+ *
+ * @param indices Triangle list, indexing the positions
+ * @param indices_count Number of indices
+ * @param positions Vertex positions, as 3 floats each
+ * @param positions_stride Bytes between positions
+ * @param vertices_count Number of vertices
+ * @param first_index Where the list starts in the index buffer, which the
+ *   ranges of the meshlets are offset by
+ * @param meshlets Where the meshlets are appended
+ */
+void BuildMeshlets(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t positions_stride,
+    uint32_t vertices_count,
+    uint32_t first_index,
+    eastl::vector<Meshlet> &meshlets);
+
+// Whether a meshlet of a mesh with the given model matrix is outside the
+// frustum or facing away from the viewer, both in world space; the matrix is
+// assumed to scale uniformly
+bool IsMeshletCulled(
+    const Meshlet &meshlet,
+    const glm::mat4 &model_mat,
+    const glm::vec4 *frustum_planes,
+    const glm::vec3 &viewer_position);
+
+} // namespace vks
+
+#endif
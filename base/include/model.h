@@ -1,13 +1,17 @@
 #ifndef VKS_MODEL
 #define VKS_MODEL
 
+#include <geometry_arena.h>
 #include <mesh.h>
+#include <meshlets.h>
+#include <mesh_lods.h>
 #include <vulkan_buffer.h>
 #include <EASTL/vector.h>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtx/hash.hpp>
 #include <vulkan_tools.h>
+#include <frustum.h>
 #include <map>
 #include <renderer_type.h>
 #include <vertex_setup.h>
@@ -24,7 +28,6 @@ struct Vertex {
   glm::vec3 bitangent;
   glm::vec3 tangent;
 
-  // Used by std::map to hash a vertex
   bool operator==(const Vertex &other) const {
     return (pos == other.pos &&
             normal == other.normal && 
@@ -36,25 +39,6 @@ struct Vertex {
   
 }; // struct Vertex
 
-} // namespace vks
-
-
-namespace std {
-
-// Used by std::map to hash a Vertex
-template<> struct hash<vks::Vertex> {
-  size_t operator()(const vks::Vertex &vertex) const {
-    return ((hash<glm::vec3>()(vertex.pos) ^
-            (hash<glm::vec3>()(vertex.normal) << 1)) >> 1) ^ 
-            (hash<glm::vec2>()(vertex.uv) << 1);
-  }
-}; // template<> struct hash<vks::Vertex>
-
-} // namespace std
-
-
-namespace vks {
-
 extern const uint32_t kModelMatsBindingPos;
 
 class VulkanDevice;
@@ -69,15 +53,60 @@ class ModelBuilder {
   void AddIndex(uint32_t index);
   void AddVertex(const Vertex &vertex);
   void AddMesh(const Mesh *mesh);
+  // Meshlets are indexed by the meshes through Mesh::set_meshlets
+  void AddMeshlets(const Meshlet *meshlets, uint32_t count);
+  // Same, through Mesh::set_lods; their indices have to be added too
+  void AddMeshLods(const MeshLod *lods, uint32_t count);
+
+  // Bulk versions of the above; each stream is grown once and then filled
+  // by the packer of its element type
+  void AddIndices(const uint32_t *indices, uint32_t count);
+  void AddVertices(const Vertex *vertices, uint32_t count);
+  void ReserveVertices(uint32_t vertices_count);
+  void ReserveIndices(uint32_t indices_count);
 
+  // Bounds which AddVertices quantizes positions within, if the layout
+  // quantizes them; see ComputePositionDequant
+  void set_position_dequant(const glm::vec4 &position_dequant) {
+    position_dequant_ = position_dequant;
+  }
+
+  // Append a whole array of one element, already in the layout's format;
+  // call it for every element of the layout with the same number of vertices
   void AddVertexElementArray(const void *data, uint32_t size,
                              VertexElementType type);
 
-  const eastl::vector<uint8_t> vertices_data(uint32_t i) const {
+  // Use data which lives elsewhere, eg. in a memory mapped mesh cache,
+  // instead of copying it in; it has to stay valid until the model has been
+  // created
+  void SetExternalVertexStream(uint32_t stream_idx, const void *data,
+                               uint32_t size);
+  void SetExternalIndices(const uint32_t *indices, uint32_t count);
+
+  // Grow the streams by the given number of vertices/indices, which are
+  // then written in place through GetVertexStreamWriteData and
+  // GetIndicesWriteData; used to pack meshes in parallel
+  void ResizeVertices(uint32_t vertices_count);
+  void ResizeIndices(uint32_t indices_count);
+  uint8_t *GetVertexStreamWriteData(uint32_t i) {
+    return vertices_data_[i].data();
+  }
+  uint32_t *GetIndicesWriteData() { return indices_data_.data(); }
+
+  // Vertex data of each stream of the layout and index data, wherever it is
+  // stored
+  const void *GetVertexStreamData(uint32_t i) const;
+  uint32_t GetVertexStreamDataSize(uint32_t i) const;
+  const uint32_t *GetIndicesData() const;
+  uint32_t GetIndicesCount() const;
+
+  const eastl::vector<uint8_t> &vertices_data(uint32_t i) const {
     return vertices_data_[i];
   }
-  const eastl::vector<uint32_t> indices_data() const { return indices_data_; }
-  const eastl::vector<const Mesh *> meshes() const { return meshes_; }
+  const eastl::vector<uint32_t> &indices_data() const { return indices_data_; }
+  const eastl::vector<const Mesh *> &meshes() const { return meshes_; }
+  const eastl::vector<Meshlet> &meshlets() const { return meshlets_; }
+  const eastl::vector<MeshLod> &lods() const { return lods_; }
   uint32_t current_vertex() const { return current_vertex_; }
   uint32_t vertex_size() const { return vertex_size_; }
   const VertexSetup *vertex_setup() const { return vertex_setup_; }
@@ -86,7 +115,18 @@ class ModelBuilder {
  private:
   eastl::vector<eastl::vector<uint8_t>> vertices_data_;
   eastl::vector<uint32_t> indices_data_;
+  eastl::vector<const void *> external_vertices_data_;
+  eastl::vector<uint32_t> external_vertices_sizes_;
+  const uint32_t *external_indices_;
+  uint32_t external_indices_count_;
   eastl::vector<const Mesh *> meshes_;
+  eastl::vector<Meshlet> meshlets_;
+  eastl::vector<MeshLod> lods_;
+  // Element sizes of the layout, cached to avoid a lookup per vertex
+  eastl::vector<uint32_t> element_sizes_;
+  // Vertices filled in so far for each element by AddVertexElementArray
+  eastl::vector<uint32_t> element_vertices_counts_;
+  glm::vec4 position_dequant_;
   uint32_t vertex_size_;
   uint32_t current_vertex_;
   const VertexSetup *vertex_setup_;
@@ -109,16 +149,109 @@ class Model {
   }
 
   const eastl::vector<Mesh> &meshes() const { return meshes_; }
+  const eastl::vector<Meshlet> &meshlets() const { return meshlets_; }
+  const eastl::vector<MeshLod> &lods() const { return lods_; }
   uint32_t GetMeshesCount() const { return SCAST_U32(meshes_.size()); }
+  // 16-bit whenever each mesh spans few enough vertices
+  VkIndexType index_type() const { return index_type_; }
+
+  // Hand the range of vertices and indices over, eg. to evict the model,
+  // which can't be drawn until RestoreGeometry() is called with the same
+  // data
+  GeometryRangeId ReleaseGeometry();
+  void RestoreGeometry(const VulkanDevice &device,
+                       const ModelBuilder &builder);
+  // Device memory of the vertices and indices
+  VkDeviceSize GetGeometrySize() const;
+
+  // Arena holding the vertices and indices, shared by the models with the
+  // same vertex streams; binding its buffers once is enough to draw all of
+  // them
+  GeometryArena *geometry_arena() const { return geometry_arena_; }
+  // Where the model's vertices and indices are in the arena; only valid
+  // while they are resident
+  const GeometryRange &GetGeometryRange() const {
+    return geometry_arena_->range(geometry_range_);
+  }
 
   void BindVertexBuffer(VkCommandBuffer cmd_buff) const;
+  // Bind only the stream holding the positions, at binding 0
+  void BindPositionBuffer(VkCommandBuffer cmd_buff) const;
   void BindIndexBuffer(VkCommandBuffer cmd_buff) const;
 
+  /**
+   * @brief Pick the LOD of each mesh from its size on screen and cull the
+   *   meshlets of the meshes drawn whole, then write the indirect draws which
+   *   RenderMeshesByMaterial issues; does nothing for models without LODs
+   *   or meshlets.
+   *
+   * @param proj Projection matrix of the frame
+   * @param view View matrix of the frame
+   * @param viewport_height Height of the viewport in pixels
+   * @param meshes_visible Which meshes CullMeshes kept; the draws of the
+   *   others are emptied
+   * @param draws_read_fence Signaled once the last submission which read the
+   *   draws has completed; it is waited on before they are rewritten in place
+   */
+  void UpdateDraws(
+      const VulkanDevice &device,
+      const glm::mat4 &proj,
+      const glm::mat4 &view,
+      float viewport_height,
+      const uint8_t *meshes_visible,
+      VkFence draws_read_fence);
+
+  /**
+   * @brief Test the bounds of every mesh against the frustum, writing 1 or 0
+   *   for each; meshes loaded without bounds always pass.
+   *
+   * @return Whether any mesh passed, ie. the model is used by the frame
+   */
+  bool CullMeshes(const szt::Frustum &frustum, uint8_t *meshes_visible) const;
+
   void RenderMeshesByMaterial(
       VkCommandBuffer cmd_buff,
       VkPipelineLayout pipe_layout,
       uint32_t desc_set_slot) const;
 
+  // Commands WriteDraws writes: one per meshlet of each mesh, or one per
+  // mesh
+  uint32_t GetDrawsCount() const;
+
+  /**
+   * @brief Write the draws UpdateDraws would pick for the frame into memory
+   *   shared with the draws of other models, so that all of them can be
+   *   issued by a few indirect calls. The first instance of each command is
+   *   the ID of its mesh, which the shaders index the mesh data with.
+   *
+   * @param meshes_visible Which meshes CullMeshes kept
+   * @param first_mesh_id ID of the model's first mesh among the meshes of
+   *   every model drawn together
+   * @param draws Where GetDrawsCount() commands are written
+   */
+  void WriteDraws(
+      const glm::mat4 &proj,
+      const glm::mat4 &view,
+      float viewport_height,
+      const uint8_t *meshes_visible,
+      uint32_t first_mesh_id,
+      VkDrawIndexedIndirectCommand *draws) const;
+
+  // Model matrix of a mesh as the shaders get it, which maps quantized
+  // positions back to model space
+  glm::mat4 GetMeshModelMatrix(uint32_t mesh_idx) const;
+  // Bounds of a mesh in world space, assuming its model matrix scales
+  // uniformly; the radius is 0 for meshes loaded without bounds
+  glm::vec4 GetMeshBoundingSphere(uint32_t mesh_idx) const;
+  // Same, as an axis aligned box around the transformed box of the mesh
+  void GetMeshBoundingBox(
+      uint32_t mesh_idx,
+      glm::vec3 *box_min,
+      glm::vec3 *box_max) const;
+  uint32_t GetMeshMaterialId(uint32_t mesh_idx) const {
+    return meshes_[mesh_idx].material_id();
+  }
+
   uint32_t NumMeshes() const;
 
   /**
@@ -130,21 +263,43 @@ class Model {
   void SetModelMatrixForAllMeshes(const glm::mat4 &mat);
 
  private:
+  void AllocateGeometry(const VulkanDevice &device,
+                        const ModelBuilder &builder);
   void CreateBuffers(const VulkanDevice &device,
                      const ModelBuilder &builder);
   void CreateDescriptorSet(const VulkanDevice &device,
                            VkDescriptorSetLayout heap_set_layout);
   void WriteDescriptorSet(const VulkanDevice &device);
+  uint32_t GetMeshFirstDraw(uint32_t mesh_idx) const;
+  // Draws of UpdateDraws and WriteDraws; their first instance is only set
+  // to the mesh IDs if mesh_ids is
+  void WriteFrameDraws(
+      const glm::mat4 &proj,
+      const glm::mat4 &view,
+      float viewport_height,
+      const uint8_t *meshes_visible,
+      bool mesh_ids,
+      uint32_t first_mesh_id,
+      VkDrawIndexedIndirectCommand *draws) const;
   
   eastl::vector<Mesh> meshes_;
-  eastl::vector<VulkanBuffer> vertex_buffers_;     
-  VulkanBuffer index_buffer_;
+  eastl::vector<Meshlet> meshlets_;
+  eastl::vector<MeshLod> lods_;
+  // First indirect command of each mesh, which has one per meshlet or a
+  // single one; empty if the meshes are drawn directly
+  eastl::vector<uint32_t> first_draws_;
+  GeometryArena *geometry_arena_;
+  GeometryRangeId geometry_range_;
+  VkIndexType index_type_;
   VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info_;
   eastl::vector<VkVertexInputBindingDescription> bindings_;
   eastl::vector<VkVertexInputAttributeDescription> attributes_;
   VulkanBuffer model_matxs_buff_;
   VulkanBuffer materialIDs_buff_;
+  // Rewritten every frame by UpdateDraws, once the frame reading it is done
   VulkanBuffer indirect_draws_buff_;
+  // Whether a mesh's commands can be drawn by a single indirect call
+  bool multi_draw_indirect_;
   VkDescriptorSet desc_set_;
   VkDescriptorPool desc_pool_;
   const VertexSetup *vtx_setup_;
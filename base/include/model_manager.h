@@ -3,21 +3,39 @@
 
 #include <EASTL/string.h>
 #include <EASTL/hash_map.h>
+#include <EASTL/vector.h>
 #include <assimp/postprocess.h>
 #include <vertex_setup.h>
 #include <vulkan_buffer.h>
 #include <EASTL/unique_ptr.h>
 #include <renderer_type.h>
+#include <vulkan_upload_manager.h>
+#include <geometry_arena.h>
+#include <memory_allocators.h>
 
 namespace vks {
 
 class VulkanDevice;
 class Model;
 class ModelBuilder;
+struct MeshCacheMaterial;
+struct ModelImport;
 
 extern const eastl::string kBaseAssetsPath;
 extern const eastl::string kBaseModelAssetsPath;
 
+// Identifies a model being loaded in the background
+typedef uint32_t ModelLoadHandle;
+
+enum class ModelLoadState : uint8_t {
+  // Being imported and having its textures decoded on a worker thread
+  IMPORTING = 0U,
+  // Created, with its uploads in flight
+  UPLOADING,
+  // Resident; the model can be registered with a renderer
+  READY
+}; // enum class ModelLoadState
+
 struct MeshesModelMatrices {
   VulkanBuffer buff;
   uint32_t num_meshes;
@@ -26,6 +44,7 @@ struct MeshesModelMatrices {
 class ModelManager {
  public:
   ModelManager();
+  ~ModelManager();
 
   void LoadObjModel(
       const VulkanDevice &device,
@@ -42,12 +61,75 @@ class ModelManager {
       const VertexSetup &vertex_setup,
       Model **model) const;
 
+  /**
+   * @brief Start loading a model in the background, as LoadOtherModel() does.
+   *   The file is imported, packed and its textures decoded on a worker
+   *   thread; the model is then created by UpdateAsyncLoads(), so the
+   *   calling thread can keep rendering meanwhile.
+   *
+   * @return Handle to follow the load with
+   */
+  ModelLoadHandle LoadOtherModelAsync(
+      const eastl::string &name,
+      const eastl::string &material_dir,
+      uint32_t assimp_post_process_steps,
+      const VertexSetup &vertex_setup);
+
+  /**
+   * @brief Move the background loads along; to be called once per frame by
+   *   the thread which owns the device. The models whose import has finished
+   *   are created, and their uploads submitted in a single batch.
+   */
+  void UpdateAsyncLoads(const VulkanDevice &device);
+
+  ModelLoadState GetLoadState(ModelLoadHandle handle) const;
+
+  // The model of a background load once it is resident, or nullptr
+  Model *GetLoadedModel(ModelLoadHandle handle) const;
+
+  /**
+   * @brief Record that a model is used by the current frame, so that it isn't
+   *   evicted; if it or any of its textures were, they start being reloaded
+   *   in the background.
+   *
+   * @return Whether the model's geometry is resident, ie. it can be drawn
+   */
+  bool MarkModelUsed(const Model &model);
+
+  // Models which aren't loaded from a file are always resident
+  bool IsModelResident(const Model &model) const;
+
+  // Release the vertex and index buffers of a model; called by the residency
+  // manager, and undone by reloading the model
+  void EvictModel(const VulkanDevice &device, const eastl::string &name);
+
   void CreateModel(
       const VulkanDevice &device,
       const eastl::string &name,
       const ModelBuilder &model_builder,
       Model **model) const;
 
+  /**
+   * @brief Arena which the models with a vertex layout store their geometry
+   *   in; models whose layouts have the same streams share it.
+   *
+   * @param vertices_count Vertices the arena is created with room for, if
+   *   there is none for the layout yet
+   * @param index_bytes Same, for the indices
+   */
+  GeometryArena *GetGeometryArena(
+      const VulkanDevice &device,
+      const VertexSetup &vertex_setup,
+      uint32_t vertices_count,
+      VkDeviceSize index_bytes);
+
+  // Compact every geometry arena, eg. after unloading or evicting models;
+  // blocks until the data has moved
+  void CompactGeometry(const VulkanDevice &device);
+
+  // Changes whenever a geometry arena moves its data to new buffers
+  uint32_t GetGeometryGeneration() const;
+
   /**
    * @brief Create UBO array of all the model matrices, for each model
    *
@@ -89,6 +171,10 @@ class ModelManager {
   }
 
  private:
+  struct AsyncModelLoad;
+  struct ResidentModel;
+  typedef eastl::vector<eastl::unique_ptr<AsyncModelLoad>> AsyncModelLoadList;
+
   // List of all models 
   typedef eastl::hash_map<eastl::string,
               eastl::unique_ptr<Model>> NameModelMap;
@@ -97,12 +183,56 @@ class ModelManager {
   VkSampler aniso_sampler_;
   eastl::string shade_material_name_;
   VkDescriptorPool sets_desc_pool_;
+  AsyncModelLoadList async_loads_;
+  // Loads bringing back evicted models, which go once they are done
+  AsyncModelLoadList reloads_;
+  // Looked up for every model each frame; the nodes come from a pool, next
+  // to each other rather than scattered over the heap. The pool is declared
+  // first so that it outlives the map, which is only used by the main thread
+  typedef eastl::hash_map<const Model *,
+              eastl::unique_ptr<ResidentModel>,
+              eastl::hash<const Model *>,
+              eastl::equal_to<const Model *>,
+              PoolAllocator> ResidentModelMap;
+  FixedSizePool resident_models_pool_;
+  mutable ResidentModelMap resident_models_;
+  eastl::vector<eastl::unique_ptr<GeometryArena>> geometry_arenas_;
+
+  void CreateImportedModel(
+      const VulkanDevice &device,
+      ModelImport &import,
+      Model **model) const;
+
+  void RestoreImportedModel(
+      const VulkanDevice &device,
+      ModelImport &import,
+      Model &model,
+      const ResidentModel &resident) const;
+
+  void ReloadModel(const Model &model, ResidentModel &resident);
+
+  // Create the model of a finished import; returns false if there was none
+  bool FinishImport(const VulkanDevice &device, AsyncModelLoad &load);
+
+  // Follow the upload of a created model, covered by ticket if it was just
+  // flushed
+  void UpdateUpload(
+      const VulkanDevice &device,
+      AsyncModelLoad &load,
+      UploadTicket ticket);
+
+  void WaitForImports(const AsyncModelLoadList &loads) const;
 
   void CreateUniqueModel(
       const VulkanDevice &device,
       const ModelBuilder &init_info,
       const eastl::string &name,
       Model **model) const;
+
+  void CreateMaterialInstances(
+      const VulkanDevice &device,
+      const eastl::string &material_dir,
+      const eastl::vector<MeshCacheMaterial> &materials) const;
 }; // class ModelManager
 
 } // namespace vks
@@ -0,0 +1,76 @@
+#ifndef VKS_OBJPARSER
+#define VKS_OBJPARSER
+
+#include <cstdint>
+#include <EASTL/string.h>
+#include <EASTL/vector.h>
+
+namespace vks {
+
+// Corner of a face; indices are zero based, or -1 when the attribute is
+// missing
+struct ObjIndex {
+  int32_t vertex_index;
+  int32_t normal_index;
+  int32_t texcoord_index;
+}; // struct ObjIndex
+
+// Triangulated faces of an OBJ group or object
+struct ObjShape {
+  eastl::string name;
+  // Three corners per triangle
+  eastl::vector<ObjIndex> indices;
+  // Material of each triangle, or -1
+  eastl::vector<int32_t> material_ids;
+}; // struct ObjShape
+
+// Material of an MTL library, with the parameters the renderer uses
+struct ObjMaterial {
+  eastl::string name;
+  float ambient[3U];
+  float diffuse[3U];
+  float specular[3U];
+  float emission[3U];
+  float shininess;
+  float dissolve;
+  eastl::string ambient_texname;
+  eastl::string diffuse_texname;
+  eastl::string specular_texname;
+  eastl::string specular_highlight_texname;
+  eastl::string bump_texname;
+  eastl::string alpha_texname;
+  eastl::string displacement_texname;
+}; // struct ObjMaterial
+
+struct ObjScene {
+  // Three floats per position and normal, two per texture coordinate
+  eastl::vector<float> positions;
+  eastl::vector<float> normals;
+  eastl::vector<float> texcoords;
+  eastl::vector<ObjShape> shapes;
+  eastl::vector<ObjMaterial> materials;
+}; // struct ObjScene
+
+/**
+ * @brief Parse an OBJ file and the MTL libraries it references. The file is
+ *   memory mapped and split at line boundaries into chunks which are parsed
+ *   on the worker pool, and then merged in order. The result matches
+ *   tinyobjloader's, with polygons triangulated as fans and a shape started
+ *   by every group or object.
+ *
+ * @param filename Path of the OBJ file
+ * @param material_dir Directory the MTL libraries are relative to
+ * @param scene Where the parsed data is returned
+ * @param err Why parsing failed, if it did
+ *
+ * @return False if the OBJ file couldn't be read
+ */
+bool ParseObj(
+    const eastl::string &filename,
+    const eastl::string &material_dir,
+    ObjScene *scene,
+    eastl::string *err);
+
+} // namespace vks
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef VKS_RANGEALLOCATOR
+#define VKS_RANGEALLOCATOR
+
+#include <cstdint>
+#include <EASTL/vector.h>
+
+namespace vks {
+
+/**
+ * @brief Hands out ranges of a linear resource of fixed capacity, eg. a
+ *   buffer, in whatever unit the caller counts it in. The free ranges are
+ *   kept sorted by offset and merged with their neighbours when freed;
+ *   allocations take the first free range they fit in, which keeps the used
+ *   ranges towards the start.
+ */
+class RangeAllocator {
+ public:
+  RangeAllocator();
+
+  // Forget every allocation, leaving the whole capacity free
+  void Reset(uint64_t capacity);
+
+  // Returns false, leaving offset untouched, if no free range can hold size
+  // units starting at a multiple of alignment
+  bool Allocate(uint64_t size, uint64_t alignment, uint64_t *offset);
+  // Size has to be the one the range was allocated with
+  void Free(uint64_t offset, uint64_t size);
+
+  uint64_t GetLargestFreeRange() const;
+
+  uint64_t capacity() const { return capacity_; }
+  uint64_t used() const { return used_; }
+
+ private:
+  struct FreeRange {
+    uint64_t offset;
+    uint64_t size;
+  }; // struct FreeRange
+
+  eastl::vector<FreeRange> free_ranges_;
+  uint64_t capacity_;
+  uint64_t used_;
+
+}; // class RangeAllocator
+
+} // namespace vks
+
+#endif
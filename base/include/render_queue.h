@@ -0,0 +1,75 @@
+#ifndef VKS_RENDERQUEUE
+#define VKS_RENDERQUEUE
+
+#include <cstdint>
+#include <EASTL/vector.h>
+
+namespace vks {
+
+// What draws are queued for, which decides the order of their keys' fields
+struct DrawPassesEnum {
+  enum DrawPasses {
+    // Front to back, so that the nearest surfaces reject the rest early
+    DEPTH_PREPASS = 0U,
+    // By material, so that draws reading the same data are together
+    SHADING,
+    num_items
+  }; // enum DrawPasses
+}; // struct DrawPassesEnum
+typedef DrawPassesEnum::DrawPasses DrawPassTypes;
+
+struct RenderQueueItem {
+  uint64_t key;
+  // Whatever the caller identifies the draw with, eg. its index
+  uint32_t value;
+}; // struct RenderQueueItem
+
+/**
+ * @brief Draws tagged with 64-bit sort keys, which are radix sorted to give
+ *   the order to issue them in. From the most significant bits down, a key
+ *   holds the pass (4 bits), the pipeline, or whatever state has to change
+ *   least (12 bits), then the material and the depth (24 bits each), in the
+ *   order the pass wants them.
+ *   The storage is kept across Clear() calls, so that refilling the queue
+ *   every frame doesn't allocate once it has grown to its size.
+ */
+class RenderQueue {
+ public:
+  RenderQueue();
+
+  static uint64_t MakeKey(
+      DrawPassTypes pass,
+      uint32_t pipeline,
+      uint32_t material,
+      float depth);
+  // Sorts after every other key of the pipeline in the pass
+  static uint64_t MakeLastKey(DrawPassTypes pass, uint32_t pipeline);
+
+  void Clear();
+  void Push(uint64_t key, uint32_t value);
+  // Add count items, returned for the caller to fill, eg. from several
+  // threads at once
+  RenderQueueItem *Append(uint32_t count);
+
+  /**
+   * @brief Stable LSD radix sort of the items by key, a byte at a time. The
+   *   bytes every key shares are skipped, and each pass is split across the
+   *   worker pool.
+   */
+  void Sort();
+
+  const RenderQueueItem *items() const { return items_.data(); }
+  uint32_t size() const { return static_cast<uint32_t>(items_.size()); }
+
+ private:
+  eastl::vector<RenderQueueItem> items_;
+  // Where each pass of the sort scatters to, before swapping with items_
+  eastl::vector<RenderQueueItem> sorted_items_;
+  // Count of each byte value for every chunk the sort is split into
+  eastl::vector<uint32_t> histograms_;
+
+}; // class RenderQueue
+
+} // namespace vks
+
+#endif
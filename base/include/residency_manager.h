@@ -0,0 +1,131 @@
+#ifndef VKS_RESIDENCYMANAGER
+#define VKS_RESIDENCYMANAGER
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <EASTL/array.h>
+#include <EASTL/hash_map.h>
+#include <EASTL/string.h>
+#include <EASTL/unique_ptr.h>
+#include <EASTL/utility.h>
+#include <EASTL/vector.h>
+#include <geometry_arena.h>
+#include <vulkan_buffer.h>
+#include <vulkan_image.h>
+
+namespace vks {
+
+class VulkanDevice;
+
+// ID of resources which aren't tracked
+extern const uint32_t kNoResidencyId;
+// Frames a resource has to go unused for before it can be evicted; every
+// eviction and reload makes the renderer wait for the GPU and re-record its
+// commands, so resources going in and out of use briefly are kept
+extern const uint64_t kResidencyMinIdleFrames;
+
+// Kinds of resources which can be evicted and reloaded
+enum class ResidentType : uint8_t {
+  MODEL = 0U,
+  TEXTURE,
+  count
+}; // enum class ResidentType
+
+/**
+ * @brief Keeps the models and textures loaded from files within a budget of
+ *   device memory. Each resource records the last frame it was used in; when
+ *   the resident ones go over the budget, the least recently used are
+ *   evicted by their managers, which reload them once they are used again.
+ *   Evicted memory is only released once the graphics queue has finished the
+ *   work submitted before the eviction.
+ */
+class ResidencyManager {
+ public:
+  ResidencyManager();
+
+  // The budget defaults to a share of the largest device local heap
+  void Init(const VulkanDevice &device);
+  void Shutdown(const VulkanDevice &device);
+
+  /**
+   * @brief Start tracking a resident resource, or return the ID of the one
+   *   with the same type and name.
+   *
+   * @param size Device memory the resource frees when evicted
+   *
+   * @return ID of the resource
+   */
+  uint32_t Track(ResidentType type, const eastl::string &name,
+                 VkDeviceSize size);
+
+  // ID of a tracked resource, or kNoResidencyId
+  uint32_t FindId(ResidentType type, const eastl::string &name) const;
+
+  void MarkUsed(uint32_t id) { entries_[id].last_used_frame = frame_; }
+  bool IsResident(uint32_t id) const { return entries_[id].resident; }
+
+  // Called by the owner of an evicted resource once it has reloaded it
+  void SetResident(uint32_t id);
+
+  // Destroy the buffer or image once the GPU can't be using them anymore
+  void RetireBuffer(const VulkanBuffer &buffer);
+  void RetireImage(eastl::unique_ptr<VulkanImage> image);
+  // Same, freeing the range of the arena so that it can be reused
+  void RetireGeometry(GeometryArena *arena, GeometryRangeId id);
+
+  /**
+   * @brief Release the retired resources whose work has completed, then,
+   *   if over budget, evict the least recently used resources until a
+   *   margin below it is free; resources used in the last
+   *   kResidencyMinIdleFrames frames are never evicted. Call at the start of
+   *   every frame.
+   */
+  void BeginFrame(const VulkanDevice &device);
+
+  // Changes whenever a resource is evicted or reloaded, so that commands
+  // and descriptors recorded with the resources can be refreshed
+  uint32_t generation() const { return generation_; }
+
+  void set_budget(VkDeviceSize budget) { budget_ = budget; }
+  VkDeviceSize budget() const { return budget_; }
+  VkDeviceSize resident_bytes() const { return resident_bytes_; }
+
+ private:
+  struct Entry {
+    eastl::string name;
+    ResidentType type;
+    VkDeviceSize size;
+    uint64_t last_used_frame;
+    bool resident;
+  }; // struct Entry
+
+  // Resources retired within the same frame, released once fence signals
+  struct RetiredBatch {
+    VkFence fence;
+    eastl::vector<VulkanBuffer> buffers;
+    eastl::vector<eastl::unique_ptr<VulkanImage>> images;
+    eastl::vector<eastl::pair<GeometryArena *, GeometryRangeId>> ranges;
+  }; // struct RetiredBatch
+
+  void EvictLeastRecentlyUsed(const VulkanDevice &device);
+  void SubmitRetired(const VulkanDevice &device);
+  void ReleaseBatch(const VulkanDevice &device, RetiredBatch &batch);
+
+  typedef eastl::hash_map<eastl::string, uint32_t> NameIdMap;
+  eastl::vector<Entry> entries_;
+  eastl::array<NameIdMap, static_cast<size_t>(ResidentType::count)> ids_;
+  // Retired since the last frame started
+  RetiredBatch retiring_;
+  eastl::vector<RetiredBatch> retired_;
+  VkDeviceSize budget_;
+  VkDeviceSize resident_bytes_;
+  uint64_t frame_;
+  uint32_t generation_;
+  // Avoids warning every frame while the used resources don't fit
+  bool over_budget_warned_;
+
+}; // class ResidencyManager
+
+} // namespace vks
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef VKS_STAGINGRING
+#define VKS_STAGINGRING
+
+#include <cstdint>
+
+namespace vks {
+
+/**
+ * @brief Bookkeeping of a ring buffer which uploads are staged through. Space
+ *   is taken at the head and given back at the tail, in the order it was
+ *   taken, once the batch which used it has completed; allocations which
+ *   don't fit before the end of the ring wrap around to its start, wasting
+ *   the end.
+ *   Only offsets are handed out, the memory belongs to the caller.
+ */
+class StagingRing {
+ public:
+  StagingRing();
+
+  // Forget every allocation, leaving the whole capacity free
+  void Reset(uint64_t capacity);
+
+  /**
+   * @brief Take size bytes starting at a multiple of alignment.
+   *
+   * @param offset Where the bytes start
+   * @param consumed Free space the allocation took, alignment padding and a
+   *   wasted end included, which Release has to be given back
+   * @return False, leaving the ring untouched, if the bytes don't fit
+   */
+  bool Allocate(
+      uint64_t size,
+      uint64_t alignment,
+      uint64_t *offset,
+      uint64_t *consumed);
+
+  /**
+   * @brief Give back the space a batch of allocations consumed, the oldest
+   *   batch first. Batches which consumed nothing leave the ring untouched,
+   *   since their head may predate the ring being reset.
+   *
+   * @param end Head of the ring once the batch's allocations were made
+   * @param consumed Sum of what the batch's allocations consumed
+   */
+  void Release(uint64_t end, uint64_t consumed);
+
+  uint64_t capacity() const { return capacity_; }
+  uint64_t head() const { return head_; }
+  uint64_t tail() const { return tail_; }
+  uint64_t used() const { return used_; }
+
+ private:
+  uint64_t capacity_;
+  uint64_t head_;
+  uint64_t tail_;
+  uint64_t used_;
+
+}; // class StagingRing
+
+} // namespace vks
+
+#endif
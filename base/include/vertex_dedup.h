@@ -0,0 +1,63 @@
+#ifndef VKS_VERTEXDEDUP
+#define VKS_VERTEXDEDUP
+
+#include <cstddef>
+#include <cstdint>
+#include <EASTL/vector.h>
+#include <model.h>
+
+namespace vks {
+
+// 64-bit hash of a block of bytes, every bit of which affects every bit of
+// the result
+uint64_t HashBytes64(const void *data, size_t size);
+
+/**
+ * @brief Open addressing hash set of vertices, which maps each vertex to its
+ *   position in the array of unique vertices it keeps; vertices are equal
+ *   when their bytes are.
+ */
+class VertexDedupMap {
+ public:
+  VertexDedupMap();
+
+  // Make room for count unique vertices without growing
+  void Reserve(uint32_t count);
+
+  // Position of the vertex in unique_vertices(), which it is appended to if
+  // it isn't there yet; the table is probed once
+  uint32_t InsertOrGet(const Vertex &vertex);
+
+  const eastl::vector<Vertex> &unique_vertices() const { return vertices_; }
+
+ private:
+  void Rehash(uint32_t capacity);
+
+  // Position of a vertex in vertices_, or kEmptySlot
+  eastl::vector<uint32_t> slots_;
+  eastl::vector<Vertex> vertices_;
+  // Hash of each of vertices_, to rehash and to skip most comparisons
+  eastl::vector<uint64_t> hashes_;
+  uint32_t mask_;
+
+}; // class VertexDedupMap
+
+/**
+ * @brief Merge vertices which were deduplicated separately, eg. per shape in
+ *   parallel, into one array of unique vertices.
+ *
+ * @param maps Per-part maps
+ * @param indices Per-part indices into the vertices of their map, remapped
+ *   in place to the merged vertices
+ * @param parts_count Number of parts
+ * @param vertices Where the merged vertices are returned
+ */
+void MergeDedupedVertices(
+    const VertexDedupMap *maps,
+    eastl::vector<uint32_t> *indices,
+    uint32_t parts_count,
+    eastl::vector<Vertex> &vertices);
+
+} // namespace vks
+
+#endif
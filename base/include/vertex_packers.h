@@ -0,0 +1,103 @@
+#ifndef VKS_VERTEXPACKERS
+#define VKS_VERTEXPACKERS
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <model.h>
+#include <vertex_setup.h>
+
+namespace vks {
+
+// Which member of a Vertex each element type is read from; specialised so
+// that the packers below know it at compile time
+template <VertexElementType kType>
+struct VertexElementTraits;
+
+template <>
+struct VertexElementTraits<VertexElementType::POSITION> {
+  typedef glm::vec3 ValueType;
+  static const ValueType &Get(const Vertex &vertex) { return vertex.pos; }
+}; // struct VertexElementTraits<POSITION>
+
+template <>
+struct VertexElementTraits<VertexElementType::NORMAL> {
+  typedef glm::vec3 ValueType;
+  static const ValueType &Get(const Vertex &vertex) { return vertex.normal; }
+}; // struct VertexElementTraits<NORMAL>
+
+template <>
+struct VertexElementTraits<VertexElementType::UV> {
+  typedef glm::vec3 ValueType;
+  static const ValueType &Get(const Vertex &vertex) { return vertex.uv; }
+}; // struct VertexElementTraits<UV>
+
+template <>
+struct VertexElementTraits<VertexElementType::TANGENT> {
+  typedef glm::vec3 ValueType;
+  static const ValueType &Get(const Vertex &vertex) { return vertex.tangent; }
+}; // struct VertexElementTraits<TANGENT>
+
+template <>
+struct VertexElementTraits<VertexElementType::BITANGENT> {
+  typedef glm::vec3 ValueType;
+  static const ValueType &Get(const Vertex &vertex) {
+    return vertex.bitangent;
+  }
+}; // struct VertexElementTraits<BITANGENT>
+
+template <>
+struct VertexElementTraits<VertexElementType::COLOUR> {
+  typedef glm::vec4 ValueType;
+  static const ValueType &Get(const Vertex &vertex) { return vertex.colour; }
+}; // struct VertexElementTraits<COLOUR>
+
+/**
+ * @brief Write one element of an array of vertices into its stream, where
+ *   consecutive vertices are stride bytes apart.
+ *   When the stream only holds this element and it matches the member's type
+ *   this is a single copy loop; otherwise the member is truncated or
+ *   zero-padded.
+ */
+template <VertexElementType kType>
+void PackVertexElement(
+    const Vertex *vertices,
+    uint32_t count,
+    uint32_t element_size,
+    uint32_t stride,
+    uint8_t *dst) {
+  typedef VertexElementTraits<kType> Traits;
+  typedef typename Traits::ValueType ValueType;
+
+  if (element_size == sizeof(ValueType) && stride == element_size) {
+    ValueType *out = reinterpret_cast<ValueType *>(dst);
+    for (uint32_t i = 0U; i < count; ++i) {
+      out[i] = Traits::Get(vertices[i]);
+    }
+    return;
+  }
+
+  uint32_t copy_size =
+    std::min(element_size, static_cast<uint32_t>(sizeof(ValueType)));
+  for (uint32_t i = 0U; i < count; ++i, dst += stride) {
+    memcpy(dst, &Traits::Get(vertices[i]), copy_size);
+    memset(dst + copy_size, 0, element_size - copy_size);
+  }
+}
+
+// Pick the packer for an element type and encoding; dispatched once per
+// element rather than once per vertex. position_dequant is only used by
+// quantized positions
+void PackVertexElement(
+    VertexElementType type,
+    VertexElementEncoding encoding,
+    const Vertex *vertices,
+    uint32_t count,
+    uint32_t element_size,
+    const glm::vec4 &position_dequant,
+    uint32_t stride,
+    uint8_t *dst);
+
+} // namespace vks
+
+#endif
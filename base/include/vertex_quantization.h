@@ -0,0 +1,86 @@
+#ifndef VKS_VERTEXQUANTIZATION
+#define VKS_VERTEXQUANTIZATION
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vertex_setup.h>
+
+namespace vks {
+
+// Distance between the decoded and the source attributes, in the units of
+// the attribute
+struct VertexQuantizationError {
+  VertexQuantizationError();
+
+  void Add(float error);
+  void Merge(const VertexQuantizationError &other);
+  float GetMean() const;
+
+  float max_error;
+  double sum_error;
+  uint32_t count;
+}; // struct VertexQuantizationError
+
+// Unit vector to/from 2 snorm16 on an octahedron
+uint32_t EncodeOctahedral(const glm::vec3 &v);
+glm::vec3 DecodeOctahedral(uint32_t packed);
+
+// Tangent frame to/from a quaternion in 4 snorm16; the frame is made
+// orthonormal and right-handed, so the bitangent is cross(normal, tangent)
+uint64_t EncodeTangentFrame(const glm::vec3 &normal, const glm::vec3 &tangent);
+void DecodeTangentFrame(uint64_t packed, glm::vec3 *normal,
+                        glm::vec3 *tangent);
+
+// Offset (xyz) and scale (w) that fit the given positions, stride bytes
+// apart, in [-1, 1]; the scale is uniform so that normals aren't skewed
+glm::vec4 ComputePositionDequant(const float *positions, uint32_t count,
+                                 uint32_t stride);
+// Transform from quantized to model space positions
+glm::mat4 GetPositionDequantMatrix(const glm::vec4 &position_dequant);
+
+/**
+ * @brief Encode an array of vectors into one element of a vertex stream.
+ *
+ * @param encoding Encoding of the element, anything but FLOAT or
+ *   TANGENT_FRAME_SNORM16
+ * @param src First source vector, or nullptr to write zeroes
+ * @param src_stride Bytes between source vectors
+ * @param count Number of vectors
+ * @param element_size Size of the element in bytes
+ * @param position_dequant Bounds of the positions; only for SNORM16_POSITION
+ * @param stride Bytes between vertices in the stream
+ * @param dst Element of the first vertex in the stream
+ * @param error Where the encoding error is accumulated, if not nullptr
+ */
+void EncodeVectors(
+    VertexElementEncoding encoding,
+    const float *src,
+    uint32_t src_stride,
+    uint32_t count,
+    uint32_t element_size,
+    const glm::vec4 &position_dequant,
+    uint32_t stride,
+    uint8_t *dst,
+    VertexQuantizationError *error);
+
+// As above for TANGENT_FRAME_SNORM16; tangents are flipped where the frame
+// is mirrored, so that the decoded bitangent points the same way. Tangents
+// and bitangents can be nullptr
+void EncodeTangentFrames(
+    const float *normals,
+    const float *tangents,
+    const float *bitangents,
+    uint32_t src_stride,
+    uint32_t count,
+    uint32_t stride,
+    uint8_t *dst,
+    VertexQuantizationError *error);
+
+// Log the error of each quantized element of the layout
+void LogVertexQuantizationErrors(
+    const VertexSetup &vertex_setup,
+    const VertexQuantizationError *errors);
+
+} // namespace vks
+
+#endif
@@ -19,6 +19,36 @@ enum class VertexElementType : uint8_t {
   num_items
 }; // enum class VertexElementType 
 
+// How an element is stored in its stream; anything but FLOAT is decoded by
+// the shaders which read it
+enum class VertexElementEncoding : uint8_t {
+  // 32-bit floats, as they are imported
+  FLOAT = 0U,
+  // Unit vector folded onto an octahedron, as 2 snorm16; R16G16_SNORM
+  OCTAHEDRAL_SNORM16,
+  // Whole tangent frame as a quaternion in 4 snorm16, stored in the normal
+  // element; the bitangent is cross(normal, tangent); R16G16B16A16_SNORM
+  TANGENT_FRAME_SNORM16,
+  // 16-bit floats, one per 2 bytes of the element; eg. R16G16_SFLOAT
+  HALF,
+  // 16-bit normalised in [0, 1], one per 2 bytes; eg. R16G16_UNORM
+  UNORM16,
+  // Positions in 4 snorm16 within the bounds of their mesh, which are
+  // mapped back by the mesh's model matrix; R16G16B16A16_SNORM
+  SNORM16_POSITION,
+  num_items
+}; // enum class VertexElementEncoding
+
+// How the elements of a layout are split into vertex buffers
+enum class VertexStreamsLayout : uint8_t {
+  // One tightly packed stream per element
+  SEPARATE = 0U,
+  // Positions in their own stream and the other elements interleaved in a
+  // second one, so that position-only passes fetch just the first
+  POSITION_INTERLEAVED,
+  num_items
+}; // enum class VertexStreamsLayout
+
 struct VertexElementTypeHash {
   template <typename T>
   std::size_t operator()(T t) const {
@@ -28,18 +58,24 @@ struct VertexElementTypeHash {
 
 struct VertexElement {
   VertexElement();
-  VertexElement(VertexElementType Type, uint32_t Size_bytes, VkFormat Format);
+  VertexElement(
+      VertexElementType Type,
+      uint32_t Size_bytes,
+      VkFormat Format,
+      VertexElementEncoding Encoding = VertexElementEncoding::FLOAT);
 
   VertexElementType type;
   uint32_t size_bytes;
   VkFormat format;
+  VertexElementEncoding encoding;
 }; // struct VertexElement
 
 class VertexSetup {
  public:
   VertexSetup(
       const eastl::vector<VertexElement> &vertex_layout/*,
-      const eastl::vector<eastl::pair<VertexElement, uint32_t>> &elements_size*/);
+      const eastl::vector<eastl::pair<VertexElement, uint32_t>> &elements_size*/,
+      VertexStreamsLayout streams_layout = VertexStreamsLayout::SEPARATE);
 
   const eastl::vector<VertexElementType> &vertex_types_layout() const {
     return vertex_types_layout_;
@@ -48,9 +84,31 @@ class VertexSetup {
   uint32_t vertex_size() const { return vertex_size_; }  
   uint32_t num_elements() const { return num_elements_; }
 
+  VertexStreamsLayout streams_layout() const { return streams_layout_; }
+  uint32_t num_streams() const {
+    return static_cast<uint32_t>(stream_strides_.size());
+  }
+  // Stream an element is stored in, and its offset within a vertex of it
+  uint32_t GetElementStream(uint32_t idx) const {
+    return element_streams_[idx];
+  }
+  uint32_t GetElementOffset(uint32_t idx) const {
+    return element_offsets_[idx];
+  }
+  uint32_t GetStreamStride(uint32_t stream) const {
+    return stream_strides_[stream];
+  }
+  // Stream which holds the positions
+  uint32_t GetPositionStream() const;
+
   VkFormat GetElementVulkanFormat(uint32_t idx) const;
   VkFormat GetElementVulkanFormat(VertexElementType element) const;
 
+  VertexElementEncoding GetElementEncoding(uint32_t idx) const;
+  VertexElementEncoding GetElementEncoding(VertexElementType element) const;
+  // True if any element isn't stored as floats
+  bool IsQuantized() const;
+
   uint32_t GetElementPosition(uint32_t idx) const;
   uint32_t GetElementPosition(VertexElementType element) const;
 
@@ -63,6 +121,7 @@ class VertexSetup {
   struct LayoutElementData {
     uint32_t size_bytes;
     VkFormat format;
+    VertexElementEncoding encoding;
   };
   std::unordered_map<VertexElementType, LayoutElementData, VertexElementTypeHash>
   vertex_layout_;
@@ -70,6 +129,10 @@ class VertexSetup {
 
   uint32_t vertex_size_;
   uint32_t num_elements_;
+  VertexStreamsLayout streams_layout_;
+  eastl::vector<uint32_t> element_streams_;
+  eastl::vector<uint32_t> element_offsets_;
+  eastl::vector<uint32_t> stream_strides_;
 }; // class VertexSetup
 
 } // namespace vks
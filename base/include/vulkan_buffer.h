@@ -2,6 +2,7 @@
 #define VKS_VULKANBUFFER
 
 #include <vulkan/vulkan.h> 
+#include <vulkan_memory_tracker.h>
 
 namespace vks {
 
@@ -13,7 +14,7 @@ struct VulkanBufferInitInfo {
   VkBufferUsageFlags buffer_usage_flags;
   VkMemoryPropertyFlags memory_property_flags;
   VkDeviceSize size;
-  VkCommandBuffer cmd_buff;
+  MemoryCategory memory_category;
 };
 
 class VulkanBuffer {
@@ -59,6 +60,8 @@ class VulkanBuffer {
   VkDeviceSize alignment_;
   VkBufferUsageFlags buffer_usage_flags_;
   VkMemoryPropertyFlags memory_property_flags_;
+  MemoryCategory memory_category_;
+  VkDeviceSize allocation_size_;
   bool initialised_;
 
 }; // class VulkanBuffer
@@ -24,9 +24,18 @@ class VulkanDevice {
   const VulkanQueue &graphics_queue() const { return graphics_queue_; };
   const VulkanQueue &present_queue() const { return present_queue_; };
   const VulkanQueue &compute_queue() const { return compute_queue_; };
+  // Queue used for uploads; it is the graphics queue when the device doesn't
+  // expose a transfer-only family
+  const VulkanQueue &transfer_queue() const { return transfer_queue_; };
   const VkPhysicalDeviceProperties physical_properties() const {
     return physical_properties_;
   };
+  const VkPhysicalDeviceFeatures &physical_features() const {
+    return physical_features_;
+  };
+  const VkPhysicalDeviceMemoryProperties &memory_properties() const {
+    return physical_memory_properties_;
+  };
   VkFormat depth_format() const { return depth_format_; };
   uint32_t GetGraphicsQueueIndex() const {
     return graphics_queue_.index;
@@ -37,11 +46,43 @@ class VulkanDevice {
   uint32_t GetComputeQueueIndex() const {
     return compute_queue_.index;
   };
+  uint32_t GetTransferQueueIndex() const {
+    return transfer_queue_.index;
+  };
+  // Whether resources written by the transfer queue need a queue family
+  // ownership transfer before the graphics queue can use them
+  bool HasDedicatedTransferQueue() const {
+    return transfer_queue_.index != graphics_queue_.index;
+  };
 
   // Get an index to the a type of memory which respects as close as possible
   // the properties and type passed as parameters 
   uint32_t GetMemoryType(uint32_t type_bits,
                          VkMemoryPropertyFlags properties_flags) const;
+  // Whether any of the memory types in type_bits has all the given properties
+  bool HasMemoryType(uint32_t type_bits,
+                     VkMemoryPropertyFlags properties_flags) const;
+
+  // Fill the budget and current usage of each memory heap; returns false if
+  // VK_EXT_memory_budget isn't available
+  bool QueryMemoryBudget(VkDeviceSize *heap_budgets,
+                         VkDeviceSize *heap_usages) const;
+
+  // Whether draws can read their count from a buffer, through
+  // VK_KHR_draw_indirect_count or VK_AMD_draw_indirect_count
+  bool HasDrawIndirectCount() const {
+    return draw_indexed_indirect_count_ != nullptr;
+  };
+  // vkCmdDrawIndexedIndirectCount of whichever extension is enabled; only
+  // valid if HasDrawIndirectCount()
+  void CmdDrawIndexedIndirectCount(
+      VkCommandBuffer cmd_buff,
+      VkBuffer buffer,
+      VkDeviceSize offset,
+      VkBuffer count_buffer,
+      VkDeviceSize count_buffer_offset,
+      uint32_t max_draw_count,
+      uint32_t stride) const;
 
   // Whether the logical device has been created and/or is still valid
   bool IsDeviceVaild() const { return device_ != VK_NULL_HANDLE; };
@@ -57,10 +98,17 @@ class VulkanDevice {
   VulkanQueue graphics_queue_;
   VulkanQueue present_queue_;
   VulkanQueue compute_queue_;
+  VulkanQueue transfer_queue_;
   VkPhysicalDeviceProperties physical_properties_;
   VkPhysicalDeviceFeatures physical_features_;
   VkPhysicalDeviceMemoryProperties physical_memory_properties_;
   VkFormat depth_format_;
+  // vkGetPhysicalDeviceMemoryProperties2KHR when the memory budget extension
+  // is enabled, nullptr otherwise
+  PFN_vkVoidFunction get_memory_properties2_;
+  // vkCmdDrawIndexedIndirectCountKHR or AMD when either extension is
+  // enabled, nullptr otherwise
+  PFN_vkVoidFunction draw_indexed_indirect_count_;
   
   // Whether a physical device supports the necessary features for the
   // application
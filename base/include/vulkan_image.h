@@ -4,6 +4,7 @@
 #include <vulkan/vulkan.h>
 #include <cstdint>
 #include <EASTL/vector.h>
+#include <vulkan_memory_tracker.h>
 
 namespace vks {
 
@@ -19,6 +20,7 @@ struct VulkanImageInitInfo {
   VkImageCreateInfo create_info;
   CreateView create_view;
   VkImageViewType view_type;
+  MemoryCategory memory_category;
 };
 
 struct VulkanImageAcquireInitInfo {
@@ -42,11 +44,26 @@ class VulkanImage {
     const VulkanDevice &device,
     const VulkanImageAcquireInitInfo &info);
 
+  // Two-step initialisation for images whose memory is owned by someone else,
+  // eg. render targets aliasing the same allocation: Create makes the image
+  // handle, then BindMemory binds it and creates the default view.
+  // memory_properties_flags in the init info are ignored.
+  void Create(
+    const VulkanDevice &device,
+    const VulkanImageInitInfo &info);
+  void BindMemory(
+    const VulkanDevice &device,
+    VkDeviceMemory memory,
+    VkDeviceSize offset);
+
   void Shutdown(const VulkanDevice &device);
 
   const VkImage &image() const { return image_; };
   const VkDeviceMemory &memory() const { return memory_; };
   const VkDeviceSize size() const { return size_; };
+  const VkMemoryRequirements &memory_requirements() const {
+    return memory_requirements_;
+  }
   const VkImageView view() const { return default_view_; };
   const VkMemoryPropertyFlags &memory_properties_flags() const {
     return memory_properties_flags_;
@@ -70,10 +87,16 @@ class VulkanImage {
   VkImage image_;
   bool owns_image_;
   VkDeviceMemory memory_;
+  bool owns_memory_;
   VkDeviceSize size_;
+  VkMemoryRequirements memory_requirements_;
   VkImageView default_view_;
+  CreateView create_view_;
+  VkImageViewType view_type_;
+  VkImageUsageFlags usage_;
   mutable eastl::vector<VkImageView> additional_views_;
   VkMemoryPropertyFlags memory_properties_flags_;
+  MemoryCategory memory_category_;
   VkImageLayout layout_;
   VkExtent3D extent_;
   uint32_t mip_levels_;
@@ -0,0 +1,64 @@
+#ifndef VKS_VULKANMEMORYTRACKER
+#define VKS_VULKANMEMORYTRACKER
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <EASTL/array.h>
+
+namespace vks {
+
+class VulkanDevice;
+
+// What a device allocation is used for
+enum class MemoryCategory : uint8_t {
+  VERTEX = 0U,
+  INDEX,
+  TEXTURE,
+  RENDER_TARGET,
+  STAGING,
+  PER_FRAME,
+  OTHER,
+  count
+}; // enum class MemoryCategory
+
+const char *GetMemoryCategoryName(MemoryCategory category);
+
+struct MemoryCategoryStats {
+  MemoryCategoryStats();
+
+  VkDeviceSize current_bytes;
+  VkDeviceSize peak_bytes;
+  uint32_t live_allocations;
+  uint32_t total_allocations;
+}; // struct MemoryCategoryStats
+
+/**
+ * @brief Keeps track of every device memory allocation made by the engine,
+ *   tagged by category, and reports it alongside the budget of each memory
+ *   heap when VK_EXT_memory_budget is available.
+ */
+class VulkanMemoryTracker {
+ public:
+  VulkanMemoryTracker();
+
+  void TrackAllocation(MemoryCategory category, VkDeviceSize size);
+  void TrackFree(MemoryCategory category, VkDeviceSize size);
+
+  const MemoryCategoryStats &GetStats(MemoryCategory category) const;
+  VkDeviceSize current_bytes() const { return current_bytes_; }
+  VkDeviceSize peak_bytes() const { return peak_bytes_; }
+
+  // Print the usage of each category and of each memory heap
+  void LogReport(const VulkanDevice &device) const;
+
+ private:
+  eastl::array<MemoryCategoryStats,
+    static_cast<size_t>(MemoryCategory::count)> stats_;
+  VkDeviceSize current_bytes_;
+  VkDeviceSize peak_bytes_;
+
+}; // class VulkanMemoryTracker
+
+} // namespace vks
+
+#endif
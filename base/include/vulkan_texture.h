@@ -40,6 +40,15 @@ class VulkanTexture {
   
   VkDescriptorImageInfo GetDescriptorImageInfo(const VkSampler sampler) const;
 
+  // Give up the image, eg. when the texture is evicted; the texture keeps its
+  // name and sampler, and can't be sampled until it gets an image back
+  eastl::unique_ptr<VulkanImage> ReleaseImage() { return eastl::move(image_); }
+  void set_image(eastl::unique_ptr<VulkanImage> image) {
+    image_ = eastl::move(image);
+  }
+  bool resident() const { return image_ != nullptr; }
+
+  const eastl::string &name() const { return name_; }
   const VulkanImage *image() const { return image_.get(); };
   VulkanImage *image() { return image_.get(); };
 
@@ -15,6 +15,65 @@ class VulkanDevice;
 
 extern const eastl::string kBaseAssetsPath;
 
+// Whether a render target has to keep its contents after the renderpass which
+// writes it
+enum class RenderTargetLifetime : uint8_t {
+  PERSISTENT = 0U,
+  // Only lives within a renderpass; it is backed by lazily allocated memory
+  // when the device has it, so tilers may never commit it at all
+  TRANSIENT
+}; // enum class RenderTargetLifetime
+
+// Alias group of the render targets which get memory of their own
+const uint32_t kNoAliasGroup = 0U;
+
+struct RenderTargetInfo {
+  eastl::string name;
+  uint32_t width;
+  uint32_t height;
+  VkFormat format;
+  VkImageUsageFlags usage;
+  RenderTargetLifetime lifetime;
+  // Render targets in the same alias group share the same memory, so their
+  // lifetimes within a frame must not overlap; they have to be cleared or
+  // fully overwritten, from an undefined layout, on each use
+  uint32_t alias_group;
+  // Where the created render target is returned
+  VulkanTexture **texture;
+}; // struct RenderTargetInfo
+
+// Contents of a texture file, decoded and ready to be uploaded
+struct DecodedTexture {
+  // Path of the file, with its slashes normalised
+  eastl::string name;
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mip_levels;
+  eastl::vector<uint8_t> data;
+  // One region per mip level, with offsets into data
+  eastl::vector<VkBufferImageCopy> copy_regions;
+}; // struct DecodedTexture
+
+// Path a texture is known by, with its slashes normalised
+eastl::string GetTextureName(const eastl::string &filename);
+
+/**
+ * @brief Read and decode a 2D texture file with all its mip levels; PNG files
+ *   are decoded with lodepng and any other with gli. Doesn't touch the device
+ *   or the texture manager, so it can run on any thread.
+ *
+ * @param filename File to load
+ * @param format Vulkan format of the data stored in the file
+ * @param decoded Where the decoded texture is returned
+ *
+ * @return False if the file couldn't be found or decoded
+ */
+bool DecodeTexture(
+    const eastl::string &filename,
+    VkFormat format,
+    DecodedTexture *decoded);
+
 class VulkanTextureManager {
  public:
   VulkanTextureManager();
@@ -73,16 +132,73 @@ class VulkanTextureManager {
       const VkSampler aniso_sampler,
       const VkImageUsageFlags img_flags = VK_IMAGE_USAGE_SAMPLED_BIT);
 
+  /**
+   * @brief Create a texture from data decoded by DecodeTexture(), unless one
+   *   with the same name exists already, in which case that one is returned,
+   *   getting its image back if it was evicted. The upload is enqueued on
+   *   the upload manager.
+   */
+  void CreateDecodedTexture(
+      const VulkanDevice &device,
+      const DecodedTexture &decoded,
+      VulkanTexture **texture,
+      const VkSampler aniso_sampler,
+      const VkImageUsageFlags img_flags = VK_IMAGE_USAGE_SAMPLED_BIT);
+
+  // Release the image of a texture, which is reloaded by passing its decoded
+  // data to CreateDecodedTexture() again
+  void EvictTexture(const VulkanDevice &device, const eastl::string &name);
+
+  // Whether a texture can be sampled; a reloaded texture only can once its
+  // upload has completed
+  bool IsTextureResident(const VulkanTexture &texture) const;
+
+  /**
+   * @brief Create a set of render targets, binding the ones sharing an alias
+   *        group to a single allocation as big as the largest of them
+   *
+   * @param infos Description of the render targets
+   * @param sampler Sampler assigned to all the render targets
+   */
+  void CreateRenderTargets(
+      const VulkanDevice &device,
+      const eastl::vector<RenderTargetInfo> &infos,
+      const VkSampler sampler);
+
   // Returns nullptr if texture isn't present
   VulkanTexture *GetTextureByName(const eastl::string &name);
 
  private:
-  VkCommandBuffer cmd_buffer_;
-
   typedef eastl::hash_map<eastl::string,
     eastl::unique_ptr<VulkanTexture>> NameTexMap;
   NameTexMap textures_;
 
+  // Memory shared by render targets, which doesn't belong to their images
+  struct RenderTargetMemory {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+  }; // struct RenderTargetMemory
+  eastl::vector<RenderTargetMemory> render_targets_memory_;
+
+  void LoadTexture(
+      const VulkanDevice &device,
+      const eastl::string &filename,
+      VkFormat format,
+      VulkanTexture **texture,
+      const VkSampler aniso_sampler,
+      const VkImageUsageFlags img_flags);
+
+  eastl::unique_ptr<VulkanImage> CreateTextureImage(
+      const VulkanDevice &device,
+      const void *data,
+      const uint32_t size,
+      const uint32_t width,
+      const uint32_t height,
+      const uint32_t mip_levels,
+      VkFormat format,
+      const eastl::vector<VkBufferImageCopy> &copy_regions,
+      const VkImageUsageFlags img_flags);
+
   void CreateTexture(
       const VulkanDevice &device,
       const eastl::string &name,
@@ -67,6 +67,8 @@ float Lerp(float a, float b, float t);
 
 bool GetSupportedDepthFormat(VkPhysicalDevice physical_device,
                              VkFormat &depth_format);
+// Depth aspect, plus the stencil one for the formats which have it
+VkImageAspectFlags GetDepthStencilAspect(VkFormat depth_format);
 bool DoesPhysicalDeviceSupportExtension(
     const char *extension_name,
     const std::vector<VkExtensionProperties> &available_extensions);
@@ -0,0 +1,131 @@
+#ifndef VKS_VULKANUPLOADMANAGER
+#define VKS_VULKANUPLOADMANAGER
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <EASTL/array.h>
+#include <EASTL/vector.h>
+#include <vulkan_buffer.h>
+#include <staging_ring.h>
+
+namespace vks {
+
+class VulkanDevice;
+class VulkanImage;
+
+// Size of the persistently mapped staging ring
+extern const VkDeviceSize kStagingRingSize;
+// Number of upload batches which can be in flight at the same time
+const uint32_t kUploadBatchesCount = 4U;
+
+// Identifies the batch in which an upload was recorded; waiting on a ticket
+// guarantees that all the uploads enqueued up to it have completed
+typedef uint64_t UploadTicket;
+
+/**
+ * @brief Records copies from host memory into device-local buffers and images
+ *   through a persistent staging ring, batching them into as few submits as
+ *   possible. Callers get a ticket back and only block on it when they
+ *   actually need the resource.
+ *   Copies run on the device's transfer queue; when that is a separate
+ *   family, ownership of the resources is released to the graphics family
+ *   and acquired back there once the batch is submitted.
+ */
+class VulkanUploadManager {
+ public:
+  VulkanUploadManager();
+
+  void Init(const VulkanDevice &device);
+  void Shutdown(const VulkanDevice &device);
+
+  // Copy size bytes of data into dst_buffer at dst_offset
+  UploadTicket EnqueueBufferCopy(
+      const VulkanDevice &device,
+      VkBuffer dst_buffer,
+      const void *data,
+      VkDeviceSize size,
+      VkDeviceSize dst_offset = 0U);
+
+  // Copy the data into the image and leave it in the shader read only layout.
+  // The buffer offsets of the regions are relative to data
+  UploadTicket EnqueueImageCopy(
+      const VulkanDevice &device,
+      VulkanImage &image,
+      const void *data,
+      VkDeviceSize size,
+      const eastl::vector<VkBufferImageCopy> &copy_regions,
+      const VkImageSubresourceRange &subresource_range);
+
+  // Submit the batch being recorded, if any; returns the ticket which
+  // covers every upload enqueued so far
+  UploadTicket Flush(const VulkanDevice &device);
+
+  // Block until the batch identified by ticket has completed, submitting it
+  // first if it is still being recorded
+  void WaitForTicket(const VulkanDevice &device, UploadTicket ticket);
+  // Non-blocking; retires the batches which have completed
+  bool IsTicketComplete(const VulkanDevice &device, UploadTicket ticket);
+
+  UploadTicket completed_ticket() const { return completed_ticket_; }
+
+ private:
+  struct UploadBatch {
+    UploadBatch();
+
+    // Recorded on the transfer queue
+    VkCommandBuffer cmd_buff;
+    // Recorded on the graphics queue to acquire ownership of the resources;
+    // only used with a dedicated transfer queue
+    VkCommandBuffer acquire_cmd_buff;
+    VkSemaphore transfer_complete_semaphore;
+    eastl::vector<VkBufferMemoryBarrier> acquire_buffer_barriers;
+    eastl::vector<VkImageMemoryBarrier> acquire_image_barriers;
+    VkFence fence;
+    UploadTicket ticket;
+    // Ring head once the batch was submitted and bytes it consumed
+    VkDeviceSize ring_end;
+    VkDeviceSize ring_bytes;
+    // Staging buffers for uploads which don't fit in the ring
+    eastl::vector<VulkanBuffer> overflow_buffers;
+    bool recording;
+    bool in_flight;
+  }; // struct UploadBatch
+
+  // Return a pointer in the staging ring where size bytes can be written,
+  // flushing and retiring batches if the ring is full
+  void *AllocateStaging(
+      const VulkanDevice &device,
+      VkDeviceSize size,
+      VkDeviceSize alignment,
+      VkBuffer *src_buffer,
+      VkDeviceSize *src_offset);
+  VkCommandBuffer BeginRecording(const VulkanDevice &device);
+  // Make the writes of the batch visible to the graphics queue, releasing
+  // ownership of the resources if they were written by another family
+  void RecordBufferRelease(
+      const VulkanDevice &device,
+      VkBuffer buffer,
+      VkDeviceSize offset,
+      VkDeviceSize size);
+  void RecordImageRelease(
+      const VulkanDevice &device,
+      VulkanImage &image,
+      const VkImageSubresourceRange &subresource_range);
+  void RecordAcquireCmdBuffer(UploadBatch &batch);
+  // Wait for the oldest in-flight batch; returns false if none is in flight
+  bool RetireOldestBatch(const VulkanDevice &device);
+  void RetireBatch(const VulkanDevice &device, UploadBatch &batch);
+
+  VulkanBuffer staging_ring_;
+  uint8_t *mapped_ring_;
+  StagingRing ring_;
+  eastl::array<UploadBatch, kUploadBatchesCount> batches_;
+  uint32_t current_batch_;
+  UploadTicket completed_ticket_;
+  UploadTicket submitted_ticket_;
+
+}; // class VulkanUploadManager
+
+} // namespace vks
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef VKS_WORKERPOOL
+#define VKS_WORKERPOOL
+
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <EASTL/deque.h>
+#include <EASTL/vector.h>
+#include <uncopyable.h>
+
+namespace vks {
+
+/**
+ * @brief Fixed set of worker threads used to split CPU-heavy loading work,
+ *   such as mesh packing, across cores, and to run long jobs in the
+ *   background.
+ */
+class WorkerPool : private szt::Uncopyable {
+ public:
+  // Called with the [begin, end) sub-range a task has to process, and the
+  // context given to ParallelFor
+  typedef void (*RangeThunk)(const void *context, uint32_t begin,
+                             uint32_t end);
+  typedef std::function<void()> JobFunction;
+
+  WorkerPool();
+  ~WorkerPool();
+
+  // With 0 threads, one less than the number of hardware threads is used
+  void Init(uint32_t num_threads = 0U);
+  void Shutdown();
+
+  /**
+   * @brief Split [0, count) into chunks and process them on the workers and
+   *   the calling thread; returns once every chunk has been processed.
+   *   Runs inline if the pool has no workers or the range is small.
+   *
+   * @param count Size of the range
+   * @param min_chunk_size Smallest chunk worth handing to another thread
+   * @param function Function, or lambda, to call on each chunk. It is only
+   *   referred to by the tasks, so that calls from the frame loop don't
+   *   allocate.
+   */
+  template <typename Function>
+  void ParallelFor(
+      uint32_t count,
+      uint32_t min_chunk_size,
+      const Function &function) {
+    ParallelFor(count, min_chunk_size, &CallRangeFunction<Function>,
+                &function);
+  }
+
+  // As above, calling thunk with context on each chunk
+  void ParallelFor(
+      uint32_t count,
+      uint32_t min_chunk_size,
+      RangeThunk thunk,
+      const void *context);
+
+  /**
+   * @brief Queue a job to run on one of the workers, without waiting for it.
+   *   Jobs are only taken by workers once there are no ParallelFor chunks
+   *   queued, so that they never hold up the thread waiting on those.
+   *   Runs inline if the pool has no workers. Shutdown() waits for the
+   *   queued jobs.
+   *
+   * @param job Function to run
+   */
+  void Enqueue(const JobFunction &job);
+
+  uint32_t num_threads() const {
+    return static_cast<uint32_t>(threads_.size());
+  }
+
+ private:
+  struct Task {
+    RangeThunk thunk;
+    const void *context;
+    uint32_t begin;
+    uint32_t end;
+    std::atomic<uint32_t> *pending;
+  }; // struct Task
+
+  void WorkerMain();
+  // Pops a task if there is one and runs it; returns false otherwise
+  bool RunPendingTask();
+  void RunTask(const Task &task);
+
+  template <typename Function>
+  static void CallRangeFunction(
+      const void *context,
+      uint32_t begin,
+      uint32_t end) {
+    (*static_cast<const Function *>(context))(begin, end);
+  }
+
+  eastl::vector<std::thread> threads_;
+  // Taken from the back, as the chunks can run in any order; unlike a
+  // deque, the storage is kept once it has grown
+  eastl::vector<Task> tasks_;
+  eastl::deque<JobFunction> jobs_;
+  std::mutex mutex_;
+  std::condition_variable tasks_cv_;
+  std::condition_variable done_cv_;
+  bool quit_;
+
+}; // class WorkerPool
+
+} // namespace vks
+
+#endif
@@ -13,9 +13,16 @@ namespace vks {
 static GLFWwindow *window_;
 static Scene *scene_;
 static bool done_ = false;
+// Whether the frame loop runs without a window or a device
+static bool headless_ = false;
+// Whether the current frame is left out of the heap allocations check
+static bool skip_allocations_check_ = false;
 extern const int32_t kWindowWidth;
 extern const int32_t kWindowHeight;
 extern const char *kWindowName;
+static const size_t kFrameArenaSize = 4U * 1024U * 1024U;
+// Frames after which the main loop is expected not to allocate anymore
+static const uint64_t kAllocationsWarmupFrames = 8U;
 
 static Timer *timer() {
   static Timer timer_;
@@ -37,15 +44,23 @@ static void InitWindow() {
 }
 
 static void InitManagers() {
+  frame_arena()->Init(kFrameArenaSize);
+  worker_pool()->Init();
+  upload_manager()->Init(vulkan()->device());
+  residency_manager()->Init(vulkan()->device());
   texture_manager()->Init(vulkan()->device());
   input_manager()->Init(window());
 }
 
 static void ShutdownManagers() {
+  upload_manager()->Shutdown(vulkan()->device());
+  residency_manager()->Shutdown(vulkan()->device());
   texture_manager()->Shutdown(vulkan()->device());
   model_manager()->Shutdown(vulkan()->device());
   material_manager()->Shutdown(vulkan()->device());
   meshes_heap_manager()->Shutdown(vulkan()->device());
+  frame_arena()->Shutdown();
+  worker_pool()->Shutdown();
 }
 
 static void InitVulkan() {
@@ -56,44 +71,91 @@ static void InitApp(Scene *scene) {
   scene->Init();
 }
 
-static void MainLoop() {
+// Report heap allocations made by a frame of the steady-state loop; with
+// VKS_ASSERT_NO_FRAME_ALLOCATIONS defined they are treated as fatal
+static void CheckFrameAllocations(uint64_t frame, uint64_t allocations) {
+  if (frame < kAllocationsWarmupFrames || allocations == 0U) {
+    return;
+  }
 
-  timer()->start();
-  float delta_time = static_cast<float>(timer()->getElapsedTimeInSec());
+#ifdef VKS_ASSERT_NO_FRAME_ALLOCATIONS
+  EXIT("Frame " << frame << " made " << allocations << " heap allocations!");
+#else
+  ELOG_WARN("Frame " << frame << " made " << allocations <<
+            " heap allocations");
+#endif
+}
 
-  while (!done_) {
-    if (glfwWindowShouldClose(window_)) {
-      done_ = true;
-      break;
-    }
+// Run a frame of the scene; returns the heap allocations it made
+static uint64_t RunFrame(float delta_time) {
+  frame_arena()->Reset();
+  skip_allocations_check_ = false;
+  uint64_t allocations_at_start = heap_allocations_count();
+
+  // Headless there is neither a device to evict from nor a window to poll
+  if (!headless_) {
+    residency_manager()->BeginFrame(vulkan()->device());
 
     glfwPollEvents();
+  }
 
-    
-    //switch (result) {
-      //case VK_SUCCESS:
-      //case VK_SUBOPTIMAL_KHR:
-        //break;
-      //case VK_ERROR_OUT_OF_DATE_KHR:
-        //// Do something clever here
-        //break;
-      //default:
-        //return false;
-    //}
+  //switch (result) {
+    //case VK_SUCCESS:
+    //case VK_SUBOPTIMAL_KHR:
+      //break;
+    //case VK_ERROR_OUT_OF_DATE_KHR:
+      //// Do something clever here
+      //break;
+    //default:
+      //return false;
+  //}
 
 
-    scene_->Update(delta_time);
+  scene_->Update(delta_time);
 
-    scene_->Render(delta_time);
-    
+  scene_->Render(delta_time);
+
+  if (!headless_) {
     input_manager()->EndFrame(window());
+  }
+
+  return heap_allocations_count() - allocations_at_start;
+}
+
+// Run frames until Exit() is called or the window is closed, or for
+// frames_count frames unless it is 0; returns the heap allocations made by
+// the frames after the warm-up ones
+static uint64_t MainLoop(uint64_t frames_count) {
+
+  timer()->start();
+  float delta_time = static_cast<float>(timer()->getElapsedTimeInSec());
+  uint64_t steady_allocations = 0U;
+
+  for (uint64_t frame = 0U;
+       !done_ && (frames_count == 0U || frame < frames_count);
+       ++frame) {
+    if (!headless_ && glfwWindowShouldClose(window_)) {
+      done_ = true;
+      break;
+    }
+
+    uint64_t allocations = RunFrame(delta_time);
+    if (!skip_allocations_check_) {
+      CheckFrameAllocations(frame, allocations);
+      if (frame >= kAllocationsWarmupFrames) {
+        steady_allocations += allocations;
+      }
+    }
 
     delta_time = static_cast<float>(timer()->getElapsedTimeInSec());
     timer()->start();
   }
+
+  return steady_allocations;
 }
 
 void Shutdown() {
+  memory_tracker()->LogReport(vulkan()->device());
   ShutdownManagers();
 
   // Do vulkan shutdown here
@@ -108,8 +170,24 @@ void ShutdownScene() {
   scene_->Shutdown();
 }
 
+void InitHeadless(uint32_t worker_threads) {
+  done_ = false;
+  headless_ = true;
+  frame_arena()->Init(kFrameArenaSize);
+  worker_pool()->Init(worker_threads);
+  LOG("Initialised headless system.");
+}
+
+void ShutdownHeadless() {
+  frame_arena()->Shutdown();
+  worker_pool()->Shutdown();
+  headless_ = false;
+  LOG("Shutdown headless system");
+}
+
 void Init() {
   done_ = false;
+  headless_ = false;
   InitWindow();
   InitVulkan();
   InitManagers();
@@ -120,12 +198,24 @@ void Run(Scene *scene) {
   scene_ = scene;
   InitApp(scene_);
   LOG("Initialised scene");
-  MainLoop();
+  MainLoop(0U);
   LOG("Exiting main loop");
   ShutdownScene();
   LOG("Shutdown scene");
 }
 
+uint64_t RunFrames(Scene *scene, uint32_t frames_count) {
+  scene_ = scene;
+  InitApp(scene_);
+  uint64_t steady_allocations = MainLoop(frames_count);
+  ShutdownScene();
+  return steady_allocations;
+}
+
+void SkipFrameAllocationsCheck() {
+  skip_allocations_check_ = true;
+}
+
 GLFWwindow *window() {
   return window_;
 }
@@ -145,6 +235,31 @@ VulkanTextureManager *texture_manager() {
   return &texture_manager_;
 }
 
+VulkanUploadManager *upload_manager() {
+  static VulkanUploadManager upload_manager_;
+  return &upload_manager_;
+}
+
+VulkanMemoryTracker *memory_tracker() {
+  static VulkanMemoryTracker memory_tracker_;
+  return &memory_tracker_;
+}
+
+ResidencyManager *residency_manager() {
+  static ResidencyManager residency_manager_;
+  return &residency_manager_;
+}
+
+LinearArena *frame_arena() {
+  static LinearArena frame_arena_;
+  return &frame_arena_;
+}
+
+WorkerPool *worker_pool() {
+  static WorkerPool worker_pool_;
+  return &worker_pool_;
+}
+
 MaterialManager *material_manager() {
   static MaterialManager material_manager_;
   return &material_manager_;
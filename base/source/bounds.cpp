@@ -0,0 +1,209 @@
+#include <bounds.h>
+#include <vulkan_tools.h>
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define VKS_BOUNDS_SSE
+#endif
+
+namespace vks {
+
+static inline glm::vec3 GetPosition(
+    const float *positions,
+    uint32_t stride,
+    uint32_t i) {
+  const float *p = reinterpret_cast<const float *>(
+      reinterpret_cast<const uint8_t *>(positions) + i * stride);
+  return glm::vec3(p[0U], p[1U], p[2U]);
+}
+
+#ifdef VKS_BOUNDS_SSE
+// Deinterleave 4 packed xyz vectors into one register per component
+static inline void LoadPositions4(
+    const float *src,
+    __m128 *x,
+    __m128 *y,
+    __m128 *z) {
+  // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+  __m128 a = _mm_loadu_ps(src);
+  __m128 b = _mm_loadu_ps(src + 4U);
+  __m128 c = _mm_loadu_ps(src + 8U);
+  __m128 b2c1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 2, 2));
+  *x = _mm_shuffle_ps(a, b2c1, _MM_SHUFFLE(3, 0, 3, 0));
+  __m128 a1b0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+  __m128 b3c2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+  *y = _mm_shuffle_ps(a1b0, b3c2, _MM_SHUFFLE(2, 0, 2, 0));
+  __m128 a2b1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+  __m128 c0c3 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+  *z = _mm_shuffle_ps(a2b1, c0c3, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+static inline float HorizontalMin(__m128 v) {
+  v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+  return _mm_cvtss_f32(v);
+}
+
+static inline float HorizontalMax(__m128 v) {
+  v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+  return _mm_cvtss_f32(v);
+}
+#endif
+
+static glm::vec3 FindFarthest(
+    const float *positions,
+    uint32_t count,
+    uint32_t stride,
+    const glm::vec3 &from) {
+  glm::vec3 farthest = from;
+  float max_distance_sq = -1.f;
+  uint32_t i = 0U;
+
+#ifdef VKS_BOUNDS_SSE
+  // Four packed positions at a time; only those further than the farthest
+  // so far are looked at one by one
+  if (stride == SCAST_U32(sizeof(glm::vec3))) {
+    const __m128 from_x = _mm_set1_ps(from.x);
+    const __m128 from_y = _mm_set1_ps(from.y);
+    const __m128 from_z = _mm_set1_ps(from.z);
+    for (; i + 4U <= count; i += 4U) {
+      __m128 x, y, z;
+      LoadPositions4(positions + i * 3U, &x, &y, &z);
+      x = _mm_sub_ps(x, from_x);
+      y = _mm_sub_ps(y, from_y);
+      z = _mm_sub_ps(z, from_z);
+      __m128 distance_sq = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+          _mm_mul_ps(z, z));
+      int further = _mm_movemask_ps(
+          _mm_cmpgt_ps(distance_sq, _mm_set1_ps(max_distance_sq)));
+      if (further == 0) {
+        continue;
+      }
+
+      float distances_sq[4U];
+      _mm_storeu_ps(distances_sq, distance_sq);
+      for (uint32_t l = 0U; l < 4U; ++l) {
+        if (distances_sq[l] > max_distance_sq) {
+          max_distance_sq = distances_sq[l];
+          farthest = GetPosition(positions, stride, i + l);
+        }
+      }
+    }
+  }
+#endif
+
+  for (; i < count; ++i) {
+    glm::vec3 p = GetPosition(positions, stride, i);
+    glm::vec3 d = p - from;
+    float distance_sq = glm::dot(d, d);
+    if (distance_sq > max_distance_sq) {
+      max_distance_sq = distance_sq;
+      farthest = p;
+    }
+  }
+  return farthest;
+}
+
+glm::vec4 ComputeBoundingSphere(
+    const float *positions,
+    uint32_t count,
+    uint32_t stride) {
+  if (count == 0U) {
+    return glm::vec4(0.f);
+  }
+
+  glm::vec3 a = FindFarthest(positions, count, stride,
+                             GetPosition(positions, stride, 0U));
+  glm::vec3 b = FindFarthest(positions, count, stride, a);
+  glm::vec3 centre = (a + b) * 0.5f;
+  float radius = glm::length(b - a) * 0.5f;
+
+  // Grow it over the points the initial guess left out
+  for (uint32_t i = 0U; i < count; ++i) {
+    glm::vec3 p = GetPosition(positions, stride, i);
+    float distance = glm::length(p - centre);
+    if (distance > radius) {
+      float new_radius = (radius + distance) * 0.5f;
+      centre += (p - centre) * ((new_radius - radius) / distance);
+      radius = new_radius;
+    }
+  }
+
+  return glm::vec4(centre, radius);
+}
+
+void ComputeBoundingBox(
+    const float *positions,
+    uint32_t count,
+    uint32_t stride,
+    glm::vec3 *box_min,
+    glm::vec3 *box_max) {
+  if (count == 0U) {
+    *box_min = glm::vec3(0.f);
+    *box_max = glm::vec3(0.f);
+    return;
+  }
+
+  glm::vec3 min_pos = GetPosition(positions, stride, 0U);
+  glm::vec3 max_pos = min_pos;
+  uint32_t i = 1U;
+
+#ifdef VKS_BOUNDS_SSE
+  // Four packed positions at a time, reduced across the lanes at the end
+  if (stride == SCAST_U32(sizeof(glm::vec3)) && count >= 4U) {
+    __m128 min_x, min_y, min_z;
+    LoadPositions4(positions, &min_x, &min_y, &min_z);
+    __m128 max_x = min_x;
+    __m128 max_y = min_y;
+    __m128 max_z = min_z;
+    for (i = 4U; i + 4U <= count; i += 4U) {
+      __m128 x, y, z;
+      LoadPositions4(positions + i * 3U, &x, &y, &z);
+      min_x = _mm_min_ps(min_x, x);
+      min_y = _mm_min_ps(min_y, y);
+      min_z = _mm_min_ps(min_z, z);
+      max_x = _mm_max_ps(max_x, x);
+      max_y = _mm_max_ps(max_y, y);
+      max_z = _mm_max_ps(max_z, z);
+    }
+    min_pos = glm::vec3(HorizontalMin(min_x), HorizontalMin(min_y),
+                        HorizontalMin(min_z));
+    max_pos = glm::vec3(HorizontalMax(max_x), HorizontalMax(max_y),
+                        HorizontalMax(max_z));
+  }
+#endif
+
+  for (; i < count; ++i) {
+    glm::vec3 p = GetPosition(positions, stride, i);
+    min_pos = glm::min(min_pos, p);
+    max_pos = glm::max(max_pos, p);
+  }
+
+  *box_min = min_pos;
+  *box_max = max_pos;
+}
+
+void ExtractFrustumPlanes(const glm::mat4 &view_proj, glm::vec4 *planes) {
+  // Rows of the matrix (Gribb and Hartmann); glm is column major
+  glm::vec4 rows[4U];
+  for (uint32_t r = 0U; r < 4U; ++r) {
+    rows[r] = glm::vec4(view_proj[0U][r], view_proj[1U][r],
+                        view_proj[2U][r], view_proj[3U][r]);
+  }
+
+  planes[0U] = rows[3U] + rows[0U];
+  planes[1U] = rows[3U] - rows[0U];
+  planes[2U] = rows[3U] + rows[1U];
+  planes[3U] = rows[3U] - rows[1U];
+  // 0 <= z, as the depth range is [0, 1]
+  planes[4U] = rows[2U];
+  planes[5U] = rows[3U] - rows[2U];
+
+  for (uint32_t p = 0U; p < 6U; ++p) {
+    planes[p] /= glm::length(glm::vec3(planes[p]));
+  }
+}
+
+} // namespace vks
@@ -1,6 +1,84 @@
 #include <EASTL/internal/config.h>
 #include <EABase/nullptr.h>
+#include <memory_allocators.h>
 #include <cstdlib>
+#include <cstddef>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Every operator below allocates through AllocateBlock and releases through
+// FreeBlock, so that memory can be released by any of them. Memory aligned
+// beyond malloc's on Windows can only be released by _aligned_free, so
+// everything goes through _aligned_malloc there
+static void* AllocateBlock(size_t size, size_t alignment) {
+	if (size == 0U) {
+		size = 1U;
+	}
+	if (alignment < sizeof(void*)) {
+		alignment = sizeof(void*);
+	}
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	if (alignment <= EASTL_SYSTEM_ALLOCATOR_MIN_ALIGNMENT) {
+		return malloc(size);
+	}
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, alignment, size) != 0) {
+		return nullptr;
+	}
+	return ptr;
+#endif
+}
+
+static void FreeBlock(void* ptr) {
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+// Global operators are replaced only to count allocations
+void* operator new(size_t size) {
+	vks::CountHeapAllocation();
+	void* ptr = AllocateBlock(size, EASTL_SYSTEM_ALLOCATOR_MIN_ALIGNMENT);
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	vks::CountHeapAllocation();
+	return AllocateBlock(size, EASTL_SYSTEM_ALLOCATOR_MIN_ALIGNMENT);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept {
+	FreeBlock(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	FreeBlock(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+	FreeBlock(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+	FreeBlock(ptr);
+}
 
 void* operator new[](
 		size_t size,
@@ -9,7 +87,7 @@ void* operator new[](
 		unsigned debugFlags,
 		const char* file,
 		int line) {
-	return malloc(size);
+	return operator new(size);
 }
 
 void* operator new[](
@@ -21,6 +99,11 @@ void* operator new[](
 		unsigned debugFlags,
 		const char* file,
 		int line) {
-	EASTL_ASSERT(alignment <= 8);
-	return malloc(size);
+	vks::CountHeapAllocation();
+	EASTL_ASSERT(alignmentOffset == 0U);
+	void* ptr = AllocateBlock(size, alignment);
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
 }
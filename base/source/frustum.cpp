@@ -1,6 +1,14 @@
 #include <frustum.h>
+#include <bounds.h>
 #include <cmath>
+#include <cstring>
 #include <glm/trigonometric.hpp>
+#include <glm/geometric.hpp>
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define VKS_FRUSTUM_SSE
+#endif
 
 namespace szt {
 
@@ -14,7 +22,9 @@ Frustum::Frustum()
     ftl_(),
     ftr_(),
     fbl_(),
-    fbr_() {}
+    fbr_(),
+    planes_(),
+    packed_planes_() {}
 
 Frustum::Frustum(float near, float far, float fov_y, float aspect_ratio)
   : near_size_(),
@@ -26,7 +36,9 @@ Frustum::Frustum(float near, float far, float fov_y, float aspect_ratio)
     ftl_(),
     ftr_(),
     fbl_(),
-    fbr_() {
+    fbr_(),
+    planes_(),
+    packed_planes_() {
   // Calculate height and width of far and near plane
   float half_tanf = std::tan(glm::radians(fov_y_) / 2.f);
   near_size_.y = 2.f * half_tanf * near_;
@@ -46,4 +58,122 @@ Frustum::Frustum(float near, float far, float fov_y, float aspect_ratio)
   fbr_ = far_centre - (up * half_sizes_far.y) + (right * half_sizes_far.x); 
 }
 
+void Frustum::ExtractPlanes(const glm::mat4 &view_proj) {
+  vks::ExtractFrustumPlanes(view_proj, planes_);
+
+  // Zeroed planes never cull, as volumes have to be behind them
+  memset(packed_planes_, 0, sizeof(packed_planes_));
+  for (uint32_t p = 0U; p < 6U; ++p) {
+    for (uint32_t c = 0U; c < 4U; ++c) {
+      packed_planes_[p / 4U][c][p % 4U] = planes_[p][c];
+    }
+  }
+}
+
+void Frustum::TestSpheres(
+    const glm::vec4 *spheres,
+    uint32_t count,
+    uint8_t *visible) const {
+#ifdef VKS_FRUSTUM_SSE
+  // Each sphere against 4 planes at a time
+  __m128 planes[2U][4U];
+  for (uint32_t g = 0U; g < 2U; ++g) {
+    for (uint32_t c = 0U; c < 4U; ++c) {
+      planes[g][c] = _mm_loadu_ps(packed_planes_[g][c]);
+    }
+  }
+  const __m128 zero = _mm_setzero_ps();
+  for (uint32_t i = 0U; i < count; ++i) {
+    __m128 x = _mm_set1_ps(spheres[i].x);
+    __m128 y = _mm_set1_ps(spheres[i].y);
+    __m128 z = _mm_set1_ps(spheres[i].z);
+    __m128 r = _mm_set1_ps(spheres[i].w);
+    __m128 outside = zero;
+    for (uint32_t g = 0U; g < 2U; ++g) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(planes[g][0U], x),
+                     _mm_mul_ps(planes[g][1U], y)),
+          _mm_add_ps(_mm_mul_ps(planes[g][2U], z),
+                     _mm_add_ps(planes[g][3U], r)));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+    }
+    visible[i] = (_mm_movemask_ps(outside) == 0) ? 1U : 0U;
+  }
+#else
+  for (uint32_t i = 0U; i < count; ++i) {
+    glm::vec3 centre(spheres[i]);
+    visible[i] = 1U;
+    for (uint32_t p = 0U; p < 6U; ++p) {
+      if (glm::dot(glm::vec3(planes_[p]), centre) + planes_[p].w <
+          -spheres[i].w) {
+        visible[i] = 0U;
+        break;
+      }
+    }
+  }
+#endif
+}
+
+void Frustum::TestBoxes(
+    const glm::vec3 *boxes_min,
+    const glm::vec3 *boxes_max,
+    uint32_t count,
+    uint8_t *visible) const {
+  // A box is outside a plane when its corner furthest along the plane's
+  // normal is, ie. its centre is further behind than its extent projected
+  // on the normal
+#ifdef VKS_FRUSTUM_SSE
+  __m128 planes[2U][4U];
+  __m128 abs_normals[2U][3U];
+  const __m128 sign_bit = _mm_set1_ps(-0.f);
+  for (uint32_t g = 0U; g < 2U; ++g) {
+    for (uint32_t c = 0U; c < 4U; ++c) {
+      planes[g][c] = _mm_loadu_ps(packed_planes_[g][c]);
+    }
+    for (uint32_t c = 0U; c < 3U; ++c) {
+      abs_normals[g][c] = _mm_andnot_ps(sign_bit, planes[g][c]);
+    }
+  }
+  const __m128 zero = _mm_setzero_ps();
+  for (uint32_t i = 0U; i < count; ++i) {
+    glm::vec3 centre = (boxes_min[i] + boxes_max[i]) * 0.5f;
+    glm::vec3 extent = (boxes_max[i] - boxes_min[i]) * 0.5f;
+    __m128 cx = _mm_set1_ps(centre.x);
+    __m128 cy = _mm_set1_ps(centre.y);
+    __m128 cz = _mm_set1_ps(centre.z);
+    __m128 ex = _mm_set1_ps(extent.x);
+    __m128 ey = _mm_set1_ps(extent.y);
+    __m128 ez = _mm_set1_ps(extent.z);
+    __m128 outside = zero;
+    for (uint32_t g = 0U; g < 2U; ++g) {
+      __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(planes[g][0U], cx),
+                     _mm_mul_ps(planes[g][1U], cy)),
+          _mm_add_ps(_mm_mul_ps(planes[g][2U], cz), planes[g][3U]));
+      __m128 radius = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(abs_normals[g][0U], ex),
+                     _mm_mul_ps(abs_normals[g][1U], ey)),
+          _mm_mul_ps(abs_normals[g][2U], ez));
+      outside = _mm_or_ps(outside,
+                          _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+    }
+    visible[i] = (_mm_movemask_ps(outside) == 0) ? 1U : 0U;
+  }
+#else
+  for (uint32_t i = 0U; i < count; ++i) {
+    glm::vec3 centre = (boxes_min[i] + boxes_max[i]) * 0.5f;
+    glm::vec3 extent = (boxes_max[i] - boxes_min[i]) * 0.5f;
+    visible[i] = 1U;
+    for (uint32_t p = 0U; p < 6U; ++p) {
+      glm::vec3 normal(planes_[p]);
+      if (glm::dot(normal, centre) + planes_[p].w +
+          glm::dot(glm::abs(normal), extent) < 0.f) {
+        visible[i] = 0U;
+        break;
+      }
+    }
+  }
+#endif
+}
+
 } // namespace szt
@@ -0,0 +1,445 @@
+#include <geometry_arena.h>
+#include <vertex_setup.h>
+#include <vulkan_device.h>
+#include <vulkan_tools.h>
+#include <logger.hpp>
+#include <base_system.h>
+#include <EASTL/algorithm.h>
+
+namespace vks {
+
+const GeometryRangeId kNoGeometryRange = 0xFFFFFFFFU;
+
+// Smallest buffers an arena is created or compacted to, so that small
+// models don't make it grow over and over
+static const uint32_t kMinVerticesCapacity = 1U << 16U;
+static const VkDeviceSize kMinIndexBytesCapacity = 1U << 20U;
+// Compaction leaves this fraction of the used space free, to grow into
+static const uint64_t kCompactHeadroomDivisor = 4U;
+// Largest alignment of a range of indices, which packing them may pad by
+static const VkDeviceSize kMaxIndexSize = sizeof(uint32_t);
+
+static inline uint32_t GetIndexSize(VkIndexType index_type) {
+  return (index_type == VK_INDEX_TYPE_UINT16) ?
+    SCAST_U32(sizeof(uint16_t)) :
+    SCAST_U32(sizeof(uint32_t));
+}
+
+GeometryArena::GeometryArena()
+    : stream_strides_(),
+      position_stream_(0U),
+      vertex_buffers_(),
+      index_buffer_(),
+      vertex_allocator_(),
+      index_allocator_(),
+      ranges_(),
+      ranges_used_(),
+      free_ids_(),
+      generation_(0U) {}
+
+void GeometryArena::Init(
+    const VulkanDevice &device,
+    const VertexSetup &vertex_setup,
+    uint32_t vertices_capacity,
+    VkDeviceSize index_bytes_capacity) {
+  stream_strides_.resize(vertex_setup.num_streams());
+  for (uint32_t i = 0U; i < vertex_setup.num_streams(); ++i) {
+    stream_strides_[i] = vertex_setup.GetStreamStride(i);
+  }
+  position_stream_ = vertex_setup.GetPositionStream();
+
+  CreateBuffers(
+      device,
+      eastl::max(vertices_capacity, kMinVerticesCapacity),
+      eastl::max(index_bytes_capacity, kMinIndexBytesCapacity));
+}
+
+void GeometryArena::Shutdown(const VulkanDevice &device) {
+  for (eastl::vector<VulkanBuffer>::iterator i = vertex_buffers_.begin();
+       i != vertex_buffers_.end();
+       ++i) {
+    i->Shutdown(device);
+  }
+  vertex_buffers_.clear();
+  index_buffer_.Shutdown(device);
+
+  ranges_.clear();
+  ranges_used_.clear();
+  free_ids_.clear();
+}
+
+bool GeometryArena::IsCompatible(const VertexSetup &vertex_setup) const {
+  if (vertex_setup.num_streams() != SCAST_U32(stream_strides_.size()) ||
+      vertex_setup.GetPositionStream() != position_stream_) {
+    return false;
+  }
+  for (uint32_t i = 0U; i < vertex_setup.num_streams(); ++i) {
+    if (vertex_setup.GetStreamStride(i) != stream_strides_[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void GeometryArena::CreateBuffers(
+    const VulkanDevice &device,
+    uint32_t vertices_capacity,
+    VkDeviceSize index_bytes_capacity) {
+  VulkanBufferInitInfo init_info;
+  init_info.memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+  // Growing and compacting copy out of the buffers
+  vertex_buffers_.resize(stream_strides_.size());
+  for (uint32_t i = 0U; i < SCAST_U32(vertex_buffers_.size()); ++i) {
+    init_info.buffer_usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    init_info.memory_category = MemoryCategory::VERTEX;
+    init_info.size = static_cast<VkDeviceSize>(vertices_capacity) *
+      stream_strides_[i];
+    vertex_buffers_[i].Init(device, init_info);
+  }
+
+  init_info.buffer_usage_flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  init_info.memory_category = MemoryCategory::INDEX;
+  init_info.size = index_bytes_capacity;
+  index_buffer_.Init(device, init_info);
+
+  vertex_allocator_.Reset(vertices_capacity);
+  index_allocator_.Reset(index_bytes_capacity);
+}
+
+GeometryRangeId GeometryArena::Allocate(
+    const VulkanDevice &device,
+    uint32_t vertices_count,
+    uint32_t indices_count,
+    VkIndexType index_type) {
+  uint32_t index_size = GetIndexSize(index_type);
+  VkDeviceSize index_bytes = static_cast<VkDeviceSize>(indices_count) *
+    index_size;
+
+  uint64_t first_vertex = 0U;
+  uint64_t index_offset = 0U;
+  bool vertices_fit = vertex_allocator_.Allocate(vertices_count, 1U,
+                                                 &first_vertex);
+  bool indices_fit = vertices_fit &&
+    index_allocator_.Allocate(index_bytes, index_size, &index_offset);
+  if (!indices_fit) {
+    if (vertices_fit) {
+      vertex_allocator_.Free(first_vertex, vertices_count);
+    }
+
+    // Relocating packs the ranges, so they need at most the used space plus
+    // the padding which aligns the indices of each
+    uint64_t vertices_capacity = vertex_allocator_.capacity();
+    while (vertices_capacity < vertex_allocator_.used() + vertices_count) {
+      vertices_capacity *= 2U;
+    }
+    uint64_t index_bytes_capacity = index_allocator_.capacity();
+    while (index_bytes_capacity < index_allocator_.used() + index_bytes +
+             kMaxIndexSize * (ranges_.size() + 1U)) {
+      index_bytes_capacity *= 2U;
+    }
+    Relocate(device, static_cast<uint32_t>(vertices_capacity),
+             index_bytes_capacity);
+
+    vertices_fit = vertex_allocator_.Allocate(vertices_count, 1U,
+                                              &first_vertex);
+    indices_fit = index_allocator_.Allocate(index_bytes, index_size,
+                                            &index_offset);
+    VKS_ASSERT(vertices_fit && indices_fit,
+               "Geometry range doesn't fit after growing the arena!");
+    LOG("Geometry arena grown to " << vertices_capacity << " vertices and " <<
+        (index_bytes_capacity >> 10U) << " KB of indices.");
+  }
+
+  GeometryRange range;
+  range.first_vertex = static_cast<uint32_t>(first_vertex);
+  range.vertices_count = vertices_count;
+  range.first_index = static_cast<uint32_t>(index_offset / index_size);
+  range.indices_count = indices_count;
+  range.index_type = index_type;
+
+  GeometryRangeId id = kNoGeometryRange;
+  if (!free_ids_.empty()) {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+    ranges_[id] = range;
+    ranges_used_[id] = true;
+  }
+  else {
+    id = SCAST_U32(ranges_.size());
+    ranges_.push_back(range);
+    ranges_used_.push_back(true);
+  }
+
+  return id;
+}
+
+void GeometryArena::Free(GeometryRangeId id) {
+  VKS_ASSERT(id < ranges_.size() && ranges_used_[id],
+             "Freeing a geometry range which isn't allocated!");
+
+  const GeometryRange &range = ranges_[id];
+  VkDeviceSize index_size = GetIndexSize(range.index_type);
+  vertex_allocator_.Free(range.first_vertex, range.vertices_count);
+  index_allocator_.Free(range.first_index * index_size,
+                        range.indices_count * index_size);
+  ranges_used_[id] = false;
+  free_ids_.push_back(id);
+}
+
+void GeometryArena::WriteVertexStream(
+    const VulkanDevice &device,
+    GeometryRangeId id,
+    uint32_t stream,
+    const void *data) {
+  const GeometryRange &range = ranges_[id];
+  if (range.vertices_count == 0U) {
+    return;
+  }
+
+  VkDeviceSize stride = stream_strides_[stream];
+  upload_manager()->EnqueueBufferCopy(
+      device,
+      vertex_buffers_[stream].buffer(),
+      data,
+      range.vertices_count * stride,
+      range.first_vertex * stride);
+}
+
+void GeometryArena::WriteIndices(
+    const VulkanDevice &device,
+    GeometryRangeId id,
+    const void *data) {
+  const GeometryRange &range = ranges_[id];
+  if (range.indices_count == 0U) {
+    return;
+  }
+
+  VkDeviceSize index_size = GetIndexSize(range.index_type);
+  upload_manager()->EnqueueBufferCopy(
+      device,
+      index_buffer_.buffer(),
+      data,
+      range.indices_count * index_size,
+      range.first_index * index_size);
+}
+
+VkDeviceSize GeometryArena::GetRangeSize(GeometryRangeId id) const {
+  const GeometryRange &range = ranges_[id];
+  VkDeviceSize size = static_cast<VkDeviceSize>(range.indices_count) *
+    GetIndexSize(range.index_type);
+  for (eastl::vector<uint32_t>::const_iterator i = stream_strides_.begin();
+       i != stream_strides_.end();
+       ++i) {
+    size += static_cast<VkDeviceSize>(range.vertices_count) * *i;
+  }
+
+  return size;
+}
+
+void GeometryArena::BindVertexBuffers(VkCommandBuffer cmd_buff) const {
+  uint32_t num_streams = SCAST_U32(vertex_buffers_.size());
+  FrameVector<VkDeviceSize> offsets;
+  offsets.assign(num_streams, 0U);
+  FrameVector<VkBuffer> buffers(num_streams);
+  FrameVector<VkBuffer>::iterator bi = buffers.begin();
+  for (eastl::vector<VulkanBuffer>::const_iterator i = vertex_buffers_.begin();
+       i != vertex_buffers_.end();
+       ++i, ++bi) {
+    *bi = i->buffer();
+  }
+
+  vkCmdBindVertexBuffers(
+      cmd_buff,
+      0U,
+      num_streams,
+      buffers.data(),
+      offsets.data());
+}
+
+void GeometryArena::BindPositionBuffer(VkCommandBuffer cmd_buff) const {
+  VkBuffer buffer = vertex_buffers_[position_stream_].buffer();
+  VkDeviceSize offset = 0U;
+
+  vkCmdBindVertexBuffers(
+      cmd_buff,
+      0U,
+      1U,
+      &buffer,
+      &offset);
+}
+
+void GeometryArena::BindIndexBuffer(
+    VkCommandBuffer cmd_buff,
+    VkIndexType index_type) const {
+  vkCmdBindIndexBuffer(
+      cmd_buff,
+      index_buffer_.buffer(),
+      0U,
+      index_type);
+}
+
+void GeometryArena::Compact(const VulkanDevice &device) {
+  uint64_t vertices_used = vertex_allocator_.used();
+  uint64_t index_bytes_used = index_allocator_.used() +
+    kMaxIndexSize * ranges_.size();
+  uint64_t vertices_capacity = eastl::max(
+      vertices_used + vertices_used / kCompactHeadroomDivisor,
+      static_cast<uint64_t>(kMinVerticesCapacity));
+  uint64_t index_bytes_capacity = eastl::max(
+      index_bytes_used + index_bytes_used / kCompactHeadroomDivisor,
+      static_cast<uint64_t>(kMinIndexBytesCapacity));
+
+  VkDeviceSize size_before = index_allocator_.capacity();
+  for (eastl::vector<uint32_t>::const_iterator i = stream_strides_.begin();
+       i != stream_strides_.end();
+       ++i) {
+    size_before += vertex_allocator_.capacity() * *i;
+  }
+
+  Relocate(device, static_cast<uint32_t>(vertices_capacity),
+           index_bytes_capacity);
+
+  VkDeviceSize size_after = index_bytes_capacity;
+  for (eastl::vector<uint32_t>::const_iterator i = stream_strides_.begin();
+       i != stream_strides_.end();
+       ++i) {
+    size_after += vertices_capacity * *i;
+  }
+  LOG("Compacted geometry arena from " << (size_before >> 10U) << " KB to " <<
+      (size_after >> 10U) << " KB.");
+}
+
+void GeometryArena::Relocate(
+    const VulkanDevice &device,
+    uint32_t vertices_capacity,
+    VkDeviceSize index_bytes_capacity) {
+  // The copies have to see every upload enqueued so far
+  upload_manager()->WaitForTicket(device, upload_manager()->Flush(device));
+
+  eastl::vector<VulkanBuffer> old_vertex_buffers;
+  old_vertex_buffers.swap(vertex_buffers_);
+  VulkanBuffer old_index_buffer = index_buffer_;
+  index_buffer_ = VulkanBuffer();
+  CreateBuffers(device, vertices_capacity, index_bytes_capacity);
+
+  // Allocating in order from empty allocators places the ranges one after
+  // the other
+  eastl::vector<VkBufferCopy> vertex_copies;
+  eastl::vector<VkBufferCopy> index_copies;
+  for (uint32_t id = 0U; id < SCAST_U32(ranges_.size()); ++id) {
+    if (!ranges_used_[id]) {
+      continue;
+    }
+
+    GeometryRange &range = ranges_[id];
+    VkDeviceSize index_size = GetIndexSize(range.index_type);
+    uint64_t first_vertex = 0U;
+    uint64_t index_offset = 0U;
+    bool fits = vertex_allocator_.Allocate(range.vertices_count, 1U,
+                                           &first_vertex);
+    fits = index_allocator_.Allocate(range.indices_count * index_size,
+                                     index_size, &index_offset) && fits;
+    VKS_ASSERT(fits, "Geometry range doesn't fit in the relocated arena!");
+
+    if (range.vertices_count != 0U) {
+      VkBufferCopy copy;
+      copy.srcOffset = range.first_vertex;
+      copy.dstOffset = first_vertex;
+      copy.size = range.vertices_count;
+      vertex_copies.push_back(copy);
+    }
+    if (range.indices_count != 0U) {
+      VkBufferCopy copy;
+      copy.srcOffset = range.first_index * index_size;
+      copy.dstOffset = index_offset;
+      copy.size = range.indices_count * index_size;
+      index_copies.push_back(copy);
+    }
+
+    range.first_vertex = static_cast<uint32_t>(first_vertex);
+    range.first_index = static_cast<uint32_t>(index_offset / index_size);
+  }
+
+  if (!vertex_copies.empty() || !index_copies.empty()) {
+    VkCommandBuffer cmd_buff = VK_NULL_HANDLE;
+    VkCommandBufferAllocateInfo cmd_buffer_allocate_info = {
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      nullptr,
+      device.graphics_queue().cmd_pool,
+      VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      1U
+    };
+    VK_CHECK_RESULT(vkAllocateCommandBuffers(
+        device.device(),
+        &cmd_buffer_allocate_info,
+        &cmd_buff));
+
+    VkCommandBufferBeginInfo cmd_buff_begin_info =
+      tools::inits::CommandBufferBeginInfo();
+    cmd_buff_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(cmd_buff, &cmd_buff_begin_info));
+
+    // The vertex copies were counted in vertices; each stream scales them by
+    // its stride
+    eastl::vector<VkBufferCopy> stream_copies(vertex_copies.size());
+    for (uint32_t s = 0U; s < SCAST_U32(vertex_buffers_.size()) &&
+           !vertex_copies.empty(); ++s) {
+      VkDeviceSize stride = stream_strides_[s];
+      for (uint32_t i = 0U; i < SCAST_U32(vertex_copies.size()); ++i) {
+        stream_copies[i].srcOffset = vertex_copies[i].srcOffset * stride;
+        stream_copies[i].dstOffset = vertex_copies[i].dstOffset * stride;
+        stream_copies[i].size = vertex_copies[i].size * stride;
+      }
+      vkCmdCopyBuffer(cmd_buff, old_vertex_buffers[s].buffer(),
+                      vertex_buffers_[s].buffer(),
+                      SCAST_U32(stream_copies.size()), stream_copies.data());
+    }
+    if (!index_copies.empty()) {
+      vkCmdCopyBuffer(cmd_buff, old_index_buffer.buffer(),
+                      index_buffer_.buffer(),
+                      SCAST_U32(index_copies.size()), index_copies.data());
+    }
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(cmd_buff));
+
+    // Waiting for the copies also waits for every frame submitted before
+    // them, which read the old buffers
+    VkFence fence = VK_NULL_HANDLE;
+    VkFenceCreateInfo fence_create_info = tools::inits::FenceCreateInfo();
+    VK_CHECK_RESULT(vkCreateFence(device.device(), &fence_create_info,
+                                  nullptr, &fence));
+    VkSubmitInfo submit_info = tools::inits::SubmitInfo();
+    submit_info.waitSemaphoreCount = 0U;
+    submit_info.pWaitSemaphores = nullptr;
+    submit_info.pWaitDstStageMask = nullptr;
+    submit_info.commandBufferCount = 1U;
+    submit_info.pCommandBuffers = &cmd_buff;
+    submit_info.signalSemaphoreCount = 0U;
+    submit_info.pSignalSemaphores = nullptr;
+    VK_CHECK_RESULT(vkQueueSubmit(device.graphics_queue().queue, 1U,
+                                  &submit_info, fence));
+    VK_CHECK_RESULT(vkWaitForFences(device.device(), 1U, &fence, VK_TRUE,
+                                    UINT64_MAX));
+    vkDestroyFence(device.device(), fence, nullptr);
+    vkFreeCommandBuffers(device.device(), device.graphics_queue().cmd_pool,
+                         1U, &cmd_buff);
+  }
+
+  // Commands recorded with the old buffers may still be around until they
+  // are recorded again
+  for (eastl::vector<VulkanBuffer>::const_iterator i =
+         old_vertex_buffers.begin();
+       i != old_vertex_buffers.end();
+       ++i) {
+    residency_manager()->RetireBuffer(*i);
+  }
+  residency_manager()->RetireBuffer(old_index_buffer);
+
+  ++generation_;
+}
+
+} // namespace vks
@@ -26,8 +26,10 @@ uint32_t LightsManager::GetNumLights() const {
   return SCAST_U32(lights_.size());
 }
   
-eastl::vector<Light> LightsManager::TransformLights(const glm::mat4 &transform) {
-	eastl::vector<Light> transformed_lights = lights_;
+void LightsManager::TransformLights(
+    const glm::mat4 &transform,
+    FrameVector<Light> &transformed_lights) const {
+  transformed_lights.assign(lights_.begin(), lights_.end());
   uint32_t num_lights = GetNumLights();
   for (uint32_t i = 0U; i < num_lights; i++) {
     glm::vec4 pos(
@@ -39,8 +41,6 @@ eastl::vector<Light> LightsManager::TransformLights(const glm::mat4 &transform)
     transformed_lights[i].pos_radius = glm::vec4(new_pos.x, new_pos.y, new_pos.z, 
                                       lights_[i].pos_radius.w);
   }
-
-	return transformed_lights;
 }
 
 } // namespace vks
@@ -0,0 +1,122 @@
+#include <mapped_file.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vks {
+
+MappedFile::MappedFile()
+    : data_(nullptr),
+#ifdef _WIN32
+      size_(0U),
+      file_handle_(INVALID_HANDLE_VALUE),
+      mapping_handle_(nullptr) {}
+#else
+      size_(0U) {}
+#endif
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const eastl::string &filename) {
+  Close();
+
+  file_handle_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                             nullptr, OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_handle_, &file_size) || file_size.QuadPart == 0) {
+    Close();
+    return false;
+  }
+
+  mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY,
+                                       0U, 0U, nullptr);
+  if (mapping_handle_ == nullptr) {
+    Close();
+    return false;
+  }
+
+  data_ = static_cast<const uint8_t *>(
+      MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0U, 0U, 0U));
+  if (data_ == nullptr) {
+    Close();
+    return false;
+  }
+  size_ = static_cast<size_t>(file_size.QuadPart);
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+    data_ = nullptr;
+  }
+  if (mapping_handle_ != nullptr) {
+    CloseHandle(mapping_handle_);
+    mapping_handle_ = nullptr;
+  }
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle_);
+    file_handle_ = INVALID_HANDLE_VALUE;
+  }
+  size_ = 0U;
+}
+
+#else
+
+bool MappedFile::Open(const eastl::string &filename) {
+  Close();
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size),
+                       PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  data_ = static_cast<const uint8_t *>(mapping);
+  size_ = static_cast<size_t>(file_stat.st_size);
+  // The whole file is about to be read, start paging it in
+  madvise(mapping, size_, MADV_WILLNEED);
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+    data_ = nullptr;
+  }
+  size_ = 0U;
+}
+
+#endif
+
+} // namespace vks
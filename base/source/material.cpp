@@ -275,10 +275,10 @@ MaterialBuilder::MaterialBuilder(
 
 void MaterialBuilder::GetVertexInputBindingDescription(
     eastl::vector<VkVertexInputBindingDescription> &bindings) const {
-  uint32_t layouts_count = vertex_setup_->num_elements();
-  for (uint32_t i = 0U; i < layouts_count; i++) {
+  uint32_t streams_count = vertex_setup_->num_streams();
+  for (uint32_t i = 0U; i < streams_count; i++) {
     VkVertexInputBindingDescription structure;
-    structure.stride = vertex_setup_->GetElementSize(i);
+    structure.stride = vertex_setup_->GetStreamStride(i);
     structure.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
     structure.binding = i;
 
@@ -335,9 +335,9 @@ void MaterialBuilder::GetVertexInputAttributeDescriptors(
   uint32_t layouts_count = vertex_setup_->num_elements();
   for (uint32_t i = 0U; i < layouts_count; i++) {
     VkVertexInputAttributeDescription input_attribute_description;
-    input_attribute_description.binding = i;
+    input_attribute_description.binding = vertex_setup_->GetElementStream(i);
     input_attribute_description.location = i;
-    input_attribute_description.offset = 0U;
+    input_attribute_description.offset = vertex_setup_->GetElementOffset(i);
     input_attribute_description.format =
       vertex_setup_->GetElementVulkanFormat(i);
 
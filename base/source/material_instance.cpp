@@ -11,6 +11,19 @@
 
 namespace vks {
 
+bool GetMaterialTextureFormat(const eastl::string &name, VkFormat *format) {
+  if (name.find("png") != eastl::string::npos) {
+    (*format) = VK_FORMAT_R8G8B8A8_UNORM;
+    return true;
+  }
+  if (name.find("dds") != eastl::string::npos) {
+    (*format) = VK_FORMAT_BC2_UNORM_BLOCK;
+    return true;
+  }
+
+  return false;
+}
+
 MaterialInstanceBuilder::MaterialInstanceBuilder(
     const eastl::string &inst_name,
     const eastl::string &mats_directory,
@@ -47,23 +60,14 @@ void MaterialInstance::Init(
   std::vector<VkWriteDescriptorSet> set_writes(builder_textures_count);
   for (uint32_t i = 0U; i < builder_textures_count; i++) {
     VulkanTexture *loaded_texture = nullptr;
-    if (builder.textures()[i].name != "") {
-      if (builder.textures()[i].name.find("png") != -1) {
-        texture_manager()->Load2DPNGTexture(
-          device,
-          builder.mats_directory() + builder.textures()[i].name,
-          VK_FORMAT_R8G8B8A8_UNORM,
-          &loaded_texture,
-          builder.aniso_sampler());
-      }
-      else if (builder.textures()[i].name.find("dds") != -1) {
-        texture_manager()->Load2DTexture(
-          device,
-          builder.mats_directory() + builder.textures()[i].name,
-          VK_FORMAT_BC2_UNORM_BLOCK,
-          &loaded_texture,
-          builder.aniso_sampler());
-      }
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    if (GetMaterialTextureFormat(builder.textures()[i].name, &format)) {
+      texture_manager()->Load2DTexture(
+        device,
+        builder.mats_directory() + builder.textures()[i].name,
+        format,
+        &loaded_texture,
+        builder.aniso_sampler());
     }
     if (loaded_texture == nullptr) {
       loaded_texture = texture_manager()->GetTextureByName(
@@ -7,6 +7,7 @@
 #include <vulkan_tools.h>
 #include <vulkan_texture.h>
 #include <vulkan_device.h>
+#include <base_system.h>
 
 namespace vks {
 
@@ -123,17 +124,25 @@ uint32_t MaterialManager::GetMaterialInstancesCount() const {
 
 void MaterialManager::GetDescriptorImageInfosByType(
       const MatTextureType texture_type,
-      eastl::vector<VkDescriptorImageInfo> &descs) {
+      FrameVector<VkDescriptorImageInfo> &descs) {
   uint32_t num_mat_instances = GetMaterialInstancesCount();
+  descs.reserve(descs.size() + num_mat_instances);
+
+  // Evicted textures are sampled as the dummy one until they are reloaded
+  const VulkanTexture *dummy_texture = texture_manager()->GetTextureByName(
+      STR(ASSETS_FOLDER) "dummy.ktx");
 
   // For all the material instances
   for (uint32_t i = 0U; i < num_mat_instances; i++) {
     // Read their texture of given type
-    VulkanTexture &texture =
-      *material_instances_[i].textures()[tools::ToUnderlying(texture_type)];
+    const VulkanTexture *texture =
+      material_instances_[i].textures()[tools::ToUnderlying(texture_type)];
+    if (!texture_manager()->IsTextureResident(*texture)) {
+      texture = dummy_texture;
+    }
 
     // Save it in the list
-    descs.push_back(texture.GetDescriptorImageInfo());
+    descs.push_back(texture->GetDescriptorImageInfo());
   }
 }
 
@@ -0,0 +1,197 @@
+#include <memory_allocators.h>
+#include <base_system.h>
+#include <vulkan_tools.h>
+#include <logger.hpp>
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace vks {
+
+// Per thread, so that the main thread's count isn't mixed up with the
+// workers' loading; constant-initialised, so it is usable by operator new
+// during static init
+static thread_local uint64_t heap_allocations_count_ = 0U;
+
+static size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1U) & ~(alignment - 1U);
+}
+
+void CountHeapAllocation() {
+  ++heap_allocations_count_;
+}
+
+uint64_t heap_allocations_count() {
+  return heap_allocations_count_;
+}
+
+void *AlignedAlloc(size_t size, size_t alignment) {
+  CountHeapAllocation();
+  if (alignment < sizeof(void *)) {
+    alignment = sizeof(void *);
+  }
+#ifdef _WIN32
+  return _aligned_malloc(size, alignment);
+#else
+  void *ptr = nullptr;
+  if (posix_memalign(&ptr, alignment, size) != 0) {
+    return nullptr;
+  }
+  return ptr;
+#endif
+}
+
+void AlignedFree(void *ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+LinearArena::LinearArena()
+    : memory_(nullptr),
+      capacity_(0U),
+      offset_(0U),
+      peak_used_(0U) {}
+
+LinearArena::~LinearArena() {
+  Shutdown();
+}
+
+void LinearArena::Init(size_t capacity) {
+  Shutdown();
+  memory_ = static_cast<uint8_t *>(AlignedAlloc(capacity,
+                                                kDefaultAllocAlignment));
+  if (memory_ == nullptr) {
+    EXIT("Couldn't allocate linear arena of " << capacity << " bytes!");
+  }
+  capacity_ = capacity;
+  offset_ = 0U;
+  peak_used_ = 0U;
+}
+
+void LinearArena::Shutdown() {
+  if (memory_ != nullptr) {
+    AlignedFree(memory_);
+    memory_ = nullptr;
+  }
+  capacity_ = 0U;
+  offset_ = 0U;
+}
+
+void *LinearArena::Allocate(size_t size, size_t alignment) {
+  size_t aligned = AlignUp(offset_, alignment);
+  if (memory_ == nullptr || aligned + size > capacity_) {
+    return nullptr;
+  }
+
+  offset_ = aligned + size;
+  if (offset_ > peak_used_) {
+    peak_used_ = offset_;
+  }
+
+  return memory_ + aligned;
+}
+
+void LinearArena::Reset() {
+  offset_ = 0U;
+}
+
+bool LinearArena::Owns(const void *ptr) const {
+  const uint8_t *p = static_cast<const uint8_t *>(ptr);
+  return p >= memory_ && p < memory_ + capacity_;
+}
+
+FrameAllocator::FrameAllocator(const char *name)
+    : name_(name) {}
+
+FrameAllocator::FrameAllocator(const FrameAllocator &x, const char *name)
+    : name_(name) {}
+
+void *FrameAllocator::allocate(size_t n, int flags) {
+  return allocate(n, kDefaultAllocAlignment, 0U, flags);
+}
+
+void *FrameAllocator::allocate(
+    size_t n,
+    size_t alignment,
+    size_t offset,
+    int flags) {
+  EASTL_ASSERT(offset == 0U);
+  if (alignment < kDefaultAllocAlignment) {
+    alignment = kDefaultAllocAlignment;
+  }
+
+  void *ptr = frame_arena()->Allocate(n, alignment);
+  if (ptr == nullptr) {
+    ELOG_WARN("Frame arena exhausted, allocating " << n <<
+              " bytes from the heap.");
+    ptr = AlignedAlloc(n, alignment);
+  }
+
+  return ptr;
+}
+
+void FrameAllocator::deallocate(void *p, size_t n) {
+  // Arena memory is given back all at once at the start of the next frame
+  if (p != nullptr && !frame_arena()->Owns(p)) {
+    AlignedFree(p);
+  }
+}
+
+void PoolAlignmentError(size_t alignment, size_t offset) {
+  EXIT("Pool blocks can't be aligned to " << alignment << " bytes at offset " <<
+       offset << "!");
+}
+
+FixedSizePool::FixedSizePool(size_t block_size, size_t blocks_per_chunk)
+    : block_size_(AlignUp(block_size < sizeof(void *) ?
+                            sizeof(void *) : block_size,
+                          kDefaultAllocAlignment)),
+      blocks_per_chunk_(blocks_per_chunk),
+      free_list_(nullptr),
+      chunks_() {}
+
+FixedSizePool::~FixedSizePool() {
+  for (eastl::vector<void *>::iterator i = chunks_.begin();
+       i != chunks_.end();
+       ++i) {
+    AlignedFree(*i);
+  }
+  chunks_.clear();
+  free_list_ = nullptr;
+}
+
+void *FixedSizePool::Allocate() {
+  if (free_list_ == nullptr) {
+    AllocateChunk();
+  }
+
+  void *block = free_list_;
+  free_list_ = *static_cast<void **>(block);
+  return block;
+}
+
+void FixedSizePool::Free(void *ptr) {
+  *static_cast<void **>(ptr) = free_list_;
+  free_list_ = ptr;
+}
+
+void FixedSizePool::AllocateChunk() {
+  uint8_t *chunk = static_cast<uint8_t *>(AlignedAlloc(
+      block_size_ * blocks_per_chunk_,
+      kDefaultAllocAlignment));
+  if (chunk == nullptr) {
+    EXIT("Couldn't allocate pool chunk!");
+  }
+  chunks_.push_back(chunk);
+
+  // Thread the new blocks into the free list
+  for (size_t i = 0U; i < blocks_per_chunk_; ++i) {
+    Free(chunk + i * block_size_);
+  }
+}
+
+} // namespace vks
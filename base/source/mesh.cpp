@@ -8,6 +8,14 @@ Mesh::Mesh()
       vertex_offset_(0U),
       material_id_(0U),
       model_mat_(1.f),
+      position_dequant_(0.f, 0.f, 0.f, 1.f),
+      first_meshlet_(0U),
+      meshlets_count_(0U),
+      first_lod_(0U),
+      lods_count_(0U),
+      bounding_sphere_(0.f),
+      bounds_min_(0.f),
+      bounds_max_(0.f),
 			dynamic_ubo_offset_(0.f) {}
 
 Mesh::Mesh(
@@ -20,6 +28,14 @@ Mesh::Mesh(
       vertex_offset_(vertex_offset),
       material_id_(material_id),
       model_mat_(1.f),
+      position_dequant_(0.f, 0.f, 0.f, 1.f),
+      first_meshlet_(0U),
+      meshlets_count_(0U),
+      first_lod_(0U),
+      lods_count_(0U),
+      bounding_sphere_(0.f),
+      bounds_min_(0.f),
+      bounds_max_(0.f),
 			dynamic_ubo_offset_(0.f) {}
 
 } // namespace vks
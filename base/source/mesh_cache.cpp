@@ -0,0 +1,409 @@
+#include <mesh_cache.h>
+#include <model.h>
+#include <vertex_setup.h>
+#include <vulkan_tools.h>
+#include <logger.hpp>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace vks {
+
+extern const uint32_t kMeshCacheVersion = 7U;
+// "VKSM"
+static const uint32_t kMeshCacheMagic = 0x4D534B56U;
+// Vertex streams and indices start at this alignment within the file, so
+// that they can be read in place from the mapping
+static const size_t kMeshCacheDataAlignment = 16U;
+
+struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_mtime;
+  uint32_t post_process_steps;
+  uint32_t streams_layout;
+  uint32_t elements_count;
+  uint32_t vertices_count;
+  uint32_t indices_count;
+  uint32_t meshes_count;
+  uint32_t meshlets_count;
+  uint32_t lods_count;
+  uint32_t materials_count;
+}; // struct MeshCacheHeader
+
+struct MeshCacheElement {
+  uint32_t type;
+  uint32_t size_bytes;
+  uint32_t encoding;
+}; // struct MeshCacheElement
+
+struct MeshCacheMesh {
+  uint32_t start_index;
+  uint32_t index_count;
+  uint32_t vertex_offset;
+  uint32_t material_id;
+  float position_dequant[4U];
+  float bounding_sphere[4U];
+  float bounds_min[3U];
+  float bounds_max[3U];
+  uint32_t first_meshlet;
+  uint32_t meshlets_count;
+  uint32_t first_lod;
+  uint32_t lods_count;
+}; // struct MeshCacheMesh
+
+// Bounds-checked reads from the mapped cache
+class MeshCacheReader {
+ public:
+  MeshCacheReader(const uint8_t *data, size_t size)
+      : begin_(data),
+        cursor_(data),
+        end_(data + size) {}
+
+  // Returns nullptr if the file is too short
+  const uint8_t *Take(size_t size) {
+    if (size > static_cast<size_t>(end_ - cursor_)) {
+      return nullptr;
+    }
+    const uint8_t *data = cursor_;
+    cursor_ += size;
+    return data;
+  }
+
+  bool Read(void *dst, size_t size) {
+    const uint8_t *src = Take(size);
+    if (src == nullptr) {
+      return false;
+    }
+    memcpy(dst, src, size);
+    return true;
+  }
+
+  bool ReadString(eastl::string &str) {
+    uint32_t length = 0U;
+    if (!Read(&length, sizeof(length))) {
+      return false;
+    }
+    const uint8_t *chars = Take(length);
+    if (chars == nullptr) {
+      return false;
+    }
+    str.assign(reinterpret_cast<const char *>(chars), length);
+    return true;
+  }
+
+  bool Align() {
+    size_t offset = static_cast<size_t>(cursor_ - begin_);
+    size_t padding = (kMeshCacheDataAlignment -
+                      offset % kMeshCacheDataAlignment) %
+                     kMeshCacheDataAlignment;
+    return Take(padding) != nullptr;
+  }
+
+ private:
+  const uint8_t *begin_;
+  const uint8_t *cursor_;
+  const uint8_t *end_;
+
+}; // class MeshCacheReader
+
+// Writes to the cache file, keeping track of the offset for the alignment
+class MeshCacheWriter {
+ public:
+  explicit MeshCacheWriter(std::ofstream &stream)
+      : stream_(stream),
+        offset_(0U) {}
+
+  void Write(const void *data, size_t size) {
+    stream_.write(static_cast<const char *>(data), size);
+    offset_ += size;
+  }
+
+  void WriteString(const eastl::string &str) {
+    uint32_t length = SCAST_U32(str.size());
+    Write(&length, sizeof(length));
+    Write(str.data(), length);
+  }
+
+  void Align() {
+    static const uint8_t kZeros[kMeshCacheDataAlignment] = {};
+    size_t padding = (kMeshCacheDataAlignment -
+                      offset_ % kMeshCacheDataAlignment) %
+                     kMeshCacheDataAlignment;
+    Write(kZeros, padding);
+  }
+
+ private:
+  std::ofstream &stream_;
+  size_t offset_;
+
+}; // class MeshCacheWriter
+
+// Size and modification time of the source, used to detect stale caches
+static bool GetSourceStamp(
+    const eastl::string &filename,
+    uint64_t *size,
+    int64_t *mtime) {
+  struct stat file_stat;
+  if (stat(filename.c_str(), &file_stat) != 0) {
+    return false;
+  }
+  *size = static_cast<uint64_t>(file_stat.st_size);
+  *mtime = static_cast<int64_t>(file_stat.st_mtime);
+  return true;
+}
+
+eastl::string GetMeshCacheFilename(const eastl::string &model_filename) {
+  return model_filename + ".vksmesh";
+}
+
+bool ReadMeshCache(
+    const eastl::string &model_filename,
+    uint32_t post_process_steps,
+    const VertexSetup &vertex_setup,
+    MappedFile &cache_file,
+    MeshCacheContents &contents) {
+  eastl::string cache_filename = GetMeshCacheFilename(model_filename);
+  if (!cache_file.Open(cache_filename)) {
+    return false;
+  }
+
+  uint64_t source_size = 0U;
+  int64_t source_mtime = 0;
+  if (!GetSourceStamp(model_filename, &source_size, &source_mtime)) {
+    cache_file.Close();
+    return false;
+  }
+
+  MeshCacheReader reader(cache_file.data(), cache_file.size());
+  MeshCacheHeader header;
+  if (!reader.Read(&header, sizeof(header)) ||
+      header.magic != kMeshCacheMagic ||
+      header.version != kMeshCacheVersion ||
+      header.source_size != source_size ||
+      header.source_mtime != source_mtime ||
+      header.post_process_steps != post_process_steps ||
+      header.streams_layout != SCAST_U32(vertex_setup.streams_layout()) ||
+      header.elements_count != vertex_setup.num_elements()) {
+    LOG("Mesh cache " << cache_filename.c_str() << " is stale.");
+    cache_file.Close();
+    return false;
+  }
+
+  // The vertex streams have to be in the requested layout already
+  for (uint32_t i = 0U; i < header.elements_count; ++i) {
+    MeshCacheElement element;
+    if (!reader.Read(&element, sizeof(element)) ||
+        element.type !=
+          SCAST_U32(vertex_setup.vertex_types_layout()[i]) ||
+        element.size_bytes != vertex_setup.GetElementSize(i) ||
+        element.encoding != SCAST_U32(vertex_setup.GetElementEncoding(i))) {
+      LOG("Mesh cache " << cache_filename.c_str() <<
+          " has a different vertex layout.");
+      cache_file.Close();
+      return false;
+    }
+  }
+
+  bool valid = true;
+  uint32_t streams_count = vertex_setup.num_streams();
+  contents.vertex_streams.resize(streams_count);
+  contents.vertex_streams_sizes.resize(streams_count);
+  for (uint32_t i = 0U; i < streams_count && valid; ++i) {
+    uint32_t size = header.vertices_count * vertex_setup.GetStreamStride(i);
+    valid = reader.Align();
+    contents.vertex_streams[i] = reader.Take(size);
+    contents.vertex_streams_sizes[i] = size;
+    valid = valid && contents.vertex_streams[i] != nullptr;
+  }
+
+  valid = valid && reader.Align();
+  contents.indices = reinterpret_cast<const uint32_t *>(
+      reader.Take(header.indices_count * sizeof(uint32_t)));
+  contents.indices_count = header.indices_count;
+  valid = valid && contents.indices != nullptr;
+
+  contents.meshes.clear();
+  contents.meshes.reserve(header.meshes_count);
+  for (uint32_t i = 0U; i < header.meshes_count && valid; ++i) {
+    MeshCacheMesh mesh;
+    valid = reader.Read(&mesh, sizeof(mesh));
+    contents.meshes.push_back(Mesh(
+        mesh.start_index,
+        mesh.index_count,
+        mesh.vertex_offset,
+        mesh.material_id));
+    contents.meshes.back().set_position_dequant(glm::vec4(
+        mesh.position_dequant[0U],
+        mesh.position_dequant[1U],
+        mesh.position_dequant[2U],
+        mesh.position_dequant[3U]));
+    contents.meshes.back().set_bounding_sphere(glm::vec4(
+        mesh.bounding_sphere[0U],
+        mesh.bounding_sphere[1U],
+        mesh.bounding_sphere[2U],
+        mesh.bounding_sphere[3U]));
+    contents.meshes.back().set_bounds(
+        glm::vec3(mesh.bounds_min[0U], mesh.bounds_min[1U],
+                  mesh.bounds_min[2U]),
+        glm::vec3(mesh.bounds_max[0U], mesh.bounds_max[1U],
+                  mesh.bounds_max[2U]));
+    contents.meshes.back().set_meshlets(mesh.first_meshlet,
+                                        mesh.meshlets_count);
+    contents.meshes.back().set_lods(mesh.first_lod, mesh.lods_count);
+  }
+
+  // Meshlets and LODs are plain data, written as they are in memory
+  contents.meshlets.resize(valid ? header.meshlets_count : 0U);
+  valid = valid && reader.Read(contents.meshlets.data(),
+                               contents.meshlets.size() * sizeof(Meshlet));
+  contents.lods.resize(valid ? header.lods_count : 0U);
+  valid = valid && reader.Read(contents.lods.data(),
+                               contents.lods.size() * sizeof(MeshLod));
+
+  contents.materials.clear();
+  contents.materials.resize(header.materials_count);
+  for (uint32_t i = 0U; i < header.materials_count && valid; ++i) {
+    MeshCacheMaterial &material = contents.materials[i];
+    uint32_t textures_count = 0U;
+    valid = reader.ReadString(material.name) &&
+      reader.Read(&material.consts, sizeof(material.consts)) &&
+      reader.Read(&textures_count, sizeof(textures_count));
+
+    material.textures.resize(valid ? textures_count : 0U);
+    for (uint32_t t = 0U; t < textures_count && valid; ++t) {
+      uint8_t type = 0U;
+      valid = reader.Read(&type, sizeof(type)) &&
+        type < SCAST_U32(MatTextureType::size) &&
+        reader.ReadString(material.textures[t].name);
+      material.textures[t].type = static_cast<MatTextureType>(type);
+    }
+  }
+
+  if (!valid) {
+    ELOG_WARN("Mesh cache " << cache_filename.c_str() << " is truncated.");
+    cache_file.Close();
+    return false;
+  }
+
+  return true;
+}
+
+bool WriteMeshCache(
+    const eastl::string &model_filename,
+    uint32_t post_process_steps,
+    const ModelBuilder &model_builder,
+    const eastl::vector<MeshCacheMaterial> &materials) {
+  const VertexSetup &vertex_setup = *model_builder.vertex_setup();
+
+  MeshCacheHeader header;
+  header.magic = kMeshCacheMagic;
+  header.version = kMeshCacheVersion;
+  if (!GetSourceStamp(model_filename, &header.source_size,
+                      &header.source_mtime)) {
+    return false;
+  }
+  header.post_process_steps = post_process_steps;
+  header.streams_layout = SCAST_U32(vertex_setup.streams_layout());
+  header.elements_count = vertex_setup.num_elements();
+  header.vertices_count = model_builder.current_vertex();
+  header.indices_count = model_builder.GetIndicesCount();
+  header.meshes_count = SCAST_U32(model_builder.meshes().size());
+  header.meshlets_count = SCAST_U32(model_builder.meshlets().size());
+  header.lods_count = SCAST_U32(model_builder.lods().size());
+  header.materials_count = SCAST_U32(materials.size());
+
+  // Write to a temporary file first, so that an interrupted bake never
+  // leaves a broken cache behind
+  eastl::string cache_filename = GetMeshCacheFilename(model_filename);
+  eastl::string tmp_filename = cache_filename + ".tmp";
+  std::ofstream stream(tmp_filename.c_str(),
+                       std::ios::binary | std::ios::trunc);
+  if (!stream.is_open()) {
+    ELOG_WARN("Couldn't open " << tmp_filename.c_str() << " for writing.");
+    return false;
+  }
+
+  MeshCacheWriter writer(stream);
+  writer.Write(&header, sizeof(header));
+
+  for (uint32_t i = 0U; i < header.elements_count; ++i) {
+    MeshCacheElement element;
+    element.type = SCAST_U32(vertex_setup.vertex_types_layout()[i]);
+    element.size_bytes = vertex_setup.GetElementSize(i);
+    element.encoding = SCAST_U32(vertex_setup.GetElementEncoding(i));
+    writer.Write(&element, sizeof(element));
+  }
+
+  for (uint32_t i = 0U; i < vertex_setup.num_streams(); ++i) {
+    writer.Align();
+    writer.Write(model_builder.GetVertexStreamData(i),
+                 model_builder.GetVertexStreamDataSize(i));
+  }
+
+  writer.Align();
+  writer.Write(model_builder.GetIndicesData(),
+               header.indices_count * sizeof(uint32_t));
+
+  for (uint32_t i = 0U; i < header.meshes_count; ++i) {
+    const Mesh *src = model_builder.meshes()[i];
+    MeshCacheMesh mesh;
+    mesh.start_index = src->start_index();
+    mesh.index_count = src->index_count();
+    mesh.vertex_offset = src->vertex_offset();
+    mesh.material_id = src->material_id();
+    for (uint32_t c = 0U; c < 4U; ++c) {
+      mesh.position_dequant[c] = src->position_dequant()[c];
+    }
+    for (uint32_t c = 0U; c < 4U; ++c) {
+      mesh.bounding_sphere[c] = src->bounding_sphere()[c];
+    }
+    for (uint32_t c = 0U; c < 3U; ++c) {
+      mesh.bounds_min[c] = src->bounds_min()[c];
+      mesh.bounds_max[c] = src->bounds_max()[c];
+    }
+    mesh.first_meshlet = src->first_meshlet();
+    mesh.meshlets_count = src->meshlets_count();
+    mesh.first_lod = src->first_lod();
+    mesh.lods_count = src->lods_count();
+    writer.Write(&mesh, sizeof(mesh));
+  }
+
+  writer.Write(model_builder.meshlets().data(),
+               header.meshlets_count * sizeof(Meshlet));
+  writer.Write(model_builder.lods().data(),
+               header.lods_count * sizeof(MeshLod));
+
+  for (uint32_t i = 0U; i < header.materials_count; ++i) {
+    const MeshCacheMaterial &material = materials[i];
+    uint32_t textures_count = SCAST_U32(material.textures.size());
+    writer.WriteString(material.name);
+    writer.Write(&material.consts, sizeof(material.consts));
+    writer.Write(&textures_count, sizeof(textures_count));
+    for (uint32_t t = 0U; t < textures_count; ++t) {
+      uint8_t type = static_cast<uint8_t>(material.textures[t].type);
+      writer.Write(&type, sizeof(type));
+      writer.WriteString(material.textures[t].name);
+    }
+  }
+
+  stream.close();
+  if (stream.fail()) {
+    ELOG_WARN("Couldn't write mesh cache " << tmp_filename.c_str() << ".");
+    remove(tmp_filename.c_str());
+    return false;
+  }
+
+  remove(cache_filename.c_str());
+  if (rename(tmp_filename.c_str(), cache_filename.c_str()) != 0) {
+    ELOG_WARN("Couldn't move mesh cache to " << cache_filename.c_str() << ".");
+    remove(tmp_filename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace vks
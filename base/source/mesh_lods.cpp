@@ -0,0 +1,362 @@
+#include <mesh_lods.h>
+#include <mesh_optimizer.h>
+#include <vulkan_tools.h>
+#include <EASTL/sort.h>
+#include <algorithm>
+#include <cmath>
+
+namespace vks {
+
+extern const uint32_t kMaxMeshLods = 4U;
+// Meshes smaller than this aren't worth simplifying any further
+static const uint32_t kMinLodIndicesCount = 3U * 64U;
+// A LOD is dropped if it doesn't have at least a fifth fewer triangles than
+// the previous one, as it mostly saves nothing
+static const float kMinLodReduction = 0.8f;
+// Largest error a LOD can reach, relative to the radius of the mesh
+static const float kMaxLodRelativeError = 0.1f;
+// Largest error, in pixels, SelectMeshLod lets through
+static const float kMaxLodPixelError = 1.f;
+
+static inline glm::vec3 GetPosition(
+    const float *positions,
+    uint32_t stride,
+    uint32_t i) {
+  const float *p = reinterpret_cast<const float *>(
+      reinterpret_cast<const uint8_t *>(positions) + i * stride);
+  return glm::vec3(p[0U], p[1U], p[2U]);
+}
+
+// Sum of squared distances from a set of planes, as a symmetric matrix
+struct Quadric {
+  Quadric()
+      : a00(0.0), a01(0.0), a02(0.0), a11(0.0), a12(0.0), a22(0.0),
+        b0(0.0), b1(0.0), b2(0.0), c(0.0) {}
+
+  void AddPlane(const glm::vec3 &n, float d) {
+    a00 += n.x * n.x; a01 += n.x * n.y; a02 += n.x * n.z;
+    a11 += n.y * n.y; a12 += n.y * n.z; a22 += n.z * n.z;
+    b0 += n.x * d; b1 += n.y * d; b2 += n.z * d;
+    c += d * d;
+  }
+
+  void Add(const Quadric &other) {
+    a00 += other.a00; a01 += other.a01; a02 += other.a02;
+    a11 += other.a11; a12 += other.a12; a22 += other.a22;
+    b0 += other.b0; b1 += other.b1; b2 += other.b2;
+    c += other.c;
+  }
+
+  double Evaluate(const glm::vec3 &p) const {
+    double x = p.x, y = p.y, z = p.z;
+    double value = a00 * x * x + a11 * y * y + a22 * z * z +
+      2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+      2.0 * (b0 * x + b1 * y + b2 * z) + c;
+    return std::max(value, 0.0);
+  }
+
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+}; // struct Quadric
+
+// Collapse of vertex from into vertex to
+struct EdgeCollapse {
+  uint32_t from;
+  uint32_t to;
+  double cost;
+
+  bool operator<(const EdgeCollapse &other) const {
+    return cost < other.cost;
+  }
+}; // struct EdgeCollapse
+
+// Vertices of edges which only one triangle uses, or more than two; moving
+// them would open holes or tear attribute seams
+static void FindLockedVertices(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    uint32_t vertices_count,
+    eastl::vector<bool> &locked) {
+  eastl::vector<uint64_t> edges;
+  edges.reserve(indices_count);
+  for (uint32_t i = 0U; i < indices_count; i += 3U) {
+    for (uint32_t e = 0U; e < 3U; ++e) {
+      uint64_t a = indices[i + e];
+      uint64_t b = indices[i + (e + 1U) % 3U];
+      edges.push_back((std::min(a, b) << 32U) | std::max(a, b));
+    }
+  }
+  eastl::sort(edges.begin(), edges.end());
+
+  locked.assign(vertices_count, false);
+  for (uint32_t i = 0U; i < edges.size();) {
+    uint32_t j = i + 1U;
+    while (j < edges.size() && edges[j] == edges[i]) {
+      ++j;
+    }
+    if (j - i != 2U) {
+      locked[static_cast<uint32_t>(edges[i] >> 32U)] = true;
+      locked[static_cast<uint32_t>(edges[i] & 0xFFFFFFFFU)] = true;
+    }
+    i = j;
+  }
+}
+
+// Whether moving vertex from onto vertex to would turn any of the triangles
+// around it over
+static bool FlipsTriangles(
+    const uint32_t *indices,
+    const eastl::vector<uint32_t> &adjacency_offsets,
+    const eastl::vector<uint32_t> &adjacency,
+    const eastl::vector<uint32_t> &remap,
+    const float *positions,
+    uint32_t stride,
+    uint32_t from,
+    uint32_t to) {
+  glm::vec3 to_position = GetPosition(positions, stride, to);
+  for (uint32_t t = adjacency_offsets[from];
+       t < adjacency_offsets[from + 1U];
+       ++t) {
+    const uint32_t *triangle = indices + adjacency[t] * 3U;
+    uint32_t v[3U] = {remap[triangle[0U]], remap[triangle[1U]],
+                      remap[triangle[2U]]};
+    if (v[0U] == to || v[1U] == to || v[2U] == to) {
+      // It collapses
+      continue;
+    }
+
+    glm::vec3 p[3U];
+    glm::vec3 moved[3U];
+    for (uint32_t c = 0U; c < 3U; ++c) {
+      p[c] = GetPosition(positions, stride, v[c]);
+      moved[c] = (v[c] == from) ? to_position : p[c];
+    }
+    glm::vec3 normal = glm::cross(p[1U] - p[0U], p[2U] - p[0U]);
+    glm::vec3 moved_normal = glm::cross(moved[1U] - moved[0U],
+                                        moved[2U] - moved[0U]);
+    if (glm::dot(normal, moved_normal) <= 0.f) {
+      return true;
+    }
+  }
+  return false;
+}
+
+float SimplifyMesh(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t positions_stride,
+    uint32_t vertices_count,
+    uint32_t target_indices_count,
+    float max_error,
+    eastl::vector<uint32_t> &result) {
+  result.assign(indices, indices + indices_count);
+
+  eastl::vector<bool> locked;
+  FindLockedVertices(indices, indices_count, vertices_count, locked);
+
+  // Planes of the triangles around each vertex
+  eastl::vector<Quadric> quadrics(vertices_count);
+  for (uint32_t i = 0U; i < indices_count; i += 3U) {
+    glm::vec3 p0 = GetPosition(positions, positions_stride, indices[i]);
+    glm::vec3 normal = glm::cross(
+        GetPosition(positions, positions_stride, indices[i + 1U]) - p0,
+        GetPosition(positions, positions_stride, indices[i + 2U]) - p0);
+    float length = glm::length(normal);
+    if (length == 0.f) {
+      continue;
+    }
+    normal /= length;
+    float d = -glm::dot(normal, p0);
+    for (uint32_t c = 0U; c < 3U; ++c) {
+      quadrics[indices[i + c]].AddPlane(normal, d);
+    }
+  }
+
+  double max_cost = static_cast<double>(max_error) * max_error;
+  double error = 0.0;
+  eastl::vector<uint32_t> remap(vertices_count);
+  eastl::vector<bool> touched(vertices_count);
+  eastl::vector<uint32_t> adjacency_offsets(vertices_count + 1U);
+  eastl::vector<uint32_t> adjacency;
+  eastl::vector<EdgeCollapse> collapses;
+
+  // Collapse the cheapest edges which don't touch each other in passes,
+  // until the target or the error limit is reached
+  while (result.size() > target_indices_count) {
+    uint32_t triangles_count = SCAST_U32(result.size()) / 3U;
+
+    collapses.clear();
+    for (uint32_t i = 0U; i < result.size(); i += 3U) {
+      for (uint32_t e = 0U; e < 3U; ++e) {
+        uint32_t a = result[i + e];
+        uint32_t b = result[i + (e + 1U) % 3U];
+        for (uint32_t dir = 0U; dir < 2U; ++dir, eastl::swap(a, b)) {
+          if (locked[a]) {
+            continue;
+          }
+          Quadric merged = quadrics[a];
+          merged.Add(quadrics[b]);
+          EdgeCollapse collapse;
+          collapse.from = a;
+          collapse.to = b;
+          collapse.cost = merged.Evaluate(
+              GetPosition(positions, positions_stride, b));
+          collapses.push_back(collapse);
+        }
+      }
+    }
+    eastl::sort(collapses.begin(), collapses.end());
+
+    // Triangles around each vertex
+    adjacency_offsets.assign(vertices_count + 1U, 0U);
+    for (uint32_t i = 0U; i < result.size(); ++i) {
+      ++adjacency_offsets[result[i] + 1U];
+    }
+    for (uint32_t v = 0U; v < vertices_count; ++v) {
+      adjacency_offsets[v + 1U] += adjacency_offsets[v];
+    }
+    adjacency.resize(result.size());
+    eastl::vector<uint32_t> fill(adjacency_offsets.begin(),
+                                 adjacency_offsets.end() - 1);
+    for (uint32_t i = 0U; i < result.size(); ++i) {
+      adjacency[fill[result[i]]++] = i / 3U;
+    }
+
+    for (uint32_t v = 0U; v < vertices_count; ++v) {
+      remap[v] = v;
+    }
+    touched.assign(vertices_count, false);
+
+    uint32_t removed_count = 0U;
+    uint32_t target_removed_count = triangles_count -
+      target_indices_count / 3U;
+    for (eastl::vector<EdgeCollapse>::const_iterator c = collapses.begin();
+         c != collapses.end() && removed_count < target_removed_count;
+         ++c) {
+      if (c->cost > max_cost) {
+        break;
+      }
+      if (touched[c->from] || touched[c->to] ||
+          FlipsTriangles(result.data(), adjacency_offsets, adjacency, remap,
+                         positions, positions_stride, c->from, c->to)) {
+        continue;
+      }
+
+      for (uint32_t t = adjacency_offsets[c->from];
+           t < adjacency_offsets[c->from + 1U];
+           ++t) {
+        const uint32_t *triangle = result.data() + adjacency[t] * 3U;
+        for (uint32_t k = 0U; k < 3U; ++k) {
+          if (remap[triangle[k]] == c->to) {
+            ++removed_count;
+          }
+          // Neighbours would be judged on stale triangles if they
+          // collapsed in the same pass
+          touched[triangle[k]] = true;
+        }
+      }
+      remap[c->from] = c->to;
+      quadrics[c->to].Add(quadrics[c->from]);
+      error = std::max(error, c->cost);
+    }
+
+    if (removed_count == 0U) {
+      break;
+    }
+
+    // Drop the triangles which collapsed
+    uint32_t write = 0U;
+    for (uint32_t i = 0U; i < result.size(); i += 3U) {
+      uint32_t a = remap[result[i]];
+      uint32_t b = remap[result[i + 1U]];
+      uint32_t c = remap[result[i + 2U]];
+      if (a != b && b != c && a != c) {
+        result[write++] = a;
+        result[write++] = b;
+        result[write++] = c;
+      }
+    }
+    result.resize(write);
+  }
+
+  return static_cast<float>(sqrt(error));
+}
+
+void BuildMeshLods(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t positions_stride,
+    uint32_t vertices_count,
+    eastl::vector<uint32_t> &lod_indices,
+    eastl::vector<MeshLod> &lods) {
+  glm::vec3 min_pos(0.f);
+  glm::vec3 max_pos(0.f);
+  for (uint32_t v = 0U; v < vertices_count; ++v) {
+    glm::vec3 p = GetPosition(positions, positions_stride, v);
+    min_pos = (v == 0U) ? p : glm::min(min_pos, p);
+    max_pos = (v == 0U) ? p : glm::max(max_pos, p);
+  }
+  float max_error = glm::length(max_pos - min_pos) * 0.5f *
+    kMaxLodRelativeError;
+
+  // Each level is simplified from the previous one, so their errors add up
+  eastl::vector<uint32_t> current(indices, indices + indices_count);
+  eastl::vector<uint32_t> simplified;
+  float error = 0.f;
+  for (uint32_t lod = 0U; lod < kMaxMeshLods; ++lod) {
+    uint32_t target_indices_count = current.size() / 6U * 3U;
+    if (target_indices_count < kMinLodIndicesCount) {
+      break;
+    }
+
+    float lod_error = SimplifyMesh(
+        current.data(), SCAST_U32(current.size()), positions,
+        positions_stride, vertices_count, target_indices_count,
+        max_error - error, simplified);
+    if (simplified.size() > current.size() * kMinLodReduction) {
+      break;
+    }
+    OptimizeVertexCache(simplified.data(), SCAST_U32(simplified.size()),
+                        vertices_count, nullptr);
+    error += lod_error;
+
+    MeshLod mesh_lod;
+    mesh_lod.first_index = SCAST_U32(lod_indices.size());
+    mesh_lod.indices_count = SCAST_U32(simplified.size());
+    mesh_lod.error = error;
+    lods.push_back(mesh_lod);
+    lod_indices.insert(lod_indices.end(), simplified.begin(),
+                       simplified.end());
+    current.swap(simplified);
+  }
+}
+
+uint32_t SelectMeshLod(
+    const MeshLod *lods,
+    uint32_t lods_count,
+    const glm::mat4 &model_mat,
+    const glm::vec4 &bounding_sphere,
+    const glm::vec3 &viewer_position,
+    float pixels_per_unit) {
+  glm::vec3 centre(model_mat * glm::vec4(glm::vec3(bounding_sphere), 1.f));
+  float scale = glm::length(glm::vec3(model_mat[0U]));
+  // Nearest the mesh can be to the viewer
+  float distance = glm::length(centre - viewer_position) -
+    bounding_sphere.w * scale;
+  if (distance <= 0.f) {
+    return 0U;
+  }
+
+  float pixels_per_error = scale * pixels_per_unit / distance;
+  uint32_t level = 0U;
+  while (level < lods_count &&
+         lods[level].error * pixels_per_error <= kMaxLodPixelError) {
+    ++level;
+  }
+  return level;
+}
+
+} // namespace vks
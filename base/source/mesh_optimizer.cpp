@@ -0,0 +1,358 @@
+#include <mesh_optimizer.h>
+#include <vulkan_tools.h>
+#include <glm/glm.hpp>
+#include <EASTL/sort.h>
+#include <algorithm>
+#include <cstring>
+
+namespace vks {
+
+extern const uint32_t kVertexCacheSize = 16U;
+
+VertexCacheStats::VertexCacheStats()
+    : transformed_vertices_count(0U),
+      triangles_count(0U),
+      vertices_count(0U) {}
+
+void VertexCacheStats::Merge(const VertexCacheStats &other) {
+  transformed_vertices_count += other.transformed_vertices_count;
+  triangles_count += other.triangles_count;
+  vertices_count += other.vertices_count;
+}
+
+float VertexCacheStats::GetACMR() const {
+  return (triangles_count != 0U) ?
+    static_cast<float>(transformed_vertices_count) / triangles_count : 0.f;
+}
+
+float VertexCacheStats::GetATVR() const {
+  return (vertices_count != 0U) ?
+    static_cast<float>(transformed_vertices_count) / vertices_count : 0.f;
+}
+
+VertexCacheStats AnalyzeVertexCache(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    uint32_t vertices_count,
+    uint32_t cache_size) {
+  VertexCacheStats stats;
+  stats.triangles_count = indices_count / 3U;
+
+  // Time at which each vertex entered the cache; it is still in it while
+  // fewer than cache_size misses have happened since
+  eastl::vector<uint32_t> cache_times(vertices_count, 0U);
+  uint32_t time = cache_size + 1U;
+  eastl::vector<bool> used(vertices_count, false);
+  for (uint32_t i = 0U; i < indices_count; ++i) {
+    uint32_t v = indices[i];
+    if (time - cache_times[v] > cache_size) {
+      cache_times[v] = time++;
+      ++stats.transformed_vertices_count;
+    }
+    if (!used[v]) {
+      used[v] = true;
+      ++stats.vertices_count;
+    }
+  }
+
+  return stats;
+}
+
+// Triangles using each vertex, in compressed rows
+struct TriangleAdjacency {
+  eastl::vector<uint32_t> offsets;
+  eastl::vector<uint32_t> triangles;
+}; // struct TriangleAdjacency
+
+static void BuildTriangleAdjacency(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    uint32_t vertices_count,
+    TriangleAdjacency &adjacency,
+    eastl::vector<uint32_t> &live_counts) {
+  live_counts.assign(vertices_count, 0U);
+  for (uint32_t i = 0U; i < indices_count; ++i) {
+    ++live_counts[indices[i]];
+  }
+
+  adjacency.offsets.resize(vertices_count + 1U);
+  uint32_t offset = 0U;
+  for (uint32_t v = 0U; v < vertices_count; ++v) {
+    adjacency.offsets[v] = offset;
+    offset += live_counts[v];
+  }
+  adjacency.offsets[vertices_count] = offset;
+
+  adjacency.triangles.resize(indices_count);
+  eastl::vector<uint32_t> fill(adjacency.offsets.begin(),
+                               adjacency.offsets.end() - 1);
+  for (uint32_t i = 0U; i < indices_count; ++i) {
+    adjacency.triangles[fill[indices[i]]++] = i / 3U;
+  }
+}
+
+void OptimizeVertexCache(
+    uint32_t *indices,
+    uint32_t indices_count,
+    uint32_t vertices_count,
+    eastl::vector<uint32_t> *clusters) {
+  uint32_t triangles_count = indices_count / 3U;
+  if (clusters != nullptr) {
+    clusters->clear();
+  }
+  if (triangles_count == 0U) {
+    return;
+  }
+
+  TriangleAdjacency adjacency;
+  eastl::vector<uint32_t> live_counts;
+  BuildTriangleAdjacency(indices, indices_count, vertices_count, adjacency,
+                         live_counts);
+
+  eastl::vector<uint32_t> cache_times(vertices_count, 0U);
+  eastl::vector<bool> emitted(triangles_count, false);
+  eastl::vector<uint32_t> dead_ends;
+  eastl::vector<uint32_t> candidates;
+  eastl::vector<uint32_t> output;
+  output.reserve(indices_count);
+
+  const uint32_t cache_size = kVertexCacheSize;
+  uint32_t time = cache_size + 1U;
+  uint32_t cursor = 0U;
+  int64_t fan_vertex = 0;
+  bool restarted = true;
+  while (fan_vertex >= 0) {
+    if (restarted && clusters != nullptr) {
+      clusters->push_back(SCAST_U32(output.size()) / 3U);
+    }
+
+    // Emit all the live triangles around the fanning vertex
+    uint32_t f = static_cast<uint32_t>(fan_vertex);
+    candidates.clear();
+    for (uint32_t a = adjacency.offsets[f]; a < adjacency.offsets[f + 1U];
+         ++a) {
+      uint32_t t = adjacency.triangles[a];
+      if (emitted[t]) {
+        continue;
+      }
+
+      for (uint32_t c = 0U; c < 3U; ++c) {
+        uint32_t v = indices[t * 3U + c];
+        output.push_back(v);
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        --live_counts[v];
+        if (time - cache_times[v] > cache_size) {
+          cache_times[v] = time++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    // Next fan: the candidate which will still be in the cache after its
+    // remaining triangles are emitted, and entered it the earliest
+    int64_t next_vertex = -1;
+    int64_t best_priority = -1;
+    for (eastl::vector<uint32_t>::const_iterator c = candidates.begin();
+         c != candidates.end();
+         ++c) {
+      if (live_counts[*c] == 0U) {
+        continue;
+      }
+      int64_t priority = 0;
+      if (time - cache_times[*c] + 2U * live_counts[*c] <= cache_size) {
+        priority = time - cache_times[*c];
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        next_vertex = *c;
+      }
+    }
+
+    restarted = (next_vertex == -1);
+    if (restarted) {
+      // Dead end: go back to recently used vertices, then scan forwards
+      while (!dead_ends.empty() && next_vertex == -1) {
+        uint32_t d = dead_ends.back();
+        dead_ends.pop_back();
+        if (live_counts[d] > 0U) {
+          next_vertex = d;
+        }
+      }
+      while (cursor < vertices_count && next_vertex == -1) {
+        if (live_counts[cursor] > 0U) {
+          next_vertex = cursor;
+        }
+        ++cursor;
+      }
+    }
+    fan_vertex = next_vertex;
+  }
+
+  memcpy(indices, output.data(), indices_count * sizeof(uint32_t));
+}
+
+// Keep the candidate boundaries after which the cluster so far, simulated
+// with a cold cache, costs few enough cache misses
+static void SelectClusters(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    uint32_t vertices_count,
+    const eastl::vector<uint32_t> &candidates,
+    float threshold,
+    eastl::vector<uint32_t> &clusters) {
+  const uint32_t cache_size = kVertexCacheSize;
+  float max_acmr = threshold *
+    AnalyzeVertexCache(indices, indices_count, vertices_count,
+                       cache_size).GetACMR();
+  uint32_t triangles_count = indices_count / 3U;
+
+  eastl::vector<uint32_t> cache_times(vertices_count, 0U);
+  uint32_t time = cache_size + 1U;
+  uint32_t cluster_misses = 0U;
+  uint32_t t = 0U;
+
+  clusters.clear();
+  clusters.push_back(0U);
+  for (uint32_t c = 1U; c < SCAST_U32(candidates.size()); ++c) {
+    uint32_t end = candidates[c];
+    if (end <= t || end >= triangles_count) {
+      continue;
+    }
+
+    for (; t < end; ++t) {
+      for (uint32_t i = t * 3U; i < t * 3U + 3U; ++i) {
+        if (time - cache_times[indices[i]] > cache_size) {
+          cache_times[indices[i]] = time++;
+          ++cluster_misses;
+        }
+      }
+    }
+
+    uint32_t cluster_triangles = end - clusters.back();
+    if (cluster_misses <= max_acmr * cluster_triangles) {
+      clusters.push_back(end);
+      // Flush the cache for the next cluster
+      time += cache_size + 1U;
+      cluster_misses = 0U;
+    }
+  }
+}
+
+void OptimizeOverdraw(
+    uint32_t *indices,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t positions_stride,
+    uint32_t vertices_count,
+    const eastl::vector<uint32_t> &clusters,
+    float threshold) {
+  uint32_t triangles_count = indices_count / 3U;
+  if (triangles_count == 0U || clusters.size() < 2U) {
+    return;
+  }
+
+  eastl::vector<uint32_t> boundaries;
+  SelectClusters(indices, indices_count, vertices_count, clusters, threshold,
+                 boundaries);
+  uint32_t clusters_count = SCAST_U32(boundaries.size());
+  if (clusters_count < 2U) {
+    return;
+  }
+  boundaries.push_back(triangles_count);
+
+  const uint8_t *position_bytes = reinterpret_cast<const uint8_t *>(positions);
+  auto get_position = [&](uint32_t v) {
+    const float *p =
+      reinterpret_cast<const float *>(position_bytes + v * positions_stride);
+    return glm::vec3(p[0U], p[1U], p[2U]);
+  };
+
+  // Area weighted centroid and average normal of each cluster
+  eastl::vector<glm::vec3> centroids(clusters_count, glm::vec3(0.f));
+  eastl::vector<glm::vec3> normals(clusters_count, glm::vec3(0.f));
+  glm::vec3 mesh_centroid(0.f);
+  float mesh_area = 0.f;
+  for (uint32_t c = 0U; c < clusters_count; ++c) {
+    float cluster_area = 0.f;
+    for (uint32_t t = boundaries[c]; t < boundaries[c + 1U]; ++t) {
+      glm::vec3 p0 = get_position(indices[t * 3U + 0U]);
+      glm::vec3 p1 = get_position(indices[t * 3U + 1U]);
+      glm::vec3 p2 = get_position(indices[t * 3U + 2U]);
+      glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+      float area = glm::length(normal);
+      centroids[c] += (p0 + p1 + p2) * (area / 3.f);
+      normals[c] += normal;
+      cluster_area += area;
+    }
+    mesh_centroid += centroids[c];
+    mesh_area += cluster_area;
+    centroids[c] = (cluster_area > 0.f) ? centroids[c] / cluster_area :
+                                          get_position(
+                                              indices[boundaries[c] * 3U]);
+  }
+  if (mesh_area > 0.f) {
+    mesh_centroid /= mesh_area;
+  }
+
+  // Clusters facing away from the centre are drawn first
+  eastl::vector<float> sort_keys(clusters_count);
+  eastl::vector<uint32_t> order(clusters_count);
+  for (uint32_t c = 0U; c < clusters_count; ++c) {
+    float normal_length = glm::length(normals[c]);
+    glm::vec3 normal = (normal_length > 0.f) ? normals[c] / normal_length :
+                                               glm::vec3(0.f);
+    sort_keys[c] = glm::dot(centroids[c] - mesh_centroid, normal);
+    order[c] = c;
+  }
+  eastl::stable_sort(order.begin(), order.end(),
+    [&sort_keys](uint32_t lhs, uint32_t rhs) {
+    return sort_keys[lhs] > sort_keys[rhs];
+  });
+
+  eastl::vector<uint32_t> sorted;
+  sorted.reserve(indices_count);
+  for (uint32_t i = 0U; i < clusters_count; ++i) {
+    uint32_t c = order[i];
+    sorted.insert(sorted.end(), indices + boundaries[c] * 3U,
+                  indices + boundaries[c + 1U] * 3U);
+  }
+  memcpy(indices, sorted.data(), indices_count * sizeof(uint32_t));
+}
+
+void OptimizeVertexFetch(
+    uint32_t *indices,
+    uint32_t indices_count,
+    uint32_t vertices_count,
+    eastl::vector<uint32_t> &remap) {
+  const uint32_t kUnmapped = ~0U;
+  remap.assign(vertices_count, kUnmapped);
+
+  uint32_t next_vertex = 0U;
+  for (uint32_t i = 0U; i < indices_count; ++i) {
+    uint32_t &new_index = remap[indices[i]];
+    if (new_index == kUnmapped) {
+      new_index = next_vertex++;
+    }
+    indices[i] = new_index;
+  }
+
+  for (uint32_t v = 0U; v < vertices_count; ++v) {
+    if (remap[v] == kUnmapped) {
+      remap[v] = next_vertex++;
+    }
+  }
+}
+
+void RemapVertices(
+    uint8_t *vertices,
+    uint32_t vertices_count,
+    uint32_t stride,
+    const eastl::vector<uint32_t> &remap) {
+  eastl::vector<uint8_t> src(vertices, vertices + vertices_count * stride);
+  for (uint32_t v = 0U; v < vertices_count; ++v) {
+    memcpy(vertices + remap[v] * stride, src.data() + v * stride, stride);
+  }
+}
+
+} // namespace vks
@@ -0,0 +1,477 @@
+#include <mesh_packing.h>
+#include <vertex_setup.h>
+#include <bounds.h>
+#include <vulkan_tools.h>
+#include <logger.hpp>
+#include <base_system.h>
+#include <worker_pool.h>
+#include <vertex_quantization.h>
+#include <mesh_optimizer.h>
+#include <assimp/mesh.h>
+#include <assimp/postprocess.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define VKS_MESHPACKING_SSE
+#endif
+
+namespace vks {
+
+static const uint32_t kVector3Size = SCAST_U32(sizeof(aiVector3D));
+// How much worse the vertex cache may get to draw finer clusters in overdraw
+// order
+static const float kOverdrawThreshold = 1.05f;
+
+void ComputePackedMeshRanges(
+    const aiMesh *const *meshes,
+    uint32_t meshes_count,
+    eastl::vector<PackedMeshRange> &ranges,
+    uint32_t *total_vertices,
+    uint32_t *total_indices) {
+  ranges.resize(meshes_count);
+
+  uint32_t vertices_count = 0U;
+  uint32_t indices_count = 0U;
+  for (uint32_t i = 0U; i < meshes_count; ++i) {
+    ranges[i].first_vertex = vertices_count;
+    ranges[i].vertices_count = meshes[i]->mNumVertices;
+    ranges[i].first_index = indices_count;
+    ranges[i].indices_count = meshes[i]->mNumFaces * 3U;
+    vertices_count += ranges[i].vertices_count;
+    indices_count += ranges[i].indices_count;
+  }
+
+  *total_vertices = vertices_count;
+  *total_indices = indices_count;
+}
+
+// Assimp's vectors are packed, but its arrays of them come from new[] and
+// are aligned for floats; they are read as such rather than through the
+// addresses of their members
+static inline const float *GetFloats(const void *vectors) {
+  return static_cast<const float *>(vectors);
+}
+
+// Copy an attribute into a stream whose elements may be smaller or bigger
+// than a vector and may be interleaved with others, stride bytes apart;
+// missing attributes and extra components are zeroed
+static void CopyVectors(
+    const aiVector3D *src,
+    uint32_t count,
+    uint32_t element_size,
+    uint32_t stride,
+    uint8_t *dst) {
+  if (stride == element_size) {
+    if (src == nullptr) {
+      memset(dst, 0, count * element_size);
+      return;
+    }
+
+    if (element_size == kVector3Size) {
+      memcpy(dst, src, count * element_size);
+      return;
+    }
+  }
+
+  if (src == nullptr) {
+    for (uint32_t i = 0U; i < count; ++i, dst += stride) {
+      memset(dst, 0, element_size);
+    }
+    return;
+  }
+
+  uint32_t copy_size = std::min(element_size, kVector3Size);
+  for (uint32_t i = 0U; i < count; ++i, dst += stride) {
+    memcpy(dst, &src[i], copy_size);
+    memset(dst + copy_size, 0, element_size - copy_size);
+  }
+}
+
+// Handedness of a tangent frame; negative if it is mirrored
+static inline float Handedness(
+    const aiVector3D &n,
+    const aiVector3D &t,
+    const aiVector3D &b) {
+  return (n.y * t.z - n.z * t.y) * b.x +
+         (n.z * t.x - n.x * t.z) * b.y +
+         (n.x * t.y - n.y * t.x) * b.z;
+}
+
+#ifdef VKS_MESHPACKING_SSE
+// Deinterleave 4 packed xyz vectors into one register per component
+static inline void LoadVectors4(
+    const float *src,
+    __m128 *x,
+    __m128 *y,
+    __m128 *z) {
+  // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+  __m128 a = _mm_loadu_ps(src);
+  __m128 b = _mm_loadu_ps(src + 4U);
+  __m128 c = _mm_loadu_ps(src + 8U);
+  __m128 b2c1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 2, 2));
+  *x = _mm_shuffle_ps(a, b2c1, _MM_SHUFFLE(3, 0, 3, 0));
+  __m128 a1b0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+  __m128 b3c2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+  *y = _mm_shuffle_ps(a1b0, b3c2, _MM_SHUFFLE(2, 0, 2, 0));
+  __m128 a2b1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+  __m128 c0c3 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+  *z = _mm_shuffle_ps(a2b1, c0c3, _MM_SHUFFLE(2, 0, 2, 0));
+}
+#endif
+
+// Flip in place the tangents of mirrored tangent frames, so that
+// cross(normal, tangent) always points along the bitangent
+static void FlipMirroredTangents(
+    const aiVector3D *normals,
+    const aiVector3D *bitangents,
+    uint32_t count,
+    uint32_t element_size,
+    uint32_t stride,
+    uint8_t *tangents) {
+  uint32_t i = 0U;
+
+#ifdef VKS_MESHPACKING_SSE
+  // Four tangents at a time; the sign mask of each frame is expanded back to
+  // the packed layout and xor-ed into the tangents
+  if (element_size == kVector3Size && stride == kVector3Size) {
+    const __m128 sign_bit = _mm_set1_ps(-0.f);
+    const __m128 zero = _mm_setzero_ps();
+    float *dst = reinterpret_cast<float *>(tangents);
+    for (; i + 4U <= count; i += 4U) {
+      __m128 nx, ny, nz, tx, ty, tz, bx, by, bz;
+      LoadVectors4(GetFloats(normals) + i * 3U, &nx, &ny, &nz);
+      LoadVectors4(dst + i * 3U, &tx, &ty, &tz);
+      LoadVectors4(GetFloats(bitangents) + i * 3U, &bx, &by, &bz);
+
+      __m128 cx = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+      __m128 cy = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+      __m128 cz = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+      __m128 handedness = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(cx, bx), _mm_mul_ps(cy, by)),
+          _mm_mul_ps(cz, bz));
+      __m128 mask = _mm_and_ps(_mm_cmplt_ps(handedness, zero), sign_bit);
+
+      float *t = dst + i * 3U;
+      _mm_storeu_ps(t, _mm_xor_ps(_mm_loadu_ps(t),
+          _mm_shuffle_ps(mask, mask, _MM_SHUFFLE(1, 0, 0, 0))));
+      _mm_storeu_ps(t + 4U, _mm_xor_ps(_mm_loadu_ps(t + 4U),
+          _mm_shuffle_ps(mask, mask, _MM_SHUFFLE(2, 2, 1, 1))));
+      _mm_storeu_ps(t + 8U, _mm_xor_ps(_mm_loadu_ps(t + 8U),
+          _mm_shuffle_ps(mask, mask, _MM_SHUFFLE(3, 3, 3, 2))));
+    }
+  }
+#endif
+
+  uint32_t copy_size = std::min(element_size, kVector3Size);
+  for (; i < count; ++i) {
+    uint8_t *dst = tangents + i * stride;
+    float t[3U] = {0.f, 0.f, 0.f};
+    memcpy(t, dst, copy_size);
+    if (Handedness(normals[i], aiVector3D(t[0U], t[1U], t[2U]),
+                   bitangents[i]) < 0.f) {
+      for (uint32_t c = 0U; c < 3U; ++c) {
+        t[c] = -t[c];
+      }
+      memcpy(dst, t, copy_size);
+    }
+  }
+}
+
+// Encode a quantized element of a mesh
+static void EncodeAssimpElement(
+    const aiMesh *ai_mesh,
+    VertexElementType type,
+    VertexElementEncoding encoding,
+    bool has_tangent_space,
+    uint32_t element_size,
+    const glm::vec4 &position_dequant,
+    uint32_t stride,
+    uint8_t *dst,
+    VertexQuantizationError *error) {
+  uint32_t count = ai_mesh->mNumVertices;
+  const aiVector3D *src = nullptr;
+  // Flipped copy of the tangents, which are encoded after the flip
+  eastl::vector<aiVector3D> tangents;
+
+  switch (type) {
+    case VertexElementType::POSITION: {
+      src = ai_mesh->mVertices;
+      break;
+    }
+    case VertexElementType::NORMAL: {
+      if (encoding == VertexElementEncoding::TANGENT_FRAME_SNORM16) {
+        EncodeTangentFrames(
+            GetFloats(ai_mesh->mNormals),
+            GetFloats(has_tangent_space ? ai_mesh->mTangents : nullptr),
+            GetFloats(has_tangent_space ? ai_mesh->mBitangents : nullptr),
+            kVector3Size, count, stride, dst, error);
+        return;
+      }
+      src = ai_mesh->mNormals;
+      break;
+    }
+    case VertexElementType::UV: {
+      src = ai_mesh->mTextureCoords[0U];
+      break;
+    }
+    case VertexElementType::TANGENT: {
+      if (has_tangent_space && ai_mesh->mNormals != nullptr) {
+        tangents.assign(ai_mesh->mTangents, ai_mesh->mTangents + count);
+        FlipMirroredTangents(ai_mesh->mNormals, ai_mesh->mBitangents, count,
+                             kVector3Size, kVector3Size,
+                             reinterpret_cast<uint8_t *>(tangents.data()));
+        src = tangents.data();
+      }
+      else if (has_tangent_space) {
+        src = ai_mesh->mTangents;
+      }
+      break;
+    }
+    case VertexElementType::BITANGENT: {
+      src = has_tangent_space ? ai_mesh->mBitangents : nullptr;
+      break;
+    }
+    case VertexElementType::COLOUR: {
+      break;
+    }
+    default:
+      ELOG_WARN("Unsupported vertex element type!");
+      return;
+  }
+
+  EncodeVectors(encoding, GetFloats(src), kVector3Size, count, element_size,
+                position_dequant, stride, dst, error);
+}
+
+static void PackAssimpMesh(
+    const aiMesh *ai_mesh,
+    const PackedMeshRange &range,
+    uint32_t post_process_steps,
+    const VertexSetup &vertex_setup,
+    uint8_t *const *streams,
+    uint32_t *indices,
+    glm::vec4 *position_dequant,
+    VertexQuantizationError *errors) {
+  bool has_tangent_space =
+    (post_process_steps & aiProcess_CalcTangentSpace) &&
+    ai_mesh->mTangents != nullptr && ai_mesh->mBitangents != nullptr;
+
+  // Quantized positions are fit to the mesh's own bounds
+  glm::vec4 dequant(0.f, 0.f, 0.f, 1.f);
+
+  for (uint32_t e = 0U; e < vertex_setup.num_elements(); ++e) {
+    uint32_t element_size = vertex_setup.GetElementSize(e);
+    uint32_t stream = vertex_setup.GetElementStream(e);
+    uint32_t stride = vertex_setup.GetStreamStride(stream);
+    uint8_t *dst = streams[stream] + range.first_vertex * stride +
+      vertex_setup.GetElementOffset(e);
+
+    VertexElementEncoding encoding = vertex_setup.GetElementEncoding(e);
+    if (encoding != VertexElementEncoding::FLOAT) {
+      if (encoding == VertexElementEncoding::SNORM16_POSITION) {
+        dequant = ComputePositionDequant(GetFloats(ai_mesh->mVertices),
+                                         range.vertices_count, kVector3Size);
+      }
+      EncodeAssimpElement(ai_mesh, vertex_setup.vertex_types_layout()[e],
+                          encoding, has_tangent_space, element_size, dequant,
+                          stride, dst, (errors != nullptr) ? &errors[e] :
+                                                             nullptr);
+      continue;
+    }
+
+    switch (vertex_setup.vertex_types_layout()[e]) {
+      case VertexElementType::POSITION: {
+        CopyVectors(ai_mesh->mVertices, range.vertices_count, element_size,
+                    stride, dst);
+        break;
+      }
+      case VertexElementType::NORMAL: {
+        CopyVectors(ai_mesh->mNormals, range.vertices_count, element_size,
+                    stride, dst);
+        break;
+      }
+      case VertexElementType::UV: {
+        CopyVectors(ai_mesh->mTextureCoords[0U], range.vertices_count,
+                    element_size, stride, dst);
+        break;
+      }
+      case VertexElementType::TANGENT: {
+        CopyVectors(has_tangent_space ? ai_mesh->mTangents : nullptr,
+                    range.vertices_count, element_size, stride, dst);
+        if (has_tangent_space && ai_mesh->mNormals != nullptr) {
+          FlipMirroredTangents(ai_mesh->mNormals, ai_mesh->mBitangents,
+                               range.vertices_count, element_size, stride,
+                               dst);
+        }
+        break;
+      }
+      case VertexElementType::BITANGENT: {
+        CopyVectors(has_tangent_space ? ai_mesh->mBitangents : nullptr,
+                    range.vertices_count, element_size, stride, dst);
+        break;
+      }
+      case VertexElementType::COLOUR: {
+        CopyVectors(nullptr, range.vertices_count, element_size, stride, dst);
+        break;
+      }
+      default:
+        ELOG_WARN("Unsupported vertex element type!");
+    }
+  }
+
+  uint32_t *dst_indices = indices + range.first_index;
+  for (uint32_t f = 0U; f < ai_mesh->mNumFaces; ++f) {
+    const aiFace &face = ai_mesh->mFaces[f];
+    VKS_ASSERT(face.mNumIndices == 3U, "Only triangulated meshes can be packed");
+    dst_indices[0U] = face.mIndices[0U] + range.first_vertex;
+    dst_indices[1U] = face.mIndices[1U] + range.first_vertex;
+    dst_indices[2U] = face.mIndices[2U] + range.first_vertex;
+    dst_indices += 3U;
+  }
+
+  if (position_dequant != nullptr) {
+    *position_dequant = dequant;
+  }
+}
+
+void PackAssimpMeshes(
+    const aiMesh *const *meshes,
+    const PackedMeshRange *ranges,
+    uint32_t meshes_count,
+    uint32_t post_process_steps,
+    const VertexSetup &vertex_setup,
+    uint8_t *const *streams,
+    uint32_t *indices,
+    glm::vec4 *position_dequants,
+    VertexQuantizationError *errors) {
+  // Errors are gathered per chunk and merged at its end
+  std::mutex errors_mutex;
+  worker_pool()->ParallelFor(
+      meshes_count,
+      1U,
+      [&](uint32_t begin, uint32_t end) {
+    eastl::vector<VertexQuantizationError> chunk_errors(
+        (errors != nullptr) ? vertex_setup.num_elements() : 0U);
+    for (uint32_t i = begin; i < end; ++i) {
+      PackAssimpMesh(meshes[i], ranges[i], post_process_steps, vertex_setup,
+                     streams, indices,
+                     (position_dequants != nullptr) ? &position_dequants[i] :
+                                                      nullptr,
+                     (errors != nullptr) ? chunk_errors.data() : nullptr);
+    }
+
+    if (errors != nullptr) {
+      std::lock_guard<std::mutex> lock(errors_mutex);
+      for (uint32_t e = 0U; e < vertex_setup.num_elements(); ++e) {
+        errors[e].Merge(chunk_errors[e]);
+      }
+    }
+  });
+}
+
+static void OptimizePackedMesh(
+    const aiMesh *ai_mesh,
+    const PackedMeshRange &range,
+    const VertexSetup &vertex_setup,
+    uint8_t *const *streams,
+    uint32_t *indices,
+    VertexCacheStats *stats_before,
+    VertexCacheStats *stats_after,
+    PackedMeshExtras *extras) {
+  // Work on indices local to the mesh
+  uint32_t *mesh_indices = indices + range.first_index;
+  for (uint32_t i = 0U; i < range.indices_count; ++i) {
+    mesh_indices[i] -= range.first_vertex;
+  }
+
+  if (stats_before != nullptr) {
+    stats_before->Merge(AnalyzeVertexCache(mesh_indices, range.indices_count,
+                                           range.vertices_count,
+                                           kVertexCacheSize));
+  }
+
+  eastl::vector<uint32_t> clusters;
+  OptimizeVertexCache(mesh_indices, range.indices_count, range.vertices_count,
+                      &clusters);
+  OptimizeOverdraw(mesh_indices, range.indices_count,
+                   GetFloats(ai_mesh->mVertices), kVector3Size,
+                   range.vertices_count, clusters, kOverdrawThreshold);
+
+  // Meshlets and LODs are built from the float positions, which are still
+  // in the imported vertex order
+  if (extras != nullptr) {
+    const float *positions = GetFloats(ai_mesh->mVertices);
+    extras->bounding_sphere = ComputeBoundingSphere(
+        positions, range.vertices_count, kVector3Size);
+    ComputeBoundingBox(positions, range.vertices_count, kVector3Size,
+                       &extras->bounds_min, &extras->bounds_max);
+    BuildMeshlets(mesh_indices, range.indices_count, positions, kVector3Size,
+                  range.vertices_count, range.first_index, extras->meshlets);
+    BuildMeshLods(mesh_indices, range.indices_count, positions, kVector3Size,
+                  range.vertices_count, extras->lod_indices, extras->lods);
+  }
+
+  eastl::vector<uint32_t> remap;
+  OptimizeVertexFetch(mesh_indices, range.indices_count, range.vertices_count,
+                      remap);
+  for (uint32_t s = 0U; s < vertex_setup.num_streams(); ++s) {
+    uint32_t stride = vertex_setup.GetStreamStride(s);
+    RemapVertices(streams[s] + range.first_vertex * stride,
+                  range.vertices_count, stride, remap);
+  }
+
+  if (stats_after != nullptr) {
+    stats_after->Merge(AnalyzeVertexCache(mesh_indices, range.indices_count,
+                                          range.vertices_count,
+                                          kVertexCacheSize));
+  }
+
+  for (uint32_t i = 0U; i < range.indices_count; ++i) {
+    mesh_indices[i] += range.first_vertex;
+  }
+  if (extras != nullptr) {
+    for (eastl::vector<uint32_t>::iterator i = extras->lod_indices.begin();
+         i != extras->lod_indices.end();
+         ++i) {
+      *i = remap[*i] + range.first_vertex;
+    }
+  }
+}
+
+void OptimizePackedMeshes(
+    const aiMesh *const *meshes,
+    const PackedMeshRange *ranges,
+    uint32_t meshes_count,
+    const VertexSetup &vertex_setup,
+    uint8_t *const *streams,
+    uint32_t *indices,
+    VertexCacheStats *stats_before,
+    VertexCacheStats *stats_after,
+    PackedMeshExtras *extras) {
+  std::mutex stats_mutex;
+  worker_pool()->ParallelFor(
+      meshes_count,
+      1U,
+      [&](uint32_t begin, uint32_t end) {
+    VertexCacheStats chunk_before;
+    VertexCacheStats chunk_after;
+    for (uint32_t i = begin; i < end; ++i) {
+      OptimizePackedMesh(meshes[i], ranges[i], vertex_setup, streams, indices,
+                         &chunk_before, &chunk_after,
+                         (extras != nullptr) ? &extras[i] : nullptr);
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    if (stats_before != nullptr) {
+      stats_before->Merge(chunk_before);
+    }
+    if (stats_after != nullptr) {
+      stats_after->Merge(chunk_after);
+    }
+  });
+}
+
+} // namespace vks
@@ -5,14 +5,13 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <cstring>
 #include <model.h>
-#include <EASTL/sort.h>
+#include <vertex_packers.h>
+#include <render_queue.h>
 #include <base_system.h>
 #include <logger.hpp>
 
 namespace vks {
 
-// 64 MB, not MiB!
-const uint32_t kHeapMaxSize = 64U * 1000000U;
 extern const uint32_t kVertexBuffersBaseBindPos = 4U;
 extern const uint32_t kIndirectDrawCmdsBindingPos = 3U;
 extern const uint32_t kIdxBufferBindPos = 2U;
@@ -22,19 +21,38 @@ extern const uint32_t kMaterialIDsBufferBindPos = 1U;
 MeshesHeapBuilder::MeshesHeapBuilder(
     const VertexSetup &vtx_setup,
     VkDescriptorPool desc_pool)
-    : vertices_data_(vtx_setup.num_elements()),
+    : vertices_data_(vtx_setup.num_streams()),
       indices_data_(),
       vtx_setup_(&vtx_setup),
       meshes_(),
-      size_(0U),
+      element_sizes_(vtx_setup.num_elements()),
       current_vertex_(0U),
-      desc_pool_(desc_pool) {}
+      desc_pool_(desc_pool) {
+  // The visibility buffer shaders fetch each element, as floats, from its
+  // own storage buffer
+  VKS_ASSERT(vtx_setup.streams_layout() == VertexStreamsLayout::SEPARATE,
+             "Meshes heaps need one vertex stream per element");
+  VKS_ASSERT(!vtx_setup.IsQuantized(),
+             "Meshes heaps need float vertex elements");
+  for (uint32_t i = 0U; i < vtx_setup.num_elements(); ++i) {
+    element_sizes_[i] = vtx_setup.GetElementSize(i);
+  }
+}
 
 bool MeshesHeapBuilder::TestMesh(
     uint32_t num_vtxs,
     uint32_t num_idxs) const {
-  if ((size_ + (num_vtxs * vtx_setup_->vertex_size()) +
-      (num_idxs * SCAST_U32(sizeof(uint32_t)))) > kHeapMaxSize) {
+  // Each stream and the indices are bound whole as storage buffers, which
+  // is what limits the size of a heap
+  VkDeviceSize max_size =
+    vulkan()->device().physical_properties().limits.maxStorageBufferRange;
+  for (uint32_t i = 0U; i < vtx_setup_->num_streams(); ++i) {
+    if (static_cast<VkDeviceSize>(current_vertex_ + num_vtxs) *
+          vtx_setup_->GetStreamStride(i) > max_size) {
+      return false;
+    }
+  }
+  if ((indices_data_.size() + num_idxs) * sizeof(uint32_t) > max_size) {
     return false;
   }
 
@@ -48,64 +66,65 @@ void MeshesHeapBuilder::AddMesh(
                          mat_id));
 }
 
+void MeshesHeapBuilder::AddMesh(
+    uint32_t mat_id,
+    uint32_t start_idx,
+    uint32_t num_idxs) {
+  meshes_.push_back(Mesh(start_idx, num_idxs, 0U, mat_id));
+}
 
 void MeshesHeapBuilder::AddIndex(uint32_t index) {
   indices_data_.push_back(index);
 }
 
+void MeshesHeapBuilder::AddIndices(const uint32_t *indices, uint32_t count) {
+  indices_data_.insert(indices_data_.end(), indices, indices + count);
+}
+
 void MeshesHeapBuilder::AddVertex(const Vertex &vertex) {
-  // Use a vector to layout the data in memory as specified by the layout 
-  uint32_t elm_idx = 0U;
-  for (eastl::vector<eastl::vector<uint8_t>>::iterator i =
-         vertices_data_.begin();
-       i != vertices_data_.end();
-       ++i, ++elm_idx) {
-    uint32_t element_size = vtx_setup_->GetElementSize(elm_idx);
-    if (i->size() < (current_vertex_ + 1U) * element_size) {
-      i->resize(i->size() + element_size);
-    }
+  AddVertices(&vertex, 1U);
+}
 
-    unsigned char *dst =
-      i->data() +
-      (element_size * current_vertex_);
-
-    const void *read_location = nullptr;
-    switch (vtx_setup_->vertex_types_layout()[elm_idx]) {
-      case VertexElementType::POSITION: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.pos));
-        break;
-      }
-      case VertexElementType::NORMAL: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.normal));
-        break;
-      }
-      case VertexElementType::COLOUR: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.colour));
-        break;
-      }
-      case VertexElementType::UV: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.uv));
-        break;
-      }
-      case VertexElementType::TANGENT: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.tangent));
-        break;
-      }
-      case VertexElementType::BITANGENT: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.bitangent));
-        break;
-      }
-      default:
-        ELOG_WARN("Unsupported vertex element type!");
-    }
+void MeshesHeapBuilder::AddVertices(const Vertex *vertices, uint32_t count) {
+  uint32_t first_vtx = current_vertex_;
+  ResizeVertices(count);
+
+  for (uint32_t i = 0U; i < vtx_setup_->num_elements(); ++i) {
+    uint32_t stream = vtx_setup_->GetElementStream(i);
+    uint32_t stride = vtx_setup_->GetStreamStride(stream);
+    PackVertexElement(
+        vtx_setup_->vertex_types_layout()[i],
+        VertexElementEncoding::FLOAT,
+        vertices,
+        count,
+        element_sizes_[i],
+        glm::vec4(0.f, 0.f, 0.f, 1.f),
+        stride,
+        vertices_data_[stream].data() + first_vtx * stride +
+          vtx_setup_->GetElementOffset(i));
+  }
+}
+
+void MeshesHeapBuilder::ReserveVertices(uint32_t num_vtxs) {
+  for (uint32_t i = 0U; i < vtx_setup_->num_streams(); ++i) {
+    vertices_data_[i].reserve(
+        (current_vertex_ + num_vtxs) * vtx_setup_->GetStreamStride(i));
+  }
+}
+
+void MeshesHeapBuilder::ReserveIndices(uint32_t num_idxs) {
+  indices_data_.reserve(indices_data_.size() + num_idxs);
+}
 
-    memcpy(
-        dst,
-        read_location,
-        element_size);
-  } 
+void MeshesHeapBuilder::ResizeVertices(uint32_t num_vtxs) {
+  current_vertex_ += num_vtxs;
+  for (uint32_t i = 0U; i < vtx_setup_->num_streams(); ++i) {
+    vertices_data_[i].resize(current_vertex_ * vtx_setup_->GetStreamStride(i));
+  }
+}
 
-  current_vertex_++;
+void MeshesHeapBuilder::ResizeIndices(uint32_t num_idxs) {
+  indices_data_.resize(indices_data_.size() + num_idxs);
 }
 
 MeshesHeap::MeshesHeap(const VulkanDevice &device,
@@ -127,14 +146,17 @@ MeshesHeap::MeshesHeap(const VulkanDevice &device,
     device_(&device) {
   uint32_t meshes_count = SCAST_U32(builder.meshes().size());
 
+  // Meshes reading the same material follow each other
+  RenderQueue queue;
   for (uint32_t i = 0U; i < meshes_count; i++) {
-    meshes_.push_back((builder.meshes()[i]));
+    queue.Push(RenderQueue::MakeKey(DrawPassTypes::SHADING, 0U,
+                                    builder.meshes()[i].material_id(), 0.f),
+               i);
+  }
+  queue.Sort();
+  for (uint32_t i = 0U; i < meshes_count; i++) {
+    meshes_.push_back((builder.meshes()[queue.items()[i].value]));
   }
-  
-  eastl::sort(meshes_.begin(), meshes_.end(),
-    [](const Mesh &lhs, const Mesh &rhs) {
-    return (lhs.material_id() < rhs.material_id());
-  });
 
   CreateBuffers(device, builder);
 }
@@ -158,21 +180,21 @@ void MeshesHeap::CreateBuffers(const VulkanDevice &device,
   // Create buffers for the vertex and index buffers
   VulkanBufferInitInfo init_info;
   
-  vertex_buffers_.resize(builder.vtx_setup()->num_elements());
-  uint32_t elm_idx = 0U;
+  vertex_buffers_.resize(builder.vtx_setup()->num_streams());
+  uint32_t stream_idx = 0U;
   for (eastl::vector<VulkanBuffer>::iterator i = vertex_buffers_.begin();
        i != vertex_buffers_.end();
-       ++i, ++elm_idx) { 
+       ++i, ++stream_idx) { 
     init_info.buffer_usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
     init_info.memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    init_info.size = SCAST_U32(builder.vertices_data(elm_idx).size()) *
-      SCAST_U32(sizeof(uint8_t)),
-    init_info.cmd_buff = vulkan()->copy_cmd_buff();
+    init_info.memory_category = MemoryCategory::VERTEX;
+    init_info.size = SCAST_U32(builder.vertices_data(stream_idx).size()) *
+      SCAST_U32(sizeof(uint8_t));
     i->Init(
         device,
         init_info, 
-        SCAST_CVOIDPTR(builder.vertices_data(elm_idx).data()));
+        SCAST_CVOIDPTR(builder.vertices_data(stream_idx).data()));
     LOG("BUFF: " << i->buffer());
   }
 
@@ -180,6 +202,7 @@ void MeshesHeap::CreateBuffers(const VulkanDevice &device,
     SCAST_U32(sizeof(uint32_t));
   init_info.buffer_usage_flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  init_info.memory_category = MemoryCategory::INDEX;
   index_buffer_.Init(
       device,
       init_info, 
@@ -190,6 +213,7 @@ void MeshesHeap::CreateBuffers(const VulkanDevice &device,
   init_info.memory_property_flags = /*VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |*/
     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
   init_info.buffer_usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  init_info.memory_category = MemoryCategory::OTHER;
   model_matxs_buff_.Init(device, init_info);
 
   // Upload the data to it
@@ -280,7 +304,7 @@ void MeshesHeap::CreateDescriptorSet(VkDescriptorSetLayout heap_set_layout) {
 }
 
 void MeshesHeap::WriteDescriptorSet() {
-  eastl::vector<VkWriteDescriptorSet> write_desc_sets;
+  FrameVector<VkWriteDescriptorSet> write_desc_sets;
 
   uint32_t counter = 0U;
   eastl::vector<VkDescriptorBufferInfo> elems_buff_infos(
@@ -362,10 +386,10 @@ void MeshesHeap::WriteDescriptorSet() {
 
 void MeshesHeap::BindVertexBuffer(VkCommandBuffer cmd_buff) const {
   uint32_t num_elements = SCAST_U32(vertex_buffers_.size());
-  eastl::vector<VkDeviceSize> offsets;
+  FrameVector<VkDeviceSize> offsets;
   offsets.assign(num_elements, 0U);
-  eastl::vector<VkBuffer> buffers(num_elements);
-  eastl::vector<VkBuffer>::iterator bi = buffers.begin();
+  FrameVector<VkBuffer> buffers(num_elements);
+  FrameVector<VkBuffer>::iterator bi = buffers.begin();
   for (eastl::vector<VulkanBuffer>::const_iterator i = vertex_buffers_.begin();
        i != vertex_buffers_.end();
        ++i, ++bi) {
@@ -381,6 +405,8 @@ void MeshesHeap::BindVertexBuffer(VkCommandBuffer cmd_buff) const {
 }
 
 void MeshesHeap::BindIndexBuffer(VkCommandBuffer cmd_buff) const {
+  // Stays 32-bit: the visibility buffer shaders read it as a uint array and
+  // ignore the vertex offsets of the draws
   vkCmdBindIndexBuffer(
       cmd_buff,
       index_buffer_.buffer(),
@@ -12,6 +12,7 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/vector3.h>
+#include <mesh_packing.h>
 
 namespace vks {
 
@@ -55,99 +56,76 @@ void MeshesHeapManager::LoadOtherModel(
   
   uint32_t mat_idx_offset = material_manager()->GetMaterialInstancesCount();
 
-  // For each shape, which corresponds to a mesh in the model
+  // Meshes are assigned to heaps in order, then each heap's meshes are
+  // packed in parallel into their own ranges of the heap's streams
   uint32_t meshes_count = scene->mNumMeshes;
-  uint32_t idx_offset = 0U;
-  for (uint32_t mi = 0U; mi < meshes_count; mi++) {
-    const aiMesh *ai_mesh = scene->mMeshes[mi];
-
+  eastl::vector<const aiMesh *> heap_meshes;
+  eastl::vector<PackedMeshRange> heap_ranges;
+  eastl::vector<uint8_t *> streams(vertex_setup.num_streams());
+  for (uint32_t mi = 0U; mi <= meshes_count; mi++) {
     // Try and fit mesh into current heap
-    if (!current_heap_builder->TestMesh(ai_mesh->mNumVertices,
-                                        ai_mesh->mNumFaces * 3U)) {
-        // Create heap 
-        current_model->AddHeap(
-          eastl::make_unique<MeshesHeap>(device, *current_heap_builder.get()));
+    if (mi == meshes_count ||
+        !current_heap_builder->TestMesh(scene->mMeshes[mi]->mNumVertices,
+                                        scene->mMeshes[mi]->mNumFaces * 3U)) {
+      for (uint32_t i = 0U; i < vertex_setup.num_streams(); ++i) {
+        streams[i] = current_heap_builder->GetVertexStreamWriteData(i);
+      }
+      PackAssimpMeshes(
+          heap_meshes.data(),
+          heap_ranges.data(),
+          SCAST_U32(heap_meshes.size()),
+          assimp_post_process_steps,
+          vertex_setup,
+          streams.data(),
+          current_heap_builder->GetIndicesWriteData(),
+          nullptr,
+          nullptr);
+      // Heaps are drawn whole by the visibility buffer, without meshlets
+      OptimizePackedMeshes(
+          heap_meshes.data(),
+          heap_ranges.data(),
+          SCAST_U32(heap_meshes.size()),
+          vertex_setup,
+          streams.data(),
+          current_heap_builder->GetIndicesWriteData(),
+          nullptr,
+          nullptr,
+          nullptr);
+      heap_meshes.clear();
+      heap_ranges.clear();
 
-        // Change heap builder
-        current_heap_builder.reset(nullptr);
-        current_heap_builder =
-          eastl::make_unique<MeshesHeapBuilder>(
-              vertex_setup,
-              heap_sets_desc_pool_);
+      // Create heap 
+      current_model->AddHeap(
+        eastl::make_unique<MeshesHeap>(device, *current_heap_builder.get()));
+      if (mi == meshes_count) {
+        break;
+      }
 
-        // Reset counters
-        idx_offset = 0U;
+      // Change heap builder
+      current_heap_builder.reset(nullptr);
+      current_heap_builder =
+        eastl::make_unique<MeshesHeapBuilder>(
+            vertex_setup,
+            heap_sets_desc_pool_);
     }
 
+    const aiMesh *ai_mesh = scene->mMeshes[mi];
+    PackedMeshRange range;
+    range.first_vertex = current_heap_builder->current_vertex();
+    range.vertices_count = ai_mesh->mNumVertices;
+    range.first_index =
+      SCAST_U32(current_heap_builder->indices_data().size());
+    range.indices_count = ai_mesh->mNumFaces * 3U;
+    current_heap_builder->ResizeVertices(range.vertices_count);
+    current_heap_builder->ResizeIndices(range.indices_count);
+    heap_meshes.push_back(ai_mesh);
+    heap_ranges.push_back(range);
+
     // Create a mesh
     current_heap_builder->AddMesh(ai_mesh->mMaterialIndex + mat_idx_offset - 1U,
-                                  ai_mesh->mNumFaces * 3U);
-
-    //meshes[mi] = Mesh(
-    //    SCAST_U32(model_builder.indices_data().size()),
-    //    ai_mesh->mNumFaces * 3U,
-    //    0U,
-    //    ai_mesh->mMaterialIndex + mat_idx_offset - 1U);
-   
-    // Load the vertices for this mesh 
-    for (uint32_t i = 0U; i < ai_mesh->mNumVertices; i++) {
-      Vertex vertex; 
-      vertex.pos = {
-        ai_mesh->mVertices[i].x,
-        ai_mesh->mVertices[i].y,
-        ai_mesh->mVertices[i].z
-      };
-      vertex.normal = {
-        ai_mesh->mNormals[i].x,
-        ai_mesh->mNormals[i].y,
-        ai_mesh->mNormals[i].z
-      };
-      if (ai_mesh->mTextureCoords[0U]) {
-        vertex.uv = {
-          ai_mesh->mTextureCoords[0U][i].x,
-          ai_mesh->mTextureCoords[0U][i].y,
-          ai_mesh->mTextureCoords[0U][i].z
-        };
-      }
-      else {
-        vertex.uv = { 0.f, 0.f, 0.f};
-      }
-      if (assimp_post_process_steps & aiProcess_CalcTangentSpace) {
-        vertex.bitangent = {
-          ai_mesh->mBitangents[i].x,
-          ai_mesh->mBitangents[i].y,
-          ai_mesh->mBitangents[i].z
-        };
-        vertex.tangent = {
-          ai_mesh->mTangents[i].x,
-          ai_mesh->mTangents[i].y,
-          ai_mesh->mTangents[i].z
-        };
-
-        if (glm::dot(glm::cross(vertex.normal, vertex.tangent),
-                     vertex.bitangent) < 0.0f) {
-          vertex.tangent = vertex.tangent * -1.0f;
-        }
-      }
-      
-      current_heap_builder->AddVertex(vertex);
-    }
-
-    // Load indices
-    for (uint32_t i = 0U; i < ai_mesh->mNumFaces; i++) {
-      aiFace &face = ai_mesh->mFaces[i];
-      // Superfluous; all faces are triangulated
-      for (uint32_t j = 0U; j < face.mNumIndices; j++) {
-        current_heap_builder->AddIndex(face.mIndices[j] + idx_offset);
-      }
-    }
-    
-    idx_offset += ai_mesh->mNumVertices;
+                                  range.first_index,
+                                  range.indices_count);
   }
-        
-  // Create heap 
-  current_model->AddHeap(
-    eastl::make_unique<MeshesHeap>(device, *current_heap_builder.get()));
 
   //CreateUniqueModel(
   //    device,
@@ -0,0 +1,193 @@
+#include <meshlets.h>
+#include <bounds.h>
+#include <vulkan_tools.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vks {
+
+extern const uint32_t kMeshletMaxVertices = 64U;
+extern const uint32_t kMeshletMaxTriangles = 124U;
+// Meshlets whose normals spread further than ~84 degrees from the axis would
+// hardly ever be culled by their cone, so they don't get one
+static const float kMinConeSpreadDot = 0.1f;
+
+static inline glm::vec3 GetPosition(
+    const float *positions,
+    uint32_t stride,
+    uint32_t i) {
+  const float *p = reinterpret_cast<const float *>(
+      reinterpret_cast<const uint8_t *>(positions) + i * stride);
+  return glm::vec3(p[0U], p[1U], p[2U]);
+}
+
+// Unit normal of a triangle, or false if it is degenerate
+static bool GetTriangleNormal(
+    const uint32_t *triangle,
+    const float *positions,
+    uint32_t stride,
+    glm::vec3 *p0,
+    glm::vec3 *normal) {
+  *p0 = GetPosition(positions, stride, triangle[0U]);
+  glm::vec3 n = glm::cross(
+      GetPosition(positions, stride, triangle[1U]) - *p0,
+      GetPosition(positions, stride, triangle[2U]) - *p0);
+  float length = glm::length(n);
+  if (length == 0.f) {
+    return false;
+  }
+  *normal = n / length;
+  return true;
+}
+
+// Cone bounding the normals of the triangles, with its apex placed behind
+// all of their planes; see Meshlet
+static void ComputeNormalCone(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t stride,
+    Meshlet *meshlet) {
+  glm::vec3 centre(meshlet->bounding_sphere);
+  meshlet->cone_apex = centre;
+  meshlet->cone_axis_cutoff = glm::vec4(0.f, 0.f, 1.f, 1.f);
+
+  glm::vec3 p0, normal;
+  glm::vec3 axis(0.f);
+  for (uint32_t i = 0U; i < indices_count; i += 3U) {
+    if (GetTriangleNormal(indices + i, positions, stride, &p0, &normal)) {
+      axis += normal;
+    }
+  }
+  float axis_length = glm::length(axis);
+  if (axis_length == 0.f) {
+    return;
+  }
+  axis /= axis_length;
+
+  float min_dot = 1.f;
+  for (uint32_t i = 0U; i < indices_count; i += 3U) {
+    if (GetTriangleNormal(indices + i, positions, stride, &p0, &normal)) {
+      min_dot = std::min(min_dot, glm::dot(axis, normal));
+    }
+  }
+  if (min_dot <= kMinConeSpreadDot) {
+    return;
+  }
+
+  // Move the apex back along the axis until it is behind every triangle
+  float max_t = 0.f;
+  for (uint32_t i = 0U; i < indices_count; i += 3U) {
+    if (GetTriangleNormal(indices + i, positions, stride, &p0, &normal)) {
+      float t = glm::dot(centre - p0, normal) / glm::dot(axis, normal);
+      max_t = std::max(max_t, t);
+    }
+  }
+
+  meshlet->cone_apex = centre - axis * max_t;
+  meshlet->cone_axis_cutoff = glm::vec4(axis,
+                                        sqrtf(1.f - min_dot * min_dot));
+}
+
+static void FinishMeshlet(
+    const uint32_t *indices,
+    uint32_t first_index,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t positions_stride,
+    const eastl::vector<glm::vec3> &points,
+    eastl::vector<Meshlet> &meshlets) {
+  Meshlet meshlet;
+  meshlet.first_index = first_index;
+  meshlet.indices_count = indices_count;
+  meshlet.bounding_sphere = ComputeBoundingSphere(
+      &points[0U].x, SCAST_U32(points.size()),
+      SCAST_U32(sizeof(glm::vec3)));
+  ComputeNormalCone(indices, indices_count, positions, positions_stride,
+                    &meshlet);
+  meshlets.push_back(meshlet);
+}
+
+void BuildMeshlets(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    const float *positions,
+    uint32_t positions_stride,
+    uint32_t vertices_count,
+    uint32_t first_index,
+    eastl::vector<Meshlet> &meshlets) {
+  // Meshlet each vertex was last added to, so that shared vertices are
+  // counted once
+  eastl::vector<uint32_t> vertex_meshlets(
+      vertices_count, std::numeric_limits<uint32_t>::max());
+  eastl::vector<glm::vec3> points;
+  points.reserve(kMeshletMaxVertices);
+
+  uint32_t meshlet_idx = SCAST_U32(meshlets.size());
+  uint32_t meshlet_start = 0U;
+  for (uint32_t i = 0U; i < indices_count; i += 3U) {
+    uint32_t new_vertices = 0U;
+    for (uint32_t c = 0U; c < 3U; ++c) {
+      if (vertex_meshlets[indices[i + c]] != meshlet_idx) {
+        ++new_vertices;
+      }
+    }
+
+    // Close the current meshlet if the triangle doesn't fit
+    if (points.size() + new_vertices > kMeshletMaxVertices ||
+        (i - meshlet_start) / 3U == kMeshletMaxTriangles) {
+      FinishMeshlet(indices + meshlet_start, first_index + meshlet_start,
+                    i - meshlet_start, positions, positions_stride, points,
+                    meshlets);
+      ++meshlet_idx;
+      meshlet_start = i;
+      points.clear();
+    }
+
+    for (uint32_t c = 0U; c < 3U; ++c) {
+      uint32_t v = indices[i + c];
+      if (vertex_meshlets[v] != meshlet_idx) {
+        vertex_meshlets[v] = meshlet_idx;
+        points.push_back(GetPosition(positions, positions_stride, v));
+      }
+    }
+  }
+
+  if (meshlet_start < indices_count) {
+    FinishMeshlet(indices + meshlet_start, first_index + meshlet_start,
+                  indices_count - meshlet_start, positions, positions_stride,
+                  points, meshlets);
+  }
+}
+
+bool IsMeshletCulled(
+    const Meshlet &meshlet,
+    const glm::mat4 &model_mat,
+    const glm::vec4 *frustum_planes,
+    const glm::vec3 &viewer_position) {
+  glm::vec3 centre(model_mat * glm::vec4(glm::vec3(meshlet.bounding_sphere),
+                                         1.f));
+  float scale = glm::length(glm::vec3(model_mat[0U]));
+  float radius = meshlet.bounding_sphere.w * scale;
+  for (uint32_t p = 0U; p < 6U; ++p) {
+    if (glm::dot(glm::vec3(frustum_planes[p]), centre) +
+        frustum_planes[p].w < -radius) {
+      return true;
+    }
+  }
+
+  float cutoff = meshlet.cone_axis_cutoff.w;
+  if (cutoff >= 1.f) {
+    return false;
+  }
+  glm::vec3 apex(model_mat * glm::vec4(meshlet.cone_apex, 1.f));
+  glm::vec3 axis = glm::normalize(glm::mat3(model_mat) *
+                                  glm::vec3(meshlet.cone_axis_cutoff));
+  glm::vec3 view_dir = apex - viewer_position;
+  float view_distance = glm::length(view_dir);
+  return view_distance > 0.f &&
+    glm::dot(view_dir, axis) >= cutoff * view_distance;
+}
+
+} // namespace vks
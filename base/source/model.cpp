@@ -11,7 +11,15 @@
 #include <deque>
 #include <algorithm>
 #include <EASTL/vector.h>
+#include <EASTL/algorithm.h>
+#include <vertex_packers.h>
+#include <vertex_quantization.h>
 #include <glm/gtc/type_ptr.hpp>
+#include <worker_pool.h>
+#include <bounds.h>
+#include <frustum.h>
+#include <render_queue.h>
+#include <cmath>
 
 namespace vks {
 
@@ -33,90 +41,313 @@ Vertex::Vertex()
 ModelBuilder::ModelBuilder(
     const VertexSetup &vertex_setup,
     VkDescriptorPool desc_pool)
-    : vertices_data_(vertex_setup.num_elements()),
+    : vertices_data_(vertex_setup.num_streams()),
       indices_data_(),
+      external_vertices_data_(vertex_setup.num_streams(), nullptr),
+      external_vertices_sizes_(vertex_setup.num_streams(), 0U),
+      external_indices_(nullptr),
+      external_indices_count_(0U),
       meshes_(),
+      meshlets_(),
+      lods_(),
+      element_sizes_(vertex_setup.num_elements()),
+      element_vertices_counts_(vertex_setup.num_elements(), 0U),
+      position_dequant_(0.f, 0.f, 0.f, 1.f),
       vertex_size_(vertex_setup.vertex_size()),
       current_vertex_(0U),
       vertex_setup_(&vertex_setup),
-      desc_pool_(desc_pool) {}
+      desc_pool_(desc_pool) {
+  for (uint32_t i = 0U; i < vertex_setup.num_elements(); ++i) {
+    element_sizes_[i] = vertex_setup.GetElementSize(i);
+  }
+}
 
 void ModelBuilder::AddIndex(uint32_t index) {
   indices_data_.push_back(index);
 }
 
-void AddVertexElementArray(const void *data, uint32_t size,
-                           VertexElementType type) {
-  
+void ModelBuilder::AddIndices(const uint32_t *indices, uint32_t count) {
+  indices_data_.insert(indices_data_.end(), indices, indices + count);
+}
+
+void ModelBuilder::AddVertexElementArray(
+    const void *data,
+    uint32_t size,
+    VertexElementType type) {
+  const eastl::vector<VertexElementType> &layout =
+    vertex_setup_->vertex_types_layout();
+  eastl::vector<VertexElementType>::const_iterator element =
+    eastl::find(layout.begin(), layout.end(), type);
+  if (element == layout.end()) {
+    ELOG_WARN("Vertex element array not in the layout!");
+    return;
+  }
+
+  // The element may share its stream with others, so it is scattered into
+  // its slot of each vertex
+  uint32_t elm_idx = SCAST_U32(element - layout.begin());
+  uint32_t element_size = element_sizes_[elm_idx];
+  uint32_t stream = vertex_setup_->GetElementStream(elm_idx);
+  uint32_t stride = vertex_setup_->GetStreamStride(stream);
+  uint32_t count = size / element_size;
+  uint32_t first_vertex = element_vertices_counts_[elm_idx];
+  element_vertices_counts_[elm_idx] = first_vertex + count;
+  if (first_vertex + count > current_vertex_) {
+    current_vertex_ = first_vertex + count;
+    for (uint32_t i = 0U; i < vertex_setup_->num_streams(); ++i) {
+      vertices_data_[i].resize(
+          current_vertex_ * vertex_setup_->GetStreamStride(i));
+    }
+  }
 
+  const uint8_t *src = static_cast<const uint8_t *>(data);
+  uint8_t *dst = vertices_data_[stream].data() + first_vertex * stride +
+    vertex_setup_->GetElementOffset(elm_idx);
+  if (stride == element_size) {
+    memcpy(dst, src, size);
+    return;
+  }
+  for (uint32_t i = 0U; i < count; ++i, src += element_size, dst += stride) {
+    memcpy(dst, src, element_size);
+  }
 }
 
 void ModelBuilder::AddVertex(const Vertex &vertex) {
+  AddVertices(&vertex, 1U);
+}
+
+void ModelBuilder::AddVertices(const Vertex *vertices, uint32_t count) {
+  uint32_t first_vertex = current_vertex_;
+  ResizeVertices(count);
+
+  for (uint32_t i = 0U; i < vertex_setup_->num_elements(); ++i) {
+    uint32_t stream = vertex_setup_->GetElementStream(i);
+    uint32_t stride = vertex_setup_->GetStreamStride(stream);
+    PackVertexElement(
+        vertex_setup_->vertex_types_layout()[i],
+        vertex_setup_->GetElementEncoding(i),
+        vertices,
+        count,
+        element_sizes_[i],
+        position_dequant_,
+        stride,
+        vertices_data_[stream].data() + first_vertex * stride +
+          vertex_setup_->GetElementOffset(i));
+  }
+}
+
+void ModelBuilder::ReserveVertices(uint32_t vertices_count) {
+  for (uint32_t i = 0U; i < vertex_setup_->num_streams(); ++i) {
+    vertices_data_[i].reserve(
+        (current_vertex_ + vertices_count) * vertex_setup_->GetStreamStride(i));
+  }
+}
 
-  // Use a vector to layout the data in memory as specified by the layout 
-  //uint32_t layout_count = vertex_setup_->num_elements();
-  uint32_t elm_idx = 0U;
-  for (eastl::vector<eastl::vector<uint8_t>>::iterator i =
-         vertices_data_.begin();
-       i != vertices_data_.end();
-       ++i, ++elm_idx) {
-    uint32_t element_size = vertex_setup_->GetElementSize(elm_idx);
-    if (i->size() < (current_vertex_ + 1U) * element_size) {
-      i->resize(i->size() + element_size);
+void ModelBuilder::ReserveIndices(uint32_t indices_count) {
+  indices_data_.reserve(indices_data_.size() + indices_count);
+}
+
+void ModelBuilder::ResizeVertices(uint32_t vertices_count) {
+  current_vertex_ += vertices_count;
+  for (uint32_t i = 0U; i < vertex_setup_->num_streams(); ++i) {
+    vertices_data_[i].resize(
+        current_vertex_ * vertex_setup_->GetStreamStride(i));
+  }
+  element_vertices_counts_.assign(vertex_setup_->num_elements(),
+                                  current_vertex_);
+}
+
+void ModelBuilder::ResizeIndices(uint32_t indices_count) {
+  indices_data_.resize(indices_data_.size() + indices_count);
+}
+
+void ModelBuilder::AddMesh(const Mesh *mesh) {
+  meshes_.push_back(mesh);
+}
+
+void ModelBuilder::AddMeshlets(const Meshlet *meshlets, uint32_t count) {
+  meshlets_.insert(meshlets_.end(), meshlets, meshlets + count);
+}
+
+void ModelBuilder::AddMeshLods(const MeshLod *lods, uint32_t count) {
+  lods_.insert(lods_.end(), lods, lods + count);
+}
+
+void ModelBuilder::SetExternalVertexStream(
+    uint32_t stream_idx,
+    const void *data,
+    uint32_t size) {
+  external_vertices_data_[stream_idx] = data;
+  external_vertices_sizes_[stream_idx] = size;
+  current_vertex_ = size / vertex_setup_->GetStreamStride(stream_idx);
+}
+
+void ModelBuilder::SetExternalIndices(const uint32_t *indices,
+                                      uint32_t count) {
+  external_indices_ = indices;
+  external_indices_count_ = count;
+}
+
+const void *ModelBuilder::GetVertexStreamData(uint32_t i) const {
+  if (external_vertices_data_[i] != nullptr) {
+    return external_vertices_data_[i];
+  }
+  return SCAST_CVOIDPTR(vertices_data_[i].data());
+}
+
+uint32_t ModelBuilder::GetVertexStreamDataSize(uint32_t i) const {
+  if (external_vertices_data_[i] != nullptr) {
+    return external_vertices_sizes_[i];
+  }
+  return SCAST_U32(vertices_data_[i].size());
+}
+
+const uint32_t *ModelBuilder::GetIndicesData() const {
+  if (external_indices_ != nullptr) {
+    return external_indices_;
+  }
+  return indices_data_.data();
+}
+
+uint32_t ModelBuilder::GetIndicesCount() const {
+  if (external_indices_ != nullptr) {
+    return external_indices_count_;
+  }
+  return SCAST_U32(indices_data_.size());
+}
+
+// Largest number of vertices a mesh can span with 16-bit indices
+static const uint32_t kMaxNarrowIndexedVertices = 65536U;
+
+// Rebase each mesh's indices to the lowest vertex it references, which
+// becomes its vertex offset, so that they fit in 16 bits even when the model
+// has more vertices than that; its LODs reference a subset of its vertices,
+// so they are rebased the same way. Fails, leaving the meshes untouched, if
+// any mesh spans too many vertices
+static bool NarrowIndices(
+    const uint32_t *indices,
+    uint32_t indices_count,
+    const eastl::vector<MeshLod> &lods,
+    eastl::vector<Mesh> &meshes,
+    eastl::vector<uint16_t> &narrow_indices) {
+  uint32_t meshes_count = SCAST_U32(meshes.size());
+  eastl::vector<uint32_t> base_vertices(meshes_count, 0U);
+  for (uint32_t m = 0U; m < meshes_count; ++m) {
+    const uint32_t *mesh_indices = indices + meshes[m].start_index();
+    uint32_t mesh_indices_count = meshes[m].index_count();
+    if (mesh_indices_count == 0U) {
+      continue;
     }
 
-    unsigned char *dst =
-      i->data() +
-      (element_size * current_vertex_);
+    uint32_t min_index = mesh_indices[0U];
+    uint32_t max_index = mesh_indices[0U];
+    for (uint32_t i = 1U; i < mesh_indices_count; ++i) {
+      min_index = std::min(min_index, mesh_indices[i]);
+      max_index = std::max(max_index, mesh_indices[i]);
+    }
+    if (max_index - min_index >= kMaxNarrowIndexedVertices) {
+      return false;
+    }
+    base_vertices[m] = min_index;
+  }
 
-    const void *read_location = nullptr;
-    switch (vertex_setup_->vertex_types_layout()[elm_idx]) {
-      case VertexElementType::POSITION: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.pos));
-        break;
-      }
-      case VertexElementType::NORMAL: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.normal));
-        break;
-      }
-      case VertexElementType::COLOUR: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.colour));
-        break;
-      }
-      case VertexElementType::UV: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.uv));
-        break;
-      }
-      case VertexElementType::TANGENT: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.tangent));
-        break;
-      }
-      case VertexElementType::BITANGENT: {
-        read_location = SCAST_CVOIDPTR(glm::value_ptr(vertex.bitangent));
-        break;
+  narrow_indices.assign(indices_count, 0U);
+  for (uint32_t m = 0U; m < meshes_count; ++m) {
+    uint32_t start_index = meshes[m].start_index();
+    for (uint32_t i = start_index;
+         i < start_index + meshes[m].index_count();
+         ++i) {
+      narrow_indices[i] = static_cast<uint16_t>(indices[i] - base_vertices[m]);
+    }
+    for (uint32_t l = meshes[m].first_lod();
+         l < meshes[m].first_lod() + meshes[m].lods_count();
+         ++l) {
+      for (uint32_t i = lods[l].first_index;
+           i < lods[l].first_index + lods[l].indices_count;
+           ++i) {
+        narrow_indices[i] =
+          static_cast<uint16_t>(indices[i] - base_vertices[m]);
       }
-      default:
-        ELOG_WARN("Unsupported vertex element type!");
     }
+    meshes[m].set_vertex_offset(meshes[m].vertex_offset() + base_vertices[m]);
+  }
 
-    memcpy(
-        dst,
-        read_location,
-        element_size);
-  } 
+  return true;
+}
 
-  //unsigned char *dst = vertices_data_.data() + (vertex_size_ * current_vertex_);
-  current_vertex_++;
+// Indirect commands a mesh is given
+static inline uint32_t GetMeshDrawsCount(const Mesh &mesh) {
+  return std::max(mesh.meshlets_count(), 1U);
 }
 
-void ModelBuilder::AddMesh(const Mesh *mesh) {
-  meshes_.push_back(mesh);
+// Write the draws of a mesh into its range of commands: the given LOD, or
+// else its meshlets which pass the culling, merging the ones which are
+// contiguous in the index buffer, or else the whole mesh. The rest of the
+// range is filled with empty draws. All the meshlets pass if there are no
+// frustum planes. The draws are offset to the model's range of the arena,
+// and start at first_instance, which indirect draws carry the mesh ID in
+static void WriteMeshDraws(
+    const GeometryRange &range,
+    const Mesh &mesh,
+    const Meshlet *meshlets,
+    const MeshLod *lod,
+    const glm::vec4 *frustum_planes,
+    const glm::vec3 &viewer_position,
+    uint32_t first_instance,
+    VkDrawIndexedIndirectCommand *draws) {
+  uint32_t draws_count = 0U;
+  int32_t vertex_offset =
+    static_cast<int32_t>(range.first_vertex + mesh.vertex_offset());
+  if (lod != nullptr || mesh.meshlets_count() == 0U) {
+    VkDrawIndexedIndirectCommand &draw = draws[draws_count++];
+    draw.indexCount = (lod != nullptr) ? lod->indices_count :
+                                         mesh.index_count();
+    draw.instanceCount = 1U;
+    draw.firstIndex = range.first_index +
+      ((lod != nullptr) ? lod->first_index : mesh.start_index());
+    draw.vertexOffset = vertex_offset;
+    draw.firstInstance = first_instance;
+  }
+  else {
+    for (uint32_t i = 0U; i < mesh.meshlets_count(); ++i) {
+      const Meshlet &meshlet = meshlets[i];
+      if (frustum_planes != nullptr &&
+          IsMeshletCulled(meshlet, mesh.model_mat(), frustum_planes,
+                          viewer_position)) {
+        continue;
+      }
+
+      uint32_t first_index = range.first_index + meshlet.first_index;
+      if (draws_count != 0U) {
+        VkDrawIndexedIndirectCommand &last = draws[draws_count - 1U];
+        if (last.firstIndex + last.indexCount == first_index) {
+          last.indexCount += meshlet.indices_count;
+          continue;
+        }
+      }
+
+      VkDrawIndexedIndirectCommand &draw = draws[draws_count++];
+      draw.indexCount = meshlet.indices_count;
+      draw.instanceCount = 1U;
+      draw.firstIndex = first_index;
+      draw.vertexOffset = vertex_offset;
+      draw.firstInstance = first_instance;
+    }
+  }
+
+  memset(draws + draws_count, 0,
+         (GetMeshDrawsCount(mesh) - draws_count) *
+           sizeof(VkDrawIndexedIndirectCommand));
 }
 
 Model::Model()
     : meshes_(),
-      vertex_buffers_(),
-      index_buffer_(),
+      meshlets_(),
+      lods_(),
+      first_draws_(),
+      geometry_arena_(nullptr),
+      geometry_range_(kNoGeometryRange),
+      index_type_(VK_INDEX_TYPE_UINT32),
       vertex_input_state_create_info_(
           tools::inits::PipelineVertexInputStateCreateInfo()),
       bindings_(),
@@ -124,6 +355,7 @@ Model::Model()
       model_matxs_buff_(),
       materialIDs_buff_(),
       indirect_draws_buff_(),
+      multi_draw_indirect_(false),
       desc_set_(VK_NULL_HANDLE),
       desc_pool_(VK_NULL_HANDLE),
       vtx_setup_(nullptr) {}
@@ -135,6 +367,19 @@ void Model::Init(const VulkanDevice &device,
   for (uint32_t i = 0U; i < meshes_count; i++) {
     meshes_.push_back(*(model_builder.meshes()[i]));
   }
+  meshlets_ = model_builder.meshlets();
+  lods_ = model_builder.lods();
+  // Only meshes which have something to choose from need indirect draws
+  if (!meshlets_.empty() || !lods_.empty()) {
+    uint32_t draws_count = 0U;
+    first_draws_.resize(meshes_count);
+    for (uint32_t i = 0U; i < meshes_count; i++) {
+      first_draws_[i] = draws_count;
+      draws_count += GetMeshDrawsCount(meshes_[i]);
+    }
+  }
+  multi_draw_indirect_ = device.physical_features().multiDrawIndirect ==
+    VK_TRUE;
   
   //std::sort(meshes_.begin(), meshes_.end(),
   //  [](const Mesh &lhs, const Mesh &rhs) {
@@ -147,44 +392,64 @@ void Model::Init(const VulkanDevice &device,
   CreateBuffers(device, model_builder);
 }
 
+void Model::AllocateGeometry(const VulkanDevice &device,
+                             const ModelBuilder &builder) {
+  // Halve the indices whenever the meshes allow it
+  eastl::vector<uint16_t> narrow_indices;
+  uint32_t indices_count = builder.GetIndicesCount();
+  if (NarrowIndices(builder.GetIndicesData(), indices_count, lods_, meshes_,
+                    narrow_indices)) {
+    index_type_ = VK_INDEX_TYPE_UINT16;
+  }
+  else {
+    index_type_ = VK_INDEX_TYPE_UINT32;
+  }
+
+  // The vertices and indices go into the arena of the layout, at an offset
+  // which the draws add
+  const VertexSetup &vertex_setup = *builder.vertex_setup();
+  VkDeviceSize index_bytes = static_cast<VkDeviceSize>(indices_count) *
+    ((index_type_ == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) :
+                                             sizeof(uint32_t));
+  geometry_arena_ = model_manager()->GetGeometryArena(
+      device,
+      vertex_setup,
+      builder.current_vertex(),
+      index_bytes);
+  geometry_range_ = geometry_arena_->Allocate(
+      device,
+      builder.current_vertex(),
+      indices_count,
+      index_type_);
+
+  for (uint32_t i = 0U; i < vertex_setup.num_streams(); ++i) {
+    geometry_arena_->WriteVertexStream(
+        device,
+        geometry_range_,
+        i,
+        builder.GetVertexStreamData(i));
+  }
+  geometry_arena_->WriteIndices(
+      device,
+      geometry_range_,
+      (index_type_ == VK_INDEX_TYPE_UINT16) ?
+        SCAST_CVOIDPTR(narrow_indices.data()) :
+        SCAST_CVOIDPTR(builder.GetIndicesData()));
+}
+
 void Model::CreateBuffers(const VulkanDevice &device,
                           const ModelBuilder &builder) {
   uint32_t meshes_count = SCAST_U32(builder.meshes().size());
 
-  // Create buffers for the vertex and index buffers
-  VulkanBufferInitInfo init_info;
-  
-  vertex_buffers_.resize(builder.vertex_setup()->num_elements());
-  uint32_t elm_idx = 0U;
-  for (eastl::vector<VulkanBuffer>::iterator i = vertex_buffers_.begin();
-       i != vertex_buffers_.end();
-       ++i, ++elm_idx) { 
-    init_info.buffer_usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-    init_info.memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    init_info.size = SCAST_U32(builder.vertices_data(elm_idx).size()) *
-      SCAST_U32(sizeof(uint8_t)),
-    init_info.cmd_buff = vulkan()->copy_cmd_buff();
-    i->Init(
-        device,
-        init_info, 
-        SCAST_CVOIDPTR(builder.vertices_data(elm_idx).data()));
-  }
+  AllocateGeometry(device, builder);
 
-  init_info.size = SCAST_U32(builder.indices_data().size()) *
-    SCAST_U32(sizeof(uint32_t));
-  init_info.buffer_usage_flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-  index_buffer_.Init(
-      device,
-      init_info, 
-      SCAST_CVOIDPTR(builder.indices_data().data()));
-  
   // Create model matrices buffer
+  VulkanBufferInitInfo init_info;
   init_info.size = meshes_count * SCAST_U32(sizeof(glm::mat4));
   init_info.memory_property_flags = /*VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |*/
     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
   init_info.buffer_usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  init_info.memory_category = MemoryCategory::OTHER;
   model_matxs_buff_.Init(device, init_info);
 
   // Upload the data to it
@@ -195,7 +460,7 @@ void Model::CreateBuffers(const VulkanDevice &device,
        ++itor, ++counter) { 
       void *data = nullptr;
       model_matxs_buff_.Map(device, &data, mat4_size, counter * mat4_size);
-      *static_cast<glm::mat4 *>(data) = itor->model_mat();
+      *static_cast<glm::mat4 *>(data) = GetMeshModelMatrix(counter);
       model_matxs_buff_.Unmap(device);
   }
  
@@ -222,45 +487,75 @@ void Model::CreateBuffers(const VulkanDevice &device,
       SCAST_U32(material_ids.size()) *
         SCAST_U32(sizeof(uint32_t)));
   materialIDs_buff_.Unmap(vulkan()->device());
+
+  // Indirect draws, of the whole meshes until the first update
+  if (!first_draws_.empty()) {
+    uint32_t draws_count = GetDrawsCount();
+    init_info.size = draws_count *
+      SCAST_U32(sizeof(VkDrawIndexedIndirectCommand));
+    init_info.buffer_usage_flags = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    indirect_draws_buff_.Init(device, init_info);
+
+    void *mapped_draws = nullptr;
+    indirect_draws_buff_.Map(device, &mapped_draws);
+    VkDrawIndexedIndirectCommand *draws =
+      static_cast<VkDrawIndexedIndirectCommand *>(mapped_draws);
+    const GeometryRange &range = geometry_arena_->range(geometry_range_);
+    for (uint32_t i = 0U; i < meshes_count; ++i) {
+      WriteMeshDraws(range, meshes_[i],
+                     meshlets_.data() + meshes_[i].first_meshlet(),
+                     nullptr, nullptr, glm::vec3(0.f), 0U,
+                     draws + first_draws_[i]);
+    }
+    indirect_draws_buff_.Unmap(device);
+  }
 }
 
 void Model::Shutdown(const VulkanDevice &device) {
-  index_buffer_.Shutdown(device);
-  for (eastl::vector<VulkanBuffer>::iterator i = vertex_buffers_.begin();
-       i != vertex_buffers_.end();
-       ++i) {
-    i->Shutdown(device);
+  if (geometry_range_ != kNoGeometryRange) {
+    geometry_arena_->Free(geometry_range_);
+    geometry_range_ = kNoGeometryRange;
   }
   model_matxs_buff_.Shutdown(device);
   materialIDs_buff_.Shutdown(device);
+  indirect_draws_buff_.Shutdown(device);
 }
   
-void Model::BindVertexBuffer(VkCommandBuffer cmd_buff) const {
-  uint32_t num_elements = SCAST_U32(vertex_buffers_.size());
-  eastl::vector<VkDeviceSize> offsets;
-  offsets.assign(num_elements, 0U);
-  eastl::vector<VkBuffer> buffers(num_elements);
-  eastl::vector<VkBuffer>::iterator bi = buffers.begin();
-  for (eastl::vector<VulkanBuffer>::const_iterator i = vertex_buffers_.begin();
-       i != vertex_buffers_.end();
-       ++i, ++bi) {
-    *bi = i->buffer();
+GeometryRangeId Model::ReleaseGeometry() {
+  GeometryRangeId range = geometry_range_;
+  geometry_range_ = kNoGeometryRange;
+  return range;
+}
+
+void Model::RestoreGeometry(const VulkanDevice &device,
+                            const ModelBuilder &builder) {
+  // Narrowing the indices rebases the meshes again
+  uint32_t meshes_count = SCAST_U32(meshes_.size());
+  for (uint32_t i = 0U; i < meshes_count; ++i) {
+    meshes_[i].set_vertex_offset(builder.meshes()[i]->vertex_offset());
   }
 
-  vkCmdBindVertexBuffers(
-      cmd_buff,
-      0U,
-      num_elements,
-      buffers.data(),
-      offsets.data());
+  AllocateGeometry(device, builder);
+}
+
+VkDeviceSize Model::GetGeometrySize() const {
+  if (geometry_range_ == kNoGeometryRange) {
+    return 0U;
+  }
+
+  return geometry_arena_->GetRangeSize(geometry_range_);
+}
+
+void Model::BindVertexBuffer(VkCommandBuffer cmd_buff) const {
+  geometry_arena_->BindVertexBuffers(cmd_buff);
+}
+
+void Model::BindPositionBuffer(VkCommandBuffer cmd_buff) const {
+  geometry_arena_->BindPositionBuffer(cmd_buff);
 }
 
 void Model::BindIndexBuffer(VkCommandBuffer cmd_buff) const {
-  vkCmdBindIndexBuffer(
-      cmd_buff,
-      index_buffer_.buffer(),
-      0U,
-      VK_INDEX_TYPE_UINT32);
+  geometry_arena_->BindIndexBuffer(cmd_buff, index_type_);
 }
   
 void Model::CreateDescriptorSet(const VulkanDevice &device,
@@ -279,7 +574,7 @@ void Model::CreateDescriptorSet(const VulkanDevice &device,
 }
 
 void Model::WriteDescriptorSet(const VulkanDevice &device) {
-  eastl::vector<VkWriteDescriptorSet> write_desc_sets;
+  FrameVector<VkWriteDescriptorSet> write_desc_sets;
 
   uint32_t counter = 0U;
   //eastl::vector<VkDescriptorBufferInfo> elems_buff_infos(
@@ -347,6 +642,156 @@ void Model::WriteDescriptorSet(const VulkanDevice &device) {
       nullptr);
 }
 
+uint32_t Model::GetMeshFirstDraw(uint32_t mesh_idx) const {
+  return first_draws_.empty() ? mesh_idx : first_draws_[mesh_idx];
+}
+
+uint32_t Model::GetDrawsCount() const {
+  if (first_draws_.empty()) {
+    return SCAST_U32(meshes_.size());
+  }
+
+  return first_draws_.back() + GetMeshDrawsCount(meshes_.back());
+}
+
+glm::mat4 Model::GetMeshModelMatrix(uint32_t mesh_idx) const {
+  // Quantized positions are mapped back to model space here
+  const Mesh &mesh = meshes_[mesh_idx];
+  return mesh.model_mat() * GetPositionDequantMatrix(mesh.position_dequant());
+}
+
+glm::vec4 Model::GetMeshBoundingSphere(uint32_t mesh_idx) const {
+  const Mesh &mesh = meshes_[mesh_idx];
+  const glm::vec4 &sphere = mesh.bounding_sphere();
+  glm::vec3 centre(mesh.model_mat() * glm::vec4(glm::vec3(sphere), 1.f));
+  float scale = glm::length(glm::vec3(mesh.model_mat()[0U]));
+  return glm::vec4(centre, sphere.w * scale);
+}
+
+void Model::GetMeshBoundingBox(
+    uint32_t mesh_idx,
+    glm::vec3 *box_min,
+    glm::vec3 *box_max) const {
+  // The extent along each world axis is the sum of the ones of the box's
+  // axes projected on it
+  const Mesh &mesh = meshes_[mesh_idx];
+  const glm::mat4 &model_mat = mesh.model_mat();
+  glm::vec3 centre = (mesh.bounds_min() + mesh.bounds_max()) * 0.5f;
+  glm::vec3 extent = (mesh.bounds_max() - mesh.bounds_min()) * 0.5f;
+  glm::vec3 world_centre(model_mat * glm::vec4(centre, 1.f));
+  glm::vec3 world_extent =
+    glm::abs(glm::vec3(model_mat[0U])) * extent.x +
+    glm::abs(glm::vec3(model_mat[1U])) * extent.y +
+    glm::abs(glm::vec3(model_mat[2U])) * extent.z;
+  *box_min = world_centre - world_extent;
+  *box_max = world_centre + world_extent;
+}
+
+bool Model::CullMeshes(
+    const szt::Frustum &frustum,
+    uint8_t *meshes_visible) const {
+  // All of the boxes are tested in one go
+  uint32_t meshes_count = SCAST_U32(meshes_.size());
+  FrameVector<glm::vec3> boxes_min(meshes_count);
+  FrameVector<glm::vec3> boxes_max(meshes_count);
+  for (uint32_t i = 0U; i < meshes_count; ++i) {
+    GetMeshBoundingBox(i, &boxes_min[i], &boxes_max[i]);
+  }
+  frustum.TestBoxes(boxes_min.data(), boxes_max.data(), meshes_count,
+                    meshes_visible);
+
+  bool any_visible = false;
+  for (uint32_t i = 0U; i < meshes_count; ++i) {
+    if (meshes_[i].bounding_sphere().w <= 0.f) {
+      meshes_visible[i] = 1U;
+    }
+    any_visible = any_visible || meshes_visible[i] != 0U;
+  }
+  return any_visible;
+}
+
+void Model::WriteFrameDraws(
+    const glm::mat4 &proj,
+    const glm::mat4 &view,
+    float viewport_height,
+    const uint8_t *meshes_visible,
+    bool mesh_ids,
+    uint32_t first_mesh_id,
+    VkDrawIndexedIndirectCommand *draws) const {
+  const GeometryRange &range = geometry_arena_->range(geometry_range_);
+  glm::vec4 frustum_planes[6U];
+  ExtractFrustumPlanes(proj * view, frustum_planes);
+  glm::vec3 viewer_position(glm::inverse(view)[3U]);
+  float pixels_per_unit = 0.5f * viewport_height * fabsf(proj[1U][1U]);
+  uint32_t meshes_count = SCAST_U32(meshes_.size());
+
+  // Meshes write disjoint ranges of the commands
+  worker_pool()->ParallelFor(
+      meshes_count,
+      1U,
+      [&](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+      const Mesh &mesh = meshes_[i];
+      if (meshes_visible[i] == 0U) {
+        memset(draws + GetMeshFirstDraw(i), 0,
+               GetMeshDrawsCount(mesh) * sizeof(VkDrawIndexedIndirectCommand));
+        continue;
+      }
+      const MeshLod *lods = lods_.data() + mesh.first_lod();
+      uint32_t level = SelectMeshLod(lods, mesh.lods_count(), mesh.model_mat(),
+                                     mesh.bounding_sphere(), viewer_position,
+                                     pixels_per_unit);
+      WriteMeshDraws(
+          range,
+          mesh,
+          meshlets_.data() + mesh.first_meshlet(),
+          (level != 0U) ? &lods[level - 1U] : nullptr,
+          frustum_planes,
+          viewer_position,
+          mesh_ids ? first_mesh_id + i : 0U,
+          draws + GetMeshFirstDraw(i));
+    }
+  });
+}
+
+void Model::UpdateDraws(
+    const VulkanDevice &device,
+    const glm::mat4 &proj,
+    const glm::mat4 &view,
+    float viewport_height,
+    const uint8_t *meshes_visible,
+    VkFence draws_read_fence) {
+  if (first_draws_.empty()) {
+    return;
+  }
+
+  // There's a single copy of the draws, which the GPU may still be reading
+  VK_CHECK_RESULT(vkWaitForFences(device.device(), 1U, &draws_read_fence,
+                                  VK_TRUE, UINT64_MAX));
+  void *mapped_draws = nullptr;
+  indirect_draws_buff_.Map(device, &mapped_draws);
+  WriteFrameDraws(
+      proj,
+      view,
+      viewport_height,
+      meshes_visible,
+      false,
+      0U,
+      static_cast<VkDrawIndexedIndirectCommand *>(mapped_draws));
+  indirect_draws_buff_.Unmap(device);
+}
+
+void Model::WriteDraws(
+    const glm::mat4 &proj,
+    const glm::mat4 &view,
+    float viewport_height,
+    const uint8_t *meshes_visible,
+    uint32_t first_mesh_id,
+    VkDrawIndexedIndirectCommand *draws) const {
+  WriteFrameDraws(proj, view, viewport_height, meshes_visible, true,
+                  first_mesh_id, draws);
+}
+
 void Model::RenderMeshesByMaterial(
       VkCommandBuffer cmd_buff,
       VkPipelineLayout pipe_layout,
@@ -362,11 +807,21 @@ void Model::RenderMeshesByMaterial(
     0U,
     nullptr);
  
-    uint32_t mesh_idx = 0U;
+    // The commands are recorded ahead of the frames, so only the materials
+    // can order them; meshes reading the same material follow each other
+    RenderQueue queue;
+    for (uint32_t i = 0U; i < meshes_.size(); ++i) {
+      queue.Push(RenderQueue::MakeKey(DrawPassTypes::SHADING, 0U,
+                                      meshes_[i].material_id(), 0.f),
+                 i);
+    }
+    queue.Sort();
+
+    const GeometryRange &range = geometry_arena_->range(geometry_range_);
     uint32_t uint32_t_size = SCAST_U32(sizeof(uint32_t));
-     for (eastl::vector<Mesh>::const_iterator itor = meshes_.begin();
-          itor != meshes_.end();
-          itor++, mesh_idx++) {
+     for (uint32_t q = 0U; q < queue.size(); ++q) {
+       uint32_t mesh_idx = queue.items()[q].value;
+       const Mesh &mesh = meshes_[mesh_idx];
        // Set the mesh ID
        vkCmdPushConstants(
             cmd_buff,
@@ -376,14 +831,39 @@ void Model::RenderMeshesByMaterial(
             uint32_t_size,
             &mesh_idx);
 
-        // Render the mesh
-        vkCmdDrawIndexed(
-            cmd_buff,
-            itor->index_count(),
-            1U,
-            itor->start_index(),
-            itor->vertex_offset(),
-            0U);
+        if (first_draws_.empty()) {
+          // Render the mesh
+          vkCmdDrawIndexed(
+              cmd_buff,
+              mesh.index_count(),
+              1U,
+              range.first_index + mesh.start_index(),
+              range.first_vertex + mesh.vertex_offset(),
+              0U);
+          continue;
+        }
+
+        // Render whatever UpdateDraws picked for it
+        uint32_t draw_size = SCAST_U32(sizeof(VkDrawIndexedIndirectCommand));
+        uint32_t draws_count = GetMeshDrawsCount(mesh);
+        VkDeviceSize offset = first_draws_[mesh_idx] * draw_size;
+        if (multi_draw_indirect_) {
+          vkCmdDrawIndexedIndirect(
+              cmd_buff,
+              indirect_draws_buff_.buffer(),
+              offset,
+              draws_count,
+              draw_size);
+          continue;
+        }
+        for (uint32_t i = 0U; i < draws_count; ++i) {
+          vkCmdDrawIndexedIndirect(
+              cmd_buff,
+              indirect_draws_buff_.buffer(),
+              offset + i * draw_size,
+              1U,
+              draw_size);
+        }
     }
 
   
@@ -1,7 +1,5 @@
 #include <model_manager.h>
 #include <model.h>
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
 #include <vector>
 #include <iostream>
 #include <mesh.h>
@@ -20,6 +18,19 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/vector3.h>
+#include <mesh_cache.h>
+#include <mesh_packing.h>
+#include <vertex_quantization.h>
+#include <mesh_optimizer.h>
+#include <vertex_dedup.h>
+#include <worker_pool.h>
+#include <mapped_file.h>
+#include <obj_parser.h>
+#include <vulkan_texture_manager.h>
+#include <residency_manager.h>
+#include <Timer.h>
+#include <atomic>
+#include <thread>
 #include <unordered_map>
 #include <string>
 
@@ -30,7 +41,48 @@ const eastl::string kBaseModelAssetsPath = "../assets/models/";
 
 ModelManager::ModelManager()
     : models_(),
-      deferred_gpass_set_layout_(VK_NULL_HANDLE) {}
+      deferred_gpass_set_layout_(VK_NULL_HANDLE),
+      async_loads_(),
+      reloads_(),
+      resident_models_pool_(sizeof(ResidentModelMap::node_type), 256U),
+      resident_models_(ResidentModelMap::allocator_type(
+          &resident_models_pool_, "resident models")),
+      geometry_arenas_() {}
+
+ModelManager::~ModelManager() {}
+
+// Unique vertices and indices of an OBJ shape
+static void DedupObjShape(
+    const ObjScene &scene,
+    const ObjShape &shape,
+    VertexDedupMap &map,
+    eastl::vector<uint32_t> &indices) {
+  uint32_t corners_count = SCAST_U32(shape.indices.size());
+  // Most corners share their vertex with a few others
+  map.Reserve(corners_count / 4U);
+  indices.resize(corners_count);
+  for (uint32_t i = 0U; i < corners_count; i++) {
+    const ObjIndex &idx = shape.indices[i];
+    Vertex vertex; 
+    vertex.pos = {
+      scene.positions[3U * idx.vertex_index + 0U],
+      scene.positions[3U * idx.vertex_index + 1U],
+      scene.positions[3U * idx.vertex_index + 2U]
+    };
+    vertex.uv = {
+      scene.texcoords[2U * idx.texcoord_index + 0U],
+      scene.texcoords[2U * idx.texcoord_index + 1U],
+      0.f
+    };
+    vertex.normal = {
+      scene.normals[3U * idx.normal_index + 0U],
+      scene.normals[3U * idx.normal_index + 1U],
+      scene.normals[3U * idx.normal_index + 2U]
+    };
+
+    indices[i] = map.InsertOrGet(vertex);
+  }
+}
 
 void ModelManager::LoadObjModel(
     const VulkanDevice &device,
@@ -43,75 +95,64 @@ void ModelManager::LoadObjModel(
     return;
   }
 
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-
-  std::string err;
-  bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err,
-                              filename.c_str(), material_dir.c_str());
-
-  if (!ret) {
-    EXIT(err);
+  ObjScene scene;
+  eastl::string err;
+  if (!ParseObj(filename, material_dir, &scene, &err)) {
+    EXIT(err.c_str());
   }
+  const eastl::vector<ObjShape> &shapes = scene.shapes;
+  const eastl::vector<ObjMaterial> &materials = scene.materials;
 
-  // Group all vertex data together
-  std::unordered_map<Vertex, uint32_t> unique_vertices;
   uint32_t materials_count = SCAST_U32(materials.size());
   ModelBuilder model_builder(
         vertex_setup,
         sets_desc_pool_);
 
-  // For each shape, which corresponds to a mesh in the model
+  // Each shape, which corresponds to a mesh in the model, is deduplicated on
+  // its own in parallel; their unique vertices are then merged, as shapes
+  // can share vertices, and packed into the streams in one go
   uint32_t shapes_size = SCAST_U32(shapes.size());
+  eastl::vector<VertexDedupMap> shape_maps(shapes_size);
+  eastl::vector<eastl::vector<uint32_t>> shape_indices(shapes_size);
+  worker_pool()->ParallelFor(
+      shapes_size,
+      1U,
+      [&](uint32_t begin, uint32_t end) {
+    for (uint32_t si = begin; si < end; ++si) {
+      DedupObjShape(scene, shapes[si], shape_maps[si], shape_indices[si]);
+    }
+  });
+  eastl::vector<Vertex> vertices;
+  MergeDedupedVertices(shape_maps.data(), shape_indices.data(), shapes_size,
+                       vertices);
+
   eastl::vector<Mesh> meshes(shapes_size);
   for (uint32_t si = 0U; si < shapes_size; si++) {
-    uint32_t index_offset = 0U;
-
-    // Create a mesh
     meshes[si] = Mesh(
-        SCAST_U32(model_builder.indices_data().size()),
-        SCAST_U32(shapes[si].mesh.indices.size()),
+        model_builder.GetIndicesCount(),
+        SCAST_U32(shape_indices[si].size()),
         0U,
-        SCAST_U32(shapes[si].mesh.material_ids[0U]));    
-
-    // Load the vertices for this mesh 
-    uint32_t num_faces = SCAST_U32(shapes[si].mesh.num_face_vertices.size());
-    for (uint32_t f = 0U; f < num_faces; f++) {
-      uint32_t fv = shapes[si].mesh.num_face_vertices[f];
-
-      for (uint32_t v = 0U; v < fv; v++) {
-        tinyobj::index_t idx = shapes[si].mesh.indices[index_offset + v];
-        Vertex vertex; 
-        vertex.pos = {
-          attrib.vertices[3U * idx.vertex_index + 0U],
-          attrib.vertices[3U * idx.vertex_index + 1U],
-          attrib.vertices[3U * idx.vertex_index + 2U]
-        };
-        vertex.uv = {
-          attrib.texcoords[2U * idx.texcoord_index + 0U],
-          attrib.texcoords[2U * idx.texcoord_index + 1U],
-          0.f
-        };
-        vertex.normal = {
-          attrib.normals[3U * idx.normal_index + 0U],
-          attrib.normals[3U * idx.normal_index + 1U],
-          attrib.normals[3U * idx.normal_index + 2U]
-        };
-
-        if (unique_vertices.count(vertex) == 0U) {
-          unique_vertices[vertex] = model_builder.current_vertex();
-          model_builder.AddVertex(vertex);
-        }
-
-        model_builder.AddIndex(unique_vertices[vertex]);
-      }
+        SCAST_U32(shapes[si].material_ids[0U]));    
+    model_builder.AddIndices(shape_indices[si].data(),
+                             SCAST_U32(shape_indices[si].size()));
+    model_builder.AddMesh(&meshes[si]);
+  }
 
-      index_offset += fv;
+  // Vertices are shared by the shapes, so quantized positions are fit to
+  // the bounds of the whole model
+  if (!vertices.empty() &&
+      vertex_setup.GetElementEncoding(VertexElementType::POSITION) ==
+        VertexElementEncoding::SNORM16_POSITION) {
+    glm::vec4 position_dequant = ComputePositionDequant(
+        &vertices.data()->pos.x,
+        SCAST_U32(vertices.size()),
+        SCAST_U32(sizeof(Vertex)));
+    model_builder.set_position_dequant(position_dequant);
+    for (uint32_t si = 0U; si < shapes_size; si++) {
+      meshes[si].set_position_dequant(position_dequant);
     }
-
-    model_builder.AddMesh(&meshes[si]);
   }
+  model_builder.AddVertices(vertices.data(), SCAST_U32(vertices.size()));
 
   CreateUniqueModel(
       device,
@@ -177,119 +218,13 @@ void ModelManager::LoadObjModel(
 
 }
 
-void ModelManager::LoadOtherModel(
-    const VulkanDevice &device,
-    const eastl::string &filename,
-    const eastl::string &material_dir,
-    uint32_t assimp_post_process_steps,
-    const VertexSetup &vertex_setup,
-    Model **model) const {
-  if (SCAST_U32(models_.count(filename)) != 0U) {
-    (*model) = models_[filename].get();
-    return;
-  }
-
-  Assimp::Importer assimp_importer;
-  const aiScene *scene = assimp_importer.ReadFile(
-      filename.c_str(),
-      assimp_post_process_steps);
- 
-  if (scene == nullptr || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE ||
-      scene->mRootNode == nullptr) {
-    EXIT(assimp_importer.GetErrorString());
-  }
-
-  uint32_t materials_count = scene->mNumMaterials;
-  
-  ModelBuilder model_builder(
-        vertex_setup,
-        sets_desc_pool_);
-  
-  uint32_t mat_idx_offset = material_manager()->GetMaterialInstancesCount();
-
-  // For each shape, which corresponds to a mesh in the model
-  uint32_t meshes_count = scene->mNumMeshes;
-  std::vector<Mesh> meshes(meshes_count);
-  uint32_t idx_offset = 0U;
-  for (uint32_t mi = 0U; mi < meshes_count; mi++) {
-    const aiMesh *ai_mesh = scene->mMeshes[mi];
-    // Create a mesh
-    meshes[mi] = Mesh(
-        SCAST_U32(model_builder.indices_data().size()),
-        ai_mesh->mNumFaces * 3U,
-        0U,
-        ai_mesh->mMaterialIndex);
-  
-    LOG("MATIDX: " << ai_mesh->mMaterialIndex);
-    // Load the vertices for this mesh 
-    for (uint32_t i = 0U; i < ai_mesh->mNumVertices; i++) {
-      Vertex vertex; 
-      vertex.pos = {
-        ai_mesh->mVertices[i].x,
-        ai_mesh->mVertices[i].y,
-        ai_mesh->mVertices[i].z
-      };
-      vertex.normal = {
-        ai_mesh->mNormals[i].x,
-        ai_mesh->mNormals[i].y,
-        ai_mesh->mNormals[i].z
-      };
-      if (ai_mesh->mTextureCoords[0U]) {
-        vertex.uv = {
-          ai_mesh->mTextureCoords[0U][i].x,
-          ai_mesh->mTextureCoords[0U][i].y,
-          ai_mesh->mTextureCoords[0U][i].z
-        };
-      }
-      else {
-        vertex.uv = { 0.f, 0.f, 0.f};
-      }
-      if (assimp_post_process_steps & aiProcess_CalcTangentSpace) {
-        vertex.bitangent = {
-          ai_mesh->mBitangents[i].x,
-          ai_mesh->mBitangents[i].y,
-          ai_mesh->mBitangents[i].z
-        };
-        vertex.tangent = {
-          ai_mesh->mTangents[i].x,
-          ai_mesh->mTangents[i].y,
-          ai_mesh->mTangents[i].z
-        };
-
-        if (glm::dot(glm::cross(vertex.normal, vertex.tangent),
-                     vertex.bitangent) < 0.0f) {
-          vertex.tangent = vertex.tangent * -1.0f;
-        }
-      }
-      model_builder.AddVertex(vertex);
-    }
-
-    // Load indices
-    for (uint32_t i = 0U; i < ai_mesh->mNumFaces; i++) {
-      aiFace &face = ai_mesh->mFaces[i];
-      // Superfluous; all faces are triangulated
-      for (uint32_t j = 0U; j < face.mNumIndices; j++) {
-        model_builder.AddIndex(face.mIndices[j] + idx_offset);
-        if (i == 0U || i == ai_mesh->mNumFaces - 1) {
-        }
-      }
-    }
-    
-    idx_offset += ai_mesh->mNumVertices;
-    model_builder.AddMesh(&meshes[mi]);
-  }
-
-  CreateUniqueModel(
-      device,
-      model_builder,
-      filename,
-      model);
-  LOG("Meshes count: " << meshes_count);
-
-  // Materials
+// Gather the materials of an imported scene, skipping assimp's default one
+static void GetAssimpMaterials(
+    const aiScene *scene,
+    eastl::vector<MeshCacheMaterial> &materials) {
   aiString assimp_default_mat_name("DefaultMaterial");
-  LOG("Materials count: " << materials_count);
-  for (uint32_t i = 0U; i < materials_count; i++) {
+  materials.reserve(scene->mNumMaterials);
+  for (uint32_t i = 0U; i < scene->mNumMaterials; i++) {
     // Avoid loading assimp's default material
     const aiMaterial *ai_mat = scene->mMaterials[i];
 
@@ -299,12 +234,11 @@ void ModelManager::LoadOtherModel(
       continue;
     }
 
-    MaterialInstanceBuilder mat_builder(
-        mat_name.C_Str(),
-        material_dir,
-        aniso_sampler_);
+    materials.push_back(MeshCacheMaterial());
+    MeshCacheMaterial &material = materials.back();
+    material.name = mat_name.C_Str();
 
-    MaterialConstants mat_consts;
+    MaterialConstants &mat_consts = material.consts;
     aiColor4D colour;
     if (ai_mat->Get(AI_MATKEY_COLOR_AMBIENT, colour) == AI_SUCCESS) {
       mat_consts.ambient = glm::vec3(
@@ -340,8 +274,6 @@ void ModelManager::LoadOtherModel(
       mat_consts.diffuse_dissolve.w = value;
     };
 
-    mat_builder.AddConstants(mat_consts);
-
     MaterialBuilderTexture builder_texture;
     aiString texture_path;
     builder_texture.type = MatTextureType::AMBIENT; 
@@ -349,7 +281,7 @@ void ModelManager::LoadOtherModel(
         AI_SUCCESS) {
       builder_texture.name = texture_path.C_Str();
     }
-    mat_builder.AddTexture(builder_texture);
+    material.textures.push_back(builder_texture);
    
     builder_texture.type = MatTextureType::DIFFUSE; 
     builder_texture.name = "";
@@ -357,7 +289,7 @@ void ModelManager::LoadOtherModel(
         AI_SUCCESS) {
       builder_texture.name = texture_path.C_Str();
     }
-    mat_builder.AddTexture(builder_texture);
+    material.textures.push_back(builder_texture);
       
     builder_texture.type = MatTextureType::SPECULAR; 
     builder_texture.name = "";
@@ -365,7 +297,7 @@ void ModelManager::LoadOtherModel(
         AI_SUCCESS) {
       builder_texture.name = texture_path.C_Str();
     }
-    mat_builder.AddTexture(builder_texture);
+    material.textures.push_back(builder_texture);
     
     builder_texture.type = MatTextureType::SPECULAR_HIGHLIGHT; 
     builder_texture.name = "";
@@ -373,7 +305,7 @@ void ModelManager::LoadOtherModel(
                            &texture_path) == AI_SUCCESS) {
       builder_texture.name = texture_path.C_Str();
     }
-    mat_builder.AddTexture(builder_texture);
+    material.textures.push_back(builder_texture);
     
     builder_texture.type = MatTextureType::NORMAL; 
     builder_texture.name = "";
@@ -385,7 +317,7 @@ void ModelManager::LoadOtherModel(
         AI_SUCCESS) {
       builder_texture.name = texture_path.C_Str();
     }
-    mat_builder.AddTexture(builder_texture);
+    material.textures.push_back(builder_texture);
     
     builder_texture.type = MatTextureType::ALPHA; 
     builder_texture.name = "";
@@ -393,7 +325,7 @@ void ModelManager::LoadOtherModel(
         AI_SUCCESS) {
       builder_texture.name = texture_path.C_Str();
     }
-    mat_builder.AddTexture(builder_texture);
+    material.textures.push_back(builder_texture);
     
     builder_texture.type = MatTextureType::DISPLACEMENT; 
     builder_texture.name = "";
@@ -401,17 +333,672 @@ void ModelManager::LoadOtherModel(
         AI_SUCCESS) {
       builder_texture.name = texture_path.C_Str();
     }
-    mat_builder.AddTexture(builder_texture);
+    material.textures.push_back(builder_texture);
+  }
+}
+
+
+// Everything a model is created from; gathering it doesn't touch the device,
+// so that it can run on any thread
+struct ModelImport {
+  ModelImport(
+      const eastl::string &filename,
+      const eastl::string &material_dir,
+      uint32_t post_process_steps,
+      const VertexSetup &vertex_setup,
+      VkDescriptorPool desc_pool)
+      : filename(filename),
+        material_dir(material_dir),
+        post_process_steps(post_process_steps),
+        vertex_setup(vertex_setup),
+        cache_file(),
+        cached(),
+        from_cache(false),
+        meshes(),
+        builder(this->vertex_setup, desc_pool),
+        materials(),
+        textures(),
+        timer() {
+    timer.start();
+  }
+
+  eastl::string filename;
+  eastl::string material_dir;
+  uint32_t post_process_steps;
+  // The builder keeps a reference to it
+  VertexSetup vertex_setup;
+  // The builder's data points inside the mapping when the cache is used
+  MappedFile cache_file;
+  MeshCacheContents cached;
+  bool from_cache;
+  eastl::vector<Mesh> meshes;
+  ModelBuilder builder;
+  eastl::vector<MeshCacheMaterial> materials;
+  // Textures of the materials, decoded ahead of their creation
+  eastl::vector<DecodedTexture> textures;
+  Timer timer;
+}; // struct ModelImport
+
+struct ModelManager::AsyncModelLoad {
+  AsyncModelLoad()
+      : import(),
+        imported(false),
+        state(ModelLoadState::IMPORTING),
+        flushed(false),
+        ticket(0U),
+        model(nullptr),
+        reload(nullptr) {}
+
+  // Only touched by the worker until imported is set
+  eastl::unique_ptr<ModelImport> import;
+  std::atomic<bool> imported;
+  ModelLoadState state;
+  // Whether ticket covers the uploads of the model
+  bool flushed;
+  UploadTicket ticket;
+  Model *model;
+  // Set when the load brings back an evicted model into model
+  ResidentModel *reload;
+}; // struct ModelManager::AsyncModelLoad
+
+// What an evictable model is reloaded from, and what it is tracked with
+struct ModelManager::ResidentModel {
+  ResidentModel(
+      const eastl::string &material_dir,
+      uint32_t post_process_steps,
+      const VertexSetup &vertex_setup)
+      : material_dir(material_dir),
+        post_process_steps(post_process_steps),
+        vertex_setup(vertex_setup),
+        residency_id(kNoResidencyId),
+        texture_ids(),
+        reloading(false) {}
+
+  eastl::string material_dir;
+  uint32_t post_process_steps;
+  VertexSetup vertex_setup;
+  uint32_t residency_id;
+  // Textures of its materials
+  eastl::vector<uint32_t> texture_ids;
+  bool reloading;
+}; // struct ModelManager::ResidentModel
+
+// Decode the textures of the materials, in parallel
+static void DecodeMaterialTextures(ModelImport &import) {
+  eastl::vector<eastl::pair<eastl::string, VkFormat>> files;
+  for (eastl::vector<MeshCacheMaterial>::const_iterator i =
+         import.materials.begin();
+       i != import.materials.end();
+       ++i) {
+    for (uint32_t t = 0U; t < SCAST_U32(i->textures.size()); ++t) {
+      VkFormat format = VK_FORMAT_UNDEFINED;
+      if (!GetMaterialTextureFormat(i->textures[t].name, &format)) {
+        continue;
+      }
+      eastl::string name(
+          GetTextureName(import.material_dir + i->textures[t].name));
+      bool found = false;
+      for (uint32_t f = 0U; f < SCAST_U32(files.size()) && !found; ++f) {
+        found = (files[f].first == name);
+      }
+      if (!found) {
+        files.push_back(eastl::make_pair(name, format));
+      }
+    }
+  }
+
+  import.textures.resize(files.size());
+  worker_pool()->ParallelFor(
+      SCAST_U32(files.size()),
+      1U,
+      [&files, &import](uint32_t begin, uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+      // Textures which fail are left empty, and fall back to the dummy one
+      // when the material loads them
+      if (!DecodeTexture(files[i].first, files[i].second,
+                         &import.textures[i])) {
+        import.textures[i].data.clear();
+      }
+    }
+  });
+}
+
+// Fill the builder, from the mesh cache if it is up to date or by importing
+// the file otherwise, and decode the textures of the model
+static void ImportOtherModel(ModelImport &import) {
+  const VertexSetup &vertex_setup = import.vertex_setup;
+  ModelBuilder &model_builder = import.builder;
+
+  // Use the baked data if it is up to date; the buffers are filled straight
+  // from the mapping
+  MeshCacheContents &cached = import.cached;
+  if (ReadMeshCache(import.filename, import.post_process_steps, vertex_setup,
+                    import.cache_file, cached)) {
+    for (uint32_t i = 0U; i < vertex_setup.num_streams(); ++i) {
+      model_builder.SetExternalVertexStream(
+          i,
+          cached.vertex_streams[i],
+          cached.vertex_streams_sizes[i]);
+    }
+    model_builder.SetExternalIndices(cached.indices, cached.indices_count);
+    for (eastl::vector<Mesh>::const_iterator i = cached.meshes.begin();
+         i != cached.meshes.end();
+         ++i) {
+      model_builder.AddMesh(&(*i));
+    }
+    model_builder.AddMeshlets(cached.meshlets.data(),
+                              SCAST_U32(cached.meshlets.size()));
+    model_builder.AddMeshLods(cached.lods.data(),
+                              SCAST_U32(cached.lods.size()));
+    import.materials = cached.materials;
+    import.from_cache = true;
+
+    DecodeMaterialTextures(import);
+    return;
+  }
+
+  Assimp::Importer assimp_importer;
+  const aiScene *scene = assimp_importer.ReadFile(
+      import.filename.c_str(),
+      import.post_process_steps);
+ 
+  if (scene == nullptr || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE ||
+      scene->mRootNode == nullptr) {
+    EXIT(assimp_importer.GetErrorString());
+  }
+
+  // Meshes are packed in parallel, each into its own range of the streams
+  uint32_t meshes_count = scene->mNumMeshes;
+  eastl::vector<PackedMeshRange> ranges;
+  uint32_t vertices_count = 0U;
+  uint32_t indices_count = 0U;
+  ComputePackedMeshRanges(scene->mMeshes, meshes_count, ranges,
+                          &vertices_count, &indices_count);
+  model_builder.ResizeVertices(vertices_count);
+  model_builder.ResizeIndices(indices_count);
+
+  eastl::vector<uint8_t *> streams(vertex_setup.num_streams());
+  for (uint32_t i = 0U; i < vertex_setup.num_streams(); ++i) {
+    streams[i] = model_builder.GetVertexStreamWriteData(i);
+  }
+  eastl::vector<glm::vec4> position_dequants(meshes_count);
+  eastl::vector<VertexQuantizationError> quantization_errors(
+      vertex_setup.num_elements());
+  PackAssimpMeshes(
+      scene->mMeshes,
+      ranges.data(),
+      meshes_count,
+      import.post_process_steps,
+      vertex_setup,
+      streams.data(),
+      model_builder.GetIndicesWriteData(),
+      position_dequants.data(),
+      quantization_errors.data());
+  if (vertex_setup.IsQuantized()) {
+    LogVertexQuantizationErrors(vertex_setup, quantization_errors.data());
+  }
+
+  VertexCacheStats stats_before;
+  VertexCacheStats stats_after;
+  eastl::vector<PackedMeshExtras> extras(meshes_count);
+  OptimizePackedMeshes(
+      scene->mMeshes,
+      ranges.data(),
+      meshes_count,
+      vertex_setup,
+      streams.data(),
+      model_builder.GetIndicesWriteData(),
+      &stats_before,
+      &stats_after,
+      extras.data());
+  LOG("Vertex cache ACMR " << stats_before.GetACMR() << " -> " <<
+      stats_after.GetACMR() << ", ATVR " << stats_before.GetATVR() <<
+      " -> " << stats_after.GetATVR() << ".");
+
+  eastl::vector<Mesh> &meshes = import.meshes;
+  meshes.resize(meshes_count);
+  for (uint32_t mi = 0U; mi < meshes_count; mi++) {
+    meshes[mi] = Mesh(
+        ranges[mi].first_index,
+        ranges[mi].indices_count,
+        0U,
+        scene->mMeshes[mi]->mMaterialIndex);
+    meshes[mi].set_position_dequant(position_dequants[mi]);
+    meshes[mi].set_bounding_sphere(extras[mi].bounding_sphere);
+    meshes[mi].set_bounds(extras[mi].bounds_min, extras[mi].bounds_max);
+    meshes[mi].set_meshlets(SCAST_U32(model_builder.meshlets().size()),
+                            SCAST_U32(extras[mi].meshlets.size()));
+    model_builder.AddMeshlets(extras[mi].meshlets.data(),
+                              SCAST_U32(extras[mi].meshlets.size()));
+
+    // The LODs go after the indices of all the meshes
+    uint32_t lods_first_index = model_builder.GetIndicesCount();
+    for (eastl::vector<MeshLod>::iterator i = extras[mi].lods.begin();
+         i != extras[mi].lods.end();
+         ++i) {
+      i->first_index += lods_first_index;
+    }
+    model_builder.AddIndices(extras[mi].lod_indices.data(),
+                             SCAST_U32(extras[mi].lod_indices.size()));
+    meshes[mi].set_lods(SCAST_U32(model_builder.lods().size()),
+                        SCAST_U32(extras[mi].lods.size()));
+    model_builder.AddMeshLods(extras[mi].lods.data(),
+                              SCAST_U32(extras[mi].lods.size()));
+
+    model_builder.AddMesh(&meshes[mi]);
+  }
+  LOG("Meshes count: " << meshes_count);
+  LOG("Meshlets count: " << model_builder.meshlets().size());
+  LOG("LODs count: " << model_builder.lods().size());
+
+  GetAssimpMaterials(scene, import.materials);
+  LOG("Materials count: " << import.materials.size());
+
+  if (!WriteMeshCache(import.filename, import.post_process_steps,
+                      model_builder, import.materials)) {
+    ELOG_WARN("Couldn't bake the mesh cache of " << import.filename.c_str());
+  }
+
+  DecodeMaterialTextures(import);
+}
+
+void ModelManager::LoadOtherModel(
+    const VulkanDevice &device,
+    const eastl::string &filename,
+    const eastl::string &material_dir,
+    uint32_t assimp_post_process_steps,
+    const VertexSetup &vertex_setup,
+    Model **model) const {
+  if (SCAST_U32(models_.count(filename)) != 0U) {
+    (*model) = models_[filename].get();
+    return;
+  }
+
+  ModelImport import(
+      filename,
+      material_dir,
+      assimp_post_process_steps,
+      vertex_setup,
+      sets_desc_pool_);
+  ImportOtherModel(import);
+  CreateImportedModel(device, import, model);
+}
+
+void ModelManager::CreateImportedModel(
+    const VulkanDevice &device,
+    ModelImport &import,
+    Model **model) const {
+  CreateUniqueModel(
+      device,
+      import.builder,
+      import.filename,
+      model);
+
+  // Models loaded from files can be evicted, as they can be loaded again
+  eastl::unique_ptr<ResidentModel> &resident = resident_models_[*model];
+  bool track = (resident == nullptr);
+  if (track) {
+    resident = eastl::make_unique<ResidentModel>(
+        import.material_dir,
+        import.post_process_steps,
+        import.vertex_setup);
+    resident->residency_id = residency_manager()->Track(
+        ResidentType::MODEL,
+        import.filename,
+        (*model)->GetGeometrySize());
+  }
+
+  // The materials find these by name instead of loading them again
+  for (eastl::vector<DecodedTexture>::const_iterator i =
+         import.textures.begin();
+       i != import.textures.end();
+       ++i) {
+    if (!i->data.empty()) {
+      VulkanTexture *texture = nullptr;
+      texture_manager()->CreateDecodedTexture(
+          device,
+          *i,
+          &texture,
+          aniso_sampler_);
+      if (track) {
+        resident->texture_ids.push_back(residency_manager()->Track(
+            ResidentType::TEXTURE,
+            i->name,
+            texture->image()->size()));
+      }
+    }
+  }
+  CreateMaterialInstances(device, import.material_dir, import.materials);
+
+  LOG((import.from_cache ? "Loaded " : "Imported ") <<
+      import.filename.c_str() <<
+      (import.from_cache ? " from its mesh cache" : "") << " in " <<
+      import.timer.getElapsedTimeInMilliSec() << " ms.");
+}
+
+void ModelManager::RestoreImportedModel(
+    const VulkanDevice &device,
+    ModelImport &import,
+    Model &model,
+    const ResidentModel &resident) const {
+  if (!residency_manager()->IsResident(resident.residency_id)) {
+    model.RestoreGeometry(device, import.builder);
+  }
+
+  // Only the evicted textures are created again
+  for (eastl::vector<DecodedTexture>::const_iterator i =
+         import.textures.begin();
+       i != import.textures.end();
+       ++i) {
+    if (!i->data.empty()) {
+      VulkanTexture *texture = nullptr;
+      texture_manager()->CreateDecodedTexture(
+          device,
+          *i,
+          &texture,
+          aniso_sampler_);
+    }
+  }
+
+  LOG("Reloaded " << import.filename.c_str() << " in " <<
+      import.timer.getElapsedTimeInMilliSec() << " ms.");
+}
+
+bool ModelManager::MarkModelUsed(const Model &model) {
+  ResidentModelMap::iterator found = resident_models_.find(&model);
+  if (found == resident_models_.end()) {
+    return true;
+  }
+
+  ResidentModel &resident = *found->second;
+  residency_manager()->MarkUsed(resident.residency_id);
+  bool geometry_resident =
+    residency_manager()->IsResident(resident.residency_id);
+  bool textures_resident = true;
+  for (eastl::vector<uint32_t>::const_iterator i =
+         resident.texture_ids.begin();
+       i != resident.texture_ids.end();
+       ++i) {
+    residency_manager()->MarkUsed(*i);
+    textures_resident = textures_resident &&
+      residency_manager()->IsResident(*i);
+  }
+
+  if ((!geometry_resident || !textures_resident) && !resident.reloading) {
+    ReloadModel(model, resident);
+  }
+
+  return geometry_resident;
+}
+
+bool ModelManager::IsModelResident(const Model &model) const {
+  ResidentModelMap::const_iterator found = resident_models_.find(&model);
+  return found == resident_models_.end() ||
+    residency_manager()->IsResident(found->second->residency_id);
+}
+
+void ModelManager::EvictModel(
+    const VulkanDevice &device,
+    const eastl::string &name) {
+  NameModelMap::iterator found = models_.find(name);
+  if (found == models_.end()) {
+    return;
+  }
+
+  GeometryRangeId range = found->second->ReleaseGeometry();
+  residency_manager()->RetireGeometry(found->second->geometry_arena(), range);
+}
+
+void ModelManager::ReloadModel(const Model &model, ResidentModel &resident) {
+  // Find the name the model was loaded with
+  NameModelMap::iterator found = models_.begin();
+  while (found != models_.end() && found->second.get() != &model) {
+    ++found;
+  }
+  VKS_ASSERT(found != models_.end(), "Reloading an unknown model!");
+
+  reloads_.push_back(eastl::make_unique<AsyncModelLoad>());
+  AsyncModelLoad *load = reloads_.back().get();
+  load->model = found->second.get();
+  load->reload = &resident;
+  load->import = eastl::make_unique<ModelImport>(
+      found->first,
+      resident.material_dir,
+      resident.post_process_steps,
+      resident.vertex_setup,
+      sets_desc_pool_);
+  resident.reloading = true;
+  worker_pool()->Enqueue([load]() {
+    ImportOtherModel(*load->import);
+    load->imported.store(true);
+  });
+}
+
+ModelLoadHandle ModelManager::LoadOtherModelAsync(
+    const eastl::string &filename,
+    const eastl::string &material_dir,
+    uint32_t assimp_post_process_steps,
+    const VertexSetup &vertex_setup) {
+  async_loads_.push_back(eastl::make_unique<AsyncModelLoad>());
+  AsyncModelLoad *load = async_loads_.back().get();
+  ModelLoadHandle handle = SCAST_U32(async_loads_.size()) - 1U;
+
+  if (SCAST_U32(models_.count(filename)) != 0U) {
+    load->imported = true;
+    load->state = ModelLoadState::READY;
+    load->model = models_[filename].get();
+    return handle;
+  }
+
+  load->import = eastl::make_unique<ModelImport>(
+      filename,
+      material_dir,
+      assimp_post_process_steps,
+      vertex_setup,
+      sets_desc_pool_);
+  worker_pool()->Enqueue([load]() {
+    ImportOtherModel(*load->import);
+    load->imported.store(true);
+  });
+
+  return handle;
+}
+
+bool ModelManager::FinishImport(
+    const VulkanDevice &device,
+    AsyncModelLoad &load) {
+  if (load.state != ModelLoadState::IMPORTING || !load.imported.load()) {
+    return false;
+  }
+
+  if (load.reload != nullptr) {
+    RestoreImportedModel(device, *load.import, *load.model, *load.reload);
+  }
+  else {
+    CreateImportedModel(device, *load.import, &load.model);
+  }
+  // Everything the model needs has been copied to staging memory
+  load.import.reset();
+  load.state = ModelLoadState::UPLOADING;
+  return true;
+}
+
+void ModelManager::UpdateUpload(
+    const VulkanDevice &device,
+    AsyncModelLoad &load,
+    UploadTicket ticket) {
+  if (load.state != ModelLoadState::UPLOADING) {
+    return;
+  }
+
+  if (!load.flushed) {
+    load.ticket = ticket;
+    load.flushed = true;
+  }
+  if (!upload_manager()->IsTicketComplete(device, load.ticket)) {
+    return;
+  }
+
+  load.state = ModelLoadState::READY;
+  if (load.reload != nullptr) {
+    residency_manager()->SetResident(load.reload->residency_id);
+    for (eastl::vector<uint32_t>::const_iterator i =
+           load.reload->texture_ids.begin();
+         i != load.reload->texture_ids.end();
+         ++i) {
+      residency_manager()->SetResident(*i);
+    }
+    load.reload->reloading = false;
+  }
+}
+
+void ModelManager::UpdateAsyncLoads(const VulkanDevice &device) {
+  bool created = false;
+  for (AsyncModelLoadList::iterator i = async_loads_.begin();
+       i != async_loads_.end();
+       ++i) {
+    created = FinishImport(device, **i) || created;
+  }
+  // Creating a model the app asked for happens once; bringing evicted ones
+  // back is part of the steady state, and is checked
+  if (created) {
+    SkipFrameAllocationsCheck();
+  }
+  for (AsyncModelLoadList::iterator i = reloads_.begin();
+       i != reloads_.end();
+       ++i) {
+    created = FinishImport(device, **i) || created;
+  }
+
+  // The uploads of all the models created this frame go in one batch
+  UploadTicket ticket = 0U;
+  if (created) {
+    ticket = upload_manager()->Flush(device);
+  }
+
+  for (AsyncModelLoadList::iterator i = async_loads_.begin();
+       i != async_loads_.end();
+       ++i) {
+    UpdateUpload(device, **i, ticket);
+  }
+  AsyncModelLoadList::iterator i = reloads_.begin();
+  while (i != reloads_.end()) {
+    UpdateUpload(device, **i, ticket);
+    if ((*i)->state == ModelLoadState::READY) {
+      i = reloads_.erase(i);
+    }
+    else {
+      ++i;
+    }
+  }
+}
+
+ModelLoadState ModelManager::GetLoadState(ModelLoadHandle handle) const {
+  VKS_ASSERT(handle < async_loads_.size(), "Invalid model load handle!");
+  return async_loads_[handle]->state;
+}
+
+Model *ModelManager::GetLoadedModel(ModelLoadHandle handle) const {
+  if (GetLoadState(handle) != ModelLoadState::READY) {
+    return nullptr;
+  }
+
+  return async_loads_[handle]->model;
+}
+
+void ModelManager::CreateMaterialInstances(
+    const VulkanDevice &device,
+    const eastl::string &material_dir,
+    const eastl::vector<MeshCacheMaterial> &materials) const {
+  for (eastl::vector<MeshCacheMaterial>::const_iterator i = materials.begin();
+       i != materials.end();
+       ++i) {
+    MaterialInstanceBuilder mat_builder(
+        i->name,
+        material_dir,
+        aniso_sampler_);
+    mat_builder.AddConstants(i->consts);
+    for (uint32_t t = 0U; t < SCAST_U32(i->textures.size()); ++t) {
+      mat_builder.AddTexture(i->textures[t]);
+    }
 
     material_manager()->CreateMaterialInstance(device, mat_builder);
   }
 }
 
+void ModelManager::WaitForImports(const AsyncModelLoadList &loads) const {
+  for (AsyncModelLoadList::const_iterator i = loads.begin();
+       i != loads.end();
+       ++i) {
+    while (!(*i)->imported.load()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
 void ModelManager::Shutdown(const VulkanDevice &device) {
+  // The imports still running write into their loads
+  WaitForImports(async_loads_);
+  WaitForImports(reloads_);
+  async_loads_.clear();
+  reloads_.clear();
+  // The buckets are freed too, while the pool is still there
+  resident_models_.clear(true);
+
   NameModelMap::iterator iter;
   for (iter = models_.begin(); iter != models_.end(); iter ++) {
     iter->second->Shutdown(device);
   }
+
+  for (eastl::vector<eastl::unique_ptr<GeometryArena>>::iterator i =
+         geometry_arenas_.begin();
+       i != geometry_arenas_.end();
+       ++i) {
+    (*i)->Shutdown(device);
+  }
+  geometry_arenas_.clear();
+}
+
+GeometryArena *ModelManager::GetGeometryArena(
+    const VulkanDevice &device,
+    const VertexSetup &vertex_setup,
+    uint32_t vertices_count,
+    VkDeviceSize index_bytes) {
+  for (eastl::vector<eastl::unique_ptr<GeometryArena>>::iterator i =
+         geometry_arenas_.begin();
+       i != geometry_arenas_.end();
+       ++i) {
+    if ((*i)->IsCompatible(vertex_setup)) {
+      return i->get();
+    }
+  }
+
+  geometry_arenas_.push_back(eastl::make_unique<GeometryArena>());
+  geometry_arenas_.back()->Init(device, vertex_setup, vertices_count,
+                                index_bytes);
+  return geometry_arenas_.back().get();
+}
+
+void ModelManager::CompactGeometry(const VulkanDevice &device) {
+  for (eastl::vector<eastl::unique_ptr<GeometryArena>>::iterator i =
+         geometry_arenas_.begin();
+       i != geometry_arenas_.end();
+       ++i) {
+    (*i)->Compact(device);
+  }
+}
+
+uint32_t ModelManager::GetGeometryGeneration() const {
+  // Arenas are only ever added, so the sum changes whenever one of them does
+  uint32_t generation = SCAST_U32(geometry_arenas_.size());
+  for (eastl::vector<eastl::unique_ptr<GeometryArena>>::const_iterator i =
+         geometry_arenas_.begin();
+       i != geometry_arenas_.end();
+       ++i) {
+    generation += (*i)->generation();
+  }
+
+  return generation;
 }
 
 void ModelManager::GetMeshesModelMatricesBuffer(
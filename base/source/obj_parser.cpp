@@ -0,0 +1,838 @@
+#include <obj_parser.h>
+#include <mapped_file.h>
+#include <base_system.h>
+#include <worker_pool.h>
+#include <vulkan_tools.h>
+#include <logger.hpp>
+#include <EASTL/hash_map.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+namespace vks {
+
+// Chunks smaller than this aren't worth a task of their own
+static const size_t kObjMinChunkSize = 1U << 20U;
+// Chunks per thread, so that uneven chunks balance out
+static const uint32_t kObjChunksPerThread = 4U;
+
+typedef eastl::hash_map<eastl::string, int32_t> ObjMaterialMap;
+
+enum class ObjEventType {
+  USE_MATERIAL,
+  MATERIAL_LIBRARY,
+  GROUP,
+  OBJECT
+}; // enum class ObjEventType
+
+// Statement which changes how the faces after it are grouped
+struct ObjChunkEvent {
+  ObjEventType type;
+  // Faces and triangulated corners of the chunk which precede it
+  uint32_t faces_count;
+  uint32_t corners_count;
+  eastl::string name;
+}; // struct ObjChunkEvent
+
+// What a run of whole lines of the file contains
+struct ObjChunk {
+  eastl::vector<float> positions;
+  eastl::vector<float> normals;
+  eastl::vector<float> texcoords;
+  // Corners of the triangulated faces
+  eastl::vector<ObjIndex> corners;
+  // Negative indices resolve against the attributes of the chunk, so the
+  // ones of preceding chunks have to be added to them; each entry is a
+  // corner times 3 plus the attribute, as ordered in ObjIndex
+  eastl::vector<uint32_t> relative_indices;
+  // Faces including those with less than 3 corners, which still count as
+  // faces when grouping them
+  uint32_t faces_count;
+  eastl::vector<ObjChunkEvent> events;
+}; // struct ObjChunk
+
+static inline bool IsSpace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+static inline bool IsDigit(char c) {
+  return static_cast<uint32_t>(c - '0') < 10U;
+}
+
+// Whether the character at p is a space; the end of the line isn't
+static inline bool IsSpaceAt(const char *p, const char *end) {
+  return p < end && IsSpace(*p);
+}
+
+static inline const char *SkipSpaces(const char *p, const char *end) {
+  while (p < end && IsSpace(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+static inline const char *FindTokenEnd(const char *p, const char *end) {
+  while (p < end && !IsSpace(*p) && *p != '\r') {
+    ++p;
+  }
+  return p;
+}
+
+// Whether the line starts with the keyword followed by a space
+static inline bool MatchKeyword(
+    const char *p,
+    const char *end,
+    const char *keyword,
+    size_t length) {
+  return SCAST_U32(end - p) > length &&
+    memcmp(p, keyword, length) == 0 &&
+    IsSpace(p[length]);
+}
+
+// First whitespace separated word, as read by sscanf's %s
+static eastl::string ReadWord(const char *p, const char *end) {
+  while (p < end && isspace(static_cast<unsigned char>(*p))) {
+    ++p;
+  }
+  const char *word_end = p;
+  while (word_end < end && !isspace(static_cast<unsigned char>(*word_end))) {
+    ++word_end;
+  }
+  return eastl::string(p, word_end);
+}
+
+// Integer at p, as read by atoi
+static int32_t ReadInt(const char *p, const char *end) {
+  while (p < end && isspace(static_cast<unsigned char>(*p))) {
+    ++p;
+  }
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = *p == '-';
+    ++p;
+  }
+  int64_t value = 0;
+  while (p < end && IsDigit(*p)) {
+    value = value * 10 + (*p - '0');
+    ++p;
+  }
+  return static_cast<int32_t>(negative ? -value : value);
+}
+
+/**
+ * @brief Parse a decimal number at [s, s_end), ignoring anything after it,
+ *   without the locale and allocation overhead of strtod. The arithmetic is
+ *   the one of tinyobjloader, so that the parsed values match it bit for bit.
+ *
+ * @return False if there is no number at s
+ */
+static bool TryParseDouble(const char *s, const char *s_end, double *result) {
+  static const double kPowLut[] = {
+    1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001
+  };
+  static const int32_t kPowLutSize =
+    static_cast<int32_t>(sizeof(kPowLut) / sizeof(kPowLut[0U]));
+
+  if (s >= s_end) {
+    return false;
+  }
+
+  const char *curr = s;
+  bool negative = false;
+  if (*curr == '+' || *curr == '-') {
+    negative = *curr == '-';
+    ++curr;
+  } else if (!IsDigit(*curr)) {
+    return false;
+  }
+
+  double mantissa = 0.0;
+  int32_t read = 0;
+  while (curr != s_end && IsDigit(*curr)) {
+    mantissa *= 10;
+    mantissa += static_cast<int32_t>(*curr - '0');
+    ++curr;
+    ++read;
+  }
+  if (read == 0) {
+    return false;
+  }
+
+  int32_t exponent = 0;
+  if (curr != s_end && *curr == '.') {
+    ++curr;
+    read = 1;
+    while (curr != s_end && IsDigit(*curr)) {
+      mantissa += static_cast<int32_t>(*curr - '0') *
+        (read < kPowLutSize ? kPowLut[read] : pow(10.0, -read));
+      ++read;
+      ++curr;
+    }
+  }
+
+  if (curr != s_end && (*curr == 'e' || *curr == 'E')) {
+    ++curr;
+    bool negative_exponent = false;
+    if (curr != s_end && (*curr == '+' || *curr == '-')) {
+      negative_exponent = *curr == '-';
+      ++curr;
+    } else if (curr == s_end || !IsDigit(*curr)) {
+      return false;
+    }
+
+    read = 0;
+    while (curr != s_end && IsDigit(*curr)) {
+      exponent = exponent * 10 + static_cast<int32_t>(*curr - '0');
+      ++curr;
+      ++read;
+    }
+    if (read == 0) {
+      return false;
+    }
+    if (negative_exponent) {
+      exponent = -exponent;
+    }
+  }
+
+  double value = exponent != 0 ?
+    ldexp(mantissa * pow(5.0, exponent), exponent) :
+    mantissa;
+  *result = negative ? -value : value;
+  return true;
+}
+
+// Float in the next token of the line, or the default value if it isn't a
+// number; moves past the token
+static inline float ParseFloat(
+    const char **p,
+    const char *end,
+    double default_value = 0.0) {
+  const char *token = SkipSpaces(*p, end);
+  const char *token_end = FindTokenEnd(token, end);
+  double value = default_value;
+  TryParseDouble(token, token_end, &value);
+  *p = token_end;
+  return static_cast<float>(value);
+}
+
+static inline void ParseFloats(
+    const char *p,
+    const char *end,
+    uint32_t count,
+    eastl::vector<float> &values) {
+  for (uint32_t i = 0U; i < count; ++i) {
+    values.push_back(ParseFloat(&p, end));
+  }
+}
+
+static inline const char *FindIndexEnd(const char *p, const char *end) {
+  while (p < end && *p != '/' && !IsSpace(*p) && *p != '\r') {
+    ++p;
+  }
+  return p;
+}
+
+// Zero based index of an attribute, with negative indices counting back
+// from the attributes read so far; relative is set for those
+static inline int32_t FixIndex(int32_t idx, int32_t count, bool *relative) {
+  *relative = idx < 0;
+  if (idx > 0) {
+    return idx - 1;
+  }
+  if (idx == 0) {
+    return 0;
+  }
+  return count + idx;
+}
+
+/**
+ * @brief Parse a face corner in any of the v, v/vt, v//vn or v/vt/vn forms.
+ *
+ * @param p Start of the corner, moved past it
+ * @param end End of the line
+ * @param chunk Chunk whose attributes relative indices resolve against
+ * @param relative_mask Set to which attributes, as bits ordered like
+ *   ObjIndex, are relative
+ */
+static ObjIndex ParseCorner(
+    const char **p,
+    const char *end,
+    const ObjChunk &chunk,
+    uint32_t *relative_mask) {
+  ObjIndex corner = {-1, -1, -1};
+  *relative_mask = 0U;
+  bool relative = false;
+
+  const char *token = *p;
+  corner.vertex_index = FixIndex(
+      ReadInt(token, end),
+      static_cast<int32_t>(chunk.positions.size() / 3U),
+      &relative);
+  *relative_mask |= relative ? 1U : 0U;
+  token = FindIndexEnd(token, end);
+  if (token == end || *token != '/') {
+    *p = token;
+    return corner;
+  }
+  ++token;
+
+  if (token == end || *token != '/') {
+    corner.texcoord_index = FixIndex(
+        ReadInt(token, end),
+        static_cast<int32_t>(chunk.texcoords.size() / 2U),
+        &relative);
+    *relative_mask |= relative ? 4U : 0U;
+    token = FindIndexEnd(token, end);
+    if (token == end || *token != '/') {
+      *p = token;
+      return corner;
+    }
+  }
+  ++token;
+
+  corner.normal_index = FixIndex(
+      ReadInt(token, end),
+      static_cast<int32_t>(chunk.normals.size() / 3U),
+      &relative);
+  *relative_mask |= relative ? 2U : 0U;
+  *p = FindIndexEnd(token, end);
+  return corner;
+}
+
+static inline void AddCorner(
+    const ObjIndex &corner,
+    uint32_t relative_mask,
+    ObjChunk *chunk) {
+  uint32_t corner_idx = SCAST_U32(chunk->corners.size());
+  for (uint32_t a = 0U; a < 3U; ++a) {
+    if ((relative_mask & (1U << a)) != 0U) {
+      chunk->relative_indices.push_back(corner_idx * 3U + a);
+    }
+  }
+  chunk->corners.push_back(corner);
+}
+
+// Triangulate a face as a fan, as its corners are read, and add it to the
+// chunk
+static void ParseFace(const char *p, const char *end, ObjChunk *chunk) {
+  ObjIndex first_corner, previous_corner;
+  uint32_t first_mask = 0U;
+  uint32_t previous_mask = 0U;
+  uint32_t corners_count = 0U;
+  p = SkipSpaces(p, end);
+  while (p < end) {
+    uint32_t relative_mask;
+    ObjIndex corner = ParseCorner(&p, end, *chunk, &relative_mask);
+    if (corners_count == 0U) {
+      first_corner = corner;
+      first_mask = relative_mask;
+    } else if (corners_count >= 2U) {
+      AddCorner(first_corner, first_mask, chunk);
+      AddCorner(previous_corner, previous_mask, chunk);
+      AddCorner(corner, relative_mask, chunk);
+    }
+    previous_corner = corner;
+    previous_mask = relative_mask;
+    ++corners_count;
+
+    while (p < end && (IsSpace(*p) || *p == '\r')) {
+      ++p;
+    }
+  }
+  ++chunk->faces_count;
+}
+
+static void AddEvent(
+    ObjEventType type,
+    const eastl::string &name,
+    ObjChunk *chunk) {
+  ObjChunkEvent event;
+  event.type = type;
+  event.faces_count = chunk->faces_count;
+  event.corners_count = SCAST_U32(chunk->corners.size());
+  event.name = name;
+  chunk->events.push_back(event);
+}
+
+// End of the line starting at p; a line ends at a LF, a CR or a CR LF
+static inline const char *FindLineEnd(const char *p, const char *end) {
+  const char *line_end = static_cast<const char *>(
+      memchr(p, '\n', static_cast<size_t>(end - p)));
+  if (line_end == nullptr) {
+    line_end = end;
+  }
+  const char *cr = static_cast<const char *>(
+      memchr(p, '\r', static_cast<size_t>(line_end - p)));
+  return cr != nullptr ? cr : line_end;
+}
+
+static void ParseObjLine(const char *p, const char *end, ObjChunk *chunk) {
+  p = SkipSpaces(p, end);
+  if (p == end || *p == '#') {
+    return;
+  }
+
+  if (p[0U] == 'v' && IsSpaceAt(p + 1U, end)) {
+    ParseFloats(p + 2U, end, 3U, chunk->positions);
+  } else if (MatchKeyword(p, end, "vn", 2U)) {
+    ParseFloats(p + 3U, end, 3U, chunk->normals);
+  } else if (MatchKeyword(p, end, "vt", 2U)) {
+    ParseFloats(p + 3U, end, 2U, chunk->texcoords);
+  } else if (p[0U] == 'f' && IsSpaceAt(p + 1U, end)) {
+    ParseFace(p + 2U, end, chunk);
+  } else if (MatchKeyword(p, end, "usemtl", 6U)) {
+    AddEvent(ObjEventType::USE_MATERIAL, ReadWord(p + 7U, end), chunk);
+  } else if (MatchKeyword(p, end, "mtllib", 6U)) {
+    AddEvent(ObjEventType::MATERIAL_LIBRARY, eastl::string(p + 7U, end),
+             chunk);
+  } else if (p[0U] == 'g' && IsSpaceAt(p + 1U, end)) {
+    // The name is the first one after the keyword
+    const char *name = SkipSpaces(p + 1U, end);
+    AddEvent(ObjEventType::GROUP,
+             eastl::string(name, FindTokenEnd(name, end)),
+             chunk);
+  } else if (p[0U] == 'o' && IsSpaceAt(p + 1U, end)) {
+    AddEvent(ObjEventType::OBJECT, ReadWord(p + 2U, end), chunk);
+  }
+}
+
+static void ParseObjChunk(const char *p, const char *end, ObjChunk *chunk) {
+  chunk->faces_count = 0U;
+  while (p < end) {
+    const char *line_end = FindLineEnd(p, end);
+    ParseObjLine(p, line_end, chunk);
+    p = line_end < end ? line_end + 1U : end;
+  }
+}
+
+// Options of MTL texture statements, which come before the texture name,
+// and how many values each takes
+struct MtlTextureOption {
+  const char *name;
+  size_t length;
+  uint32_t values_count;
+}; // struct MtlTextureOption
+
+static const MtlTextureOption kMtlTextureOptions[] = {
+  {"-blendu", 7U, 1U},
+  {"-blendv", 7U, 1U},
+  {"-clamp", 6U, 1U},
+  {"-boost", 6U, 1U},
+  {"-bm", 3U, 1U},
+  {"-o", 2U, 3U},
+  {"-s", 2U, 3U},
+  {"-t", 2U, 3U},
+  {"-type", 5U, 1U},
+  {"-imfchan", 8U, 1U},
+  {"-mm", 3U, 2U}
+};
+
+// Name of the texture of a texture statement, skipping its options; texname
+// is left untouched if there is none
+static void ParseTextureName(
+    const char *p,
+    const char *end,
+    eastl::string *texname) {
+  static const uint32_t kOptionsCount = SCAST_U32(
+      sizeof(kMtlTextureOptions) / sizeof(kMtlTextureOptions[0U]));
+
+  while (p < end) {
+    const MtlTextureOption *option = nullptr;
+    for (uint32_t o = 0U; o < kOptionsCount; ++o) {
+      if (MatchKeyword(p, end, kMtlTextureOptions[o].name,
+                       kMtlTextureOptions[o].length)) {
+        option = &kMtlTextureOptions[o];
+        break;
+      }
+    }
+
+    if (option != nullptr) {
+      p += option->length;
+      for (uint32_t v = 0U; v < option->values_count; ++v) {
+        p = FindTokenEnd(SkipSpaces(p, end), end);
+      }
+    } else {
+      // Anything else is taken as the name, the last one wins
+      p = SkipSpaces(p, end);
+      const char *name_end = FindTokenEnd(p, end);
+      *texname = eastl::string(p, name_end);
+      p = SkipSpaces(name_end, end);
+    }
+  }
+}
+
+static void InitMaterial(ObjMaterial *material) {
+  material->name.clear();
+  for (uint32_t c = 0U; c < 3U; ++c) {
+    material->ambient[c] = 0.f;
+    material->diffuse[c] = 0.f;
+    material->specular[c] = 0.f;
+    material->emission[c] = 0.f;
+  }
+  material->shininess = 1.f;
+  material->dissolve = 1.f;
+  material->ambient_texname.clear();
+  material->diffuse_texname.clear();
+  material->specular_texname.clear();
+  material->specular_highlight_texname.clear();
+  material->bump_texname.clear();
+  material->alpha_texname.clear();
+  material->displacement_texname.clear();
+}
+
+static inline void ParseColour(const char *p, const char *end, float *colour) {
+  for (uint32_t c = 0U; c < 3U; ++c) {
+    colour[c] = ParseFloat(&p, end);
+  }
+}
+
+static void ParseMtlLine(
+    const char *p,
+    const char *end,
+    ObjMaterial *material,
+    eastl::vector<ObjMaterial> &materials,
+    ObjMaterialMap &material_map) {
+  while (end > p && IsSpace(end[-1])) {
+    --end;
+  }
+  p = SkipSpaces(p, end);
+  if (p == end || *p == '#') {
+    return;
+  }
+
+  if (MatchKeyword(p, end, "newmtl", 6U)) {
+    if (!material->name.empty()) {
+      material_map.insert(eastl::make_pair(
+          material->name, static_cast<int32_t>(materials.size())));
+      materials.push_back(*material);
+    }
+    InitMaterial(material);
+    material->name = ReadWord(p + 7U, end);
+  } else if (MatchKeyword(p, end, "Ka", 2U)) {
+    ParseColour(p + 2U, end, material->ambient);
+  } else if (MatchKeyword(p, end, "Kd", 2U)) {
+    ParseColour(p + 2U, end, material->diffuse);
+  } else if (MatchKeyword(p, end, "Ks", 2U)) {
+    ParseColour(p + 2U, end, material->specular);
+  } else if (MatchKeyword(p, end, "Ke", 2U)) {
+    ParseColour(p + 2U, end, material->emission);
+  } else if (MatchKeyword(p, end, "Ns", 2U)) {
+    p += 2U;
+    material->shininess = ParseFloat(&p, end);
+  } else if (MatchKeyword(p, end, "d", 1U)) {
+    p += 1U;
+    material->dissolve = ParseFloat(&p, end);
+  } else if (MatchKeyword(p, end, "Tr", 2U)) {
+    // Transparency is the inverse of dissolve
+    p += 2U;
+    material->dissolve = 1.f - ParseFloat(&p, end);
+  } else if (MatchKeyword(p, end, "map_Ka", 6U)) {
+    ParseTextureName(p + 7U, end, &material->ambient_texname);
+  } else if (MatchKeyword(p, end, "map_Kd", 6U)) {
+    ParseTextureName(p + 7U, end, &material->diffuse_texname);
+  } else if (MatchKeyword(p, end, "map_Ks", 6U)) {
+    ParseTextureName(p + 7U, end, &material->specular_texname);
+  } else if (MatchKeyword(p, end, "map_Ns", 6U)) {
+    ParseTextureName(p + 7U, end, &material->specular_highlight_texname);
+  } else if (MatchKeyword(p, end, "map_bump", 8U)) {
+    ParseTextureName(p + 9U, end, &material->bump_texname);
+  } else if (MatchKeyword(p, end, "bump", 4U)) {
+    ParseTextureName(p + 5U, end, &material->bump_texname);
+  } else if (MatchKeyword(p, end, "map_d", 5U)) {
+    // Without a name, the whole statement is kept as one
+    material->alpha_texname = eastl::string(p + 6U, end);
+    ParseTextureName(p + 6U, end, &material->alpha_texname);
+  } else if (MatchKeyword(p, end, "disp", 4U)) {
+    ParseTextureName(p + 5U, end, &material->displacement_texname);
+  }
+}
+
+// Append the materials of an MTL library; returns false if it can't be read
+static bool ParseMtl(
+    const eastl::string &filename,
+    eastl::vector<ObjMaterial> &materials,
+    ObjMaterialMap &material_map) {
+  MappedFile file;
+  if (!file.Open(filename)) {
+    return false;
+  }
+
+  // Statements before the first newmtl go to an unnamed material, which is
+  // only kept if the library has no newmtl at all
+  ObjMaterial material;
+  InitMaterial(&material);
+
+  const char *p = reinterpret_cast<const char *>(file.data());
+  const char *end = p + file.size();
+  while (p < end) {
+    const char *line_end = FindLineEnd(p, end);
+    ParseMtlLine(p, line_end, &material, materials, material_map);
+    p = line_end < end ? line_end + 1U : end;
+  }
+
+  material_map.insert(eastl::make_pair(
+      material.name, static_cast<int32_t>(materials.size())));
+  materials.push_back(material);
+
+  return true;
+}
+
+// Load the first of the space separated libraries of an mtllib statement
+// which can be read
+static void LoadMaterialLibrary(
+    const eastl::string &filenames,
+    const eastl::string &material_dir,
+    eastl::vector<ObjMaterial> &materials,
+    ObjMaterialMap &material_map) {
+  size_t begin = 0U;
+  while (begin < filenames.size()) {
+    size_t end = filenames.find(' ', begin);
+    if (end == eastl::string::npos) {
+      end = filenames.size();
+    }
+    if (end > begin) {
+      eastl::string filename =
+        material_dir + filenames.substr(begin, end - begin);
+      if (ParseMtl(filename, materials, material_map)) {
+        return;
+      }
+      ELOG_WARN("Material file " << filename.c_str() << " not found");
+    }
+    begin = end + 1U;
+  }
+
+  ELOG_WARN("Couldn't load any material library of " << filenames.c_str());
+}
+
+/**
+ * @brief Groups faces into shapes as the statements between them dictate;
+ *   chunks are fed to it in file order.
+ */
+class ObjShapeBuilder {
+ public:
+  ObjShapeBuilder(const eastl::string &material_dir, ObjScene *scene)
+      : material_dir_(material_dir),
+        scene_(scene),
+        material_map_(),
+        material_id_(-1),
+        name_(),
+        shape_(),
+        pending_corners_(),
+        pending_faces_count_(0U) {}
+
+  void AddChunk(const ObjChunk &chunk) {
+    uint32_t faces_count = 0U;
+    uint32_t corners_count = 0U;
+    for (const ObjChunkEvent &event : chunk.events) {
+      AddFaces(chunk, faces_count, event.faces_count, corners_count,
+               event.corners_count);
+      faces_count = event.faces_count;
+      corners_count = event.corners_count;
+      ProcessEvent(event);
+    }
+    AddFaces(chunk, faces_count, chunk.faces_count, corners_count,
+             SCAST_U32(chunk.corners.size()));
+  }
+
+  void Finish() {
+    // A material change on the last line leaves faces in the shape only
+    if (FlushFaces() || !shape_.indices.empty()) {
+      scene_->shapes.push_back(eastl::move(shape_));
+    }
+    shape_ = ObjShape();
+  }
+
+ private:
+  struct CornersRange {
+    const ObjIndex *begin;
+    const ObjIndex *end;
+  }; // struct CornersRange
+
+  void AddFaces(
+      const ObjChunk &chunk,
+      uint32_t faces_begin,
+      uint32_t faces_end,
+      uint32_t corners_begin,
+      uint32_t corners_end) {
+    pending_faces_count_ += faces_end - faces_begin;
+    if (corners_end > corners_begin) {
+      CornersRange range = {
+        chunk.corners.data() + corners_begin,
+        chunk.corners.data() + corners_end
+      };
+      pending_corners_.push_back(range);
+    }
+  }
+
+  // Move the faces since the last statement into the current shape, with
+  // the current material; returns false if there were none
+  bool FlushFaces() {
+    if (pending_faces_count_ == 0U) {
+      return false;
+    }
+
+    for (const CornersRange &range : pending_corners_) {
+      shape_.indices.insert(shape_.indices.end(), range.begin, range.end);
+      shape_.material_ids.insert(shape_.material_ids.end(),
+                                 SCAST_U32(range.end - range.begin) / 3U,
+                                 material_id_);
+    }
+    shape_.name = name_;
+    pending_corners_.clear();
+    pending_faces_count_ = 0U;
+    return true;
+  }
+
+  void ProcessEvent(const ObjChunkEvent &event) {
+    switch (event.type) {
+      case ObjEventType::USE_MATERIAL: {
+        ObjMaterialMap::const_iterator found =
+          material_map_.find(event.name);
+        int32_t material_id =
+          found != material_map_.end() ? found->second : -1;
+        // Faces with different materials share the shape
+        if (material_id != material_id_) {
+          FlushFaces();
+          material_id_ = material_id;
+        }
+        break;
+      }
+      case ObjEventType::MATERIAL_LIBRARY: {
+        LoadMaterialLibrary(event.name, material_dir_, scene_->materials,
+                            material_map_);
+        break;
+      }
+      case ObjEventType::GROUP:
+      case ObjEventType::OBJECT: {
+        if (FlushFaces()) {
+          scene_->shapes.push_back(eastl::move(shape_));
+        }
+        // Faces moved to the shape by a material change are dropped if
+        // none follow it, as tinyobjloader does
+        shape_ = ObjShape();
+        name_ = event.name;
+        break;
+      }
+    }
+  }
+
+  eastl::string material_dir_;
+  ObjScene *scene_;
+  ObjMaterialMap material_map_;
+  int32_t material_id_;
+  // Name of the current group or object
+  eastl::string name_;
+  ObjShape shape_;
+  // Faces read since the last statement
+  eastl::vector<CornersRange> pending_corners_;
+  uint32_t pending_faces_count_;
+
+}; // class ObjShapeBuilder
+
+// Offset the relative indices of each chunk by the attributes of the ones
+// before it, and gather the attributes of all of them
+static void MergeObjAttributes(
+    eastl::vector<ObjChunk> &chunks,
+    ObjScene *scene) {
+  uint32_t chunks_count = SCAST_U32(chunks.size());
+  eastl::vector<uint32_t> positions_offsets(chunks_count + 1U, 0U);
+  eastl::vector<uint32_t> normals_offsets(chunks_count + 1U, 0U);
+  eastl::vector<uint32_t> texcoords_offsets(chunks_count + 1U, 0U);
+  for (uint32_t c = 0U; c < chunks_count; ++c) {
+    positions_offsets[c + 1U] =
+      positions_offsets[c] + SCAST_U32(chunks[c].positions.size());
+    normals_offsets[c + 1U] =
+      normals_offsets[c] + SCAST_U32(chunks[c].normals.size());
+    texcoords_offsets[c + 1U] =
+      texcoords_offsets[c] + SCAST_U32(chunks[c].texcoords.size());
+  }
+  scene->positions.resize(positions_offsets[chunks_count]);
+  scene->normals.resize(normals_offsets[chunks_count]);
+  scene->texcoords.resize(texcoords_offsets[chunks_count]);
+
+  worker_pool()->ParallelFor(
+      chunks_count,
+      1U,
+      [&](uint32_t begin, uint32_t end) {
+    for (uint32_t c = begin; c < end; ++c) {
+      ObjChunk &chunk = chunks[c];
+      const int32_t offsets[3U] = {
+        static_cast<int32_t>(positions_offsets[c] / 3U),
+        static_cast<int32_t>(normals_offsets[c] / 3U),
+        static_cast<int32_t>(texcoords_offsets[c] / 2U)
+      };
+      for (uint32_t r : chunk.relative_indices) {
+        ObjIndex &corner = chunk.corners[r / 3U];
+        switch (r % 3U) {
+          case 0U: corner.vertex_index += offsets[0U]; break;
+          case 1U: corner.normal_index += offsets[1U]; break;
+          default: corner.texcoord_index += offsets[2U]; break;
+        }
+      }
+
+      eastl::copy(chunk.positions.begin(), chunk.positions.end(),
+                  scene->positions.begin() + positions_offsets[c]);
+      eastl::copy(chunk.normals.begin(), chunk.normals.end(),
+                  scene->normals.begin() + normals_offsets[c]);
+      eastl::copy(chunk.texcoords.begin(), chunk.texcoords.end(),
+                  scene->texcoords.begin() + texcoords_offsets[c]);
+    }
+  });
+}
+
+bool ParseObj(
+    const eastl::string &filename,
+    const eastl::string &material_dir,
+    ObjScene *scene,
+    eastl::string *err) {
+  MappedFile file;
+  if (!file.Open(filename)) {
+    *err = "Cannot open file [" + filename + "]";
+    return false;
+  }
+
+  const char *data = reinterpret_cast<const char *>(file.data());
+  const char *data_end = data + file.size();
+
+  // Split the file at the line breaks after evenly spaced offsets
+  uint32_t chunks_count = SCAST_U32(std::min(
+      std::max(file.size() / kObjMinChunkSize, static_cast<size_t>(1U)),
+      static_cast<size_t>((worker_pool()->num_threads() + 1U) *
+                          kObjChunksPerThread)));
+  eastl::vector<const char *> chunk_starts(chunks_count + 1U);
+  chunk_starts[0U] = data;
+  chunk_starts[chunks_count] = data_end;
+  for (uint32_t c = 1U; c < chunks_count; ++c) {
+    const char *p = std::max(data + file.size() / chunks_count * c,
+                             chunk_starts[c - 1U]);
+    while (p < data_end && *p != '\n' && *p != '\r') {
+      ++p;
+    }
+    chunk_starts[c] = std::min(p + 1U, data_end);
+  }
+
+  eastl::vector<ObjChunk> chunks(chunks_count);
+  worker_pool()->ParallelFor(
+      chunks_count,
+      1U,
+      [&](uint32_t begin, uint32_t end) {
+    for (uint32_t c = begin; c < end; ++c) {
+      ParseObjChunk(chunk_starts[c], chunk_starts[c + 1U], &chunks[c]);
+    }
+  });
+
+  scene->shapes.clear();
+  scene->materials.clear();
+  MergeObjAttributes(chunks, scene);
+
+  ObjShapeBuilder shape_builder(material_dir, scene);
+  for (const ObjChunk &chunk : chunks) {
+    shape_builder.AddChunk(chunk);
+  }
+  shape_builder.Finish();
+
+  return true;
+}
+
+} // namespace vks
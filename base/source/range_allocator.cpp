@@ -0,0 +1,114 @@
+#include <range_allocator.h>
+#include <vulkan_tools.h>
+#include <EASTL/algorithm.h>
+
+namespace vks {
+
+RangeAllocator::RangeAllocator()
+    : free_ranges_(),
+      capacity_(0U),
+      used_(0U) {}
+
+void RangeAllocator::Reset(uint64_t capacity) {
+  free_ranges_.clear();
+  if (capacity != 0U) {
+    FreeRange range = {0U, capacity};
+    free_ranges_.push_back(range);
+  }
+  capacity_ = capacity;
+  used_ = 0U;
+}
+
+bool RangeAllocator::Allocate(
+    uint64_t size,
+    uint64_t alignment,
+    uint64_t *offset) {
+  if (size == 0U) {
+    *offset = 0U;
+    return true;
+  }
+
+  for (eastl::vector<FreeRange>::iterator i = free_ranges_.begin();
+       i != free_ranges_.end();
+       ++i) {
+    uint64_t aligned = ((i->offset + alignment - 1U) / alignment) * alignment;
+    uint64_t padding = aligned - i->offset;
+    if (padding + size > i->size) {
+      continue;
+    }
+
+    // The padding stays free in front of the allocation, and whatever is
+    // left after it too
+    uint64_t remainder = i->size - padding - size;
+    if (padding == 0U) {
+      i->offset += size;
+      i->size = remainder;
+      if (remainder == 0U) {
+        free_ranges_.erase(i);
+      }
+    }
+    else {
+      i->size = padding;
+      if (remainder != 0U) {
+        FreeRange after = {aligned + size, remainder};
+        free_ranges_.insert(i + 1, after);
+      }
+    }
+
+    used_ += size;
+    *offset = aligned;
+    return true;
+  }
+
+  return false;
+}
+
+void RangeAllocator::Free(uint64_t offset, uint64_t size) {
+  if (size == 0U) {
+    return;
+  }
+  VKS_ASSERT(offset + size <= capacity_, "Freeing a range out of bounds!");
+
+  eastl::vector<FreeRange>::iterator next = eastl::lower_bound(
+      free_ranges_.begin(),
+      free_ranges_.end(),
+      offset,
+      [](const FreeRange &range, uint64_t range_offset) {
+    return range.offset < range_offset;
+  });
+
+  bool merge_prev = next != free_ranges_.begin() &&
+    (next - 1)->offset + (next - 1)->size == offset;
+  bool merge_next = next != free_ranges_.end() &&
+    offset + size == next->offset;
+  if (merge_prev && merge_next) {
+    (next - 1)->size += size + next->size;
+    free_ranges_.erase(next);
+  }
+  else if (merge_prev) {
+    (next - 1)->size += size;
+  }
+  else if (merge_next) {
+    next->offset = offset;
+    next->size += size;
+  }
+  else {
+    FreeRange range = {offset, size};
+    free_ranges_.insert(next, range);
+  }
+
+  used_ -= size;
+}
+
+uint64_t RangeAllocator::GetLargestFreeRange() const {
+  uint64_t largest = 0U;
+  for (eastl::vector<FreeRange>::const_iterator i = free_ranges_.begin();
+       i != free_ranges_.end();
+       ++i) {
+    largest = eastl::max(largest, i->size);
+  }
+
+  return largest;
+}
+
+} // namespace vks
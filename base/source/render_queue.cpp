@@ -0,0 +1,148 @@
+#include <render_queue.h>
+#include <base_system.h>
+#include <vulkan_tools.h>
+#include <worker_pool.h>
+#include <cstring>
+#include <EASTL/algorithm.h>
+
+namespace vks {
+
+static const uint32_t kPipelineBits = 12U;
+static const uint32_t kFieldBits = 24U;
+static const uint64_t kFieldMask = (1ULL << kFieldBits) - 1ULL;
+static const uint32_t kPipelineShift = 2U * kFieldBits;
+static const uint32_t kPassShift = kPipelineShift + kPipelineBits;
+
+static const uint32_t kRadixBits = 8U;
+static const uint32_t kRadixSize = 1U << kRadixBits;
+static const uint32_t kKeyDigits = 64U / kRadixBits;
+// Fewer items than this per chunk aren't worth handing to another thread
+static const uint32_t kMinSortChunkSize = 4096U;
+
+RenderQueue::RenderQueue()
+    : items_(),
+      sorted_items_(),
+      histograms_() {}
+
+uint64_t RenderQueue::MakeKey(
+    DrawPassTypes pass,
+    uint32_t pipeline,
+    uint32_t material,
+    float depth) {
+  VKS_ASSERT(pipeline < (1U << kPipelineBits),
+             "Too many pipelines for a sort key!");
+
+  // Non-negative floats order as their bits do, of which the 24 most
+  // significant are kept; negative depths and NaNs go first
+  float clamped_depth = depth > 0.f ? depth : 0.f;
+  uint32_t depth_bits = 0U;
+  memcpy(&depth_bits, &clamped_depth, sizeof(depth_bits));
+  uint64_t depth_field = depth_bits >> (31U - kFieldBits);
+  uint64_t material_field = eastl::min(static_cast<uint64_t>(material),
+                                       kFieldMask);
+
+  uint64_t key = (static_cast<uint64_t>(pass) << kPassShift) |
+    (static_cast<uint64_t>(pipeline) << kPipelineShift);
+  if (pass == DrawPassTypes::DEPTH_PREPASS) {
+    return key | (depth_field << kFieldBits) | material_field;
+  }
+  return key | (material_field << kFieldBits) | depth_field;
+}
+
+uint64_t RenderQueue::MakeLastKey(DrawPassTypes pass, uint32_t pipeline) {
+  return (static_cast<uint64_t>(pass) << kPassShift) |
+    (static_cast<uint64_t>(pipeline) << kPipelineShift) |
+    ((1ULL << kPipelineShift) - 1ULL);
+}
+
+void RenderQueue::Clear() {
+  items_.clear();
+}
+
+void RenderQueue::Push(uint64_t key, uint32_t value) {
+  RenderQueueItem item = {key, value};
+  items_.push_back(item);
+}
+
+RenderQueueItem *RenderQueue::Append(uint32_t count) {
+  uint32_t first = size();
+  items_.resize(first + count);
+  return items_.data() + first;
+}
+
+void RenderQueue::Sort() {
+  uint32_t count = size();
+  if (count <= 1U) {
+    return;
+  }
+
+  // The chunks are fixed up front, so that counting and scattering a byte
+  // see the same items in each
+  uint32_t chunks_count = eastl::min(count / kMinSortChunkSize,
+                                     worker_pool()->num_threads() + 1U);
+  chunks_count = eastl::max(chunks_count, 1U);
+  uint32_t chunk_size = (count + chunks_count - 1U) / chunks_count;
+  chunks_count = (count + chunk_size - 1U) / chunk_size;
+  sorted_items_.resize(count);
+  histograms_.resize(chunks_count * kRadixSize);
+
+  // Bytes which are the same in every key don't need a pass
+  uint64_t first_key = items_[0U].key;
+  uint64_t differing_bits = 0U;
+  for (uint32_t i = 1U; i < count; ++i) {
+    differing_bits |= items_[i].key ^ first_key;
+  }
+
+  for (uint32_t digit = 0U; digit < kKeyDigits; ++digit) {
+    uint32_t shift = digit * kRadixBits;
+    if (((differing_bits >> shift) & (kRadixSize - 1U)) == 0U) {
+      continue;
+    }
+
+    const RenderQueueItem *src = items_.data();
+    RenderQueueItem *dst = sorted_items_.data();
+    uint32_t *histograms = histograms_.data();
+    worker_pool()->ParallelFor(
+        chunks_count,
+        1U,
+        [&](uint32_t begin, uint32_t end) {
+      for (uint32_t c = begin; c < end; ++c) {
+        uint32_t *histogram = histograms + c * kRadixSize;
+        memset(histogram, 0, kRadixSize * sizeof(uint32_t));
+        uint32_t chunk_end = eastl::min((c + 1U) * chunk_size, count);
+        for (uint32_t i = c * chunk_size; i < chunk_end; ++i) {
+          ++histogram[(src[i].key >> shift) & (kRadixSize - 1U)];
+        }
+      }
+    });
+
+    // Turn the counts into where each chunk starts writing each byte value;
+    // the chunks follow each other within a value, which keeps the sort
+    // stable
+    uint32_t offset = 0U;
+    for (uint32_t v = 0U; v < kRadixSize; ++v) {
+      for (uint32_t c = 0U; c < chunks_count; ++c) {
+        uint32_t value_count = histograms[c * kRadixSize + v];
+        histograms[c * kRadixSize + v] = offset;
+        offset += value_count;
+      }
+    }
+
+    worker_pool()->ParallelFor(
+        chunks_count,
+        1U,
+        [&](uint32_t begin, uint32_t end) {
+      for (uint32_t c = begin; c < end; ++c) {
+        uint32_t *histogram = histograms + c * kRadixSize;
+        uint32_t chunk_end = eastl::min((c + 1U) * chunk_size, count);
+        for (uint32_t i = c * chunk_size; i < chunk_end; ++i) {
+          dst[histogram[(src[i].key >> shift) & (kRadixSize - 1U)]++] = src[i];
+        }
+      }
+    });
+
+    items_.swap(sorted_items_);
+  }
+}
+
+} // namespace vks
@@ -0,0 +1,246 @@
+#include <residency_manager.h>
+#include <vulkan_device.h>
+#include <vulkan_tools.h>
+#include <logger.hpp>
+#include <base_system.h>
+#include <EASTL/utility.h>
+
+namespace vks {
+
+const uint32_t kNoResidencyId = 0xFFFFFFFFU;
+const uint64_t kResidencyMinIdleFrames = 600U;
+
+// The default budget is this fraction of the largest device local heap; the
+// rest is left to render targets and per-frame data
+static const VkDeviceSize kBudgetHeapDivisor = 2U;
+// Going over the budget evicts down to this fraction below it, so that the
+// next resource loaded doesn't evict another right away
+static const VkDeviceSize kEvictionHeadroomDivisor = 8U;
+
+ResidencyManager::ResidencyManager()
+    : entries_(),
+      ids_(),
+      retiring_(),
+      retired_(),
+      budget_(0U),
+      resident_bytes_(0U),
+      frame_(0U),
+      generation_(0U),
+      over_budget_warned_(false) {
+  retiring_.fence = VK_NULL_HANDLE;
+}
+
+void ResidencyManager::Init(const VulkanDevice &device) {
+  const VkPhysicalDeviceMemoryProperties &properties =
+    device.memory_properties();
+  VkDeviceSize largest_heap = 0U;
+  for (uint32_t i = 0U; i < properties.memoryHeapCount; ++i) {
+    if ((properties.memoryHeaps[i].flags &
+         VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0U) {
+      largest_heap = eastl::max(largest_heap, properties.memoryHeaps[i].size);
+    }
+  }
+  budget_ = largest_heap / kBudgetHeapDivisor;
+
+  LOG("Residency budget: " << (budget_ >> 20U) << " MB.");
+}
+
+void ResidencyManager::Shutdown(const VulkanDevice &device) {
+  for (eastl::vector<RetiredBatch>::iterator i = retired_.begin();
+       i != retired_.end();
+       ++i) {
+    VK_CHECK_RESULT(vkWaitForFences(device.device(), 1U, &i->fence, VK_TRUE,
+                                    UINT64_MAX));
+    ReleaseBatch(device, *i);
+  }
+  retired_.clear();
+  // Whatever wasn't submitted yet is released along with the device's work
+  ReleaseBatch(device, retiring_);
+
+  entries_.clear();
+  for (uint32_t t = 0U; t < SCAST_U32(ids_.size()); ++t) {
+    ids_[t].clear();
+  }
+  resident_bytes_ = 0U;
+}
+
+uint32_t ResidencyManager::Track(
+    ResidentType type,
+    const eastl::string &name,
+    VkDeviceSize size) {
+  NameIdMap &ids = ids_[tools::ToUnderlying(type)];
+  NameIdMap::const_iterator found = ids.find(name);
+  if (found != ids.end()) {
+    return found->second;
+  }
+
+  Entry entry;
+  entry.name = name;
+  entry.type = type;
+  entry.size = size;
+  entry.last_used_frame = frame_;
+  entry.resident = true;
+  uint32_t id = SCAST_U32(entries_.size());
+  entries_.push_back(entry);
+  ids[name] = id;
+  resident_bytes_ += size;
+
+  return id;
+}
+
+uint32_t ResidencyManager::FindId(
+    ResidentType type,
+    const eastl::string &name) const {
+  const NameIdMap &ids = ids_[tools::ToUnderlying(type)];
+  NameIdMap::const_iterator found = ids.find(name);
+  return (found != ids.end()) ? found->second : kNoResidencyId;
+}
+
+void ResidencyManager::SetResident(uint32_t id) {
+  Entry &entry = entries_[id];
+  if (entry.resident) {
+    return;
+  }
+
+  entry.resident = true;
+  entry.last_used_frame = frame_;
+  resident_bytes_ += entry.size;
+  ++generation_;
+}
+
+void ResidencyManager::RetireBuffer(const VulkanBuffer &buffer) {
+  retiring_.buffers.push_back(buffer);
+}
+
+void ResidencyManager::RetireImage(eastl::unique_ptr<VulkanImage> image) {
+  retiring_.images.push_back(eastl::move(image));
+}
+
+void ResidencyManager::RetireGeometry(
+    GeometryArena *arena,
+    GeometryRangeId id) {
+  retiring_.ranges.push_back(eastl::make_pair(arena, id));
+}
+
+void ResidencyManager::BeginFrame(const VulkanDevice &device) {
+  ++frame_;
+
+  eastl::vector<RetiredBatch>::iterator i = retired_.begin();
+  while (i != retired_.end()) {
+    if (vkGetFenceStatus(device.device(), i->fence) == VK_SUCCESS) {
+      ReleaseBatch(device, *i);
+      i = retired_.erase(i);
+    }
+    else {
+      ++i;
+    }
+  }
+
+  if (resident_bytes_ > budget_) {
+    EvictLeastRecentlyUsed(device);
+  }
+  else {
+    over_budget_warned_ = false;
+  }
+
+  SubmitRetired(device);
+}
+
+void ResidencyManager::EvictLeastRecentlyUsed(const VulkanDevice &device) {
+  VkDeviceSize target_bytes = budget_ - budget_ / kEvictionHeadroomDivisor;
+  while (resident_bytes_ > target_bytes) {
+    // There are few enough resources that a scan beats keeping them ordered
+    uint32_t victim = kNoResidencyId;
+    for (uint32_t i = 0U; i < SCAST_U32(entries_.size()); ++i) {
+      const Entry &entry = entries_[i];
+      if (!entry.resident ||
+          entry.last_used_frame + kResidencyMinIdleFrames > frame_) {
+        continue;
+      }
+      if (victim == kNoResidencyId ||
+          entry.last_used_frame < entries_[victim].last_used_frame) {
+        victim = i;
+      }
+    }
+
+    if (victim == kNoResidencyId) {
+      if (resident_bytes_ > budget_ && !over_budget_warned_) {
+        ELOG_WARN("Resources in use take " << (resident_bytes_ >> 20U) <<
+                  " MB, over the residency budget of " << (budget_ >> 20U) <<
+                  " MB");
+        over_budget_warned_ = true;
+      }
+      return;
+    }
+
+    Entry &entry = entries_[victim];
+    switch (entry.type) {
+      case ResidentType::MODEL:
+        model_manager()->EvictModel(device, entry.name);
+        break;
+      case ResidentType::TEXTURE:
+        texture_manager()->EvictTexture(device, entry.name);
+        break;
+      default:
+        break;
+    }
+    entry.resident = false;
+    resident_bytes_ -= entry.size;
+    ++generation_;
+
+    LOG("Evicted " << entry.name.c_str() << ", unused for " <<
+        (frame_ - entry.last_used_frame) << " frames.");
+  }
+}
+
+void ResidencyManager::SubmitRetired(const VulkanDevice &device) {
+  if (retiring_.buffers.empty() && retiring_.images.empty() &&
+      retiring_.ranges.empty()) {
+    return;
+  }
+
+  // An empty submission signals once all the work submitted before it on
+  // the queue has completed; the evicted resources are only drawn with on
+  // the graphics queue
+  VkFenceCreateInfo fence_create_info = tools::inits::FenceCreateInfo();
+  VK_CHECK_RESULT(vkCreateFence(device.device(), &fence_create_info, nullptr,
+                                &retiring_.fence));
+  VK_CHECK_RESULT(vkQueueSubmit(device.graphics_queue().queue, 0U, nullptr,
+                                retiring_.fence));
+
+  retired_.push_back(eastl::move(retiring_));
+  retiring_ = RetiredBatch();
+  retiring_.fence = VK_NULL_HANDLE;
+}
+
+void ResidencyManager::ReleaseBatch(
+    const VulkanDevice &device,
+    RetiredBatch &batch) {
+  for (eastl::vector<VulkanBuffer>::iterator i = batch.buffers.begin();
+       i != batch.buffers.end();
+       ++i) {
+    i->Shutdown(device);
+  }
+  batch.buffers.clear();
+  for (eastl::vector<eastl::unique_ptr<VulkanImage>>::iterator i =
+         batch.images.begin();
+       i != batch.images.end();
+       ++i) {
+    (*i)->Shutdown(device);
+  }
+  batch.images.clear();
+  for (eastl::vector<eastl::pair<GeometryArena *, GeometryRangeId>>::iterator
+         i = batch.ranges.begin();
+       i != batch.ranges.end();
+       ++i) {
+    i->first->Free(i->second);
+  }
+  batch.ranges.clear();
+
+  if (batch.fence != VK_NULL_HANDLE) {
+    vkDestroyFence(device.device(), batch.fence, nullptr);
+    batch.fence = VK_NULL_HANDLE;
+  }
+}
+
+} // namespace vks
@@ -0,0 +1,74 @@
+#include <staging_ring.h>
+#include <vulkan_tools.h>
+
+namespace vks {
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1U) / alignment * alignment;
+}
+
+StagingRing::StagingRing()
+    : capacity_(0U),
+      head_(0U),
+      tail_(0U),
+      used_(0U) {}
+
+void StagingRing::Reset(uint64_t capacity) {
+  capacity_ = capacity;
+  head_ = 0U;
+  tail_ = 0U;
+  used_ = 0U;
+}
+
+bool StagingRing::Allocate(
+    uint64_t size,
+    uint64_t alignment,
+    uint64_t *offset,
+    uint64_t *consumed) {
+  if (used_ == 0U) {
+    head_ = 0U;
+    tail_ = 0U;
+  }
+
+  uint64_t aligned = AlignUp(head_, alignment);
+  if (head_ > tail_ || used_ == 0U) {
+    // Free space is at the end of the ring and before the tail
+    if (aligned + size <= capacity_) {
+      *offset = aligned;
+      *consumed = aligned + size - head_;
+    }
+    else if (size <= tail_) {
+      // Wrap around, wasting the end of the ring
+      *offset = 0U;
+      *consumed = (capacity_ - head_) + size;
+    }
+    else {
+      return false;
+    }
+  }
+  else {
+    // Free space is between the head and the tail
+    if (aligned + size > tail_) {
+      return false;
+    }
+    *offset = aligned;
+    *consumed = aligned + size - head_;
+  }
+
+  head_ = *offset + size;
+  used_ += *consumed;
+
+  return true;
+}
+
+void StagingRing::Release(uint64_t end, uint64_t consumed) {
+  if (consumed == 0U) {
+    return;
+  }
+  VKS_ASSERT(consumed <= used_, "Releasing more of the ring than is used!");
+
+  tail_ = end;
+  used_ -= consumed;
+}
+
+} // namespace vks
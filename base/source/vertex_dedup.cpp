@@ -0,0 +1,132 @@
+#include <vertex_dedup.h>
+#include <vulkan_tools.h>
+#include <cstring>
+
+namespace vks {
+
+static const uint32_t kEmptySlot = 0xFFFFFFFFU;
+static const uint32_t kMinSlotsCount = 16U;
+static const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+
+static inline uint64_t RotateLeft(uint64_t x, uint32_t bits) {
+  return (x << bits) | (x >> (64U - bits));
+}
+
+// Final mix of MurmurHash3
+static inline uint64_t Mix64(uint64_t h) {
+  h ^= h >> 33U;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33U;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33U;
+  return h;
+}
+
+uint64_t HashBytes64(const void *data, size_t size) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  uint64_t h = kPrime2 ^ (static_cast<uint64_t>(size) * kPrime1);
+
+  // Rounds as in xxHash64, over whole words and then the zero padded tail
+  size_t i = 0U;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    h = RotateLeft(h ^ (word * kPrime2), 31U) * kPrime1;
+  }
+  if (i < size) {
+    uint64_t word = 0U;
+    memcpy(&word, bytes + i, size - i);
+    h = RotateLeft(h ^ (word * kPrime2), 31U) * kPrime1;
+  }
+
+  return Mix64(h);
+}
+
+VertexDedupMap::VertexDedupMap()
+    : slots_(kMinSlotsCount, kEmptySlot),
+      vertices_(),
+      hashes_(),
+      mask_(kMinSlotsCount - 1U) {}
+
+void VertexDedupMap::Reserve(uint32_t count) {
+  vertices_.reserve(count);
+  hashes_.reserve(count);
+
+  // Keep the load under a half, so that probe sequences stay short
+  uint32_t capacity = SCAST_U32(slots_.size());
+  while (capacity < count * 2U) {
+    capacity *= 2U;
+  }
+  if (capacity != slots_.size()) {
+    Rehash(capacity);
+  }
+}
+
+uint32_t VertexDedupMap::InsertOrGet(const Vertex &vertex) {
+  if ((vertices_.size() + 1U) * 2U > slots_.size()) {
+    Rehash(SCAST_U32(slots_.size()) * 2U);
+  }
+
+  uint64_t hash = HashBytes64(&vertex, sizeof(vertex));
+  for (uint32_t slot = static_cast<uint32_t>(hash) & mask_;;
+       slot = (slot + 1U) & mask_) {
+    uint32_t idx = slots_[slot];
+    if (idx == kEmptySlot) {
+      idx = SCAST_U32(vertices_.size());
+      slots_[slot] = idx;
+      vertices_.push_back(vertex);
+      hashes_.push_back(hash);
+      return idx;
+    }
+    if (hashes_[idx] == hash &&
+        memcmp(&vertices_[idx], &vertex, sizeof(vertex)) == 0) {
+      return idx;
+    }
+  }
+}
+
+void VertexDedupMap::Rehash(uint32_t capacity) {
+  slots_.assign(capacity, kEmptySlot);
+  mask_ = capacity - 1U;
+  for (uint32_t i = 0U; i < hashes_.size(); ++i) {
+    uint32_t slot = static_cast<uint32_t>(hashes_[i]) & mask_;
+    while (slots_[slot] != kEmptySlot) {
+      slot = (slot + 1U) & mask_;
+    }
+    slots_[slot] = i;
+  }
+}
+
+void MergeDedupedVertices(
+    const VertexDedupMap *maps,
+    eastl::vector<uint32_t> *indices,
+    uint32_t parts_count,
+    eastl::vector<Vertex> &vertices) {
+  uint32_t total_count = 0U;
+  for (uint32_t p = 0U; p < parts_count; ++p) {
+    total_count += SCAST_U32(maps[p].unique_vertices().size());
+  }
+
+  // Only the unique vertices of each part go through the merged map, which
+  // are far fewer than the corners
+  VertexDedupMap merged;
+  merged.Reserve(total_count);
+  eastl::vector<uint32_t> remap;
+  for (uint32_t p = 0U; p < parts_count; ++p) {
+    const eastl::vector<Vertex> &part_vertices = maps[p].unique_vertices();
+    remap.resize(part_vertices.size());
+    for (uint32_t v = 0U; v < part_vertices.size(); ++v) {
+      remap[v] = merged.InsertOrGet(part_vertices[v]);
+    }
+    for (eastl::vector<uint32_t>::iterator i = indices[p].begin();
+         i != indices[p].end();
+         ++i) {
+      *i = remap[*i];
+    }
+  }
+
+  vertices = merged.unique_vertices();
+}
+
+} // namespace vks
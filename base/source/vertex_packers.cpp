@@ -0,0 +1,111 @@
+#include <vertex_packers.h>
+#include <vertex_quantization.h>
+#include <logger.hpp>
+
+namespace vks {
+
+// Encode the quantized elements straight from the members of the vertices
+static void EncodeVertexElement(
+    VertexElementType type,
+    VertexElementEncoding encoding,
+    const Vertex *vertices,
+    uint32_t count,
+    uint32_t element_size,
+    const glm::vec4 &position_dequant,
+    uint32_t stride,
+    uint8_t *dst) {
+  uint32_t src_stride = SCAST_U32(sizeof(Vertex));
+  if (encoding == VertexElementEncoding::TANGENT_FRAME_SNORM16) {
+    EncodeTangentFrames(&vertices->normal.x, &vertices->tangent.x,
+                        &vertices->bitangent.x, src_stride, count, stride, dst,
+                        nullptr);
+    return;
+  }
+
+  const float *src = nullptr;
+  switch (type) {
+    case VertexElementType::POSITION: {
+      src = &vertices->pos.x;
+      break;
+    }
+    case VertexElementType::NORMAL: {
+      src = &vertices->normal.x;
+      break;
+    }
+    case VertexElementType::UV: {
+      src = &vertices->uv.x;
+      break;
+    }
+    case VertexElementType::TANGENT: {
+      src = &vertices->tangent.x;
+      break;
+    }
+    case VertexElementType::BITANGENT: {
+      src = &vertices->bitangent.x;
+      break;
+    }
+    case VertexElementType::COLOUR: {
+      src = &vertices->colour.x;
+      break;
+    }
+    default:
+      ELOG_WARN("Unsupported vertex element type!");
+      return;
+  }
+
+  EncodeVectors(encoding, src, src_stride, count, element_size,
+                position_dequant, stride, dst, nullptr);
+}
+
+void PackVertexElement(
+    VertexElementType type,
+    VertexElementEncoding encoding,
+    const Vertex *vertices,
+    uint32_t count,
+    uint32_t element_size,
+    const glm::vec4 &position_dequant,
+    uint32_t stride,
+    uint8_t *dst) {
+  if (encoding != VertexElementEncoding::FLOAT) {
+    EncodeVertexElement(type, encoding, vertices, count, element_size,
+                        position_dequant, stride, dst);
+    return;
+  }
+
+  switch (type) {
+    case VertexElementType::POSITION: {
+      PackVertexElement<VertexElementType::POSITION>(
+          vertices, count, element_size, stride, dst);
+      break;
+    }
+    case VertexElementType::NORMAL: {
+      PackVertexElement<VertexElementType::NORMAL>(
+          vertices, count, element_size, stride, dst);
+      break;
+    }
+    case VertexElementType::UV: {
+      PackVertexElement<VertexElementType::UV>(
+          vertices, count, element_size, stride, dst);
+      break;
+    }
+    case VertexElementType::TANGENT: {
+      PackVertexElement<VertexElementType::TANGENT>(
+          vertices, count, element_size, stride, dst);
+      break;
+    }
+    case VertexElementType::BITANGENT: {
+      PackVertexElement<VertexElementType::BITANGENT>(
+          vertices, count, element_size, stride, dst);
+      break;
+    }
+    case VertexElementType::COLOUR: {
+      PackVertexElement<VertexElementType::COLOUR>(
+          vertices, count, element_size, stride, dst);
+      break;
+    }
+    default:
+      ELOG_WARN("Unsupported vertex element type!");
+  }
+}
+
+} // namespace vks
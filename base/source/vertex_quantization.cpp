@@ -0,0 +1,287 @@
+#include <vertex_quantization.h>
+#include <vulkan_tools.h>
+#include <logger.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vks {
+
+static const char *const kElementNames[] = {
+  "positions",
+  "normals",
+  "uvs",
+  "tangents",
+  "bitangents",
+  "colours"
+};
+
+VertexQuantizationError::VertexQuantizationError()
+    : max_error(0.f),
+      sum_error(0.0),
+      count(0U) {}
+
+void VertexQuantizationError::Add(float error) {
+  max_error = std::max(max_error, error);
+  sum_error += error;
+  ++count;
+}
+
+void VertexQuantizationError::Merge(const VertexQuantizationError &other) {
+  max_error = std::max(max_error, other.max_error);
+  sum_error += other.sum_error;
+  count += other.count;
+}
+
+float VertexQuantizationError::GetMean() const {
+  return (count != 0U) ? static_cast<float>(sum_error / count) : 0.f;
+}
+
+uint32_t EncodeOctahedral(const glm::vec3 &v) {
+  float l1_norm = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+  if (l1_norm == 0.f) {
+    return glm::packSnorm2x16(glm::vec2(0.f));
+  }
+
+  glm::vec3 n = v / l1_norm;
+  glm::vec2 p(n.x, n.y);
+  // Fold the lower hemisphere over the diagonals
+  if (n.z < 0.f) {
+    p = glm::vec2(
+        (1.f - fabsf(n.y)) * (n.x >= 0.f ? 1.f : -1.f),
+        (1.f - fabsf(n.x)) * (n.y >= 0.f ? 1.f : -1.f));
+  }
+
+  return glm::packSnorm2x16(p);
+}
+
+glm::vec3 DecodeOctahedral(uint32_t packed) {
+  glm::vec2 p = glm::unpackSnorm2x16(packed);
+  glm::vec3 n(p.x, p.y, 1.f - fabsf(p.x) - fabsf(p.y));
+  float t = std::max(-n.z, 0.f);
+  n.x += (n.x >= 0.f) ? -t : t;
+  n.y += (n.y >= 0.f) ? -t : t;
+  return glm::normalize(n);
+}
+
+// Any unit vector perpendicular to the given one
+static glm::vec3 GetPerpendicular(const glm::vec3 &n) {
+  glm::vec3 axis = (fabsf(n.x) < 0.9f) ? glm::vec3(1.f, 0.f, 0.f) :
+                                         glm::vec3(0.f, 1.f, 0.f);
+  return glm::normalize(glm::cross(n, axis));
+}
+
+// Orthonormal normal and tangent of a frame, whatever the input
+static void OrthonormaliseFrame(
+    const glm::vec3 &normal,
+    const glm::vec3 &tangent,
+    glm::vec3 *n,
+    glm::vec3 *t) {
+  float normal_length = glm::length(normal);
+  *n = (normal_length > 0.f) ? normal / normal_length :
+                               glm::vec3(0.f, 0.f, 1.f);
+
+  glm::vec3 ortho_tangent = tangent - *n * glm::dot(*n, tangent);
+  float tangent_length = glm::length(ortho_tangent);
+  *t = (tangent_length > 1e-6f) ? ortho_tangent / tangent_length :
+                                  GetPerpendicular(*n);
+}
+
+uint64_t EncodeTangentFrame(const glm::vec3 &normal,
+                            const glm::vec3 &tangent) {
+  glm::vec3 n, t;
+  OrthonormaliseFrame(normal, tangent, &n, &t);
+
+  glm::quat q = glm::normalize(glm::quat_cast(
+      glm::mat3(t, glm::cross(n, t), n)));
+  // q and -q are the same rotation; keep w positive
+  if (q.w < 0.f) {
+    q = -q;
+  }
+
+  return glm::packSnorm4x16(glm::vec4(q.x, q.y, q.z, q.w));
+}
+
+void DecodeTangentFrame(uint64_t packed, glm::vec3 *normal,
+                        glm::vec3 *tangent) {
+  glm::vec4 v = glm::unpackSnorm4x16(packed);
+  glm::mat3 frame = glm::mat3_cast(glm::normalize(glm::quat(v.w, v.x, v.y,
+                                                            v.z)));
+  *normal = frame[2];
+  *tangent = frame[0];
+}
+
+glm::vec4 ComputePositionDequant(const float *positions, uint32_t count,
+                                 uint32_t stride) {
+  if (count == 0U) {
+    return glm::vec4(0.f, 0.f, 0.f, 1.f);
+  }
+
+  const uint8_t *src = reinterpret_cast<const uint8_t *>(positions);
+  glm::vec3 min_pos(reinterpret_cast<const float *>(src)[0U],
+                    reinterpret_cast<const float *>(src)[1U],
+                    reinterpret_cast<const float *>(src)[2U]);
+  glm::vec3 max_pos = min_pos;
+  for (uint32_t i = 1U; i < count; ++i) {
+    const float *p = reinterpret_cast<const float *>(src + i * stride);
+    glm::vec3 pos(p[0U], p[1U], p[2U]);
+    min_pos = glm::min(min_pos, pos);
+    max_pos = glm::max(max_pos, pos);
+  }
+
+  glm::vec3 half_extent = (max_pos - min_pos) * 0.5f;
+  float scale = std::max(std::max(half_extent.x, half_extent.y),
+                         half_extent.z);
+  return glm::vec4((min_pos + max_pos) * 0.5f, (scale > 0.f) ? scale : 1.f);
+}
+
+glm::mat4 GetPositionDequantMatrix(const glm::vec4 &position_dequant) {
+  glm::mat4 mat(position_dequant.w);
+  mat[3U] = glm::vec4(glm::vec3(position_dequant), 1.f);
+  return mat;
+}
+
+// Source vector i, or zero if there is no source
+static inline glm::vec3 GetSourceVector(
+    const float *src,
+    uint32_t src_stride,
+    uint32_t i) {
+  if (src == nullptr) {
+    return glm::vec3(0.f);
+  }
+  const float *v = reinterpret_cast<const float *>(
+      reinterpret_cast<const uint8_t *>(src) + i * src_stride);
+  return glm::vec3(v[0U], v[1U], v[2U]);
+}
+
+void EncodeVectors(
+    VertexElementEncoding encoding,
+    const float *src,
+    uint32_t src_stride,
+    uint32_t count,
+    uint32_t element_size,
+    const glm::vec4 &position_dequant,
+    uint32_t stride,
+    uint8_t *dst,
+    VertexQuantizationError *error) {
+  // Branch once per array rather than once per vertex
+  switch (encoding) {
+    case VertexElementEncoding::OCTAHEDRAL_SNORM16: {
+      for (uint32_t i = 0U; i < count; ++i, dst += stride) {
+        glm::vec3 v = GetSourceVector(src, src_stride, i);
+        uint32_t packed = EncodeOctahedral(v);
+        memcpy(dst, &packed, sizeof(packed));
+        float length = glm::length(v);
+        if (error != nullptr && length > 0.f) {
+          error->Add(glm::length(DecodeOctahedral(packed) - v / length));
+        }
+      }
+      break;
+    }
+    case VertexElementEncoding::HALF: {
+      uint32_t components = element_size / SCAST_U32(sizeof(uint16_t));
+      for (uint32_t i = 0U; i < count; ++i, dst += stride) {
+        glm::vec3 v = GetSourceVector(src, src_stride, i);
+        float error_sq = 0.f;
+        for (uint32_t c = 0U; c < components; ++c) {
+          float value = (c < 3U) ? v[c] : 0.f;
+          uint16_t packed = glm::packHalf1x16(value);
+          memcpy(dst + c * sizeof(packed), &packed, sizeof(packed));
+          float diff = glm::unpackHalf1x16(packed) - value;
+          error_sq += diff * diff;
+        }
+        if (error != nullptr) {
+          error->Add(sqrtf(error_sq));
+        }
+      }
+      break;
+    }
+    case VertexElementEncoding::UNORM16: {
+      uint32_t components = element_size / SCAST_U32(sizeof(uint16_t));
+      for (uint32_t i = 0U; i < count; ++i, dst += stride) {
+        glm::vec3 v = GetSourceVector(src, src_stride, i);
+        float error_sq = 0.f;
+        for (uint32_t c = 0U; c < components; ++c) {
+          float value = (c < 3U) ? v[c] : 0.f;
+          uint16_t packed = glm::packUnorm1x16(value);
+          memcpy(dst + c * sizeof(packed), &packed, sizeof(packed));
+          // Includes the clamping of values outside [0, 1]
+          float diff = glm::unpackUnorm1x16(packed) - value;
+          error_sq += diff * diff;
+        }
+        if (error != nullptr) {
+          error->Add(sqrtf(error_sq));
+        }
+      }
+      break;
+    }
+    case VertexElementEncoding::SNORM16_POSITION: {
+      glm::vec3 offset(position_dequant);
+      float inv_scale = 1.f / position_dequant.w;
+      for (uint32_t i = 0U; i < count; ++i, dst += stride) {
+        glm::vec3 v = GetSourceVector(src, src_stride, i);
+        uint64_t packed = glm::packSnorm4x16(
+            glm::vec4((v - offset) * inv_scale, 1.f));
+        memcpy(dst, &packed, sizeof(packed));
+        if (error != nullptr) {
+          glm::vec3 decoded = offset + position_dequant.w *
+            glm::vec3(glm::unpackSnorm4x16(packed));
+          error->Add(glm::length(decoded - v));
+        }
+      }
+      break;
+    }
+    default:
+      ELOG_WARN("Unsupported vertex element encoding!");
+  }
+}
+
+void EncodeTangentFrames(
+    const float *normals,
+    const float *tangents,
+    const float *bitangents,
+    uint32_t src_stride,
+    uint32_t count,
+    uint32_t stride,
+    uint8_t *dst,
+    VertexQuantizationError *error) {
+  for (uint32_t i = 0U; i < count; ++i, dst += stride) {
+    glm::vec3 normal = GetSourceVector(normals, src_stride, i);
+    glm::vec3 tangent = GetSourceVector(tangents, src_stride, i);
+    glm::vec3 bitangent = GetSourceVector(bitangents, src_stride, i);
+    if (glm::dot(glm::cross(normal, tangent), bitangent) < 0.f) {
+      tangent = -tangent;
+    }
+
+    uint64_t packed = EncodeTangentFrame(normal, tangent);
+    memcpy(dst, &packed, sizeof(packed));
+
+    if (error != nullptr) {
+      glm::vec3 n, t, decoded_n, decoded_t;
+      OrthonormaliseFrame(normal, tangent, &n, &t);
+      DecodeTangentFrame(packed, &decoded_n, &decoded_t);
+      error->Add(std::max(glm::length(decoded_n - n),
+                          glm::length(decoded_t - t)));
+    }
+  }
+}
+
+void LogVertexQuantizationErrors(
+    const VertexSetup &vertex_setup,
+    const VertexQuantizationError *errors) {
+  for (uint32_t i = 0U; i < vertex_setup.num_elements(); ++i) {
+    if (vertex_setup.GetElementEncoding(i) == VertexElementEncoding::FLOAT ||
+        errors[i].count == 0U) {
+      continue;
+    }
+
+    LOG("Quantized " <<
+        kElementNames[SCAST_U32(vertex_setup.vertex_types_layout()[i])] <<
+        ": max error " << errors[i].max_error << ", mean error " <<
+        errors[i].GetMean() << " over " << errors[i].count << " vertices.");
+  }
+}
+
+} // namespace vks
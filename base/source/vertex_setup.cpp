@@ -7,36 +7,109 @@ namespace vks {
 VertexElement::VertexElement()
     : type(),
       size_bytes(0U),
-      format() {}
+      format(),
+      encoding(VertexElementEncoding::FLOAT) {}
 
 VertexElement::VertexElement(
     VertexElementType Type,
     uint32_t Size_bytes,
-    VkFormat Format)
+    VkFormat Format,
+    VertexElementEncoding Encoding)
     : type(Type),
       size_bytes(Size_bytes),
-      format(Format) {}
+      format(Format),
+      encoding(Encoding) {}
+
+// Checks that an element is big enough for its encoding
+static bool IsValidEncoding(const VertexElement &element) {
+  switch (element.encoding) {
+    case VertexElementEncoding::FLOAT: {
+      return true;
+    }
+    case VertexElementEncoding::OCTAHEDRAL_SNORM16: {
+      return element.size_bytes == 4U;
+    }
+    case VertexElementEncoding::TANGENT_FRAME_SNORM16: {
+      return element.size_bytes == 8U &&
+        element.type == VertexElementType::NORMAL;
+    }
+    case VertexElementEncoding::HALF:
+    case VertexElementEncoding::UNORM16: {
+      return element.size_bytes % 2U == 0U && element.size_bytes <= 8U;
+    }
+    case VertexElementEncoding::SNORM16_POSITION: {
+      return element.size_bytes == 8U &&
+        element.type == VertexElementType::POSITION;
+    }
+    default:
+      return false;
+  }
+}
 
 VertexSetup::VertexSetup(
     const eastl::vector<VertexElement> &vertex_layout/*,
-    const eastl::vector<eastl::pair<VertexElement, uint32_t>> &elements_size*/)
+    const eastl::vector<eastl::pair<VertexElement, uint32_t>> &elements_size*/,
+    VertexStreamsLayout streams_layout)
     : vertex_layout_(),
       vertex_types_layout_(),
       vertex_size_(0U),
-      num_elements_(0U) {
+      num_elements_(0U),
+      streams_layout_(streams_layout),
+      element_streams_(),
+      element_offsets_(),
+      stream_strides_() {
   num_elements_ = SCAST_U32(vertex_layout.size());
+  bool has_position = false;
   for (uint32_t i = 0U; i < num_elements_; i++) {
     vertex_size_ += vertex_layout[i].size_bytes;
    
+    VKS_ASSERT(IsValidEncoding(vertex_layout[i]),
+               "Vertex element size doesn't match its encoding");
     vertex_layout_[vertex_layout[i].type] = {
       vertex_layout[i].size_bytes,
-      vertex_layout[i].format
+      vertex_layout[i].format,
+      vertex_layout[i].encoding
     };
 
     vertex_types_layout_.push_back(vertex_layout[i].type);
+    has_position = has_position ||
+      (vertex_layout[i].type == VertexElementType::POSITION);
+  }
+
+  // Assign the elements to streams, in layout order
+  element_streams_.resize(num_elements_);
+  element_offsets_.resize(num_elements_);
+  for (uint32_t i = 0U; i < num_elements_; i++) {
+    uint32_t stream = i;
+    if (streams_layout_ == VertexStreamsLayout::POSITION_INTERLEAVED) {
+      if (vertex_layout[i].type == VertexElementType::POSITION) {
+        stream = 0U;
+      }
+      else {
+        stream = has_position ? 1U : 0U;
+      }
+    }
+
+    if (stream >= SCAST_U32(stream_strides_.size())) {
+      stream_strides_.resize(stream + 1U, 0U);
+    }
+    element_streams_[i] = stream;
+    element_offsets_[i] = stream_strides_[stream];
+    stream_strides_[stream] += vertex_layout[i].size_bytes;
   }
 }
 
+uint32_t VertexSetup::GetPositionStream() const {
+  for (uint32_t i = 0U; i < num_elements_; i++) {
+    if (vertex_types_layout_[i] == VertexElementType::POSITION) {
+      return element_streams_[i];
+    }
+  }
+
+  ELOG_ERR("The layout has no positions!");
+  return 0U;
+}
+
 uint32_t VertexSetup::GetElementSize(uint32_t idx) const {
   return GetElementSize(vertex_types_layout_[idx]);
 }
@@ -69,6 +142,31 @@ VkFormat VertexSetup::GetElementVulkanFormat(VertexElementType element) const {
   return VK_FORMAT_UNDEFINED;
 }
   
+VertexElementEncoding VertexSetup::GetElementEncoding(uint32_t idx) const {
+  return GetElementEncoding(vertex_types_layout_[idx]);
+}
+
+VertexElementEncoding VertexSetup::GetElementEncoding(
+    VertexElementType element) const {
+  auto it = vertex_layout_.find(element);
+  if (it != vertex_layout_.end()) {
+    return it->second.encoding;
+  }
+
+  ELOG_ERR("Element searched for has not been found!");
+  return VertexElementEncoding::FLOAT;
+}
+
+bool VertexSetup::IsQuantized() const {
+  for (auto it = vertex_layout_.begin(); it != vertex_layout_.end(); ++it) {
+    if (it->second.encoding != VertexElementEncoding::FLOAT) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 uint32_t VertexSetup::GetElementPosition(uint32_t idx) const {
   return GetElementPosition(vertex_types_layout_[idx]);
 }
@@ -145,6 +145,23 @@ void VulkanBase::CreateInstance() {
   extensions.assign(glfw_extensions, glfw_extensions +
                     glfw_extension_count);
   
+#ifdef VK_EXT_memory_budget
+  // Needed to query the memory budget; optional
+  uint32_t instance_extensions_count = 0U;
+  VK_CHECK_RESULT(vkEnumerateInstanceExtensionProperties(
+      nullptr, &instance_extensions_count, nullptr));
+  std::vector<VkExtensionProperties> instance_extensions(
+      instance_extensions_count);
+  VK_CHECK_RESULT(vkEnumerateInstanceExtensionProperties(
+      nullptr, &instance_extensions_count, instance_extensions.data()));
+  if (tools::DoesPhysicalDeviceSupportExtension(
+        VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+        instance_extensions)) {
+    extensions.push_back(
+        VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+  }
+#endif
+  
   std::vector<const char *> layers;
 
 #ifndef NDEBUG
@@ -13,6 +13,19 @@ static const std::vector<const char*> kDeviceExtensions = {
   VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// Enabled only if the physical device supports them
+static const std::vector<const char*> kOptionalDeviceExtensions = {
+#ifdef VK_EXT_memory_budget
+  VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+#endif
+#ifdef VK_KHR_draw_indirect_count
+  VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+#endif
+#ifdef VK_AMD_draw_indirect_count
+  VK_AMD_EXTENSION_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+#endif
+};
+
 #ifndef NDEBUG
 static const std::vector<const char*> kDeviceDebugValidationLayers = {
   "VK_LAYER_LUNARG_standard_validation"
@@ -26,6 +39,7 @@ struct QueueFamilyIndices{
   uint32_t graphics_family;
   uint32_t present_family;
   uint32_t compute_family;
+  uint32_t transfer_family;
 };
 
 static bool IsQueueFamilyIndicesComplete(
@@ -37,10 +51,13 @@ VulkanDevice::VulkanDevice()
       graphics_queue_(),
       present_queue_(),
       compute_queue_(),
+      transfer_queue_(),
       physical_properties_(),
       physical_features_(),
       physical_memory_properties_(),
-      depth_format_() {}
+      depth_format_(),
+      get_memory_properties2_(nullptr),
+      draw_indexed_indirect_count_(nullptr) {}
 
 void VulkanDevice::Init(VkInstance instance, VkSurfaceKHR surface) {
   uint32_t num_devices = 0U;
@@ -56,7 +73,12 @@ void VulkanDevice::Init(VkInstance instance, VkSurfaceKHR surface) {
 
   // This saves both the physical device which we want to use and the queue
   // family indices which we want to create queues from
-  QueueFamilyIndices queue_families = { UINT32_MAX, UINT32_MAX, UINT32_MAX };
+  QueueFamilyIndices queue_families = {
+    UINT32_MAX,
+    UINT32_MAX,
+    UINT32_MAX,
+    UINT32_MAX
+  };
   for (uint32_t i = 0; i < num_devices; ++i) {
     if (IsPhysicalDeviceSuitable(physical_devices[i], queue_families,
                                  surface)) {
@@ -72,6 +94,10 @@ void VulkanDevice::Init(VkInstance instance, VkSurfaceKHR surface) {
   graphics_queue_.index = queue_families.graphics_family;
   present_queue_.index = queue_families.present_family;
   compute_queue_.index = queue_families.compute_family;
+  transfer_queue_.index = queue_families.transfer_family;
+  if (HasDedicatedTransferQueue()) {
+    LOG("Using dedicated transfer queue family " << transfer_queue_.index);
+  }
  
   // Store properties and features of the physical device for later use 
   vkGetPhysicalDeviceProperties(physical_device_, &physical_properties_);
@@ -84,7 +110,8 @@ void VulkanDevice::Init(VkInstance instance, VkSurfaceKHR surface) {
   // Use a set to select only unique family ids
   std::set<uint32_t> unique_queue_families = { queue_families.graphics_family,
                                               queue_families.present_family,
-                                              queue_families.compute_family };
+                                              queue_families.compute_family,
+                                              queue_families.transfer_family };
 
   std::set<uint32_t>::iterator it;
   // queue_priorities is a vector so that if in the future there is the need
@@ -106,6 +133,33 @@ void VulkanDevice::Init(VkInstance instance, VkSurfaceKHR surface) {
   std::vector<const char *> extensions;
   extensions.assign(kDeviceExtensions.begin(), kDeviceExtensions.end());
 
+  uint32_t extensions_count = 0U;
+  VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(
+      physical_device_, nullptr, &extensions_count, nullptr));
+  std::vector<VkExtensionProperties> available_extensions(extensions_count);
+  VK_CHECK_RESULT(vkEnumerateDeviceExtensionProperties(
+      physical_device_, nullptr, &extensions_count,
+      available_extensions.data()));
+  for (uint32_t i = 0U; i < kOptionalDeviceExtensions.size(); ++i) {
+    if (tools::DoesPhysicalDeviceSupportExtension(kOptionalDeviceExtensions[i],
+                                                  available_extensions)) {
+      extensions.push_back(kOptionalDeviceExtensions[i]);
+    }
+  }
+
+#ifdef VK_EXT_memory_budget
+  // The budget is queried through the properties2 instance extension, which
+  // is only enabled when the instance supports it
+  get_memory_properties2_ = vkGetInstanceProcAddr(
+      instance,
+      "vkGetPhysicalDeviceMemoryProperties2KHR");
+  if (!tools::DoesPhysicalDeviceSupportExtension(
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+        available_extensions)) {
+    get_memory_properties2_ = nullptr;
+  }
+#endif
+
 #ifndef NDEBUG
   layers.assign(
       kDeviceDebugValidationLayers.begin(),
@@ -128,6 +182,29 @@ void VulkanDevice::Init(VkInstance instance, VkSurfaceKHR surface) {
   VK_CHECK_RESULT(vkCreateDevice(physical_device_, &device_create_info, nullptr,
                                  &device_));
 
+  // Draw counts read from buffers, through the KHR extension or else the AMD
+  // one it was promoted from; both have the same signature
+  draw_indexed_indirect_count_ = nullptr;
+#ifdef VK_KHR_draw_indirect_count
+  if (tools::DoesPhysicalDeviceSupportExtension(
+        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+        available_extensions)) {
+    draw_indexed_indirect_count_ = vkGetDeviceProcAddr(
+        device_,
+        "vkCmdDrawIndexedIndirectCountKHR");
+  }
+#endif
+#ifdef VK_AMD_draw_indirect_count
+  if (draw_indexed_indirect_count_ == nullptr &&
+      tools::DoesPhysicalDeviceSupportExtension(
+        VK_AMD_EXTENSION_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+        available_extensions)) {
+    draw_indexed_indirect_count_ = vkGetDeviceProcAddr(
+        device_,
+        "vkCmdDrawIndexedIndirectCountAMD");
+  }
+#endif
+
   // Retrieve queues after having created the device
   vkGetDeviceQueue(device_, queue_families.graphics_family, 0U,
                    &graphics_queue_.queue);
@@ -135,6 +212,8 @@ void VulkanDevice::Init(VkInstance instance, VkSurfaceKHR surface) {
                    &present_queue_.queue);
   vkGetDeviceQueue(device_, queue_families.compute_family, 0U,
                    &compute_queue_.queue);
+  vkGetDeviceQueue(device_, queue_families.transfer_family, 0U,
+                   &transfer_queue_.queue);
 
   // Create default command pools for the queues
   VkCommandPoolCreateInfo cmd_pool_create_info =
@@ -149,9 +228,16 @@ void VulkanDevice::Init(VkInstance instance, VkSurfaceKHR surface) {
   cmd_pool_create_info.queueFamilyIndex = queue_families.compute_family;
   VK_CHECK_RESULT(vkCreateCommandPool(device_, &cmd_pool_create_info, nullptr,
                                       &compute_queue_.cmd_pool));
+  cmd_pool_create_info.queueFamilyIndex = queue_families.transfer_family;
+  VK_CHECK_RESULT(vkCreateCommandPool(device_, &cmd_pool_create_info, nullptr,
+                                      &transfer_queue_.cmd_pool));
 }
 
 void VulkanDevice::Shutdown() {
+  if (transfer_queue_.cmd_pool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device_, transfer_queue_.cmd_pool, nullptr);
+    transfer_queue_.cmd_pool = VK_NULL_HANDLE;
+  }
   if (compute_queue_.cmd_pool != VK_NULL_HANDLE) {
     vkDestroyCommandPool(device_, compute_queue_.cmd_pool, nullptr);
     compute_queue_.cmd_pool = VK_NULL_HANDLE;
@@ -188,6 +274,12 @@ uint32_t VulkanDevice::GetMemoryType(
   return -1;
 }
 
+bool VulkanDevice::HasMemoryType(
+    uint32_t type_bits,
+    VkMemoryPropertyFlags properties_flags) const {
+  return GetMemoryType(type_bits, properties_flags) != UINT32_MAX;
+}
+
 bool VulkanDevice::IsPhysicalDeviceSuitable(
     VkPhysicalDevice physical_device,
     QueueFamilyIndices &queue_families,
@@ -262,6 +354,7 @@ bool VulkanDevice::IsPhysicalDeviceSuitable(
   // Scan through the enumerated queue families and select a graphics, 
   // compute and present queue; they could be on two separate families
   QueueFamilyIndices selected_queue_families = {
+    UINT32_MAX,
     UINT32_MAX,
     UINT32_MAX,
     UINT32_MAX
@@ -305,10 +398,79 @@ bool VulkanDevice::IsPhysicalDeviceSuitable(
     return false;
   }
 
+  // Prefer a family which only supports transfers for uploads, as it usually
+  // maps to a DMA engine which can run alongside rendering; otherwise fall
+  // back to the graphics family
+  selected_queue_families.transfer_family =
+    selected_queue_families.graphics_family;
+  for (uint32_t i = 0U; i < queue_families_count; ++i) {
+    if ((queue_family_properties[i].queueCount > 0U) &&
+        (queue_family_properties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+        !(queue_family_properties[i].queueFlags &
+          (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      selected_queue_families.transfer_family = i;
+      break;
+    }
+  }
+
   queue_families = selected_queue_families;
   return true;
 }
 
+bool VulkanDevice::QueryMemoryBudget(
+    VkDeviceSize *heap_budgets,
+    VkDeviceSize *heap_usages) const {
+#ifdef VK_EXT_memory_budget
+  if (get_memory_properties2_ == nullptr) {
+    return false;
+  }
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {};
+  budget_properties.sType =
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  VkPhysicalDeviceMemoryProperties2KHR memory_properties = {};
+  memory_properties.sType =
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+  memory_properties.pNext = &budget_properties;
+
+  reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+      get_memory_properties2_)(physical_device_, &memory_properties);
+
+  for (uint32_t i = 0U; i < physical_memory_properties_.memoryHeapCount;
+       ++i) {
+    heap_budgets[i] = budget_properties.heapBudget[i];
+    heap_usages[i] = budget_properties.heapUsage[i];
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void VulkanDevice::CmdDrawIndexedIndirectCount(
+    VkCommandBuffer cmd_buff,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkBuffer count_buffer,
+    VkDeviceSize count_buffer_offset,
+    uint32_t max_draw_count,
+    uint32_t stride) const {
+  VKS_ASSERT(draw_indexed_indirect_count_ != nullptr,
+             "Draw indirect count isn't supported!");
+#if defined(VK_KHR_draw_indirect_count)
+  reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+      draw_indexed_indirect_count_)(cmd_buff, buffer, offset, count_buffer,
+                                    count_buffer_offset, max_draw_count,
+                                    stride);
+#elif defined(VK_AMD_draw_indirect_count)
+  reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountAMD>(
+      draw_indexed_indirect_count_)(cmd_buff, buffer, offset, count_buffer,
+                                    count_buffer_offset, max_draw_count,
+                                    stride);
+#endif
+}
+
 void VulkanDevice::CreateImageView( 
     const VkImageViewCreateInfo &image_vew_create_info,
     VulkanImage &image) const {
@@ -3,6 +3,7 @@
 #include <vulkan_tools.h>
 #include <utility>
 #include <logger.hpp>
+#include <base_system.h>
 
 namespace vks {
 
@@ -10,10 +11,16 @@ VulkanImage::VulkanImage()
     : image_(VK_NULL_HANDLE),
       owns_image_(false),
       memory_(VK_NULL_HANDLE),
+      owns_memory_(false),
       size_(0U),
+      memory_requirements_(),
       default_view_(VK_NULL_HANDLE),
+      create_view_(CreateView::NO),
+      view_type_(VK_IMAGE_VIEW_TYPE_2D),
+      usage_(0U),
       additional_views_(),
       memory_properties_flags_(),
+      memory_category_(MemoryCategory::OTHER),
       layout_(),
       extent_({0U, 0U, 0U}),
       mip_levels_(1U),
@@ -22,41 +29,68 @@ VulkanImage::VulkanImage()
 void VulkanImage::Init(
     const VulkanDevice &device,
     const VulkanImageInitInfo &info) {
+  Create(device, info);
   memory_properties_flags_ = info.memory_properties_flags;
+
+  // Allocate memory for the image 
+  VkMemoryAllocateInfo mem_alloc_info = {
+    VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+    nullptr,
+    memory_requirements_.size,
+    device.GetMemoryType(memory_requirements_.memoryTypeBits,
+                         memory_properties_flags_)
+  };
+
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VK_CHECK_RESULT(vkAllocateMemory(device.device(), &mem_alloc_info, nullptr,
+                                   &memory));
+  memory_tracker()->TrackAllocation(memory_category_,
+                                    memory_requirements_.size);
+
+  BindMemory(device, memory, 0U);
+  owns_memory_ = true;
+}
+
+void VulkanImage::Create(
+    const VulkanDevice &device,
+    const VulkanImageInitInfo &info) {
+  memory_category_ = info.memory_category;
   layout_ = info.create_info.initialLayout;
   extent_ = info.create_info.extent;
   mip_levels_ = info.create_info.mipLevels;
   format_ = info.create_info.format;
+  create_view_ = info.create_view;
+  view_type_ = info.view_type;
+  usage_ = info.create_info.usage;
 
   // Create the image handle
   VK_CHECK_RESULT(vkCreateImage(device.device(), &info.create_info, nullptr,
                                 &image_));
 
   // Check what the memory requirements for the image are
-  VkMemoryRequirements memory_requirements;
-  vkGetImageMemoryRequirements(device.device(), image_, &memory_requirements);
+  vkGetImageMemoryRequirements(device.device(), image_,
+                               &memory_requirements_);
 
-  // Allocate memory for the image 
-  VkMemoryAllocateInfo mem_alloc_info = {
-    VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-    nullptr,
-    memory_requirements.size,
-    device.GetMemoryType(memory_requirements.memoryTypeBits,
-                         memory_properties_flags_)
-  };
+  size_ = memory_requirements_.size;
+  owns_image_ = true;
+}
 
-  VK_CHECK_RESULT(vkAllocateMemory(device.device(), &mem_alloc_info, nullptr,
-                                   &memory_));
+void VulkanImage::BindMemory(
+    const VulkanDevice &device,
+    VkDeviceMemory memory,
+    VkDeviceSize offset) {
+  memory_ = memory;
+  owns_memory_ = false;
 
   // Assign the memory to the image 
-  VK_CHECK_RESULT(vkBindImageMemory(device.device(), image_, memory_, 0U));
+  VK_CHECK_RESULT(vkBindImageMemory(device.device(), image_, memory_, offset));
 
-  if (info.create_view == CreateView::YES) { 
+  if (create_view_ == CreateView::YES) { 
     // Create an image view for the texture
     VkImageViewCreateInfo img_view_create_info =
       tools::inits::ImageViewCreateInfo(
         image_,
-        info.view_type,
+        view_type_,
         format_,
         {
           VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -72,10 +106,9 @@ void VulkanImage::Init(
           1U
         });
 
-    if (info.create_info.usage &
-             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+    if (usage_ & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
       img_view_create_info.subresourceRange = {
-        VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+        tools::GetDepthStencilAspect(format_),
         0U,
         mip_levels_,
         0U,
@@ -89,9 +122,6 @@ void VulkanImage::Init(
           nullptr,
           &default_view_));
   }
-
-  size_ = memory_requirements.size;
-  owns_image_ = true;
 }
 
 void VulkanImage::Init(
@@ -125,7 +155,7 @@ void VulkanImage::Init(
     if (info.image_usages &
              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
       img_view_create_info.subresourceRange = {
-        VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+        tools::GetDepthStencilAspect(format_),
         0U,
         mip_levels_,
         0U,
@@ -157,10 +187,11 @@ void VulkanImage::Shutdown(const VulkanDevice &device) {
     vkDestroyImage(device.device(), image_, nullptr);
     image_ = VK_NULL_HANDLE;
   }
-  if (memory_ != VK_NULL_HANDLE && owns_image_) {
+  if (memory_ != VK_NULL_HANDLE && owns_memory_) {
     vkFreeMemory(device.device(), memory_, nullptr);
-    memory_ = VK_NULL_HANDLE;
+    memory_tracker()->TrackFree(memory_category_, size_);
   }
+  memory_ = VK_NULL_HANDLE;
 }
 
 VkDescriptorImageInfo VulkanImage::GetDescriptorImageInfo(
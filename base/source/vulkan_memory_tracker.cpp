@@ -0,0 +1,116 @@
+#include <vulkan_memory_tracker.h>
+#include <vulkan_device.h>
+#include <vulkan_tools.h>
+#include <logger.hpp>
+
+namespace vks {
+
+static const VkDeviceSize kBytesPerMiB = 1024U * 1024U;
+
+const char *GetMemoryCategoryName(MemoryCategory category) {
+  switch (category) {
+    case MemoryCategory::VERTEX: {
+      return "vertex";
+    }
+    case MemoryCategory::INDEX: {
+      return "index";
+    }
+    case MemoryCategory::TEXTURE: {
+      return "texture";
+    }
+    case MemoryCategory::RENDER_TARGET: {
+      return "render target";
+    }
+    case MemoryCategory::STAGING: {
+      return "staging";
+    }
+    case MemoryCategory::PER_FRAME: {
+      return "per-frame";
+    }
+    default: {
+      return "other";
+    }
+  }
+}
+
+MemoryCategoryStats::MemoryCategoryStats()
+    : current_bytes(0U),
+      peak_bytes(0U),
+      live_allocations(0U),
+      total_allocations(0U) {}
+
+VulkanMemoryTracker::VulkanMemoryTracker()
+    : stats_(),
+      current_bytes_(0U),
+      peak_bytes_(0U) {}
+
+void VulkanMemoryTracker::TrackAllocation(
+    MemoryCategory category,
+    VkDeviceSize size) {
+  MemoryCategoryStats &stats = stats_[static_cast<size_t>(category)];
+  stats.current_bytes += size;
+  stats.live_allocations++;
+  stats.total_allocations++;
+  if (stats.current_bytes > stats.peak_bytes) {
+    stats.peak_bytes = stats.current_bytes;
+  }
+
+  current_bytes_ += size;
+  if (current_bytes_ > peak_bytes_) {
+    peak_bytes_ = current_bytes_;
+  }
+}
+
+void VulkanMemoryTracker::TrackFree(
+    MemoryCategory category,
+    VkDeviceSize size) {
+  MemoryCategoryStats &stats = stats_[static_cast<size_t>(category)];
+  VKS_ASSERT(stats.current_bytes >= size && stats.live_allocations > 0U,
+             "Freeing more memory than was allocated for the category!");
+  stats.current_bytes -= size;
+  stats.live_allocations--;
+  current_bytes_ -= size;
+}
+
+const MemoryCategoryStats &VulkanMemoryTracker::GetStats(
+    MemoryCategory category) const {
+  return stats_[static_cast<size_t>(category)];
+}
+
+void VulkanMemoryTracker::LogReport(const VulkanDevice &device) const {
+  ELOG("GPU memory report:");
+  for (uint32_t i = 0U; i < static_cast<uint32_t>(MemoryCategory::count);
+       ++i) {
+    const MemoryCategoryStats &stats = stats_[i];
+    ELOG("  " << GetMemoryCategoryName(static_cast<MemoryCategory>(i)) <<
+         ": " << stats.current_bytes / kBytesPerMiB << " MiB in " <<
+         stats.live_allocations << " allocations, peak " <<
+         stats.peak_bytes / kBytesPerMiB << " MiB, " <<
+         stats.total_allocations << " allocations overall");
+  }
+  ELOG("  total: " << current_bytes_ / kBytesPerMiB << " MiB, peak " <<
+       peak_bytes_ / kBytesPerMiB << " MiB");
+
+  const VkPhysicalDeviceMemoryProperties &memory_properties =
+    device.memory_properties();
+  VkDeviceSize heap_budgets[VK_MAX_MEMORY_HEAPS];
+  VkDeviceSize heap_usages[VK_MAX_MEMORY_HEAPS];
+  bool has_budget = device.QueryMemoryBudget(heap_budgets, heap_usages);
+  for (uint32_t i = 0U; i < memory_properties.memoryHeapCount; ++i) {
+    const VkMemoryHeap &heap = memory_properties.memoryHeaps[i];
+    const char *heap_type =
+      (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "device" : "host";
+    if (has_budget) {
+      ELOG("  heap " << i << " (" << heap_type << "): " <<
+           heap_usages[i] / kBytesPerMiB << " / " <<
+           heap_budgets[i] / kBytesPerMiB << " MiB budget, size " <<
+           heap.size / kBytesPerMiB << " MiB");
+    }
+    else {
+      ELOG("  heap " << i << " (" << heap_type << "): size " <<
+           heap.size / kBytesPerMiB << " MiB, budget not available");
+    }
+  }
+}
+
+} // namespace vks
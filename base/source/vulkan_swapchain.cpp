@@ -279,8 +279,8 @@ void VulkanSwapChain::Present(
   present_info.swapchainCount = 1U;
   present_info.pSwapchains = &swapchain_;
   present_info.pImageIndices = &current_idx_;
-  std::vector<VkResult> results(1U);
-  present_info.pResults = results.data();
+  VkResult result = VK_SUCCESS;
+  present_info.pResults = &result;
 
   VK_CHECK_RESULT(vkQueuePresentKHR(queue.queue, &present_info)); 
 }
@@ -32,7 +32,9 @@ void VulkanTexture::Init(const VulkanDevice &device,
 }
 
 void VulkanTexture::Shutdown(const VulkanDevice &device) {
-  image_->Shutdown(device);
+  if (image_ != nullptr) {
+    image_->Shutdown(device);
+  }
   LOG("Shutdown tex " << name_);
 }
 
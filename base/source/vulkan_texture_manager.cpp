@@ -6,28 +6,97 @@
 #include <logger.hpp>
 #include <lodepng.h>
 #include <EASTL/utility.h>
+#include <base_system.h>
 
 namespace vks {
 
+eastl::string GetTextureName(const eastl::string &filename) {
+  eastl::string name(filename);
+  tools::Replace(name, "\\", "/");
+  tools::Replace(name, "//", "/");
+  return name;
+}
+
+// Region copying a whole mip level, starting at offset in the data
+static VkBufferImageCopy GetMipCopyRegion(
+    uint32_t mip_level,
+    uint32_t width,
+    uint32_t height,
+    uint32_t offset) {
+  VkBufferImageCopy copy_region;
+  copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  copy_region.imageSubresource.mipLevel = mip_level;
+  copy_region.imageSubresource.baseArrayLayer = 0U;
+  copy_region.imageSubresource.layerCount = 1U;
+  copy_region.imageExtent.width = width;
+  copy_region.imageExtent.height = height;
+  copy_region.imageExtent.depth = 1U;
+  copy_region.bufferOffset = offset;
+  copy_region.bufferRowLength = 0U;
+  copy_region.bufferImageHeight = 0U;
+  copy_region.imageOffset.x = 0U;
+  copy_region.imageOffset.y = 0U;
+  copy_region.imageOffset.z = 0U;
+  return copy_region;
+}
+
+bool DecodeTexture(
+    const eastl::string &filename,
+    VkFormat format,
+    DecodedTexture *decoded) {
+  decoded->name = GetTextureName(filename);
+  decoded->format = format;
+  decoded->copy_regions.clear();
+
+  if (decoded->name.find("png") != eastl::string::npos) {
+    std::vector<unsigned char> png_data;
+    uint32_t width = 0U;
+    uint32_t height = 0U;
+    if (lodepng::decode(png_data, width, height,
+                        decoded->name.c_str()) != 0U) {
+      return false;
+    }
+
+    decoded->width = width;
+    decoded->height = height;
+    decoded->mip_levels = 1U;
+    decoded->data.assign(png_data.data(), png_data.data() + png_data.size());
+    decoded->copy_regions.push_back(GetMipCopyRegion(0U, width, height, 0U));
+    return true;
+  }
+
+  gli::texture2d tex_2D(gli::load(decoded->name.c_str()));
+  if (tex_2D.empty()) {
+    return false;
+  }
+
+  // Get dimensions of first mip level
+  decoded->width = SCAST_U32(tex_2D[0U].extent().x);
+  decoded->height = SCAST_U32(tex_2D[0U].extent().y);
+  decoded->mip_levels = SCAST_U32(tex_2D.levels());
+  const uint8_t *tex_data = static_cast<const uint8_t *>(tex_2D.data());
+  decoded->data.assign(tex_data, tex_data + tex_2D.size());
+
+  // Use an offset to go through all the mip levels
+  uint32_t offset = 0U;
+  for (uint32_t i = 0U; i < decoded->mip_levels; ++i) {
+    decoded->copy_regions.push_back(GetMipCopyRegion(
+        i,
+        SCAST_U32(tex_2D[i].extent().x),
+        SCAST_U32(tex_2D[i].extent().y),
+        offset));
+    offset += static_cast<uint32_t>(tex_2D[i].size());
+  }
+
+  return true;
+}
+
 VulkanTextureManager::VulkanTextureManager()
-    : cmd_buffer_(VK_NULL_HANDLE),
-      textures_() {}
+    : textures_(),
+      render_targets_memory_() {}
 
 void VulkanTextureManager::Init(const VulkanDevice &device) {
-  // Create a separate command buffer for submitting
-  // image barriers
-  VkCommandBufferAllocateInfo cmd_buffer_allocate_info = {
-    VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-    nullptr,
-    device.graphics_queue().cmd_pool,
-    VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-    1U
-  };
-
-  VK_CHECK_RESULT(vkAllocateCommandBuffers(
-      device.device(),
-      &cmd_buffer_allocate_info,
-      &cmd_buffer_));
+  // Nothing to setup; texture data goes through the upload manager
 }
 
 void VulkanTextureManager::Shutdown(const VulkanDevice &device) {
@@ -36,11 +105,15 @@ void VulkanTextureManager::Shutdown(const VulkanDevice &device) {
     iter->second->Shutdown(device);
   }
 
-  if (cmd_buffer_ != VK_NULL_HANDLE) {
-    vkFreeCommandBuffers(device.device(), device.graphics_queue().cmd_pool,
-                         1U, &cmd_buffer_);
-    cmd_buffer_ = VK_NULL_HANDLE;
+  // The images bound to this memory are gone, so it can be released
+  for (eastl::vector<RenderTargetMemory>::iterator i =
+         render_targets_memory_.begin();
+       i != render_targets_memory_.end();
+       ++i) {
+    vkFreeMemory(device.device(), i->memory, nullptr);
+    memory_tracker()->TrackFree(MemoryCategory::RENDER_TARGET, i->size);
   }
+  render_targets_memory_.clear();
 }
 
 void VulkanTextureManager::Create2DTextureFromData(
@@ -55,25 +128,8 @@ void VulkanTextureManager::Create2DTextureFromData(
     const VkSampler sampler,
     const VkImageUsageFlags img_usage_flags) {
 
-  // Setup buffer copy regions for each mip level
   eastl::vector<VkBufferImageCopy> buffer_copy_regions;
-
-  VkBufferImageCopy copy_region;
-  copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  copy_region.imageSubresource.mipLevel = 0U;
-  copy_region.imageSubresource.baseArrayLayer = 0U;
-  copy_region.imageSubresource.layerCount = 1U;
-  copy_region.imageExtent.width = width;
-  copy_region.imageExtent.height = height;
-  copy_region.imageExtent.depth = 1U;
-  copy_region.bufferOffset = 0U;
-  copy_region.bufferRowLength = 0U;
-  copy_region.bufferImageHeight = 0U;
-  copy_region.imageOffset.x = 0U;
-  copy_region.imageOffset.y = 0U;
-  copy_region.imageOffset.z = 0U;
-
-  buffer_copy_regions.push_back(copy_region);
+  buffer_copy_regions.push_back(GetMipCopyRegion(0U, width, height, 0U));
   
   CreateTexture(
     device,
@@ -92,68 +148,89 @@ void VulkanTextureManager::Create2DTextureFromData(
 
 void VulkanTextureManager::Load2DPNGTexture(
     const VulkanDevice &device,
-    const eastl::string &filename_original,
+    const eastl::string &filename,
+    VkFormat format,
+    VulkanTexture **texture,
+    const VkSampler aniso_sampler,
+    const VkImageUsageFlags img_usage_flags) {
+  LoadTexture(
+      device,
+      filename,
+      format,
+      texture,
+      aniso_sampler,
+      img_usage_flags);
+}
+
+void VulkanTextureManager::LoadTexture(
+    const VulkanDevice &device,
+    const eastl::string &filename,
     VkFormat format,
     VulkanTexture **texture,
     const VkSampler aniso_sampler,
     const VkImageUsageFlags img_usage_flags) {
-  eastl::string filename(filename_original);
-  tools::Replace(filename, "\\", "/");
-  tools::Replace(filename, "//", "/");
-  
   // First check if the texture requested is already present
-  (*texture) = GetTextureByName(filename);
+  eastl::string name(GetTextureName(filename));
+  (*texture) = GetTextureByName(name);
   if ((*texture) != nullptr) {
-    LOG("Texture " + filename + " already exists, returning pre-loaded one.");
+    LOG("Texture " + name + " already exists, returning pre-loaded one.");
     return;
   }
 
-  std::vector<unsigned char> png_data;
-  uint32_t width = 0U;
-  uint32_t height = 0U;
-
-  uint32_t err = lodepng::decode(png_data, width, height, filename.c_str());
-
-  if (err != 0U) {
+  DecodedTexture decoded;
+  if (!DecodeTexture(name, format, &decoded)) {
     ELOG_WARN("Couldn't find or load texture " +
-        filename + " .");
+        name + " .");
     (*texture) = nullptr;
     return;
   }
-  
-  // Setup buffer copy regions for each mip level
-  eastl::vector<VkBufferImageCopy> buffer_copy_regions;
 
-  VkBufferImageCopy copy_region;
-  copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  copy_region.imageSubresource.mipLevel = 0U;
-  copy_region.imageSubresource.baseArrayLayer = 0U;
-  copy_region.imageSubresource.layerCount = 1U;
-  copy_region.imageExtent.width = width;
-  copy_region.imageExtent.height = height;
-  copy_region.imageExtent.depth = 1U;
-  copy_region.bufferOffset = 0U;
-  copy_region.bufferRowLength = 0U;
-  copy_region.bufferImageHeight = 0U;
-  copy_region.imageOffset.x = 0U;
-  copy_region.imageOffset.y = 0U;
-  copy_region.imageOffset.z = 0U;
+  CreateDecodedTexture(
+      device,
+      decoded,
+      texture,
+      aniso_sampler,
+      img_usage_flags);
+}
 
-  buffer_copy_regions.push_back(copy_region);
+void VulkanTextureManager::CreateDecodedTexture(
+    const VulkanDevice &device,
+    const DecodedTexture &decoded,
+    VulkanTexture **texture,
+    const VkSampler aniso_sampler,
+    const VkImageUsageFlags img_usage_flags) {
+  (*texture) = GetTextureByName(decoded.name);
+  if ((*texture) != nullptr) {
+    // Evicted textures get their image back, so that whoever points to them
+    // stays valid
+    if (!(*texture)->resident()) {
+      (*texture)->set_image(CreateTextureImage(
+          device,
+          decoded.data.data(),
+          SCAST_U32(decoded.data.size()),
+          decoded.width,
+          decoded.height,
+          decoded.mip_levels,
+          decoded.format,
+          decoded.copy_regions,
+          img_usage_flags));
+    }
+    return;
+  }
 
   CreateTexture(
-    device,
-    filename,
-    png_data.data(),
-    png_data.size(),
-    width,
-    height,
-    1U,
-    format,
-    buffer_copy_regions,
-    texture,
-    aniso_sampler,
-    img_usage_flags);
+      device,
+      decoded.name,
+      decoded.data.data(),
+      SCAST_U32(decoded.data.size()),
+      decoded.width,
+      decoded.height,
+      decoded.mip_levels,
+      decoded.format,
+      decoded.copy_regions,
+      texture,
+      aniso_sampler,
+      img_usage_flags);
 }
 
 void VulkanTextureManager::CreateTexture(
@@ -169,6 +246,38 @@ void VulkanTextureManager::CreateTexture(
     VulkanTexture **texture,
     const VkSampler aniso_sampler,
     const VkImageUsageFlags img_usage_flags) {
+  VulkanTextureInitInfo texture_init_info;
+  texture_init_info.image = CreateTextureImage(
+      device,
+      data,
+      size,
+      width,
+      height,
+      mip_levels,
+      format,
+      copy_regions,
+      img_usage_flags);
+  texture_init_info.create_sampler = CreateSampler::NO;
+  texture_init_info.sampler = aniso_sampler;
+  texture_init_info.name = name;
+
+  CreateUniqueTexture(
+      device,
+      texture_init_info,
+      name,
+      texture);
+}
+
+eastl::unique_ptr<VulkanImage> VulkanTextureManager::CreateTextureImage(
+    const VulkanDevice &device,
+    const void *data,
+    const uint32_t size,
+    const uint32_t width,
+    const uint32_t height,
+    const uint32_t mip_levels,
+    VkFormat format,
+    const eastl::vector<VkBufferImageCopy> &copy_regions,
+    const VkImageUsageFlags img_usage_flags) {
   // Create the image
   VkImageCreateInfo image_create_info = tools::inits::ImageCreateInfo(
       0U,
@@ -190,215 +299,52 @@ void VulkanTextureManager::CreateTexture(
   image_init_info.view_type = VK_IMAGE_VIEW_TYPE_2D;
   image_init_info.memory_properties_flags = 
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  if (img_usage_flags & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) {
+    image_init_info.memory_category = MemoryCategory::RENDER_TARGET;
+  }
+  else {
+    image_init_info.memory_category = MemoryCategory::TEXTURE;
+  }
   eastl::unique_ptr<VulkanImage> image = eastl::make_unique<VulkanImage>();
   image->Init(device, image_init_info);
 
   if (data != nullptr) {
     VKS_ASSERT(size != 0U, "Size is zero when initial data was passed!");
-    // Get the device properties for the requested texture format
-    VkFormatProperties format_proerties;
-    vkGetPhysicalDeviceFormatProperties(device.physical_device(), format,
-                                        &format_proerties);
-
-    // Create a host-visible staging buffer for containing the raw data
-    VkBufferCreateInfo buf_create_info = tools::inits::BufferCreateInfo();
-    buf_create_info.size = size;
-    buf_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    buf_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    buf_create_info.queueFamilyIndexCount = 0U;
-    buf_create_info.pQueueFamilyIndices = nullptr;
-
-    VkBuffer staging_buffer = VK_NULL_HANDLE;
-    VK_CHECK_RESULT(vkCreateBuffer(
-        device.device(),
-        &buf_create_info,
-        nullptr,
-        &staging_buffer));
-
-    // Get the memory requirements for the staging buffer
-    VkMemoryRequirements memory_requirements;
-    vkGetBufferMemoryRequirements(device.device(), staging_buffer,
-                                  &memory_requirements);
-
-    // Allocate memory for the staging buffer
-    VkMemoryAllocateInfo mem_alloc_info = tools::inits::MemoryAllocateInfo();
-    mem_alloc_info.allocationSize = memory_requirements.size;
-    // Retrieve the index for a type of memory visible to the host
-    mem_alloc_info.memoryTypeIndex = device.GetMemoryType(
-        memory_requirements.memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-   
-    VkDeviceMemory staging_buffer_memory = VK_NULL_HANDLE; 
-    VK_CHECK_RESULT(vkAllocateMemory(device.device(), &mem_alloc_info, nullptr,
-                                     &staging_buffer_memory));
-
-    // Then bind it to the buffer handle
-    VK_CHECK_RESULT(vkBindBufferMemory(device.device(), staging_buffer, 
-                                       staging_buffer_memory, 0U));
-
-    // Now copy the texture data into the staging buffer
-    void *mapped_data = nullptr;
-    vkMapMemory(device.device(), staging_buffer_memory, 0U,
-                memory_requirements.size, 0U, &mapped_data);
-    memcpy(mapped_data, data, size);
-    vkUnmapMemory(device.device(), staging_buffer_memory);
 
-
-    // Use an image barrier to setup an optimal image layout for the copy
     VkImageSubresourceRange subresource_range;
     subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     subresource_range.baseMipLevel = 0U;
     subresource_range.levelCount = mip_levels;
     subresource_range.baseArrayLayer = 0U;
     subresource_range.layerCount = 1U;
-    
-    // Use the separate command buffer for texture loading
-    VkCommandBufferBeginInfo cmd_buff_begin_info =
-      tools::inits::CommandBufferBeginInfo();
-    VK_CHECK_RESULT(vkBeginCommandBuffer(cmd_buffer_, &cmd_buff_begin_info));
-
-    tools::SetImageLayout(
-        cmd_buffer_,
-        *image.get(),
-        VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        subresource_range);
-   
-    // Copy the mip levels from the staging buffer into the image
-    vkCmdCopyBufferToImage(
-        cmd_buffer_,
-        staging_buffer,
-        image->image(),
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        SCAST_U32(copy_regions.size()),
-        copy_regions.data());
-
-    // Change the image layout to shader read so that shaders can sample it
-    tools::SetImageLayout(  
-        cmd_buffer_,
+
+    // The copy and the layout transitions are batched with the other pending
+    // uploads
+    upload_manager()->EnqueueImageCopy(
+        device,
         *image.get(),
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        data,
+        size,
+        copy_regions,
         subresource_range);
-
-    VK_CHECK_RESULT(vkEndCommandBuffer(cmd_buffer_));
-
-    // Use a fence to make sure that the copying operations have completed
-    // and then submit the command buffer
-    VkFenceCreateInfo fence_create_info = tools::inits::FenceCreateInfo();
-    VkFence copy_fence = VK_NULL_HANDLE;
-    VK_CHECK_RESULT(vkCreateFence(device.device(), &fence_create_info, nullptr,
-                                  &copy_fence));
-
-    VkSubmitInfo submit_info = tools::inits::SubmitInfo();
-    submit_info.waitSemaphoreCount = 0U;
-    submit_info.pWaitSemaphores = nullptr;
-    submit_info.pWaitDstStageMask = nullptr;
-    submit_info.commandBufferCount = 1U;
-    submit_info.pCommandBuffers = &cmd_buffer_;
-    submit_info.signalSemaphoreCount = 0U;
-    submit_info.pSignalSemaphores = nullptr;
-    
-    vkQueueSubmit(device.graphics_queue().queue, 1U, &submit_info,
-                  copy_fence);
-
-    VK_CHECK_RESULT(vkWaitForFences(device.device(), 1U, &copy_fence,
-          VK_TRUE, UINT64_MAX)); 
-
-    // Cleanup the staging resources
-    vkDestroyFence(device.device(), copy_fence, nullptr);
-    copy_fence = VK_NULL_HANDLE;
-    vkFreeMemory(device.device(), staging_buffer_memory, nullptr);
-    staging_buffer_memory = VK_NULL_HANDLE;
-    vkDestroyBuffer(device.device(), staging_buffer, nullptr);
-    staging_buffer = VK_NULL_HANDLE;
-
   }
 
-  VulkanTextureInitInfo texture_init_info;
-  texture_init_info.image = eastl::move(image);
-  texture_init_info.create_sampler = CreateSampler::NO;
-  texture_init_info.sampler = aniso_sampler;
-  texture_init_info.name = name;
-
-  CreateUniqueTexture(
-      device,
-      texture_init_info,
-      name,
-      texture);
+  return image;
 }
 
 
 void VulkanTextureManager::Load2DTexture(
     const VulkanDevice &device,
-    const eastl::string &filename_original,
+    const eastl::string &filename,
     VkFormat format,
     VulkanTexture **texture,
     const VkSampler aniso_sampler,
     const VkImageUsageFlags img_usage_flags) {
-  // Change the slashes
-  eastl::string filename(filename_original);
-  tools::Replace(filename, "\\", "/");
-  tools::Replace(filename, "//", "/");
-
-  // First check if the texture requested is already present
-  (*texture) = GetTextureByName(filename);
-  if ((*texture) != nullptr) {
-    LOG("Texture " + filename + " already exists, returning pre-loaded one.");
-    return;
-  }
-
-  gli::texture2d tex_2D(gli::load(filename.c_str()));
-  if (tex_2D.empty()) {
-    ELOG_WARN("Couldn't find or load texture " +
-        filename + " .");
-    (*texture) = nullptr;
-    return;
-  }
-
-  // Get dimensions of first mip level
-  uint32_t width = SCAST_U32(tex_2D[0U].extent().x);
-  uint32_t height = SCAST_U32(tex_2D[0U].extent().y);
-  uint32_t mip_levels = SCAST_U32(tex_2D.levels());
-
-
-  // Setup buffer copy regions for each mip level
-  eastl::vector<VkBufferImageCopy> buffer_copy_regions;
-  // Use an offset to go through all the mip levels
-  uint32_t offset = 0U;
-
-  for (uint32_t i = 0U; i < mip_levels; ++i) {
-    VkBufferImageCopy copy_region;
-    copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copy_region.imageSubresource.mipLevel = i;
-    copy_region.imageSubresource.baseArrayLayer = 0U;
-    copy_region.imageSubresource.layerCount = 1U;
-    copy_region.imageExtent.width = SCAST_U32(tex_2D[i].extent().x);
-    copy_region.imageExtent.height = SCAST_U32(tex_2D[i].extent().y);
-    copy_region.imageExtent.depth = 1U;
-    copy_region.bufferOffset = offset;
-    copy_region.bufferRowLength = 0U;
-    copy_region.bufferImageHeight = 0U;
-    copy_region.imageOffset.x = 0U;
-    copy_region.imageOffset.y = 0U;
-    copy_region.imageOffset.z = 0U;
-
-    buffer_copy_regions.push_back(copy_region);
-
-    offset += static_cast<uint32_t>(tex_2D[i].size());
-  }
-
-  CreateTexture(
+  LoadTexture(
       device,
       filename,
-      tex_2D.data(),
-      tex_2D.size(),
-      width,
-      height,
-      mip_levels,
       format,
-      buffer_copy_regions,
       texture,
       aniso_sampler,
       img_usage_flags);
@@ -406,75 +352,157 @@ void VulkanTextureManager::Load2DTexture(
 
 void VulkanTextureManager::Load2DTexture(
     const VulkanDevice &device,
-    const eastl::string &filename_original,
+    const eastl::string &filename,
     VkFormat format,
     VulkanTexture **texture,
     const VkImageUsageFlags img_flags) {
-  // Change the slashes
-  eastl::string filename(filename_original);
-  tools::Replace(filename, "\\", "/");
-  tools::Replace(filename, "//", "/");
+  LoadTexture(
+      device,
+      filename,
+      format,
+      texture,
+      VK_NULL_HANDLE,
+      img_flags);
+}
 
-  // First check if the texture requested is already present
-  (*texture) = GetTextureByName(filename);
-  if ((*texture) != nullptr) {
-    LOG("Texture " + filename + " already exists, returning pre-loaded one.");
-    return;
+void VulkanTextureManager::CreateRenderTargets(
+    const VulkanDevice &device,
+    const eastl::vector<RenderTargetInfo> &infos,
+    const VkSampler sampler) {
+  const uint32_t num_targets = SCAST_U32(infos.size());
+
+  // Create the image handles first, so that the requirements of all the
+  // targets in an alias group are known before allocating their memory
+  eastl::vector<eastl::unique_ptr<VulkanImage>> images(num_targets);
+  for (uint32_t i = 0U; i < num_targets; ++i) {
+    const RenderTargetInfo &info = infos[i];
+    VkImageUsageFlags usage = info.usage;
+    if (info.lifetime == RenderTargetLifetime::TRANSIENT) {
+      VKS_ASSERT((usage & ~(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                            VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT)) == 0U,
+                 "Transient render target " << info.name.c_str() <<
+                 " can only be used as an attachment!");
+      usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
+
+    VulkanImageInitInfo image_init_info;
+    image_init_info.create_info = tools::inits::ImageCreateInfo(
+        0U,
+        VK_IMAGE_TYPE_2D,
+        info.format,
+        { info.width, info.height, 1U },
+        1U,
+        1U,
+        VK_SAMPLE_COUNT_1_BIT,
+        VK_IMAGE_TILING_OPTIMAL,
+        usage,
+        VK_SHARING_MODE_EXCLUSIVE,
+        0U,
+        nullptr,
+        VK_IMAGE_LAYOUT_UNDEFINED); 
+    image_init_info.create_view = CreateView::YES;
+    image_init_info.view_type = VK_IMAGE_VIEW_TYPE_2D;
+    image_init_info.memory_properties_flags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    image_init_info.memory_category = MemoryCategory::RENDER_TARGET;
+
+    images[i] = eastl::make_unique<VulkanImage>();
+    images[i]->Create(device, image_init_info);
   }
 
-  gli::texture2d tex_2D(gli::load(filename.c_str()));
-  if (tex_2D.empty()) {
-    ELOG_WARN("Couldn't find or load texture " +
-        filename + " .");
-    (*texture) = nullptr;
-    return;
+  // One allocation per alias group, and one for each non-aliased target
+  eastl::vector<bool> bound(num_targets, false);
+  for (uint32_t i = 0U; i < num_targets; ++i) {
+    if (bound[i]) {
+      continue;
+    }
+
+    VkMemoryRequirements requirements = images[i]->memory_requirements();
+    bool all_transient =
+      infos[i].lifetime == RenderTargetLifetime::TRANSIENT;
+    if (infos[i].alias_group != kNoAliasGroup) {
+      for (uint32_t j = i + 1U; j < num_targets; ++j) {
+        if (infos[j].alias_group != infos[i].alias_group) {
+          continue;
+        }
+        const VkMemoryRequirements &other = images[j]->memory_requirements();
+        requirements.size = eastl::max(requirements.size, other.size);
+        requirements.memoryTypeBits &= other.memoryTypeBits;
+        all_transient = all_transient &&
+          infos[j].lifetime == RenderTargetLifetime::TRANSIENT;
+      }
+    }
+    VKS_ASSERT(requirements.memoryTypeBits != 0U,
+               "Render targets aliased with " << infos[i].name.c_str() <<
+               " have no memory type in common!");
+
+    VkMemoryPropertyFlags memory_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (all_transient &&
+        device.HasMemoryType(requirements.memoryTypeBits,
+                             memory_flags |
+                               VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+      memory_flags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    }
+
+    VkMemoryAllocateInfo mem_alloc_info = {
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      nullptr,
+      requirements.size,
+      device.GetMemoryType(requirements.memoryTypeBits, memory_flags)
+    };
+    RenderTargetMemory memory = { VK_NULL_HANDLE, requirements.size };
+    VK_CHECK_RESULT(vkAllocateMemory(device.device(), &mem_alloc_info, nullptr,
+                                     &memory.memory));
+    memory_tracker()->TrackAllocation(MemoryCategory::RENDER_TARGET,
+                                      memory.size);
+    render_targets_memory_.push_back(memory);
+
+    // Aliased images all start at the beginning of the allocation
+    for (uint32_t j = i; j < num_targets; ++j) {
+      if (j == i || (infos[i].alias_group != kNoAliasGroup &&
+                     infos[j].alias_group == infos[i].alias_group)) {
+        images[j]->BindMemory(device, memory.memory, 0U);
+        bound[j] = true;
+      }
+    }
   }
 
-  // Get dimensions of first mip level
-  uint32_t width = SCAST_U32(tex_2D[0U].extent().x);
-  uint32_t height = SCAST_U32(tex_2D[0U].extent().y);
-  uint32_t mip_levels = SCAST_U32(tex_2D.levels());
-
+  for (uint32_t i = 0U; i < num_targets; ++i) {
+    VulkanTextureInitInfo texture_init_info;
+    texture_init_info.image = eastl::move(images[i]);
+    texture_init_info.create_sampler = CreateSampler::NO;
+    texture_init_info.sampler = sampler;
+    texture_init_info.name = infos[i].name;
+
+    CreateUniqueTexture(
+        device,
+        texture_init_info,
+        infos[i].name,
+        infos[i].texture);
+  }
+}
 
-  // Setup buffer copy regions for each mip level
-  eastl::vector<VkBufferImageCopy> buffer_copy_regions;
-  // Use an offset to go through all the mip levels
-  uint32_t offset = 0U;
+void VulkanTextureManager::EvictTexture(
+    const VulkanDevice &device,
+    const eastl::string &name) {
+  VulkanTexture *texture = GetTextureByName(name);
+  if (texture == nullptr || !texture->resident()) {
+    return;
+  }
 
-  for (uint32_t i = 0U; i < mip_levels; ++i) {
-    VkBufferImageCopy copy_region;
-    copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copy_region.imageSubresource.mipLevel = i;
-    copy_region.imageSubresource.baseArrayLayer = 0U;
-    copy_region.imageSubresource.layerCount = 1U;
-    copy_region.imageExtent.width = SCAST_U32(tex_2D[i].extent().x);
-    copy_region.imageExtent.height = SCAST_U32(tex_2D[i].extent().y);
-    copy_region.imageExtent.depth = 1U;
-    copy_region.bufferOffset = offset;
-    copy_region.bufferRowLength = 0U;
-    copy_region.bufferImageHeight = 0U;
-    copy_region.imageOffset.x = 0U;
-    copy_region.imageOffset.y = 0U;
-    copy_region.imageOffset.z = 0U;
-
-    buffer_copy_regions.push_back(copy_region);
+  residency_manager()->RetireImage(texture->ReleaseImage());
+}
 
-    offset += static_cast<uint32_t>(tex_2D[i].size());
+bool VulkanTextureManager::IsTextureResident(
+    const VulkanTexture &texture) const {
+  if (!texture.resident()) {
+    return false;
   }
 
-  CreateTexture(
-      device,
-      filename,
-      tex_2D.data(),
-      tex_2D.size(),
-      width,
-      height,
-      mip_levels,
-      format,
-      buffer_copy_regions,
-      texture,
-      VK_NULL_HANDLE,
-      img_flags);
+  uint32_t id = residency_manager()->FindId(ResidentType::TEXTURE,
+                                            texture.name());
+  return id == kNoResidencyId || residency_manager()->IsResident(id);
 }
 
 VulkanTexture *VulkanTextureManager::GetTextureByName(
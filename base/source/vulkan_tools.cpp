@@ -79,6 +79,17 @@ bool GetSupportedDepthFormat(VkPhysicalDevice physical_device,
   return false;
 }
 
+VkImageAspectFlags GetDepthStencilAspect(VkFormat depth_format) {
+  switch (depth_format) {
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return VK_IMAGE_ASPECT_DEPTH_BIT;
+  }
+}
+
 uint32_t GetSwapChainNumImages(
     const VkSurfaceCapabilitiesKHR &surface_capabilities) {
   uint32_t image_count = surface_capabilities.minImageCount + 1;
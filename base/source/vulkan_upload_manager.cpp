@@ -0,0 +1,547 @@
+#include <vulkan_upload_manager.h>
+#include <vulkan_device.h>
+#include <vulkan_image.h>
+#include <vulkan_tools.h>
+#include <logger.hpp>
+#include <cstring>
+
+namespace vks {
+
+const VkDeviceSize kStagingRingSize = 64U * 1024U * 1024U;
+// Covers the texel block size of every format used for textures
+static const VkDeviceSize kStagingMinAlignment = 16U;
+// Ways in which the graphics queue reads uploaded buffers
+static const VkAccessFlags kUploadedBufferAccess =
+  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+  VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+VulkanUploadManager::UploadBatch::UploadBatch()
+    : cmd_buff(VK_NULL_HANDLE),
+      acquire_cmd_buff(VK_NULL_HANDLE),
+      transfer_complete_semaphore(VK_NULL_HANDLE),
+      acquire_buffer_barriers(),
+      acquire_image_barriers(),
+      fence(VK_NULL_HANDLE),
+      ticket(0U),
+      ring_end(0U),
+      ring_bytes(0U),
+      overflow_buffers(),
+      recording(false),
+      in_flight(false) {}
+
+VulkanUploadManager::VulkanUploadManager()
+    : staging_ring_(),
+      mapped_ring_(nullptr),
+      ring_(),
+      batches_(),
+      current_batch_(0U),
+      completed_ticket_(0U),
+      submitted_ticket_(0U) {}
+
+void VulkanUploadManager::Init(const VulkanDevice &device) {
+  // The ring stays mapped for the whole lifetime of the manager
+  VulkanBufferInitInfo init_info;
+  init_info.size = kStagingRingSize;
+  init_info.buffer_usage_flags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  init_info.memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  init_info.memory_category = MemoryCategory::STAGING;
+  staging_ring_.Init(device, init_info);
+
+  void *mapped = nullptr;
+  VK_CHECK_RESULT(staging_ring_.Map(device, &mapped));
+  mapped_ring_ = static_cast<uint8_t *>(mapped);
+  ring_.Reset(kStagingRingSize);
+
+  eastl::array<VkCommandBuffer, kUploadBatchesCount> cmd_buffs;
+  VkCommandBufferAllocateInfo cmd_buffer_allocate_info = {
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+    nullptr,
+    device.transfer_queue().cmd_pool,
+    VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+    kUploadBatchesCount
+  };
+  VK_CHECK_RESULT(vkAllocateCommandBuffers(
+      device.device(),
+      &cmd_buffer_allocate_info,
+      cmd_buffs.data()));
+
+  eastl::array<VkCommandBuffer, kUploadBatchesCount> acquire_cmd_buffs;
+  if (device.HasDedicatedTransferQueue()) {
+    cmd_buffer_allocate_info.commandPool = device.graphics_queue().cmd_pool;
+    VK_CHECK_RESULT(vkAllocateCommandBuffers(
+        device.device(),
+        &cmd_buffer_allocate_info,
+        acquire_cmd_buffs.data()));
+  }
+
+  VkFenceCreateInfo fence_create_info = tools::inits::FenceCreateInfo();
+  VkSemaphoreCreateInfo semaphore_create_info = {
+    VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    nullptr,
+    0U
+  };
+  for (uint32_t i = 0U; i < kUploadBatchesCount; ++i) {
+    batches_[i].cmd_buff = cmd_buffs[i];
+    VK_CHECK_RESULT(vkCreateFence(device.device(), &fence_create_info,
+                                  nullptr, &batches_[i].fence));
+    if (device.HasDedicatedTransferQueue()) {
+      batches_[i].acquire_cmd_buff = acquire_cmd_buffs[i];
+      VK_CHECK_RESULT(vkCreateSemaphore(
+          device.device(),
+          &semaphore_create_info,
+          nullptr,
+          &batches_[i].transfer_complete_semaphore));
+    }
+  }
+
+  LOG("Initialised upload manager, staging ring of " << kStagingRingSize <<
+      " bytes.");
+}
+
+void VulkanUploadManager::Shutdown(const VulkanDevice &device) {
+  if (mapped_ring_ == nullptr) {
+    return;
+  }
+
+  WaitForTicket(device, Flush(device));
+
+  for (eastl::array<UploadBatch, kUploadBatchesCount>::iterator i =
+         batches_.begin();
+       i != batches_.end();
+       ++i) {
+    vkDestroyFence(device.device(), i->fence, nullptr);
+    i->fence = VK_NULL_HANDLE;
+    vkFreeCommandBuffers(device.device(), device.transfer_queue().cmd_pool,
+                         1U, &i->cmd_buff);
+    i->cmd_buff = VK_NULL_HANDLE;
+    if (i->acquire_cmd_buff != VK_NULL_HANDLE) {
+      vkFreeCommandBuffers(device.device(), device.graphics_queue().cmd_pool,
+                           1U, &i->acquire_cmd_buff);
+      i->acquire_cmd_buff = VK_NULL_HANDLE;
+    }
+    if (i->transfer_complete_semaphore != VK_NULL_HANDLE) {
+      vkDestroySemaphore(device.device(), i->transfer_complete_semaphore,
+                         nullptr);
+      i->transfer_complete_semaphore = VK_NULL_HANDLE;
+    }
+  }
+
+  staging_ring_.Unmap(device);
+  mapped_ring_ = nullptr;
+  staging_ring_.Shutdown(device);
+}
+
+UploadTicket VulkanUploadManager::EnqueueBufferCopy(
+    const VulkanDevice &device,
+    VkBuffer dst_buffer,
+    const void *data,
+    VkDeviceSize size,
+    VkDeviceSize dst_offset) {
+  VKS_ASSERT(data != nullptr && size != 0U, "Nothing to upload!");
+
+  VkBuffer src_buffer = VK_NULL_HANDLE;
+  VkDeviceSize src_offset = 0U;
+  void *staging = AllocateStaging(device, size, kStagingMinAlignment,
+                                  &src_buffer, &src_offset);
+  if (staging != nullptr) {
+    memcpy(staging, data, size);
+  }
+
+  VkCommandBuffer cmd_buff = BeginRecording(device);
+
+  VkBufferCopy buff_copy;
+  buff_copy.srcOffset = src_offset;
+  buff_copy.dstOffset = dst_offset;
+  buff_copy.size = size;
+  vkCmdCopyBuffer(cmd_buff, src_buffer, dst_buffer, 1U, &buff_copy);
+  RecordBufferRelease(device, dst_buffer, dst_offset, size);
+
+  return batches_[current_batch_].ticket;
+}
+
+UploadTicket VulkanUploadManager::EnqueueImageCopy(
+    const VulkanDevice &device,
+    VulkanImage &image,
+    const void *data,
+    VkDeviceSize size,
+    const eastl::vector<VkBufferImageCopy> &copy_regions,
+    const VkImageSubresourceRange &subresource_range) {
+  VKS_ASSERT(data != nullptr && size != 0U, "Nothing to upload!");
+
+  VkDeviceSize alignment = device.physical_properties().limits.
+    optimalBufferCopyOffsetAlignment;
+  if (alignment < kStagingMinAlignment) {
+    alignment = kStagingMinAlignment;
+  }
+
+  VkBuffer src_buffer = VK_NULL_HANDLE;
+  VkDeviceSize src_offset = 0U;
+  void *staging = AllocateStaging(device, size, alignment,
+                                  &src_buffer, &src_offset);
+  if (staging != nullptr) {
+    memcpy(staging, data, size);
+  }
+
+  // Rebase the regions onto the staging allocation
+  eastl::vector<VkBufferImageCopy> regions(copy_regions);
+  for (eastl::vector<VkBufferImageCopy>::iterator i = regions.begin();
+       i != regions.end();
+       ++i) {
+    i->bufferOffset += src_offset;
+  }
+
+  VkCommandBuffer cmd_buff = BeginRecording(device);
+
+  // The copy has to wait for the transition, which SetImageLayout's top of
+  // pipe barrier wouldn't order it after
+  tools::SetImageMemoryBarrier(
+      cmd_buff,
+      image.image(),
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      0U,
+      VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      subresource_range,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT);
+  image.set_layout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  vkCmdCopyBufferToImage(
+      cmd_buff,
+      src_buffer,
+      image.image(),
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      SCAST_U32(regions.size()),
+      regions.data());
+  RecordImageRelease(device, image, subresource_range);
+
+  return batches_[current_batch_].ticket;
+}
+
+UploadTicket VulkanUploadManager::Flush(const VulkanDevice &device) {
+  UploadBatch &batch = batches_[current_batch_];
+  if (!batch.recording) {
+    return submitted_ticket_;
+  }
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(batch.cmd_buff));
+
+  VkSubmitInfo submit_info = tools::inits::SubmitInfo();
+  submit_info.waitSemaphoreCount = 0U;
+  submit_info.pWaitSemaphores = nullptr;
+  submit_info.pWaitDstStageMask = nullptr;
+  submit_info.commandBufferCount = 1U;
+  submit_info.pCommandBuffers = &batch.cmd_buff;
+  submit_info.signalSemaphoreCount = 0U;
+  submit_info.pSignalSemaphores = nullptr;
+
+  if (device.HasDedicatedTransferQueue()) {
+    // The copies run on the transfer queue, then the graphics queue acquires
+    // the resources once they have completed; the fence covers both
+    submit_info.signalSemaphoreCount = 1U;
+    submit_info.pSignalSemaphores = &batch.transfer_complete_semaphore;
+    VK_CHECK_RESULT(vkQueueSubmit(device.transfer_queue().queue, 1U,
+                                  &submit_info, VK_NULL_HANDLE));
+
+    RecordAcquireCmdBuffer(batch);
+
+    VkPipelineStageFlags acquire_wait_stage =
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo acquire_submit_info = tools::inits::SubmitInfo();
+    acquire_submit_info.waitSemaphoreCount = 1U;
+    acquire_submit_info.pWaitSemaphores = &batch.transfer_complete_semaphore;
+    acquire_submit_info.pWaitDstStageMask = &acquire_wait_stage;
+    acquire_submit_info.commandBufferCount = 1U;
+    acquire_submit_info.pCommandBuffers = &batch.acquire_cmd_buff;
+    acquire_submit_info.signalSemaphoreCount = 0U;
+    acquire_submit_info.pSignalSemaphores = nullptr;
+    VK_CHECK_RESULT(vkQueueSubmit(device.graphics_queue().queue, 1U,
+                                  &acquire_submit_info, batch.fence));
+  }
+  else {
+    VK_CHECK_RESULT(vkQueueSubmit(device.transfer_queue().queue, 1U,
+                                  &submit_info, batch.fence));
+  }
+
+  batch.ring_end = ring_.head();
+  batch.recording = false;
+  batch.in_flight = true;
+  submitted_ticket_ = batch.ticket;
+
+  // The next batch is the oldest one; it must have completed before its
+  // command buffer can be recorded again
+  current_batch_ = (current_batch_ + 1U) % kUploadBatchesCount;
+  if (batches_[current_batch_].in_flight) {
+    RetireBatch(device, batches_[current_batch_]);
+  }
+
+  return submitted_ticket_;
+}
+
+void VulkanUploadManager::WaitForTicket(
+    const VulkanDevice &device,
+    UploadTicket ticket) {
+  if (ticket <= completed_ticket_) {
+    return;
+  }
+  if (ticket > submitted_ticket_) {
+    Flush(device);
+  }
+
+  // Batches are retired from the oldest one onwards
+  for (uint32_t i = 0U; i < kUploadBatchesCount; ++i) {
+    UploadBatch &batch = batches_[(current_batch_ + i) % kUploadBatchesCount];
+    if (batch.in_flight && batch.ticket <= ticket) {
+      RetireBatch(device, batch);
+    }
+  }
+}
+
+bool VulkanUploadManager::IsTicketComplete(
+    const VulkanDevice &device,
+    UploadTicket ticket) {
+  for (uint32_t i = 0U; i < kUploadBatchesCount; ++i) {
+    UploadBatch &batch = batches_[(current_batch_ + i) % kUploadBatchesCount];
+    if (!batch.in_flight) {
+      continue;
+    }
+    if (vkGetFenceStatus(device.device(), batch.fence) != VK_SUCCESS) {
+      break;
+    }
+    RetireBatch(device, batch);
+  }
+
+  return ticket <= completed_ticket_;
+}
+
+void *VulkanUploadManager::AllocateStaging(
+    const VulkanDevice &device,
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    VkBuffer *src_buffer,
+    VkDeviceSize *src_offset) {
+  // Uploads bigger than the ring get a dedicated staging buffer which lives
+  // until the batch using it completes
+  if (size + alignment > kStagingRingSize) {
+    VulkanBufferInitInfo init_info;
+    init_info.size = size;
+    init_info.buffer_usage_flags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    init_info.memory_property_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    init_info.memory_category = MemoryCategory::STAGING;
+
+    UploadBatch &batch = batches_[current_batch_];
+    batch.overflow_buffers.push_back(VulkanBuffer());
+    batch.overflow_buffers.back().Init(device, init_info);
+
+    void *mapped = nullptr;
+    VK_CHECK_RESULT(batch.overflow_buffers.back().Map(device, &mapped));
+    *src_buffer = batch.overflow_buffers.back().buffer();
+    *src_offset = 0U;
+    ELOG_WARN("Upload of " << size << " bytes doesn't fit in the staging \
+ring, using a dedicated staging buffer.");
+    return mapped;
+  }
+
+  uint64_t offset = 0U;
+  uint64_t consumed = 0U;
+  while (!ring_.Allocate(size, alignment, &offset, &consumed)) {
+    // Submit what has been recorded so far and wait for the oldest batch
+    // to give its space back
+    Flush(device);
+    if (!RetireOldestBatch(device)) {
+      EXIT("Staging ring is full but no upload is in flight!");
+    }
+  }
+
+  batches_[current_batch_].ring_bytes += consumed;
+
+  *src_buffer = staging_ring_.buffer();
+  *src_offset = offset;
+  return mapped_ring_ + offset;
+}
+
+VkCommandBuffer VulkanUploadManager::BeginRecording(
+    const VulkanDevice &device) {
+  UploadBatch &batch = batches_[current_batch_];
+  if (!batch.recording) {
+    VkCommandBufferBeginInfo cmd_buff_begin_info =
+      tools::inits::CommandBufferBeginInfo();
+    cmd_buff_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(batch.cmd_buff,
+                                         &cmd_buff_begin_info));
+    batch.ticket = submitted_ticket_ + 1U;
+    batch.recording = true;
+  }
+
+  return batch.cmd_buff;
+}
+
+void VulkanUploadManager::RecordBufferRelease(
+    const VulkanDevice &device,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkDeviceSize size) {
+  UploadBatch &batch = batches_[current_batch_];
+
+  if (device.HasDedicatedTransferQueue()) {
+    VkBufferMemoryBarrier release_barrier = tools::inits::BufferMemoryBarrier(
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        0U,
+        device.GetTransferQueueIndex(),
+        device.GetGraphicsQueueIndex(),
+        buffer,
+        offset,
+        size);
+    vkCmdPipelineBarrier(
+        batch.cmd_buff,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0U,
+        0U, nullptr,
+        1U, &release_barrier,
+        0U, nullptr);
+
+    batch.acquire_buffer_barriers.push_back(tools::inits::BufferMemoryBarrier(
+        0U,
+        kUploadedBufferAccess,
+        device.GetTransferQueueIndex(),
+        device.GetGraphicsQueueIndex(),
+        buffer,
+        offset,
+        size));
+  }
+  else {
+    VkBufferMemoryBarrier barrier = tools::inits::BufferMemoryBarrier(
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        kUploadedBufferAccess,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        buffer,
+        offset,
+        size);
+    vkCmdPipelineBarrier(
+        batch.cmd_buff,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0U,
+        0U, nullptr,
+        1U, &barrier,
+        0U, nullptr);
+  }
+}
+
+void VulkanUploadManager::RecordImageRelease(
+    const VulkanDevice &device,
+    VulkanImage &image,
+    const VkImageSubresourceRange &subresource_range) {
+  UploadBatch &batch = batches_[current_batch_];
+
+  if (device.HasDedicatedTransferQueue()) {
+    // The layout transition is part of the ownership transfer, so both the
+    // release and the acquire barriers specify it
+    tools::SetImageMemoryBarrier(
+        batch.cmd_buff,
+        image.image(),
+        device.GetTransferQueueIndex(),
+        device.GetGraphicsQueueIndex(),
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        0U,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        subresource_range,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+    batch.acquire_image_barriers.push_back(tools::inits::ImageMemoryBarrier(
+        0U,
+        VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        device.GetTransferQueueIndex(),
+        device.GetGraphicsQueueIndex(),
+        image.image(),
+        subresource_range));
+    image.set_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  }
+  else {
+    // Change the image layout to shader read so that shaders can sample it,
+    // once the copy's writes are done
+    tools::SetImageMemoryBarrier(
+        batch.cmd_buff,
+        image.image(),
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        subresource_range,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    image.set_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  }
+}
+
+void VulkanUploadManager::RecordAcquireCmdBuffer(UploadBatch &batch) {
+  VkCommandBufferBeginInfo cmd_buff_begin_info =
+    tools::inits::CommandBufferBeginInfo();
+  cmd_buff_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK_RESULT(vkBeginCommandBuffer(batch.acquire_cmd_buff,
+                                       &cmd_buff_begin_info));
+
+  vkCmdPipelineBarrier(
+      batch.acquire_cmd_buff,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0U,
+      0U, nullptr,
+      SCAST_U32(batch.acquire_buffer_barriers.size()),
+      batch.acquire_buffer_barriers.data(),
+      SCAST_U32(batch.acquire_image_barriers.size()),
+      batch.acquire_image_barriers.data());
+
+  VK_CHECK_RESULT(vkEndCommandBuffer(batch.acquire_cmd_buff));
+
+  batch.acquire_buffer_barriers.clear();
+  batch.acquire_image_barriers.clear();
+}
+
+bool VulkanUploadManager::RetireOldestBatch(const VulkanDevice &device) {
+  for (uint32_t i = 0U; i < kUploadBatchesCount; ++i) {
+    UploadBatch &batch = batches_[(current_batch_ + i) % kUploadBatchesCount];
+    if (batch.in_flight) {
+      RetireBatch(device, batch);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void VulkanUploadManager::RetireBatch(
+    const VulkanDevice &device,
+    UploadBatch &batch) {
+  VK_CHECK_RESULT(vkWaitForFences(device.device(), 1U, &batch.fence,
+                                  VK_TRUE, UINT64_MAX));
+  VK_CHECK_RESULT(vkResetFences(device.device(), 1U, &batch.fence));
+
+  for (eastl::vector<VulkanBuffer>::iterator i =
+         batch.overflow_buffers.begin();
+       i != batch.overflow_buffers.end();
+       ++i) {
+    i->Unmap(device);
+    i->Shutdown(device);
+  }
+  batch.overflow_buffers.clear();
+
+  ring_.Release(batch.ring_end, batch.ring_bytes);
+  batch.ring_bytes = 0U;
+  batch.in_flight = false;
+  completed_ticket_ = batch.ticket;
+}
+
+} // namespace vks
@@ -0,0 +1,170 @@
+#include <worker_pool.h>
+#include <algorithm>
+#include <logger.hpp>
+
+namespace vks {
+
+// Chunks handed out per thread, so that uneven chunks balance out
+static const uint32_t kChunksPerThread = 4U;
+
+WorkerPool::WorkerPool()
+    : threads_(),
+      tasks_(),
+      jobs_(),
+      mutex_(),
+      tasks_cv_(),
+      done_cv_(),
+      quit_(false) {}
+
+WorkerPool::~WorkerPool() {
+  Shutdown();
+}
+
+void WorkerPool::Init(uint32_t num_threads) {
+  Shutdown();
+
+  if (num_threads == 0U) {
+    uint32_t hw_threads = std::thread::hardware_concurrency();
+    num_threads = (hw_threads > 1U) ? (hw_threads - 1U) : 0U;
+  }
+
+  quit_ = false;
+  threads_.reserve(num_threads);
+  for (uint32_t i = 0U; i < num_threads; ++i) {
+    threads_.push_back(std::thread(&WorkerPool::WorkerMain, this));
+  }
+
+  LOG("Started " << num_threads << " worker threads.");
+}
+
+void WorkerPool::Shutdown() {
+  if (threads_.empty()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  tasks_cv_.notify_all();
+
+  for (eastl::vector<std::thread>::iterator i = threads_.begin();
+       i != threads_.end();
+       ++i) {
+    i->join();
+  }
+  threads_.clear();
+}
+
+void WorkerPool::ParallelFor(
+    uint32_t count,
+    uint32_t min_chunk_size,
+    RangeThunk thunk,
+    const void *context) {
+  if (count == 0U) {
+    return;
+  }
+
+  uint32_t max_chunks = (num_threads() + 1U) * kChunksPerThread;
+  uint32_t num_chunks =
+    std::min(count / std::max(min_chunk_size, 1U), max_chunks);
+  if (threads_.empty() || num_chunks <= 1U) {
+    thunk(context, 0U, count);
+    return;
+  }
+
+  // Rounding up the chunk size may leave fewer chunks than planned
+  uint32_t chunk_size = (count + num_chunks - 1U) / num_chunks;
+  num_chunks = (count + chunk_size - 1U) / chunk_size;
+  std::atomic<uint32_t> pending(num_chunks);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t begin = 0U; begin < count; begin += chunk_size) {
+      Task task;
+      task.thunk = thunk;
+      task.context = context;
+      task.begin = begin;
+      task.end = std::min(begin + chunk_size, count);
+      task.pending = &pending;
+      tasks_.push_back(task);
+    }
+  }
+  tasks_cv_.notify_all();
+
+  // Help out instead of just waiting; this also keeps nested calls from
+  // worker threads from deadlocking
+  while (pending.load() != 0U) {
+    if (!RunPendingTask()) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_cv_.wait(lock, [&pending]() { return pending.load() == 0U; });
+    }
+  }
+}
+
+void WorkerPool::Enqueue(const JobFunction &job) {
+  if (threads_.empty()) {
+    job();
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(job);
+  }
+  tasks_cv_.notify_one();
+}
+
+void WorkerPool::WorkerMain() {
+  for (;;) {
+    Task task;
+    JobFunction job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      tasks_cv_.wait(lock, [this]() {
+        return quit_ || !tasks_.empty() || !jobs_.empty();
+      });
+      if (!tasks_.empty()) {
+        task = tasks_.back();
+        tasks_.pop_back();
+      } else if (!jobs_.empty()) {
+        job = jobs_.front();
+        jobs_.pop_front();
+      } else {
+        return;
+      }
+    }
+
+    if (job) {
+      job();
+    } else {
+      RunTask(task);
+    }
+  }
+}
+
+bool WorkerPool::RunPendingTask() {
+  Task task;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tasks_.empty()) {
+      return false;
+    }
+    task = tasks_.back();
+    tasks_.pop_back();
+  }
+
+  RunTask(task);
+  return true;
+}
+
+void WorkerPool::RunTask(const Task &task) {
+  task.thunk(task.context, task.begin, task.end);
+
+  // Decrement under the lock so that the waiting thread can't miss it
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--(*task.pending) == 0U) {
+    done_cv_.notify_all();
+  }
+}
+
+} // namespace vks
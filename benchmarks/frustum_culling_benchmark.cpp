@@ -0,0 +1,133 @@
+// First, so that glm builds projections with the same depth range as the
+// renderer's
+#include <camera.h>
+#include <frustum.h>
+#include <vks_benchmark.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <EASTL/vector.h>
+#include <cstdlib>
+
+// About the meshes of a large scene
+static const uint32_t kVolumesCount = 100000U;
+// Tests per run, so that a run takes long enough to time
+static const uint32_t kRepeats = 20U;
+
+static float RandomFloat(float min_value, float max_value) {
+  return min_value + (max_value - min_value) *
+    static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+}
+
+// The plain loops Frustum falls back to without SSE
+static void TestSpheresScalar(
+    const glm::vec4 *planes,
+    const glm::vec4 *spheres,
+    uint32_t count,
+    uint8_t *visible) {
+  for (uint32_t i = 0U; i < count; ++i) {
+    glm::vec3 centre(spheres[i]);
+    visible[i] = 1U;
+    for (uint32_t p = 0U; p < 6U; ++p) {
+      if (glm::dot(glm::vec3(planes[p]), centre) + planes[p].w <
+          -spheres[i].w) {
+        visible[i] = 0U;
+        break;
+      }
+    }
+  }
+}
+
+static void TestBoxesScalar(
+    const glm::vec4 *planes,
+    const glm::vec3 *boxes_min,
+    const glm::vec3 *boxes_max,
+    uint32_t count,
+    uint8_t *visible) {
+  for (uint32_t i = 0U; i < count; ++i) {
+    glm::vec3 centre = (boxes_min[i] + boxes_max[i]) * 0.5f;
+    glm::vec3 extent = (boxes_max[i] - boxes_min[i]) * 0.5f;
+    visible[i] = 1U;
+    for (uint32_t p = 0U; p < 6U; ++p) {
+      glm::vec3 normal(planes[p]);
+      if (glm::dot(normal, centre) + planes[p].w +
+          glm::dot(glm::abs(normal), extent) < 0.f) {
+        visible[i] = 0U;
+        break;
+      }
+    }
+  }
+}
+
+static uint32_t CountDifferences(
+    const eastl::vector<uint8_t> &a,
+    const eastl::vector<uint8_t> &b) {
+  uint32_t differences = 0U;
+  for (uint32_t i = 0U; i < a.size(); ++i) {
+    differences += (a[i] != b[i]) ? 1U : 0U;
+  }
+  return differences;
+}
+
+int main() {
+  // Volumes scattered all around a camera at the origin, so that only some
+  // of them are in view
+  eastl::vector<glm::vec4> spheres(kVolumesCount);
+  eastl::vector<glm::vec3> boxes_min(kVolumesCount);
+  eastl::vector<glm::vec3> boxes_max(kVolumesCount);
+  for (uint32_t i = 0U; i < kVolumesCount; ++i) {
+    glm::vec3 centre(RandomFloat(-100.f, 100.f), RandomFloat(-100.f, 100.f),
+                     RandomFloat(-100.f, 100.f));
+    glm::vec3 extent(RandomFloat(0.1f, 2.f), RandomFloat(0.1f, 2.f),
+                     RandomFloat(0.1f, 2.f));
+    spheres[i] = glm::vec4(centre, glm::length(extent));
+    boxes_min[i] = centre - extent;
+    boxes_max[i] = centre + extent;
+  }
+
+  glm::mat4 proj = glm::perspective(glm::radians(90.f), 16.f / 9.f, 0.1f,
+                                    150.f);
+  glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f),
+                               glm::vec3(0.f, 1.f, 0.f));
+  szt::Frustum frustum;
+  frustum.ExtractPlanes(proj * view);
+  const glm::vec4 *planes = frustum.planes();
+
+  eastl::vector<uint8_t> visible(kVolumesCount);
+  eastl::vector<uint8_t> visible_scalar(kVolumesCount);
+  double tests = static_cast<double>(kVolumesCount) * kRepeats;
+
+  double spheres_scalar = MeasureBest([&]() {
+    for (uint32_t r = 0U; r < kRepeats; ++r) {
+      TestSpheresScalar(planes, spheres.data(), kVolumesCount,
+                        visible_scalar.data());
+    }
+  });
+  double spheres_simd = MeasureBest([&]() {
+    for (uint32_t r = 0U; r < kRepeats; ++r) {
+      frustum.TestSpheres(spheres.data(), kVolumesCount, visible.data());
+    }
+  });
+  printf("Spheres, %u volumes, %u results differ\n", kVolumesCount,
+         CountDifferences(visible, visible_scalar));
+  ReportBenchmark("  Scalar", tests, spheres_scalar, spheres_scalar);
+  ReportBenchmark("  Frustum::TestSpheres", tests, spheres_simd,
+                  spheres_scalar);
+
+  double boxes_scalar = MeasureBest([&]() {
+    for (uint32_t r = 0U; r < kRepeats; ++r) {
+      TestBoxesScalar(planes, boxes_min.data(), boxes_max.data(),
+                      kVolumesCount, visible_scalar.data());
+    }
+  });
+  double boxes_simd = MeasureBest([&]() {
+    for (uint32_t r = 0U; r < kRepeats; ++r) {
+      frustum.TestBoxes(boxes_min.data(), boxes_max.data(), kVolumesCount,
+                        visible.data());
+    }
+  });
+  printf("Boxes, %u volumes, %u results differ\n", kVolumesCount,
+         CountDifferences(visible, visible_scalar));
+  ReportBenchmark("  Scalar", tests, boxes_scalar, boxes_scalar);
+  ReportBenchmark("  Frustum::TestBoxes", tests, boxes_simd, boxes_scalar);
+
+  return EXIT_SUCCESS;
+}
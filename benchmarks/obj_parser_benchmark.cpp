@@ -0,0 +1,96 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <obj_parser.h>
+#include <base_system.h>
+#include <worker_pool.h>
+#include <vks_benchmark.h>
+#include <tiny_obj_loader.h>
+#include <cstdlib>
+
+// Vertices along each side of the generated grid; about a 40 MB OBJ
+static const uint32_t kGridSize = 512U;
+// Faces between group and material switches
+static const uint32_t kFacesPerGroup = 4096U;
+static const char *kGeneratedObjName = "vks_obj_parser_benchmark.obj";
+
+/**
+ * @brief Writes a grid of quads with positions, normals and UVs, split into
+ *   groups which switch between a few materials, like an exported scene
+ */
+static bool WriteGridObj(const char *filename) {
+  FILE *file = fopen(filename, "w");
+  if (file == nullptr) {
+    return false;
+  }
+
+  for (uint32_t y = 0U; y < kGridSize; ++y) {
+    for (uint32_t x = 0U; x < kGridSize; ++x) {
+      float u = static_cast<float>(x) / static_cast<float>(kGridSize - 1U);
+      float v = static_cast<float>(y) / static_cast<float>(kGridSize - 1U);
+      fprintf(file, "v %f %f %f\n", u * 100.f, (u - v) * 0.25f, v * 100.f);
+      fprintf(file, "vn %f %f %f\n", 0.f, 1.f, 0.f);
+      fprintf(file, "vt %f %f\n", u, v);
+    }
+  }
+
+  uint32_t faces_count = 0U;
+  for (uint32_t y = 0U; y + 1U < kGridSize; ++y) {
+    for (uint32_t x = 0U; x + 1U < kGridSize; ++x, ++faces_count) {
+      if (faces_count % kFacesPerGroup == 0U) {
+        uint32_t group = faces_count / kFacesPerGroup;
+        fprintf(file, "g group_%u\nusemtl material_%u\n", group, group % 8U);
+      }
+      uint32_t i = y * kGridSize + x + 1U;
+      uint32_t j = i + kGridSize;
+      fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n",
+              i, i, i, i + 1U, i + 1U, i + 1U,
+              j + 1U, j + 1U, j + 1U, j, j, j);
+    }
+  }
+
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  // An OBJ given on the command line is parsed instead of a generated one
+  const char *filename = argc > 1 ? argv[1] : kGeneratedObjName;
+  if (argc <= 1 && !WriteGridObj(filename)) {
+    fprintf(stderr, "Couldn't write %s\n", filename);
+    return EXIT_FAILURE;
+  }
+
+  vks::worker_pool()->Init();
+
+  size_t triangles_count = 0U;
+  double tinyobj_seconds = MeasureBest([&]() {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string err;
+    tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename, "");
+    triangles_count = 0U;
+    for (size_t i = 0U; i < shapes.size(); ++i) {
+      triangles_count += shapes[i].mesh.indices.size() / 3U;
+    }
+  });
+  double parser_seconds = MeasureBest([&]() {
+    vks::ObjScene scene;
+    eastl::string err;
+    vks::ParseObj(filename, "", &scene, &err);
+  });
+
+  printf("%s, %u triangles, %u worker threads\n", filename,
+         static_cast<uint32_t>(triangles_count),
+         vks::worker_pool()->num_threads());
+  ReportBenchmark("  tinyobjloader", static_cast<double>(triangles_count),
+                  tinyobj_seconds, tinyobj_seconds);
+  ReportBenchmark("  ParseObj", static_cast<double>(triangles_count),
+                  parser_seconds, tinyobj_seconds);
+
+  vks::worker_pool()->Shutdown();
+  if (argc <= 1) {
+    remove(filename);
+  }
+
+  return EXIT_SUCCESS;
+}
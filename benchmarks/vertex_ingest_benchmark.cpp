@@ -0,0 +1,100 @@
+#include <model.h>
+#include <vertex_setup.h>
+#include <vks_benchmark.h>
+#include <cstdlib>
+
+// About a crytek-sponza's worth of unique vertices
+static const uint32_t kVerticesCount = 1U << 18U;
+
+// The fplus layout: quantized positions in their own stream, the quantized
+// tangent frame and half UVs interleaved in another
+static vks::VertexSetup *CreateQuantizedSetup() {
+  eastl::vector<vks::VertexElement> vtx_layout;
+  vtx_layout.push_back(vks::VertexElement(
+        vks::VertexElementType::POSITION,
+        4U * SCAST_U32(sizeof(int16_t)),
+        VK_FORMAT_R16G16B16A16_SNORM,
+        vks::VertexElementEncoding::SNORM16_POSITION));
+  vtx_layout.push_back(vks::VertexElement(
+        vks::VertexElementType::NORMAL,
+        4U * SCAST_U32(sizeof(int16_t)),
+        VK_FORMAT_R16G16B16A16_SNORM,
+        vks::VertexElementEncoding::TANGENT_FRAME_SNORM16));
+  vtx_layout.push_back(vks::VertexElement(
+        vks::VertexElementType::UV,
+        2U * SCAST_U32(sizeof(uint16_t)),
+        VK_FORMAT_R16G16_SFLOAT,
+        vks::VertexElementEncoding::HALF));
+  return new vks::VertexSetup(
+      vtx_layout,
+      vks::VertexStreamsLayout::POSITION_INTERLEAVED);
+}
+
+// Plain floats in separate streams, where each element is a strided copy
+static vks::VertexSetup *CreateFloatSetup() {
+  eastl::vector<vks::VertexElement> vtx_layout;
+  vtx_layout.push_back(vks::VertexElement(
+        vks::VertexElementType::POSITION,
+        3U * SCAST_U32(sizeof(float)),
+        VK_FORMAT_R32G32B32_SFLOAT));
+  vtx_layout.push_back(vks::VertexElement(
+        vks::VertexElementType::NORMAL,
+        3U * SCAST_U32(sizeof(float)),
+        VK_FORMAT_R32G32B32_SFLOAT));
+  vtx_layout.push_back(vks::VertexElement(
+        vks::VertexElementType::UV,
+        2U * SCAST_U32(sizeof(float)),
+        VK_FORMAT_R32G32_SFLOAT));
+  return new vks::VertexSetup(vtx_layout);
+}
+
+static float RandomFloat() {
+  return static_cast<float>(rand()) / static_cast<float>(RAND_MAX) * 2.f -
+    1.f;
+}
+
+static void BenchmarkSetup(
+    const char *name,
+    const vks::VertexSetup &vertex_setup,
+    const eastl::vector<vks::Vertex> &vertices) {
+  const vks::Vertex *data = vertices.data();
+  uint32_t count = SCAST_U32(vertices.size());
+
+  double per_vertex = MeasureBest([&]() {
+    vks::ModelBuilder builder(vertex_setup, VK_NULL_HANDLE);
+    for (uint32_t i = 0U; i < count; ++i) {
+      builder.AddVertex(data[i]);
+    }
+  });
+  double bulk = MeasureBest([&]() {
+    vks::ModelBuilder builder(vertex_setup, VK_NULL_HANDLE);
+    builder.AddVertices(data, count);
+  });
+
+  printf("%s, %u vertices\n", name, count);
+  ReportBenchmark("  AddVertex per vertex", count, per_vertex, per_vertex);
+  ReportBenchmark("  AddVertices", count, bulk, per_vertex);
+}
+
+int main() {
+  eastl::vector<vks::Vertex> vertices(kVerticesCount);
+  for (uint32_t i = 0U; i < kVerticesCount; ++i) {
+    vks::Vertex &vertex = vertices[i];
+    vertex.pos = glm::vec3(RandomFloat(), RandomFloat(), RandomFloat());
+    vertex.normal = glm::normalize(
+        glm::vec3(RandomFloat(), RandomFloat(), 2.f));
+    vertex.tangent = glm::normalize(glm::vec3(2.f, RandomFloat(), 0.f));
+    vertex.bitangent = glm::cross(vertex.normal, vertex.tangent);
+    vertex.uv = glm::vec3(RandomFloat(), RandomFloat(), 0.f);
+  }
+
+  vks::VertexSetup *quantized_setup = CreateQuantizedSetup();
+  vks::VertexSetup *float_setup = CreateFloatSetup();
+  BenchmarkSetup("Quantized, position + interleaved", *quantized_setup,
+                 vertices);
+  BenchmarkSetup("Floats, separate streams", *float_setup, vertices);
+  delete quantized_setup;
+  delete float_setup;
+
+  return EXIT_SUCCESS;
+}
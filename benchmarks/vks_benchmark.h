@@ -0,0 +1,42 @@
+#ifndef VKS_BENCHMARK
+#define VKS_BENCHMARK
+
+#include <Timer.h>
+#include <cstdint>
+#include <cstdio>
+
+// Benchmarks are plain executables, built with VKS_BUILD_BENCHMARKS and run
+// by hand in release builds; they aren't registered with ctest
+static const uint32_t kBenchmarkRuns = 5U;
+
+/**
+ * @brief Runs function kBenchmarkRuns times and returns the fastest run, in
+ *   seconds, which is the least disturbed by the rest of the system
+ */
+template <typename Function>
+double MeasureBest(const Function &function) {
+  double best = 0.0;
+  for (uint32_t i = 0U; i < kBenchmarkRuns; ++i) {
+    Timer timer;
+    timer.start();
+    function();
+    timer.stop();
+    double seconds = timer.getElapsedTimeInSec();
+    if (i == 0U || seconds < best) {
+      best = seconds;
+    }
+  }
+  return best;
+}
+
+// Prints a case as items per second, next to the baseline it is compared to
+inline void ReportBenchmark(
+    const char *name,
+    double items,
+    double seconds,
+    double baseline_seconds) {
+  printf("%-40s %10.2f M/s %8.2fx\n", name, items / seconds * 1e-6,
+         baseline_seconds / seconds);
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <array>
 #include <vulkan_tools.h>
 #include <model.h>
+#include <bounds.h>
 #include <cassert>
 #include <logger.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -13,11 +14,15 @@
 #include <material_texture_type.h>
 #include <vertex_setup.h>
 #include <EASTL/vector.h>
+#include <EASTL/algorithm.h>
+#include <EASTL/sort.h>
 #include <random>
 #include <cstring>
 #include <vulkan_texture.h>
 #include <vulkan_image.h>
 #include <meshes_heap_manager.h>
+#include <meshlets.h>
+#include <worker_pool.h>
 
 namespace vks {
 
@@ -28,6 +33,7 @@ const VkFormat kNormalFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
 const VkFormat kPositionFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
 const VkFormat kSSAOFormat = VK_FORMAT_R8_UNORM;
 const VkFormat kAccumulationFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+const VkFormat kDepthPyramidFormat = VK_FORMAT_R32_SFLOAT;
 extern const int32_t kWindowWidth;
 extern const int32_t kWindowHeight;
 const uint32_t kTileSize = 16U;
@@ -47,6 +53,15 @@ const uint32_t kAccumulationBufferBindingPos = 7U;
 const uint32_t kLightsArrayBindingPos = 8U;
 const uint32_t kLightsIndicesBindingPos = 9U;
 const uint32_t kMatConstsArrayBindingPos = 11U;
+const uint32_t kMeshCullConstsBindingPos = 12U;
+const uint32_t kCandidateDrawsBindingPos = 13U;
+const uint32_t kMeshesCullDataBindingPos = 14U;
+const uint32_t kCulledDrawsBindingPos = 15U;
+const uint32_t kDrawCountsBindingPos = 16U;
+const uint32_t kMeshesVisibilityBindingPos = 17U;
+const uint32_t kDepthPyramidBindingPos = 18U;
+const uint32_t kPyramidSrcBindingPos = 0U;
+const uint32_t kPyramidDstBindingPos = 1U;
 extern const uint32_t kModelMatxsBufferBindPos;
 extern const uint32_t kMaterialIDsBufferBindPos;
 const uint32_t kSpecInfoDrawCmdsCountID = 0U;
@@ -56,8 +71,13 @@ const uint32_t kBindingsCount = 10U;
 //const uint32_t kSSAOBuffersBindingPos = 8U;
 //const uint32_t kSSAOKernelBindingPos = 9U;
 const uint32_t kMaxNumUniformBuffers = 5U;
-const uint32_t kMaxNumSSBOs = 30U;
+const uint32_t kMaxNumSSBOs = 40U;
+// The texture arrays and the material constants are sized for this many
+// instances up front, so registering a model doesn't recreate the layouts
 const uint32_t kMaxNumMatInstances = 30U;
+const uint32_t kMaxRegisteredModels = 16U;
+// Model matrices and material IDs
+const uint32_t kModelSetSSBOsCount = 2U;
 const uint32_t kNumMeshesSpecConstPos = 0U;
 const uint32_t kNumMaterialsSpecConstPos = 0U;
 //const uint32_t kSSAOKernelSizeSpecConstPos = 0U;
@@ -74,8 +94,34 @@ const uint32_t kTileSizeSpecConstPos = 0U;
 const uint32_t kMaxLightsPerTileSpecConstPos = 2U;
 const uint32_t kRasterWidthSpecConstPos = 3U;
 const uint32_t kRasterHeightSpecConstPos = 4U;
+const uint32_t kCompactDrawsSpecConstPos = 0U;
+const uint32_t kLatePhaseSpecConstPos = 1U;
+// Local size of mesh_culling.comp
+const uint32_t kMeshCullingGroupSize = 64U;
+// Local size of depth_pyramid.comp, in both dimensions
+const uint32_t kDepthPyramidGroupSize = 8U;
+// Enough for a 32k wide screen
+const uint32_t kMaxDepthPyramidLevels = 16U;
+// Draws whose sort keys a thread makes, at least
+const uint32_t kMinSortKeysChunkSize = 1024U;
 const eastl::string kBaseShaderAssetsPath = STR(ASSETS_FOLDER) "shaders/";
 
+// Layouts of the buffers mesh_culling.comp reads
+struct MeshCullConsts {
+  glm::vec4 frustum_planes[6U];
+  uint32_t draws_count;
+  uint32_t groups_count;
+  uint32_t visibility_parity;
+  uint32_t padding;
+}; // struct MeshCullConsts
+
+struct MeshCullData {
+  glm::vec4 bounding_sphere;
+  uint32_t draw_group;
+  uint32_t group_first_draw;
+  uint32_t padding[2U];
+}; // struct MeshCullData
+
 //const uint32_t kIndirectDrawCmdsBindingPos = 4U;
 //const uint32_t kSSAOKernelSize = 16U;
 //const float kSSAORadius = 2.f;
@@ -83,6 +129,7 @@ const eastl::string kBaseShaderAssetsPath = STR(ASSETS_FOLDER) "shaders/";
 
 FPlusRenderer::FPlusRenderer()
   : depth_prepass_renderpass_(),
+  depth_prepass_late_renderpass_(),
   shade_renderpass_(),
   framebuffers_(),
   depth_prepass_framebuffer_(),
@@ -92,11 +139,14 @@ FPlusRenderer::FPlusRenderer()
   cmd_buff_depth_prepass_(VK_NULL_HANDLE),
   depth_prepass_complete_semaphore_(VK_NULL_HANDLE),
   light_culling_complete_semaphore_(VK_NULL_HANDLE),
+  frame_complete_fence_(VK_NULL_HANDLE),
   accum_buffer_(),
   depth_buffer_(),
   depth_buffer_depth_view_(nullptr),
   depth_prepass_material_(nullptr),
   lights_cull_material_(nullptr),
+  mesh_cull_materials_(),
+  depth_pyramid_material_(nullptr),
   shading_material_(nullptr),
   tonemap_material_(nullptr),
   dummy_texture_(),
@@ -106,6 +156,10 @@ FPlusRenderer::FPlusRenderer()
   desc_sets_(),
   desc_pool_(VK_NULL_HANDLE),
   pipe_layouts_(),
+  depth_pyramid_(),
+  depth_pyramid_level_views_(),
+  depth_pyramid_set_layout_(VK_NULL_HANDLE),
+  depth_pyramid_sets_(),
   main_static_buff_(),
   light_idxs_buff_(),
   proj_mat_(1.f),
@@ -117,11 +171,39 @@ FPlusRenderer::FPlusRenderer()
   nearest_sampler_(VK_NULL_HANDLE),
   nearest_sampler_repeat_(VK_NULL_HANDLE),
   registered_models_(),
+  batched_draws_(false),
+  max_draws_per_call_(1U),
+  indirect_models_(),
+  draw_groups_(),
+  meshes_model_matxs_buff_(),
+  meshes_material_ids_buff_(),
+  meshes_desc_set_(VK_NULL_HANDLE),
+  frame_draws_buff_(),
+  culled_draws_buff_(),
+  draw_counts_buff_(),
+  mesh_cull_consts_buff_(),
+  meshes_cull_data_buff_(),
+  meshes_visibility_buff_(),
+  visibility_parity_(0U),
+  meshes_spheres_(),
+  meshes_materials_(),
+  draws_queue_(),
+  residency_generation_(0U),
+  geometry_generation_(0U),
   fullscreenquad_(nullptr) {}
 
-void FPlusRenderer::Init(szt::Camera *cam) {
+void FPlusRenderer::Init(szt::Camera *cam,
+                         const VertexSetup &g_store_vertex_setup) {
   cam_ = cam;
 
+  const VulkanDevice &device = vulkan()->device();
+  batched_draws_ =
+    device.physical_features().drawIndirectFirstInstance == VK_TRUE;
+  if (device.physical_features().multiDrawIndirect == VK_TRUE) {
+    max_draws_per_call_ =
+      device.physical_properties().limits.maxDrawIndirectCount;
+  }
+
   SetupSamplers(vulkan()->device());
   SetupDescriptorPool(vulkan()->device());
   
@@ -140,8 +222,18 @@ void FPlusRenderer::Init(szt::Camera *cam) {
   SetupMaterials(vulkan()->device());
   SetupRenderPass(vulkan()->device());
   SetupFrameBuffers(vulkan()->device());
-  CreateSemaphores(vulkan()->device());
+  if (batched_draws_) {
+    SetupDepthPyramid(vulkan()->device());
+  }
+  CreateSyncObjects(vulkan()->device());
   CreateCommandBuffers(vulkan()->device());
+
+  // What doesn't depend on the models is created once; registering them
+  // only rewrites the descriptors and re-records the commands
+  SetupDescriptorSetAndPipeLayout(vulkan()->device());
+  SetupUniformBuffers(vulkan()->device());
+  SetupMaterialPipelines(vulkan()->device(), g_store_vertex_setup);
+  SetupFullscreenQuad(vulkan()->device());
 }
 
 void FPlusRenderer::Shutdown() {
@@ -187,6 +279,13 @@ void FPlusRenderer::Shutdown() {
         desc_set_layouts_[i],
         nullptr);
   }
+  if (depth_pyramid_set_layout_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(
+        vulkan()->device().device(),
+        depth_pyramid_set_layout_,
+        nullptr);
+    depth_pyramid_set_layout_ = VK_NULL_HANDLE;
+  }
 
   if (depth_prepass_complete_semaphore_!= VK_NULL_HANDLE) {
     vkDestroySemaphore(vulkan()->device().device(), depth_prepass_complete_semaphore_,
@@ -198,17 +297,54 @@ void FPlusRenderer::Shutdown() {
                        nullptr);
     light_culling_complete_semaphore_ = VK_NULL_HANDLE;
   }
+  if (frame_complete_fence_ != VK_NULL_HANDLE) {
+    vkDestroyFence(vulkan()->device().device(), frame_complete_fence_, nullptr);
+    frame_complete_fence_ = VK_NULL_HANDLE;
+  }
 
 
   light_idxs_buff_.Shutdown(vulkan()->device());
   main_static_buff_.Shutdown(vulkan()->device());
+  frame_draws_buff_.Shutdown(vulkan()->device());
+  culled_draws_buff_.Shutdown(vulkan()->device());
+  draw_counts_buff_.Shutdown(vulkan()->device());
+  mesh_cull_consts_buff_.Shutdown(vulkan()->device());
+  meshes_cull_data_buff_.Shutdown(vulkan()->device());
+  meshes_visibility_buff_.Shutdown(vulkan()->device());
+  meshes_material_ids_buff_.Shutdown(vulkan()->device());
+  meshes_model_matxs_buff_.Shutdown(vulkan()->device());
+  depth_pyramid_level_views_.clear();
+  depth_pyramid_.Shutdown(vulkan()->device());
   framebuffers_.clear();
   depth_prepass_framebuffer_.reset(nullptr);
   shade_renderpass_.reset(nullptr);
+  depth_prepass_late_renderpass_.reset(nullptr);
   depth_prepass_renderpass_.reset(nullptr);
 }
 
 void FPlusRenderer::PreRender() {
+  // Evicted and reloaded resources change what the descriptors and the
+  // recorded commands can use, and so do geometry arenas moving to new
+  // buffers; this is rare enough to wait for the GPU
+  bool residency_changed =
+    residency_generation_ != residency_manager()->generation();
+  bool geometry_changed =
+    geometry_generation_ != model_manager()->GetGeometryGeneration();
+  if (residency_changed || geometry_changed) {
+    vkDeviceWaitIdle(vulkan()->device().device());
+    if (residency_changed) {
+      SetupDescriptorSets(vulkan()->device());
+      SetupComputeCommandBuffers(vulkan()->device());
+    }
+    SetupGraphicsCommandBuffers(vulkan()->device());
+    residency_generation_ = residency_manager()->generation();
+    geometry_generation_ = model_manager()->GetGeometryGeneration();
+  }
+
+  // The draws, the culling constants and the matrices are rewritten in place
+  // through their mappings, so the previous frame has to be done reading them
+  VK_CHECK_RESULT(vkWaitForFences(vulkan()->device().device(), 1U,
+                                  &frame_complete_fence_, VK_TRUE, UINT64_MAX));
   UpdateBuffers(vulkan()->device());
 
   vulkan()->swapchain().AcquireNextImage(
@@ -219,11 +355,86 @@ void FPlusRenderer::PreRender() {
 
 void FPlusRenderer::UpdateBuffers(const VulkanDevice &device) {
   UpdatePVMatrices();
-  eastl::vector<Light> transformed_lights;
+
+  // Pick the LODs and drop the meshlets which can't be seen before the
+  // frame's draws are read
+  float viewport_height = SCAST_FLOAT(cam_->viewport().height);
+  szt::Frustum frustum;
+  frustum.ExtractPlanes(proj_mat_ * view_mat_);
+  if (batched_draws_) {
+    // The models write their draws where SetupIndirectDraws laid them out,
+    // and they are uploaded in the order they are sorted in
+    const DrawGroup &last_group = draw_groups_.back();
+    uint32_t draws_count = last_group.first_draw + last_group.draws_count;
+    FrameVector<VkDrawIndexedIndirectCommand> frame_draws(draws_count);
+    for (eastl::vector<IndirectModel>::const_iterator itor =
+           indirect_models_.begin();
+         itor != indirect_models_.end();
+         ++itor) {
+      // Registered models count as used even when out of view, as turning
+      // the camera would otherwise evict and reload them. The draws of
+      // culled models, and of models which aren't resident, are recorded
+      // until the commands are next recorded, so they have to be emptied
+      const Model &model = *itor->model;
+      bool resident = model_manager()->MarkModelUsed(model);
+      FrameVector<uint8_t> meshes_visible(model.NumMeshes());
+      if (!model.CullMeshes(frustum, meshes_visible.data()) || !resident) {
+        memset(frame_draws.data() + itor->first_draw, 0,
+               model.GetDrawsCount() * sizeof(VkDrawIndexedIndirectCommand));
+        continue;
+      }
+      model.WriteDraws(proj_mat_, view_mat_, viewport_height,
+                       meshes_visible.data(), itor->first_mesh_id,
+                       frame_draws.data() + itor->first_draw);
+    }
+    SortFrameDraws(frame_draws.data());
+
+    void *mapped_draws = nullptr;
+    frame_draws_buff_.Map(device, &mapped_draws);
+    VkDrawIndexedIndirectCommand *draws =
+      static_cast<VkDrawIndexedIndirectCommand *>(mapped_draws);
+    const RenderQueueItem *sorted_draws = draws_queue_.items();
+    for (uint32_t i = 0U; i < draws_count; ++i) {
+      draws[i] = frame_draws[sorted_draws[i].value];
+    }
+    frame_draws_buff_.Unmap(device);
+
+    // Culled on the GPU against the same frustum, and what last frame's
+    // meshes left in the depth buffer
+    MeshCullConsts cull_consts = {};
+    ExtractFrustumPlanes(proj_mat_ * view_mat_, cull_consts.frustum_planes);
+    cull_consts.draws_count = draws_count;
+    cull_consts.groups_count = SCAST_U32(draw_groups_.size());
+    visibility_parity_ = 1U - visibility_parity_;
+    cull_consts.visibility_parity = visibility_parity_;
+    void *mapped_consts = nullptr;
+    mesh_cull_consts_buff_.Map(device, &mapped_consts);
+    memcpy(mapped_consts, &cull_consts, sizeof(cull_consts));
+    mesh_cull_consts_buff_.Unmap(device);
+  }
+  else {
+    for (eastl::vector<Model*>::iterator itor = registered_models_.begin();
+         itor != registered_models_.end();
+         ++itor) {
+      // Models out of view still count as used, and empty their draws
+      Model &model = **itor;
+      bool resident = model_manager()->MarkModelUsed(model);
+      if (!resident) {
+        continue;
+      }
+      FrameVector<uint8_t> meshes_visible(model.NumMeshes());
+      model.CullMeshes(frustum, meshes_visible.data());
+      model.UpdateDraws(device, proj_mat_, view_mat_, viewport_height,
+                        meshes_visible.data(), frame_complete_fence_);
+    }
+  }
+
+  FrameVector<Light> transformed_lights;
   UpdateLights(transformed_lights);
 
-  // Cache some sizes
-  uint32_t num_mat_instances = material_manager()->GetMaterialInstancesCount();
+  // Cache some sizes; the instances of models still loading aren't in the
+  // constants until they are registered
+  uint32_t num_mat_instances = SCAST_U32(mat_consts_.size());
   uint32_t num_lights = SCAST_U32(transformed_lights.size());
   uint32_t mat4_size = SCAST_U32(sizeof(glm::mat4));
   uint32_t mat4_group_size = mat4_size * 4U;
@@ -309,11 +520,15 @@ void FPlusRenderer::Render() {
       queue_compute_infos.size(),
       queue_compute_infos.data(),
       VK_NULL_HANDLE));
+  // The shading submission waits on the culling one, which waits on the
+  // depth prepass, so its fence covers the whole frame
+  VK_CHECK_RESULT(vkResetFences(vulkan()->device().device(), 1U,
+                                &frame_complete_fence_));
   VK_CHECK_RESULT(vkQueueSubmit(
       vulkan()->device().graphics_queue().queue,
       queue_graphics_infos.size(),
       queue_graphics_infos.data(),
-      VK_NULL_HANDLE));
+      frame_complete_fence_));
 }
 
 void FPlusRenderer::PostRender() {
@@ -324,6 +539,8 @@ void FPlusRenderer::PostRender() {
 
 void FPlusRenderer::SetupRenderPass(const VulkanDevice &device) {
   depth_prepass_renderpass_ = eastl::make_unique<Renderpass>("depth_prepass");
+  depth_prepass_late_renderpass_ =
+    eastl::make_unique<Renderpass>("depth_prepass_late");
   shade_renderpass_ = eastl::make_unique<Renderpass>("shade_pass");
 
   // Colour buffer target 
@@ -359,6 +576,18 @@ void FPlusRenderer::SetupRenderPass(const VulkanDevice &device) {
       VK_ATTACHMENT_STORE_OP_DONT_CARE,
       VK_IMAGE_LAYOUT_UNDEFINED,
       VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+  // Keeps the early draws' depth, which the depth pyramid was built from
+  uint32_t depth_buf_prepass_late_id =
+    depth_prepass_late_renderpass_->AddAttachment(
+      0U,
+      device.depth_format(),
+      VK_SAMPLE_COUNT_1_BIT,
+      VK_ATTACHMENT_LOAD_OP_LOAD,
+      VK_ATTACHMENT_STORE_OP_STORE,
+      VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+      VK_ATTACHMENT_STORE_OP_DONT_CARE,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 
   // Accumulation buffer
   uint32_t accum_id = shade_renderpass_->AddAttachment(
@@ -366,7 +595,7 @@ void FPlusRenderer::SetupRenderPass(const VulkanDevice &device) {
       kAccumulationFormat,
       VK_SAMPLE_COUNT_1_BIT,
       VK_ATTACHMENT_LOAD_OP_CLEAR,
-      VK_ATTACHMENT_STORE_OP_STORE,
+      VK_ATTACHMENT_STORE_OP_DONT_CARE,
       VK_ATTACHMENT_LOAD_OP_DONT_CARE,
       VK_ATTACHMENT_STORE_OP_DONT_CARE,
       VK_IMAGE_LAYOUT_UNDEFINED,
@@ -404,6 +633,26 @@ void FPlusRenderer::SetupRenderPass(const VulkanDevice &device) {
       first_sub_prepass_id,
       depth_buf_prepass_id,
       VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+  uint32_t late_sub_prepass_id = depth_prepass_late_renderpass_->AddSubpass(
+      "depth_prepass_late",
+      VK_PIPELINE_BIND_POINT_GRAPHICS);
+  depth_prepass_late_renderpass_->AddSubpassDepthAttachmentRef(
+      late_sub_prepass_id,
+      depth_buf_prepass_late_id,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+  // The depth pyramid has to be done reading the depth before it is written
+  // again
+  depth_prepass_late_renderpass_->AddSubpassDependency(
+      VK_SUBPASS_EXTERNAL,
+      late_sub_prepass_id,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+      VK_ACCESS_SHADER_READ_BIT,
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+      0U);
   
   uint32_t first_sub_shade_id = shade_renderpass_->AddSubpass(
       "shade",
@@ -567,9 +816,10 @@ void FPlusRenderer::SetupRenderPass(const VulkanDevice &device) {
 
   shade_renderpass_->CreateVulkanRenderpass(device);
   depth_prepass_renderpass_->CreateVulkanRenderpass(device);
+  depth_prepass_late_renderpass_->CreateVulkanRenderpass(device);
 }
 
-void FPlusRenderer::CreateSemaphores(const VulkanDevice &device) {
+void FPlusRenderer::CreateSyncObjects(const VulkanDevice &device) {
   VkSemaphoreCreateInfo semaphore_create_info = {
     VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
     nullptr,
@@ -580,44 +830,61 @@ void FPlusRenderer::CreateSemaphores(const VulkanDevice &device) {
                                     nullptr, &depth_prepass_complete_semaphore_));
   VK_CHECK_RESULT(vkCreateSemaphore(device.device(), &semaphore_create_info,
                                     nullptr, &light_culling_complete_semaphore_));
+
+  // Signaled already, as there's no frame in flight to wait for yet
+  VkFenceCreateInfo fence_create_info =
+    tools::inits::FenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+  VK_CHECK_RESULT(vkCreateFence(device.device(), &fence_create_info, nullptr,
+                                &frame_complete_fence_));
 }
 
 void FPlusRenderer::SetupFrameBuffers(const VulkanDevice &device) {
-  // Accumulation buffer
-  CreateFramebufferAttachment(
-      device,
+  eastl::vector<RenderTargetInfo> render_targets;
+
+  // Accumulation buffer; it is only read by the tonemapping subpass, so it
+  // never has to leave tile memory
+  render_targets.push_back(GetRenderTargetInfo(
       kAccumulationFormat,
-      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-        VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+      RenderTargetLifetime::TRANSIENT,
+      kNoAliasGroup,
       "accumulation",
-      &accum_buffer_);
+      &accum_buffer_));
   
   // SSAO buffer
-  //CreateFramebufferAttachment(
-  //    device,
+  //render_targets.push_back(GetRenderTargetInfo(
   //    kSSAOFormat,
-  //    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-  //      VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+  //    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+  //    RenderTargetLifetime::TRANSIENT,
+  //    kNoAliasGroup,
   //    "ssao",
-  //    &ssao_buffer_);
+  //    &ssao_buffer_));
   
   // SSAO blur buffer
-  //CreateFramebufferAttachment(
-  //    device,
+  //render_targets.push_back(GetRenderTargetInfo(
   //    kSSAOFormat,
-  //    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-  //      VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+  //    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+  //    RenderTargetLifetime::TRANSIENT,
+  //    kNoAliasGroup,
   //    "ssao_blur",
-  //    &ssao_blur_buffer_);
+  //    &ssao_blur_buffer_));
 
-  // Depth buffer 
-  CreateFramebufferAttachment(
-      device,
+  // Depth buffer; it outlives the depth prepass since it is sampled by the
+  // light culling and loaded by the shading pass, and it is in use at the
+  // same time as the accumulation buffer, so it can't alias it
+  render_targets.push_back(GetRenderTargetInfo(
       device.depth_format(),
       VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
         VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+      RenderTargetLifetime::PERSISTENT,
+      kNoAliasGroup,
       "depth",
-      &depth_buffer_);
+      &depth_buffer_));
+
+  texture_manager()->CreateRenderTargets(
+      device,
+      render_targets,
+      VK_NULL_HANDLE);
 
   VkImageViewCreateInfo depth_view_create_info =
     tools::inits::ImageViewCreateInfo(
@@ -679,38 +946,56 @@ void FPlusRenderer::SetupFrameBuffers(const VulkanDevice &device) {
   }
 }
 
-void FPlusRenderer::CreateFramebufferAttachment(
-    const VulkanDevice &device,
+RenderTargetInfo FPlusRenderer::GetRenderTargetInfo(
     VkFormat format,
     VkImageUsageFlags img_usage_flags,
+    RenderTargetLifetime lifetime,
+    uint32_t alias_group,
     const eastl::string &name,
     VulkanTexture **attachment) const {
-  texture_manager()->Create2DTextureFromData(
-      device,
-      name,
-      nullptr,
-      0U,
-      cam_->viewport().width,
-      cam_->viewport().height,
-      format,
-      attachment,
-      VK_NULL_HANDLE,
-      img_usage_flags);
+  RenderTargetInfo info;
+  info.name = name;
+  info.width = cam_->viewport().width;
+  info.height = cam_->viewport().height;
+  info.format = format;
+  info.usage = img_usage_flags;
+  info.lifetime = lifetime;
+  info.alias_group = alias_group;
+  info.texture = attachment;
+
+  return info;
 }
 
-void FPlusRenderer::RegisterModel(Model &model,
-                                     const VertexSetup &g_store_vertex_setup) {
+void FPlusRenderer::RegisterModel(Model &model) {
+  if (registered_models_.size() >= kMaxRegisteredModels) {
+    EXIT("Too many models registered in FPlusRenderer!");
+  }
+  if (material_manager()->GetMaterialInstancesCount() > kMaxNumMatInstances) {
+    EXIT("Too many material instances for FPlusRenderer!");
+  }
+
+  // The descriptors are rewritten and the commands re-recorded, which the
+  // last frame submitted may still be using
+  VK_CHECK_RESULT(vkWaitForFences(vulkan()->device().device(), 1U,
+                                  &frame_complete_fence_, VK_TRUE, UINT64_MAX));
+
   registered_models_.push_back(&model);
+  SkipFrameAllocationsCheck();
 
-  SetupDescriptorSetAndPipeLayout(vulkan()->device());
   model.CreateAndWriteDescriptorSets(vulkan()->device(),
       desc_set_layouts_[DescSetLayoutTypes::MODELS]);
-  SetupUniformBuffers(vulkan()->device());
-  SetupMaterialPipelines(vulkan()->device(), g_store_vertex_setup);
+  mat_consts_ = material_manager()->GetMaterialConstants();
   SetupDescriptorSets(vulkan()->device());
-  SetupFullscreenQuad(vulkan()->device());
+  SetupIndirectDraws(vulkan()->device());
+  // The model's buffers and textures have to be resident before the
+  // command buffers using them get submitted
+  upload_manager()->WaitForTicket(
+      vulkan()->device(),
+      upload_manager()->Flush(vulkan()->device()));
   SetupGraphicsCommandBuffers(vulkan()->device());
   SetupComputeCommandBuffers(vulkan()->device());
+  residency_generation_ = residency_manager()->generation();
+  geometry_generation_ = model_manager()->GetGeometryGeneration();
  
   LOG("Registered model in FPlusRenderer.");
 }
@@ -718,16 +1003,19 @@ void FPlusRenderer::RegisterModel(Model &model,
 void FPlusRenderer::SetupMaterials(const VulkanDevice &device) {
   material_manager()->RegisterMaterialName("depth_prepass");
   material_manager()->RegisterMaterialName("lights_culling");
+  material_manager()->RegisterMaterialName("mesh_culling_early");
+  material_manager()->RegisterMaterialName("mesh_culling_late");
+  material_manager()->RegisterMaterialName("depth_pyramid");
   material_manager()->RegisterMaterialName("shade");
 }
 
 void FPlusRenderer::SetupUniformBuffers(const VulkanDevice &device) {
-  // Materials
+  // Materials; the constants are copied in as models get registered
   mat_consts_ = material_manager()->GetMaterialConstants();
-  uint32_t num_mat_instances = material_manager()->GetMaterialInstancesCount();
+  uint32_t num_mat_instances = kMaxNumMatInstances;
 
   // Lights array
-  eastl::vector<Light> transformed_lights;
+  FrameVector<Light> transformed_lights;
   UpdateLights(transformed_lights);
   uint32_t num_lights = SCAST_U32(transformed_lights.size());
 
@@ -788,6 +1076,7 @@ void FPlusRenderer::SetupUniformBuffers(const VulkanDevice &device) {
   buff_init_info.memory_property_flags =
     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
   buff_init_info.buffer_usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  buff_init_info.memory_category = MemoryCategory::PER_FRAME;
   main_static_buff_.Init(device, buff_init_info);
 
   // Upload data to it
@@ -804,7 +1093,8 @@ void FPlusRenderer::SetupUniformBuffers(const VulkanDevice &device) {
   memcpy(mapped_u8, transformed_lights.data(), lights_array_size);
   mapped_u8 += lights_array_size;
   
-  memcpy(mapped_u8, mat_consts_.data(), mat_consts_array_size);
+  memcpy(mapped_u8, mat_consts_.data(),
+         sizeof(MaterialConstants) * mat_consts_.size());
   mapped_u8 += mat_consts_array_size;
 
   //memcpy(mapped_u8, glm::value_ptr(uv_noise_scale), noise_uv_scale_size);
@@ -852,21 +1142,29 @@ void FPlusRenderer::SetupDescriptorPool(const VulkanDevice &device) {
   pool_sizes.push_back(tools::inits::DescriptorPoolSize(
       VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
       kMaxNumMatInstances * 
-        SCAST_U32(MatTextureType::size) + 10U));
+        SCAST_U32(MatTextureType::size) + 10U + kMaxDepthPyramidLevels));
 
   // Input attachments
   pool_sizes.push_back(tools::inits::DescriptorPoolSize(
     VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
     10U));
 
-  // Storage buffers
+  // Storage buffers, with those of the models' sets
   pool_sizes.push_back(tools::inits::DescriptorPoolSize(
       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-      kMaxNumSSBOs));
+      kMaxNumSSBOs + kModelSetSSBOsCount * kMaxRegisteredModels));
+
+  // Levels of the depth pyramid
+  pool_sizes.push_back(tools::inits::DescriptorPoolSize(
+      VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+      kMaxDepthPyramidLevels));
 
+  // The renderer's own sets, one for the meshes of all the models, one per
+  // level of the depth pyramid and one per registered model
   VkDescriptorPoolCreateInfo pool_create_info =
     tools::inits::DescriptrorPoolCreateInfo(
-      DescSetLayoutTypes::num_items,
+      SetTypes::num_items + 1U + kMaxDepthPyramidLevels +
+        kMaxRegisteredModels,
       SCAST_U32(pool_sizes.size()),
       pool_sizes.data());
 
@@ -917,6 +1215,34 @@ void FPlusRenderer::SetupDescriptorSetAndPipeLayout(
       VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
       nullptr));
 
+  // Buffers of the culling of the meshes' draws
+  eastl::array<uint32_t, 6U> mesh_culling_binding_pos = {
+    kMeshCullConstsBindingPos,
+    kCandidateDrawsBindingPos,
+    kMeshesCullDataBindingPos,
+    kCulledDrawsBindingPos,
+    kDrawCountsBindingPos,
+    kMeshesVisibilityBindingPos
+  };
+  for (uint32_t i = 0U; i < mesh_culling_binding_pos.size(); ++i) {
+    bindings[DescSetLayoutTypes::GENERIC].push_back(
+      tools::inits::DescriptorSetLayoutBinding(
+        mesh_culling_binding_pos[i],
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        1U,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        nullptr));
+  }
+
+  // Depth pyramid the late culling tests against
+  bindings[DescSetLayoutTypes::GENERIC].push_back(
+    tools::inits::DescriptorSetLayoutBinding(
+      kDepthPyramidBindingPos,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      1U,
+      VK_SHADER_STAGE_COMPUTE_BIT,
+      nullptr));
+
   // Model matrices for all meshes
   bindings[DescSetLayoutTypes::MODELS].push_back(
     tools::inits::DescriptorSetLayoutBinding(
@@ -945,7 +1271,7 @@ void FPlusRenderer::SetupDescriptorSetAndPipeLayout(
       VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT,
       nullptr));
 
-  uint32_t num_mat_instances = material_manager()->GetMaterialInstancesCount();
+  uint32_t num_mat_instances = kMaxNumMatInstances;
   // Diffuse textures as combined image samplers
   bindings[DescSetLayoutTypes::GENERIC].push_back(
     tools::inits::DescriptorSetLayoutBinding(
@@ -1083,10 +1409,10 @@ void FPlusRenderer::SetupDescriptorSetAndPipeLayout(
 
 void FPlusRenderer::SetupDescriptorSets(const VulkanDevice &device) {
   // Update the descriptor set
-  eastl::vector<VkWriteDescriptorSet> write_desc_sets;
+  FrameVector<VkWriteDescriptorSet> write_desc_sets;
 
   // Cache some sizes
-  uint32_t num_mat_instances = material_manager()->GetMaterialInstancesCount();
+  uint32_t num_mat_instances = kMaxNumMatInstances;
   uint32_t num_lights = lights_manager()->GetNumLights();
   uint32_t mat4_size = SCAST_U32(sizeof(glm::mat4));
   uint32_t mat4_group_size = mat4_size * 4U;
@@ -1190,10 +1516,15 @@ void FPlusRenderer::SetupDescriptorSets(const VulkanDevice &device) {
       nullptr,
       nullptr));
 
-  eastl::vector<VkDescriptorImageInfo> diff_descs_image_infos;
+  // The instances not created yet are sampled as the dummy texture
+  VkDescriptorImageInfo dummy_image_info =
+    dummy_texture_->GetDescriptorImageInfo();
+
+  FrameVector<VkDescriptorImageInfo> diff_descs_image_infos;
   material_manager()->GetDescriptorImageInfosByType(
       MatTextureType::DIFFUSE,
       diff_descs_image_infos);
+  diff_descs_image_infos.resize(num_mat_instances, dummy_image_info);
 
   // Diffuse textures as combined image samplers
   write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
@@ -1206,10 +1537,11 @@ void FPlusRenderer::SetupDescriptorSets(const VulkanDevice &device) {
       nullptr,
       nullptr));
   
-  eastl::vector<VkDescriptorImageInfo> amb_descs_image_infos;
+  FrameVector<VkDescriptorImageInfo> amb_descs_image_infos;
   material_manager()->GetDescriptorImageInfosByType(
       MatTextureType::AMBIENT,
       amb_descs_image_infos);
+  amb_descs_image_infos.resize(num_mat_instances, dummy_image_info);
 
   // Ambient textures as combined image samplers
   write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
@@ -1222,10 +1554,11 @@ void FPlusRenderer::SetupDescriptorSets(const VulkanDevice &device) {
       nullptr,
       nullptr));
   
-  eastl::vector<VkDescriptorImageInfo> spec_descs_image_infos;
+  FrameVector<VkDescriptorImageInfo> spec_descs_image_infos;
   material_manager()->GetDescriptorImageInfosByType(
       MatTextureType::SPECULAR,
       spec_descs_image_infos);
+  spec_descs_image_infos.resize(num_mat_instances, dummy_image_info);
 
   // Specular textures as combined image samplers
   write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
@@ -1238,10 +1571,11 @@ void FPlusRenderer::SetupDescriptorSets(const VulkanDevice &device) {
       nullptr,
       nullptr));
   
-  eastl::vector<VkDescriptorImageInfo> rough_descs_image_infos;
+  FrameVector<VkDescriptorImageInfo> rough_descs_image_infos;
   material_manager()->GetDescriptorImageInfosByType(
       MatTextureType::SPECULAR_HIGHLIGHT,
       rough_descs_image_infos);
+  rough_descs_image_infos.resize(num_mat_instances, dummy_image_info);
 
   // Roughness textures as combined image samplers
   write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
@@ -1254,10 +1588,11 @@ void FPlusRenderer::SetupDescriptorSets(const VulkanDevice &device) {
       nullptr,
       nullptr));
   
-  eastl::vector<VkDescriptorImageInfo> norm_descs_image_infos;
+  FrameVector<VkDescriptorImageInfo> norm_descs_image_infos;
   material_manager()->GetDescriptorImageInfosByType(
       MatTextureType::NORMAL,
       norm_descs_image_infos);
+  norm_descs_image_infos.resize(num_mat_instances, dummy_image_info);
 
   // Normal textures as combined image samplers
   write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
@@ -1390,6 +1725,10 @@ void FPlusRenderer::SetupGraphicsCommandBuffers(const VulkanDevice &device) {
   VK_CHECK_RESULT(vkBeginCommandBuffer(
       cmd_buff_depth_prepass_, &cmd_buff_begin_info));
 
+  if (batched_draws_) {
+    RecordMeshCulling(cmd_buff_depth_prepass_, CullPhaseTypes::EARLY);
+  }
+
   depth_prepass_renderpass_->BeginRenderpass(
       cmd_buff_depth_prepass_,
       VK_SUBPASS_CONTENTS_INLINE,
@@ -1410,19 +1749,44 @@ void FPlusRenderer::SetupGraphicsCommandBuffers(const VulkanDevice &device) {
       0U,
       nullptr);
     
-  for (eastl::vector<Model*>::iterator itor =
-           registered_models_.begin();
-         itor != registered_models_.end();
-         ++itor) {
-      (*itor)->BindVertexBuffer(cmd_buff_depth_prepass_);
-      (*itor)->BindIndexBuffer(cmd_buff_depth_prepass_);
-      (*itor)->RenderMeshesByMaterial(
-          cmd_buff_depth_prepass_,
-          pipe_layouts_[PipeLayoutTypes::GENERIC],
-          DescSetLayoutTypes::MODELS);
-    }
-    
+  RecordModelDraws(cmd_buff_depth_prepass_, true, CullPhaseTypes::EARLY,
+                   CullPhaseTypes::EARLY);
+
   depth_prepass_renderpass_->EndRenderpass(cmd_buff_depth_prepass_);
+
+  // The meshes the early draws hide are culled, and those which were hidden
+  // last frame but aren't anymore are drawn over them
+  if (batched_draws_) {
+    RecordDepthPyramid(cmd_buff_depth_prepass_);
+    RecordMeshCulling(cmd_buff_depth_prepass_, CullPhaseTypes::LATE);
+
+    depth_prepass_late_renderpass_->BeginRenderpass(
+        cmd_buff_depth_prepass_,
+        VK_SUBPASS_CONTENTS_INLINE,
+        depth_prepass_framebuffer_.get(),
+        {0U, 0U, cam_->viewport().width, cam_->viewport().height},
+        0U,
+        nullptr);
+
+    depth_prepass_material_->BindPipeline(cmd_buff_depth_prepass_,
+                                          VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+    vkCmdBindDescriptorSets(
+        cmd_buff_depth_prepass_,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipe_layouts_[PipeLayoutTypes::GENERIC],
+        0U,
+        DescSetLayoutTypes::MODELS,
+        desc_sets_.data(),
+        0U,
+        nullptr);
+
+    RecordModelDraws(cmd_buff_depth_prepass_, true, CullPhaseTypes::LATE,
+                     CullPhaseTypes::LATE);
+
+    depth_prepass_late_renderpass_->EndRenderpass(cmd_buff_depth_prepass_);
+  }
+
   VK_CHECK_RESULT(vkEndCommandBuffer(cmd_buff_depth_prepass_));
 
   uint32_t num_swapchain_images = vulkan()->swapchain().GetNumImages();
@@ -1451,17 +1815,8 @@ void FPlusRenderer::SetupGraphicsCommandBuffers(const VulkanDevice &device) {
         0U,
         nullptr);
 
-  for (eastl::vector<Model*>::iterator itor =
-           registered_models_.begin();
-         itor != registered_models_.end();
-         ++itor) {
-      (*itor)->BindVertexBuffer(cmd_buffers_[i]);
-      (*itor)->BindIndexBuffer(cmd_buffers_[i]);
-      (*itor)->RenderMeshesByMaterial(
-          cmd_buffers_[i],
-          pipe_layouts_[PipeLayoutTypes::GENERIC],
-          DescSetLayoutTypes::MODELS);
-    }
+    RecordModelDraws(cmd_buffers_[i], false, CullPhaseTypes::EARLY,
+                     CullPhaseTypes::LATE);
 
     //
     //// SSAO pass
@@ -1527,12 +1882,13 @@ void FPlusRenderer::SetupGraphicsCommandBuffers(const VulkanDevice &device) {
     fullscreenquad_->BindVertexBuffer(cmd_buffers_[i]);
     fullscreenquad_->BindIndexBuffer(cmd_buffers_[i]);
 
+    const GeometryRange &quad_range = fullscreenquad_->GetGeometryRange();
     vkCmdDrawIndexed(
         cmd_buffers_[i],
         6U,
         1U,
-        0U,
-        0U,
+        quad_range.first_index,
+        static_cast<int32_t>(quad_range.first_vertex),
         0U);
 
     shade_renderpass_->EndRenderpass(cmd_buffers_[i]);
@@ -1541,6 +1897,862 @@ void FPlusRenderer::SetupGraphicsCommandBuffers(const VulkanDevice &device) {
   }
 }
 
+void FPlusRenderer::RecordMeshCulling(
+    VkCommandBuffer cmd_buff,
+    CullPhaseTypes phase) const {
+  bool compact_draws = vulkan()->device().HasDrawIndirectCount();
+
+  // The early phase starts the frame's culling: the previous frame's passes
+  // have to be done reading the draws before they are overwritten, and its
+  // late culling done recording which meshes it saw
+  if (phase == CullPhaseTypes::EARLY) {
+    eastl::array<VkBufferMemoryBarrier, 3U> barriers_before = {
+      tools::inits::BufferMemoryBarrier(
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        culled_draws_buff_.buffer(),
+        0U,
+        VK_WHOLE_SIZE),
+      tools::inits::BufferMemoryBarrier(
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        draw_counts_buff_.buffer(),
+        0U,
+        VK_WHOLE_SIZE),
+      tools::inits::BufferMemoryBarrier(
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        meshes_visibility_buff_.buffer(),
+        0U,
+        VK_WHOLE_SIZE)
+    };
+    vkCmdPipelineBarrier(
+      cmd_buff,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0U,
+      0, nullptr,
+      barriers_before.size(),
+      barriers_before.data(),
+      0, nullptr);
+
+    // The draws which pass count themselves from 0 in each group, in both
+    // phases
+    if (compact_draws) {
+      vkCmdFillBuffer(cmd_buff, draw_counts_buff_.buffer(), 0U, VK_WHOLE_SIZE,
+                      0U);
+
+      VkBufferMemoryBarrier counts_barrier = tools::inits::BufferMemoryBarrier(
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        draw_counts_buff_.buffer(),
+        0U,
+        VK_WHOLE_SIZE);
+      vkCmdPipelineBarrier(
+        cmd_buff,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0U,
+        0, nullptr,
+        1U,
+        &counts_barrier,
+        0, nullptr);
+    }
+  }
+
+  mesh_cull_materials_[phase]->BindPipeline(cmd_buff,
+                                            VK_PIPELINE_BIND_POINT_COMPUTE);
+
+  vkCmdBindDescriptorSets(
+      cmd_buff,
+      VK_PIPELINE_BIND_POINT_COMPUTE,
+      pipe_layouts_[PipeLayoutTypes::GENERIC],
+      0U,
+      DescSetLayoutTypes::MODELS,
+      desc_sets_.data(),
+      0U,
+      nullptr);
+
+  const DrawGroup &last_group = draw_groups_.back();
+  uint32_t draws_count = last_group.first_draw + last_group.draws_count;
+  vkCmdDispatch(
+      cmd_buff,
+      (draws_count + kMeshCullingGroupSize - 1U) / kMeshCullingGroupSize,
+      1U,
+      1U);
+
+  // Both passes read the culled draws, and their counts
+  eastl::array<VkBufferMemoryBarrier, 2U> barriers_after = {
+    tools::inits::BufferMemoryBarrier(
+      VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      culled_draws_buff_.buffer(),
+      0U,
+      VK_WHOLE_SIZE),
+    tools::inits::BufferMemoryBarrier(
+      VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      draw_counts_buff_.buffer(),
+      0U,
+      VK_WHOLE_SIZE)
+  };
+  vkCmdPipelineBarrier(
+    cmd_buff,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+    0U,
+    0, nullptr,
+    barriers_after.size(),
+    barriers_after.data(),
+    0, nullptr);
+}
+
+void FPlusRenderer::RecordDepthPyramid(VkCommandBuffer cmd_buff) const {
+  VkImageSubresourceRange depth_range = {
+    tools::GetDepthStencilAspect(depth_buffer_->image()->format()),
+    0U,
+    depth_buffer_->image()->mip_levels(),
+    0U,
+    1U
+  };
+  VkImageSubresourceRange pyramid_range = {
+    VK_IMAGE_ASPECT_COLOR_BIT,
+    0U,
+    depth_pyramid_.mip_levels(),
+    0U,
+    1U
+  };
+
+  // The early draws' depth is read once written, and the previous frame's
+  // late culling has to be done reading the pyramid before it is rebuilt;
+  // its contents are discarded
+  eastl::array<VkImageMemoryBarrier, 2U> barriers_before = {
+    tools::inits::ImageMemoryBarrier(
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      depth_buffer_->image()->image(),
+      depth_range),
+    tools::inits::ImageMemoryBarrier(
+      VK_ACCESS_SHADER_READ_BIT,
+      VK_ACCESS_SHADER_WRITE_BIT,
+      VK_IMAGE_LAYOUT_UNDEFINED,
+      VK_IMAGE_LAYOUT_GENERAL,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      depth_pyramid_.image(),
+      pyramid_range)
+  };
+  vkCmdPipelineBarrier(
+    cmd_buff,
+    VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0U,
+    0, nullptr,
+    0, nullptr,
+    barriers_before.size(),
+    barriers_before.data());
+
+  depth_pyramid_material_->BindPipeline(cmd_buff,
+                                        VK_PIPELINE_BIND_POINT_COMPUTE);
+
+  // Each level is reduced from the one above once it has been written
+  const VkExtent3D &extent = depth_pyramid_.extent();
+  glm::ivec4 sizes(extent.width, extent.height, extent.width, extent.height);
+  for (uint32_t i = 0U; i < depth_pyramid_sets_.size(); ++i) {
+    sizes.z = eastl::max(static_cast<int32_t>(extent.width >> i), 1);
+    sizes.w = eastl::max(static_cast<int32_t>(extent.height >> i), 1);
+
+    vkCmdBindDescriptorSets(
+        cmd_buff,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        pipe_layouts_[PipeLayoutTypes::DEPTH_PYRAMID],
+        0U,
+        1U,
+        &depth_pyramid_sets_[i],
+        0U,
+        nullptr);
+    vkCmdPushConstants(
+        cmd_buff,
+        pipe_layouts_[PipeLayoutTypes::DEPTH_PYRAMID],
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0U,
+        SCAST_U32(sizeof(glm::ivec4)),
+        glm::value_ptr(sizes));
+    vkCmdDispatch(
+        cmd_buff,
+        (SCAST_U32(sizes.z) + kDepthPyramidGroupSize - 1U) /
+          kDepthPyramidGroupSize,
+        (SCAST_U32(sizes.w) + kDepthPyramidGroupSize - 1U) /
+          kDepthPyramidGroupSize,
+        1U);
+
+    // Read by the next level, and by the late culling
+    VkImageSubresourceRange level_range = {
+      VK_IMAGE_ASPECT_COLOR_BIT,
+      i,
+      1U,
+      0U,
+      1U
+    };
+    VkImageMemoryBarrier level_barrier = tools::inits::ImageMemoryBarrier(
+      VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_SHADER_READ_BIT,
+      VK_IMAGE_LAYOUT_GENERAL,
+      VK_IMAGE_LAYOUT_GENERAL,
+      VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED,
+      depth_pyramid_.image(),
+      level_range);
+    vkCmdPipelineBarrier(
+      cmd_buff,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0U,
+      0, nullptr,
+      0, nullptr,
+      1U,
+      &level_barrier);
+
+    sizes.x = sizes.z;
+    sizes.y = sizes.w;
+  }
+}
+
+void FPlusRenderer::RecordModelDraws(
+    VkCommandBuffer cmd_buff,
+    bool positions_only,
+    CullPhaseTypes first_phase,
+    CullPhaseTypes last_phase) const {
+  // Models sharing an arena are drawn with one bind of its buffers, and only
+  // rebind the index buffer when their index type differs
+  const GeometryArena *bound_arena = nullptr;
+  VkIndexType bound_index_type = VK_INDEX_TYPE_MAX_ENUM;
+  if (!batched_draws_) {
+    for (eastl::vector<Model*>::const_iterator itor =
+           registered_models_.begin();
+         itor != registered_models_.end();
+         ++itor) {
+      if (!model_manager()->IsModelResident(**itor)) {
+        continue;
+      }
+      if ((*itor)->geometry_arena() != bound_arena) {
+        if (positions_only) {
+          (*itor)->BindPositionBuffer(cmd_buff);
+        }
+        else {
+          (*itor)->BindVertexBuffer(cmd_buff);
+        }
+        bound_arena = (*itor)->geometry_arena();
+        bound_index_type = VK_INDEX_TYPE_MAX_ENUM;
+      }
+      if ((*itor)->index_type() != bound_index_type) {
+        (*itor)->BindIndexBuffer(cmd_buff);
+        bound_index_type = (*itor)->index_type();
+      }
+      (*itor)->RenderMeshesByMaterial(
+          cmd_buff,
+          pipe_layouts_[PipeLayoutTypes::GENERIC],
+          DescSetLayoutTypes::MODELS);
+    }
+
+    return;
+  }
+
+  // The mesh IDs come from the draws, indexing the data of all the meshes
+  vkCmdBindDescriptorSets(
+      cmd_buff,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipe_layouts_[PipeLayoutTypes::GENERIC],
+      DescSetLayoutTypes::MODELS,
+      1U,
+      &meshes_desc_set_,
+      0U,
+      nullptr);
+  uint32_t mesh_id_base = 0U;
+  vkCmdPushConstants(
+      cmd_buff,
+      pipe_layouts_[PipeLayoutTypes::GENERIC],
+      VK_SHADER_STAGE_VERTEX_BIT,
+      0U,
+      SCAST_U32(sizeof(uint32_t)),
+      &mesh_id_base);
+
+  // Each group of models is drawn once one of them is resident; the draws
+  // of the others are empty
+  uint32_t draw_size = SCAST_U32(sizeof(VkDrawIndexedIndirectCommand));
+  const DrawGroup &last_group = draw_groups_.back();
+  uint32_t draws_count = last_group.first_draw + last_group.draws_count;
+  for (uint32_t g = 0U; g < draw_groups_.size(); ++g) {
+    const DrawGroup &group = draw_groups_[g];
+    const Model *model = nullptr;
+    for (uint32_t i = 0U; i < group.models_count; ++i) {
+      const Model *group_model = indirect_models_[group.first_model + i].model;
+      if (model_manager()->IsModelResident(*group_model)) {
+        model = group_model;
+        break;
+      }
+    }
+    if (model == nullptr) {
+      continue;
+    }
+
+    if (model->geometry_arena() != bound_arena) {
+      if (positions_only) {
+        model->BindPositionBuffer(cmd_buff);
+      }
+      else {
+        model->BindVertexBuffer(cmd_buff);
+      }
+      bound_arena = model->geometry_arena();
+      bound_index_type = VK_INDEX_TYPE_MAX_ENUM;
+    }
+    if (model->index_type() != bound_index_type) {
+      model->BindIndexBuffer(cmd_buff);
+      bound_index_type = model->index_type();
+    }
+
+    // Each phase's draws and counts follow those of the one before
+    for (uint32_t p = first_phase; p <= last_phase; ++p) {
+      uint32_t first_draw = p * draws_count + group.first_draw;
+      if (vulkan()->device().HasDrawIndirectCount()) {
+        vulkan()->device().CmdDrawIndexedIndirectCount(
+            cmd_buff,
+            culled_draws_buff_.buffer(),
+            static_cast<VkDeviceSize>(first_draw) * draw_size,
+            draw_counts_buff_.buffer(),
+            (p * draw_groups_.size() + g) * sizeof(uint32_t),
+            group.draws_count,
+            draw_size);
+      }
+      else {
+        DrawIndirectBatch(cmd_buff, first_draw, group.draws_count);
+      }
+    }
+  }
+}
+
+void FPlusRenderer::SortFrameDraws(
+    const VkDrawIndexedIndirectCommand *draws) {
+  // Both passes draw the culled draws in the same order. Front to back lets
+  // the depth prepass reject the most; the shading pass only shades what
+  // passes its equal depth test and reads the materials through the mesh
+  // IDs, so there is no state for it to switch, and the materials only
+  // group the draws at the same depth. Compacting the draws on the GPU
+  // keeps their order
+  glm::vec3 viewer_position(inv_view_mat_[3U]);
+  const DrawGroup &last_group = draw_groups_.back();
+  draws_queue_.Clear();
+  RenderQueueItem *items =
+    draws_queue_.Append(last_group.first_draw + last_group.draws_count);
+  for (uint32_t g = 0U; g < draw_groups_.size(); ++g) {
+    // The group takes the place of the pipeline, which keeps its draws in
+    // its range; the empty ones go after the others
+    const DrawGroup &group = draw_groups_[g];
+    worker_pool()->ParallelFor(
+        group.draws_count,
+        kMinSortKeysChunkSize,
+        [&](uint32_t begin, uint32_t end) {
+      for (uint32_t i = group.first_draw + begin;
+           i < group.first_draw + end;
+           ++i) {
+        const VkDrawIndexedIndirectCommand &draw = draws[i];
+        items[i].value = i;
+        if (draw.indexCount == 0U) {
+          items[i].key =
+            RenderQueue::MakeLastKey(DrawPassTypes::DEPTH_PREPASS, g);
+          continue;
+        }
+        const glm::vec4 &sphere = meshes_spheres_[draw.firstInstance];
+        float depth =
+          glm::length(glm::vec3(sphere) - viewer_position) - sphere.w;
+        items[i].key = RenderQueue::MakeKey(
+            DrawPassTypes::DEPTH_PREPASS,
+            g,
+            meshes_materials_[draw.firstInstance],
+            depth);
+      }
+    });
+
+    // The empty draws up to the next group stay after this one's
+    uint32_t next_first_draw = g + 1U < draw_groups_.size() ?
+      draw_groups_[g + 1U].first_draw : group.first_draw + group.draws_count;
+    for (uint32_t i = group.first_draw + group.draws_count;
+         i < next_first_draw;
+         ++i) {
+      items[i].value = i;
+      items[i].key = RenderQueue::MakeLastKey(DrawPassTypes::DEPTH_PREPASS, g);
+    }
+  }
+
+  draws_queue_.Sort();
+}
+
+void FPlusRenderer::DrawIndirectBatch(
+    VkCommandBuffer cmd_buff,
+    uint32_t first_draw,
+    uint32_t draws_count) const {
+  uint32_t draw_size = SCAST_U32(sizeof(VkDrawIndexedIndirectCommand));
+  for (uint32_t i = 0U; i < draws_count; i += max_draws_per_call_) {
+    vkCmdDrawIndexedIndirect(
+        cmd_buff,
+        culled_draws_buff_.buffer(),
+        static_cast<VkDeviceSize>(first_draw + i) * draw_size,
+        eastl::min(draws_count - i, max_draws_per_call_),
+        draw_size);
+  }
+}
+
+void FPlusRenderer::SetupIndirectDraws(const VulkanDevice &device) {
+  if (!batched_draws_) {
+    return;
+  }
+
+  // The buffers are replaced, and commands recorded with them may still be
+  // executing
+  if (meshes_desc_set_ != VK_NULL_HANDLE) {
+    vkDeviceWaitIdle(device.device());
+  }
+
+  // Mesh IDs follow the order the models were registered in
+  indirect_models_.clear();
+  uint32_t meshes_count = 0U;
+  for (eastl::vector<Model*>::iterator itor = registered_models_.begin();
+       itor != registered_models_.end();
+       ++itor) {
+    IndirectModel indirect_model = {*itor, meshes_count, 0U};
+    indirect_models_.push_back(indirect_model);
+    meshes_count += (*itor)->NumMeshes();
+  }
+
+  // The draws follow the buffers the models use
+  eastl::sort(
+      indirect_models_.begin(),
+      indirect_models_.end(),
+      [](const IndirectModel &a, const IndirectModel &b) {
+    if (a.model->geometry_arena() != b.model->geometry_arena()) {
+      return a.model->geometry_arena() < b.model->geometry_arena();
+    }
+    if (a.model->index_type() != b.model->index_type()) {
+      return a.model->index_type() < b.model->index_type();
+    }
+    return a.first_mesh_id < b.first_mesh_id;
+  });
+  // Each group starts a workgroup of the culling, which compacts the draws
+  // of whole workgroups; the draws in between are left empty
+  uint32_t draws_count = 0U;
+  for (uint32_t i = 0U; i < indirect_models_.size(); ++i) {
+    const Model &model = *indirect_models_[i].model;
+    if (i != 0U &&
+        (model.geometry_arena() !=
+           indirect_models_[i - 1U].model->geometry_arena() ||
+         model.index_type() != indirect_models_[i - 1U].model->index_type())) {
+      draws_count = (draws_count + kMeshCullingGroupSize - 1U) /
+        kMeshCullingGroupSize * kMeshCullingGroupSize;
+    }
+    indirect_models_[i].first_draw = draws_count;
+    draws_count += model.GetDrawsCount();
+  }
+
+  // Split where the buffers change
+  draw_groups_.clear();
+  for (uint32_t i = 0U; i < indirect_models_.size(); ++i) {
+    const Model &model = *indirect_models_[i].model;
+    if (i == 0U ||
+        model.geometry_arena() !=
+          indirect_models_[i - 1U].model->geometry_arena() ||
+        model.index_type() != indirect_models_[i - 1U].model->index_type()) {
+      DrawGroup group = {i, 0U, indirect_models_[i].first_draw, 0U};
+      draw_groups_.push_back(group);
+    }
+    ++draw_groups_.back().models_count;
+    draw_groups_.back().draws_count += model.GetDrawsCount();
+  }
+
+  meshes_model_matxs_buff_.Shutdown(device);
+  meshes_material_ids_buff_.Shutdown(device);
+  frame_draws_buff_.Shutdown(device);
+  culled_draws_buff_.Shutdown(device);
+  draw_counts_buff_.Shutdown(device);
+  mesh_cull_consts_buff_.Shutdown(device);
+  meshes_cull_data_buff_.Shutdown(device);
+  meshes_visibility_buff_.Shutdown(device);
+
+  VulkanBufferInitInfo init_info;
+  init_info.size = meshes_count * SCAST_U32(sizeof(glm::mat4));
+  init_info.memory_property_flags =
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  init_info.buffer_usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  init_info.memory_category = MemoryCategory::OTHER;
+  meshes_model_matxs_buff_.Init(device, init_info);
+
+  init_info.size = meshes_count * SCAST_U32(sizeof(uint32_t));
+  meshes_material_ids_buff_.Init(device, init_info);
+
+  init_info.size = SCAST_U32(sizeof(MeshCullData)) * meshes_count;
+  meshes_cull_data_buff_.Init(device, init_info);
+
+  init_info.size = draws_count *
+    SCAST_U32(sizeof(VkDrawIndexedIndirectCommand));
+  init_info.memory_category = MemoryCategory::PER_FRAME;
+  frame_draws_buff_.Init(device, init_info);
+
+  init_info.size = SCAST_U32(sizeof(MeshCullConsts));
+  mesh_cull_consts_buff_.Init(device, init_info);
+
+  init_info.size = draws_count * CullPhaseTypes::num_items *
+    SCAST_U32(sizeof(VkDrawIndexedIndirectCommand));
+  init_info.memory_property_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  init_info.buffer_usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+  culled_draws_buff_.Init(device, init_info);
+
+  // The counts of the groups, then for each phase the state of the culling's
+  // ordered compaction: the next workgroup and what each has compacted
+  uint32_t cull_workgroups_count =
+    (draws_count + kMeshCullingGroupSize - 1U) / kMeshCullingGroupSize;
+  init_info.size = SCAST_U32(sizeof(uint32_t)) * CullPhaseTypes::num_items *
+    (SCAST_U32(draw_groups_.size()) + 1U + cull_workgroups_count);
+  init_info.buffer_usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  draw_counts_buff_.Init(device, init_info);
+
+  // No mesh was visible before the first frame, which the late phase then
+  // draws all of
+  eastl::vector<uint32_t> meshes_visibility(meshes_count * 2U, 0U);
+  init_info.size = SCAST_U32(sizeof(uint32_t) * meshes_visibility.size());
+  init_info.buffer_usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  meshes_visibility_buff_.Init(device, init_info, meshes_visibility.data());
+
+  // Upload the data of the meshes, at their IDs
+  void *mapped_matxs = nullptr;
+  void *mapped_material_ids = nullptr;
+  meshes_model_matxs_buff_.Map(device, &mapped_matxs);
+  meshes_material_ids_buff_.Map(device, &mapped_material_ids);
+  glm::mat4 *model_matxs = static_cast<glm::mat4 *>(mapped_matxs);
+  uint32_t *material_ids = static_cast<uint32_t *>(mapped_material_ids);
+  for (eastl::vector<IndirectModel>::const_iterator itor =
+         indirect_models_.begin();
+       itor != indirect_models_.end();
+       ++itor) {
+    for (uint32_t i = 0U; i < itor->model->NumMeshes(); ++i) {
+      model_matxs[itor->first_mesh_id + i] =
+        itor->model->GetMeshModelMatrix(i);
+      material_ids[itor->first_mesh_id + i] =
+        itor->model->GetMeshMaterialId(i);
+    }
+  }
+  meshes_material_ids_buff_.Unmap(device);
+  meshes_model_matxs_buff_.Unmap(device);
+
+  // The keys the draws are sorted by every frame come from the meshes too
+  meshes_spheres_.resize(meshes_count);
+  meshes_materials_.resize(meshes_count);
+  for (eastl::vector<IndirectModel>::const_iterator itor =
+         indirect_models_.begin();
+       itor != indirect_models_.end();
+       ++itor) {
+    for (uint32_t i = 0U; i < itor->model->NumMeshes(); ++i) {
+      meshes_spheres_[itor->first_mesh_id + i] =
+        itor->model->GetMeshBoundingSphere(i);
+      meshes_materials_[itor->first_mesh_id + i] =
+        itor->model->GetMeshMaterialId(i);
+    }
+  }
+
+  // And what the culling needs of them
+  void *mapped_cull_data = nullptr;
+  meshes_cull_data_buff_.Map(device, &mapped_cull_data);
+  MeshCullData *cull_data = static_cast<MeshCullData *>(mapped_cull_data);
+  for (uint32_t g = 0U; g < draw_groups_.size(); ++g) {
+    const DrawGroup &group = draw_groups_[g];
+    for (uint32_t m = 0U; m < group.models_count; ++m) {
+      const IndirectModel &indirect_model =
+        indirect_models_[group.first_model + m];
+      for (uint32_t i = 0U; i < indirect_model.model->NumMeshes(); ++i) {
+        MeshCullData &mesh_data = cull_data[indirect_model.first_mesh_id + i];
+        mesh_data.bounding_sphere =
+          indirect_model.model->GetMeshBoundingSphere(i);
+        mesh_data.draw_group = g;
+        mesh_data.group_first_draw = group.first_draw;
+      }
+    }
+  }
+  meshes_cull_data_buff_.Unmap(device);
+
+  // Nothing is drawn until the first update
+  void *mapped_draws = nullptr;
+  frame_draws_buff_.Map(device, &mapped_draws);
+  memset(mapped_draws, 0, draws_count * sizeof(VkDrawIndexedIndirectCommand));
+  frame_draws_buff_.Unmap(device);
+
+  // Same layout as the sets of the models
+  if (meshes_desc_set_ == VK_NULL_HANDLE) {
+    VkDescriptorSetAllocateInfo set_allocate_info =
+      tools::inits::DescriptorSetAllocateInfo(
+        desc_pool_,
+        1U,
+        &desc_set_layouts_[DescSetLayoutTypes::MODELS]);
+    VK_CHECK_RESULT(vkAllocateDescriptorSets(
+        device.device(),
+        &set_allocate_info,
+        &meshes_desc_set_));
+  }
+
+  FrameVector<VkWriteDescriptorSet> write_desc_sets;
+  VkDescriptorBufferInfo model_matxs_buff_info =
+    meshes_model_matxs_buff_.GetDescriptorBufferInfo();
+  write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
+      meshes_desc_set_,
+      kModelMatxsBufferBindPos,
+      0U,
+      1U,
+      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      nullptr,
+      &model_matxs_buff_info,
+      nullptr));
+
+  VkDescriptorBufferInfo material_ids_buff_info =
+    meshes_material_ids_buff_.GetDescriptorBufferInfo();
+  write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
+      meshes_desc_set_,
+      kMaterialIDsBufferBindPos,
+      0U,
+      1U,
+      VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      nullptr,
+      &material_ids_buff_info,
+      nullptr));
+
+  // The culling's buffers go in the generic set, with the other passes'
+  eastl::array<VkDescriptorBufferInfo, 6U> culling_buff_infos = {
+    mesh_cull_consts_buff_.GetDescriptorBufferInfo(),
+    frame_draws_buff_.GetDescriptorBufferInfo(),
+    meshes_cull_data_buff_.GetDescriptorBufferInfo(),
+    culled_draws_buff_.GetDescriptorBufferInfo(),
+    draw_counts_buff_.GetDescriptorBufferInfo(),
+    meshes_visibility_buff_.GetDescriptorBufferInfo()
+  };
+  eastl::array<uint32_t, 6U> culling_binding_pos = {
+    kMeshCullConstsBindingPos,
+    kCandidateDrawsBindingPos,
+    kMeshesCullDataBindingPos,
+    kCulledDrawsBindingPos,
+    kDrawCountsBindingPos,
+    kMeshesVisibilityBindingPos
+  };
+  for (uint32_t i = 0U; i < culling_buff_infos.size(); ++i) {
+    write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
+        desc_sets_[SetTypes::GENERIC],
+        culling_binding_pos[i],
+        0U,
+        1U,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        nullptr,
+        &culling_buff_infos[i],
+        nullptr));
+  }
+
+  VkDescriptorImageInfo depth_pyramid_img_info =
+    depth_pyramid_.GetDescriptorImageInfo(nearest_sampler_);
+  write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
+      desc_sets_[SetTypes::GENERIC],
+      kDepthPyramidBindingPos,
+      0U,
+      1U,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      &depth_pyramid_img_info,
+      nullptr,
+      nullptr));
+
+  vkUpdateDescriptorSets(
+      device.device(),
+      SCAST_U32(write_desc_sets.size()),
+      write_desc_sets.data(),
+      0U,
+      nullptr);
+}
+
+void FPlusRenderer::SetupDepthPyramid(const VulkanDevice &device) {
+  // Halve down to a single texel
+  uint32_t width = cam_->viewport().width;
+  uint32_t height = cam_->viewport().height;
+  uint32_t levels_count = 1U;
+  while ((width >> levels_count) != 0U || (height >> levels_count) != 0U) {
+    ++levels_count;
+  }
+  levels_count = eastl::min(levels_count, kMaxDepthPyramidLevels);
+
+  VulkanImageInitInfo image_init_info;
+  image_init_info.create_info = tools::inits::ImageCreateInfo(
+      0U,
+      VK_IMAGE_TYPE_2D,
+      kDepthPyramidFormat,
+      { width, height, 1U },
+      levels_count,
+      1U,
+      VK_SAMPLE_COUNT_1_BIT,
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      VK_SHARING_MODE_EXCLUSIVE,
+      0U,
+      nullptr,
+      VK_IMAGE_LAYOUT_UNDEFINED);
+  image_init_info.create_view = CreateView::YES;
+  image_init_info.view_type = VK_IMAGE_VIEW_TYPE_2D;
+  image_init_info.memory_properties_flags =
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  image_init_info.memory_category = MemoryCategory::RENDER_TARGET;
+  depth_pyramid_.Init(device, image_init_info);
+  // Written and read by compute only, so it never leaves this layout once
+  // the first reduction has moved it there
+  depth_pyramid_.set_layout(VK_IMAGE_LAYOUT_GENERAL);
+
+  for (uint32_t i = 0U; i < levels_count; ++i) {
+    VkImageViewCreateInfo level_view_create_info =
+      tools::inits::ImageViewCreateInfo(
+        depth_pyramid_.image(),
+        VK_IMAGE_VIEW_TYPE_2D,
+        kDepthPyramidFormat,
+        {
+          VK_COMPONENT_SWIZZLE_IDENTITY,
+          VK_COMPONENT_SWIZZLE_IDENTITY,
+          VK_COMPONENT_SWIZZLE_IDENTITY,
+          VK_COMPONENT_SWIZZLE_IDENTITY
+        },
+        {
+          VK_IMAGE_ASPECT_COLOR_BIT,
+          i,
+          1U,
+          0U,
+          1U
+        });
+    depth_pyramid_level_views_.push_back(
+        depth_pyramid_.CreateAdditionalImageView(
+          device,
+          level_view_create_info));
+  }
+
+  // Each level reads the one above, or the depth buffer, and writes itself
+  eastl::array<VkDescriptorSetLayoutBinding, 2U> bindings = {
+    tools::inits::DescriptorSetLayoutBinding(
+      kPyramidSrcBindingPos,
+      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      1U,
+      VK_SHADER_STAGE_COMPUTE_BIT,
+      nullptr),
+    tools::inits::DescriptorSetLayoutBinding(
+      kPyramidDstBindingPos,
+      VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+      1U,
+      VK_SHADER_STAGE_COMPUTE_BIT,
+      nullptr)
+  };
+  VkDescriptorSetLayoutCreateInfo set_layout_create_info =
+    tools::inits::DescriptrorSetLayoutCreateInfo();
+  set_layout_create_info.bindingCount = SCAST_U32(bindings.size());
+  set_layout_create_info.pBindings = bindings.data();
+  VK_CHECK_RESULT(vkCreateDescriptorSetLayout(
+      device.device(),
+      &set_layout_create_info,
+      nullptr,
+      &depth_pyramid_set_layout_));
+
+  // Push constant for the sizes of the source and destination levels
+  VkPushConstantRange push_const_range = {
+    VK_SHADER_STAGE_COMPUTE_BIT,
+    0U,
+    SCAST_U32(sizeof(glm::ivec4))
+  };
+  VkPipelineLayoutCreateInfo pipe_layout_create_info =
+    tools::inits::PipelineLayoutCreateInfo(
+      1U,
+      &depth_pyramid_set_layout_,
+      1U,
+      &push_const_range);
+  VK_CHECK_RESULT(vkCreatePipelineLayout(
+      device.device(),
+      &pipe_layout_create_info,
+      nullptr,
+      &pipe_layouts_[PipeLayoutTypes::DEPTH_PYRAMID]));
+
+  eastl::vector<VkDescriptorSetLayout> set_layouts(
+      levels_count,
+      depth_pyramid_set_layout_);
+  depth_pyramid_sets_.resize(levels_count);
+  VkDescriptorSetAllocateInfo set_allocate_info =
+    tools::inits::DescriptorSetAllocateInfo(
+      desc_pool_,
+      levels_count,
+      set_layouts.data());
+  VK_CHECK_RESULT(vkAllocateDescriptorSets(
+      device.device(),
+      &set_allocate_info,
+      depth_pyramid_sets_.data()));
+
+  eastl::vector<VkDescriptorImageInfo> src_img_infos(levels_count);
+  eastl::vector<VkDescriptorImageInfo> dst_img_infos(levels_count);
+  eastl::vector<VkWriteDescriptorSet> write_desc_sets;
+  for (uint32_t i = 0U; i < levels_count; ++i) {
+    if (i == 0U) {
+      src_img_infos[i] =
+        depth_buffer_->image()->GetDescriptorImageInfo(nearest_sampler_);
+      src_img_infos[i].imageView = *depth_buffer_depth_view_;
+      src_img_infos[i].imageLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+    else {
+      src_img_infos[i] =
+        depth_pyramid_.GetDescriptorImageInfo(nearest_sampler_);
+      src_img_infos[i].imageView = *depth_pyramid_level_views_[i - 1U];
+    }
+    write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
+        depth_pyramid_sets_[i],
+        kPyramidSrcBindingPos,
+        0U,
+        1U,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        &src_img_infos[i],
+        nullptr,
+        nullptr));
+
+    dst_img_infos[i] = depth_pyramid_.GetDescriptorImageInfo();
+    dst_img_infos[i].imageView = *depth_pyramid_level_views_[i];
+    write_desc_sets.push_back(tools::inits::WriteDescriptorSet(
+        depth_pyramid_sets_[i],
+        kPyramidDstBindingPos,
+        0U,
+        1U,
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        &dst_img_infos[i],
+        nullptr,
+        nullptr));
+  }
+
+  vkUpdateDescriptorSets(
+      device.device(),
+      SCAST_U32(write_desc_sets.size()),
+      write_desc_sets.data(),
+      0U,
+      nullptr);
+}
+
 void FPlusRenderer::SetupComputeCommandBuffers(const VulkanDevice &device) {
   // Cache common settings to all command buffers 
   VkCommandBufferBeginInfo cmd_buff_begin_info =
@@ -1696,18 +2908,27 @@ void FPlusRenderer::SetupMaterialPipelines(
 
   VertexSetup vertex_setup_quads(vtx_layout);
 
-  // Setup depth prepass material
+  // Setup depth prepass material; it only reads the position stream of the
+  // models, which is bound on its own
+  eastl::vector<VertexElement> depth_vtx_layout;
+  depth_vtx_layout.push_back(VertexElement(
+        VertexElementType::POSITION,
+        store_vertex_setup.GetElementSize(VertexElementType::POSITION),
+        store_vertex_setup.GetElementVulkanFormat(VertexElementType::POSITION),
+        store_vertex_setup.GetElementEncoding(VertexElementType::POSITION)));
+  VertexSetup vertex_setup_depth(depth_vtx_layout);
+
   eastl::unique_ptr<MaterialShader> depth_vert =
     eastl::make_unique<MaterialShader>(
       kBaseShaderAssetsPath + "passthrough.vert",
       "main",
       ShaderTypes::VERTEX);
   
-  uint32_t num_materials = material_manager()->GetMaterialInstancesCount();
+  uint32_t num_materials = kMaxNumMatInstances;
   
   eastl::unique_ptr<MaterialBuilder> builder_depth_prepass =
     eastl::make_unique<MaterialBuilder>(
-    store_vertex_setup,
+    vertex_setup_depth,
     "depth_prepass",
     pipe_layouts_[PipeLayoutTypes::GENERIC],
     depth_prepass_renderpass_->GetVkRenderpass(),
@@ -1764,6 +2985,64 @@ void FPlusRenderer::SetupMaterialPipelines(
   lights_cull_material_ =
     material_manager()->CreateMaterial(device, eastl::move(builder_culling)); 
 
+  // Setup the culling of the meshes' draws, one material per phase, whose
+  // draws are packed when their count can be read from a buffer
+  if (batched_draws_) {
+    eastl::array<const char *, CullPhaseTypes::num_items> phase_names = {
+      "mesh_culling_early",
+      "mesh_culling_late"
+    };
+    VkBool32 compact_draws = device.HasDrawIndirectCount() ? VK_TRUE : VK_FALSE;
+    for (uint32_t p = 0U; p < CullPhaseTypes::num_items; ++p) {
+      eastl::unique_ptr<MaterialShader> mesh_culling_compute =
+        eastl::make_unique<MaterialShader>(
+          kBaseShaderAssetsPath + "mesh_culling.comp",
+          "main",
+          ShaderTypes::COMPUTE);
+
+      VkBool32 late_phase = p == CullPhaseTypes::LATE ? VK_TRUE : VK_FALSE;
+      mesh_culling_compute->AddSpecialisationEntry(
+          kCompactDrawsSpecConstPos,
+          SCAST_U32(sizeof(VkBool32)),
+          &compact_draws);
+      mesh_culling_compute->AddSpecialisationEntry(
+          kLatePhaseSpecConstPos,
+          SCAST_U32(sizeof(VkBool32)),
+          &late_phase);
+
+      eastl::unique_ptr<MaterialBuilder> builder_mesh_culling =
+        eastl::make_unique<MaterialBuilder>(
+        phase_names[p],
+        pipe_layouts_[PipeLayoutTypes::GENERIC],
+        cam_->viewport());
+
+      builder_mesh_culling->AddShader(eastl::move(mesh_culling_compute));
+
+      mesh_cull_materials_[p] = material_manager()->CreateMaterial(
+          device,
+          eastl::move(builder_mesh_culling));
+    }
+
+    // And the reduction of the depth they are tested against
+    eastl::unique_ptr<MaterialShader> depth_pyramid_compute =
+      eastl::make_unique<MaterialShader>(
+        kBaseShaderAssetsPath + "depth_pyramid.comp",
+        "main",
+        ShaderTypes::COMPUTE);
+
+    eastl::unique_ptr<MaterialBuilder> builder_depth_pyramid =
+      eastl::make_unique<MaterialBuilder>(
+      "depth_pyramid",
+      pipe_layouts_[PipeLayoutTypes::DEPTH_PYRAMID],
+      cam_->viewport());
+
+    builder_depth_pyramid->AddShader(eastl::move(depth_pyramid_compute));
+
+    depth_pyramid_material_ = material_manager()->CreateMaterial(
+        device,
+        eastl::move(builder_depth_pyramid));
+  }
+
   // Setup shading material
   eastl::unique_ptr<MaterialShader> shade_frag =
     eastl::make_unique<MaterialShader>(
@@ -1771,9 +3050,11 @@ void FPlusRenderer::SetupMaterialPipelines(
       "main",
       ShaderTypes::FRAGMENT);
   
+  // The quantized layout's attributes are decoded by their own vertex shader
   eastl::unique_ptr<MaterialShader> shade_vert =
     eastl::make_unique<MaterialShader>(
-      kBaseShaderAssetsPath + "fpshade.vert",
+      kBaseShaderAssetsPath + (store_vertex_setup.IsQuantized() ?
+                                 "fpshade_quantized.vert" : "fpshade.vert"),
       "main",
       ShaderTypes::VERTEX);
   
@@ -1989,22 +3270,15 @@ void FPlusRenderer::SetupFullscreenQuad(const VulkanDevice &device){
     vertex_setup_quads,
     desc_pool_);
 
-  Vertex vtx;
-  vtx.pos = { -1.f, 1.f, 0.f };
-  model_builder.AddVertex(vtx);
-  vtx.pos = { -1.f, -1.f, 0.f };
-  model_builder.AddVertex(vtx);
-  vtx.pos = { 1.f, -1.f, 0.f };
-  model_builder.AddVertex(vtx);
-  vtx.pos = { 1.f, 1.f, 0.f };
-  model_builder.AddVertex(vtx);
-
-  model_builder.AddIndex(0U);
-  model_builder.AddIndex(2U);
-  model_builder.AddIndex(1U);
-  model_builder.AddIndex(0U);
-  model_builder.AddIndex(3U);
-  model_builder.AddIndex(2U);
+  Vertex vtxs[4U];
+  vtxs[0U].pos = { -1.f, 1.f, 0.f };
+  vtxs[1U].pos = { -1.f, -1.f, 0.f };
+  vtxs[2U].pos = { 1.f, -1.f, 0.f };
+  vtxs[3U].pos = { 1.f, 1.f, 0.f };
+  model_builder.AddVertices(vtxs, 4U);
+
+  const uint32_t idxs[6U] = { 0U, 2U, 1U, 0U, 3U, 2U };
+  model_builder.AddIndices(idxs, 6U);
 
   Mesh quad_mesh(
     0U,
@@ -2018,14 +3292,17 @@ void FPlusRenderer::SetupFullscreenQuad(const VulkanDevice &device){
                                &fullscreenquad_);
 }
 
-void FPlusRenderer::UpdateLights(eastl::vector<Light> &transformed_lights) {
-  transformed_lights = lights_manager()->TransformLights(view_mat_);
+void FPlusRenderer::UpdateLights(FrameVector<Light> &transformed_lights) {
+  lights_manager()->TransformLights(view_mat_, transformed_lights);
 }
 
 void FPlusRenderer::ReloadAllShaders() {
+  SkipFrameAllocationsCheck();
   material_manager()->ReloadAllShaders(vulkan()->device());
 
-  SetupGraphicsCommandBuffers(vulkan()->device());
+  if (has_registered_models()) {
+    SetupGraphicsCommandBuffers(vulkan()->device());
+  }
 }
 
 } // namespace vks
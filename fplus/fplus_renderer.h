@@ -11,8 +11,11 @@
 #include <EASTL/string.h>
 #include <EASTL/unique_ptr.h>
 #include <light.h>
+#include <memory_allocators.h>
 #include <renderpass.h>
 #include <framebuffer.h>
+#include <render_queue.h>
+#include <vulkan_texture_manager.h>
 
 namespace szt {
   class Camera; 
@@ -43,11 +46,22 @@ struct DescSetLayoutsEnum {
 }; // struct DescSetLayoutsEnum
 typedef DescSetLayoutsEnum::DescSetLayouts DescSetLayoutTypes;
 
+// The meshes visible last frame are drawn first, then those the depth they
+// left doesn't hide
+struct CullPhasesEnum {
+  enum CullPhases {
+    EARLY = 0U,
+    LATE,
+    num_items
+  }; // enum CullPhases
+}; // struct CullPhasesEnum
+typedef CullPhasesEnum::CullPhases CullPhaseTypes;
+
 class FPlusRenderer {
  public:
   FPlusRenderer();
 
-  void Init(szt::Camera *cam);
+  void Init(szt::Camera *cam, const VertexSetup &g_store_vertex_setup);
 
   void Shutdown();
   void PreRender();
@@ -56,9 +70,12 @@ class FPlusRenderer {
 
   void ReloadAllShaders();
 
-  // Register a model for rendering.
-  void RegisterModel(Model &model,
-                     const VertexSetup &g_store_vertex_setup);
+  // Register a model for rendering; it has to use the vertex setup the
+  // renderer was initialised with.
+  void RegisterModel(Model &model);
+
+  // Frames can only be rendered once a model has been registered
+  bool has_registered_models() const { return !registered_models_.empty(); }
   
 
  private:
@@ -72,24 +89,54 @@ class FPlusRenderer {
   void SetupDescriptorSetAndPipeLayout(const VulkanDevice &device);
   void SetupDescriptorSets(const VulkanDevice &device);
   void SetupDescriptorPool(const VulkanDevice &device);
-  void CreateSemaphores(const VulkanDevice &device);
+  void CreateSyncObjects(const VulkanDevice &device);
   void CreateCommandBuffers(const VulkanDevice &device);
   void SetupGraphicsCommandBuffers(const VulkanDevice &device);
+  // Record the compute pass which culls the frame's draws of a phase, ahead
+  // of both passes reading them
+  void RecordMeshCulling(VkCommandBuffer cmd_buff, CullPhaseTypes phase) const;
+  // Record the reduction of the depth the early draws left into
+  // depth_pyramid_
+  void RecordDepthPyramid(VkCommandBuffer cmd_buff) const;
+  // Record the draws of every resident model which the given phases let
+  // through; the depth prepass only binds the positions
+  void RecordModelDraws(
+      VkCommandBuffer cmd_buff,
+      bool positions_only,
+      CullPhaseTypes first_phase,
+      CullPhaseTypes last_phase) const;
+  // Issue a range of the culled draws, in as few calls as the device allows
+  void DrawIndirectBatch(
+      VkCommandBuffer cmd_buff,
+      uint32_t first_draw,
+      uint32_t draws_count) const;
+  // Lay out the meshes and draws of the registered models for batched
+  // indirect drawing, and create the buffers holding them
+  void SetupIndirectDraws(const VulkanDevice &device);
+  // Order the frame's draws within each group into draws_queue_, whose
+  // values index draws
+  void SortFrameDraws(const VkDrawIndexedIndirectCommand *draws);
+  // Create the depth pyramid the late culling tests the meshes against,
+  // with a view and a set per level to reduce it
+  void SetupDepthPyramid(const VulkanDevice &device);
   void SetupComputeCommandBuffers(const VulkanDevice &device);
   void SetupSamplers(const VulkanDevice &device);
   void UpdatePVMatrices();
   void UpdateBuffers(const VulkanDevice &device);
-  void UpdateLights(eastl::vector<Light> &transformed_lights);
+  void UpdateLights(FrameVector<Light> &transformed_lights);
   void SetupFullscreenQuad(const VulkanDevice &device);
-  void CreateFramebufferAttachment(
-      const VulkanDevice &device,
+  // Describe a full-screen render target
+  RenderTargetInfo GetRenderTargetInfo(
       VkFormat format,
       VkImageUsageFlags img_usage_flags,
+      RenderTargetLifetime lifetime,
+      uint32_t alias_group,
       const eastl::string &name,
       VulkanTexture **attachment) const;
-      //VkCommandBuffer cmd_buff);
 
   eastl::unique_ptr<Renderpass> depth_prepass_renderpass_;
+  // Draws the late phase's meshes over the depth of the early ones
+  eastl::unique_ptr<Renderpass> depth_prepass_late_renderpass_;
   eastl::unique_ptr<Renderpass> shade_renderpass_;
 
   /**
@@ -107,6 +154,11 @@ class FPlusRenderer {
   VkCommandBuffer cmd_buff_depth_prepass_;
   VkSemaphore depth_prepass_complete_semaphore_;
   VkSemaphore light_culling_complete_semaphore_;
+  /**
+   * @brief Signaled once the GPU is done with the last frame submitted; the
+   * host-visible buffers rewritten every frame are only mapped after it
+   */
+  VkFence frame_complete_fence_;
 
   //struct BuffersEnum {
   //  enum Buffers {
@@ -124,6 +176,8 @@ class FPlusRenderer {
 
   Material *depth_prepass_material_;
   Material *lights_cull_material_;
+  eastl::array<Material *, CullPhaseTypes::num_items> mesh_cull_materials_;
+  Material *depth_pyramid_material_;
   Material *shading_material_;
   Material *tonemap_material_;
   //Material *g_ssao_material_;
@@ -142,12 +196,21 @@ class FPlusRenderer {
   struct PipeLayoutsEnum {
     enum PipeLayouts {
       GENERIC = 0U,
+      DEPTH_PYRAMID,
       num_items
     }; // enum PipeLayouts
   }; // struct PipeLayoutsEnum
   typedef PipeLayoutsEnum::PipeLayouts PipeLayoutTypes;
   eastl::array<VkPipelineLayout, PipeLayoutTypes::num_items> pipe_layouts_;
 
+  // Farthest depth of the early draws over shrinking regions of the screen,
+  // one level per halving; level 0 copies the depth buffer. Each level is
+  // reduced from the one above through its own view and set
+  VulkanImage depth_pyramid_;
+  eastl::vector<VkImageView *> depth_pyramid_level_views_;
+  VkDescriptorSetLayout depth_pyramid_set_layout_;
+  eastl::vector<VkDescriptorSet> depth_pyramid_sets_;
+
   VulkanBuffer main_static_buff_;
   VulkanBuffer light_idxs_buff_;
 
@@ -165,6 +228,66 @@ class FPlusRenderer {
   VkSampler nearest_sampler_repeat_;
 
   eastl::vector<Model*> registered_models_;
+
+  // Where the meshes and draws of a registered model are among those of all
+  // of them
+  struct IndirectModel {
+    Model *model;
+    uint32_t first_mesh_id;
+    uint32_t first_draw;
+  }; // struct IndirectModel
+
+  // Whether the meshes of all the models are drawn by batched indirect
+  // calls, which carry the mesh IDs in their first instance; needs
+  // drawIndirectFirstInstance, otherwise every mesh is drawn with its own
+  // calls and pushed ID
+  bool batched_draws_;
+  // Draws a single indirect call can issue; 1 without multiDrawIndirect
+  uint32_t max_draws_per_call_;
+  // Models of indirect_models_ which use the same buffers, whose draws are
+  // issued together
+  struct DrawGroup {
+    uint32_t first_model;
+    uint32_t models_count;
+    uint32_t first_draw;
+    uint32_t draws_count;
+  }; // struct DrawGroup
+
+  // Sorted by geometry arena and index type, so that the draws of models
+  // using the same buffers are next to each other
+  eastl::vector<IndirectModel> indirect_models_;
+  eastl::vector<DrawGroup> draw_groups_;
+  // Model matrices and material IDs of the meshes of all the models, indexed
+  // by mesh ID through meshes_desc_set_
+  VulkanBuffer meshes_model_matxs_buff_;
+  VulkanBuffer meshes_material_ids_buff_;
+  VkDescriptorSet meshes_desc_set_;
+  // Rewritten every frame by UpdateBuffers, sorted within each group, then
+  // culled on the GPU into culled_draws_buff_, which both passes draw. With
+  // draw counts read from a buffer the draws which pass are packed at the
+  // start of their group, in order, and counted in draw_counts_buff_;
+  // otherwise they stay where they were and the culled ones are emptied.
+  // Both hold the early phase's draws, then the late one's; the groups start
+  // at a multiple of the culling's workgroup size
+  VulkanBuffer frame_draws_buff_;
+  VulkanBuffer culled_draws_buff_;
+  VulkanBuffer draw_counts_buff_;
+  // Frustum planes of the frame, and bounds and group of every mesh
+  VulkanBuffer mesh_cull_consts_buff_;
+  VulkanBuffer meshes_cull_data_buff_;
+  // Two flags per mesh, whether it was visible last frame and whether it is
+  // this one, which swap every frame as visibility_parity_ flips
+  VulkanBuffer meshes_visibility_buff_;
+  uint32_t visibility_parity_;
+  // Bounding sphere and material of every mesh, by mesh ID, which the keys
+  // the frame's draws are sorted by are made of
+  eastl::vector<glm::vec4> meshes_spheres_;
+  eastl::vector<uint32_t> meshes_materials_;
+  RenderQueue draws_queue_;
+  // Residency generation the descriptors and commands were written for
+  uint32_t residency_generation_;
+  // Same, for the buffers of the geometry arenas the commands bind
+  uint32_t geometry_generation_;
   Model *fullscreenquad_;
 
   eastl::vector<MaterialConstants> mat_consts_;
@@ -19,7 +19,11 @@ extern const char *kWindowName = "vksagres-fplus";
 FPlusScene::FPlusScene()
     : Scene(),
       renderer_(),
-      cam_() {}
+      cam_(),
+      cam_controller_(),
+      vertex_setup_(),
+      nanosuit_load_(0U),
+      nanosuit_registered_(false) {}
 
 void FPlusScene::DoInit() {
   input_manager()->SetCursorMode(window(), szt::MouseCursorMode::DISABLED);
@@ -51,36 +55,36 @@ void FPlusScene::DoInit() {
     glm::vec3(40.f, 12.f, 17.f),
     1000.f);
 
-  // Setup the vertex layout of the model to be passed
+  // Setup the vertex layout of the model to be passed; attributes are
+  // quantized, down to 20 bytes per vertex from 56 as floats
   eastl::vector<VertexElement> vtx_layout;
   vtx_layout.push_back(VertexElement(
         VertexElementType::POSITION,
-        SCAST_U32(sizeof(glm::vec3)),
-        VK_FORMAT_R32G32B32_SFLOAT));
+        4U * SCAST_U32(sizeof(int16_t)),
+        VK_FORMAT_R16G16B16A16_SNORM,
+        VertexElementEncoding::SNORM16_POSITION));
   vtx_layout.push_back(VertexElement(
         VertexElementType::NORMAL,
-        SCAST_U32(sizeof(glm::vec3)),
-        VK_FORMAT_R32G32B32_SFLOAT));
+        4U * SCAST_U32(sizeof(int16_t)),
+        VK_FORMAT_R16G16B16A16_SNORM,
+        VertexElementEncoding::TANGENT_FRAME_SNORM16));
   vtx_layout.push_back(VertexElement(
         VertexElementType::UV,
-        SCAST_U32(sizeof(glm::vec2)),
-        VK_FORMAT_R32G32_SFLOAT));
-  vtx_layout.push_back(VertexElement(
-        VertexElementType::BITANGENT,
-        SCAST_U32(sizeof(glm::vec3)),
-        VK_FORMAT_R32G32B32_SFLOAT));
-  vtx_layout.push_back(VertexElement(
-        VertexElementType::TANGENT,
-        SCAST_U32(sizeof(glm::vec3)),
-        VK_FORMAT_R32G32B32_SFLOAT));
+        2U * SCAST_U32(sizeof(uint16_t)),
+        VK_FORMAT_R16G16_SFLOAT,
+        VertexElementEncoding::HALF));
 
-  VertexSetup vertex_setup(vtx_layout);
+  // Positions get a stream of their own for the depth prepass, the other
+  // attributes are interleaved for the shading pass
+  vertex_setup_ = eastl::make_unique<VertexSetup>(
+      vtx_layout,
+      VertexStreamsLayout::POSITION_INTERLEAVED);
 
-  renderer_.Init(&cam_);
+  renderer_.Init(&cam_, *vertex_setup_);
 
-  Model*nanosuit = nullptr;
-  model_manager()->LoadOtherModel(
-      vulkan()->device(),
+  // The model is registered by DoUpdate() once it is resident, so that the
+  // app doesn't block on it
+  nanosuit_load_ = model_manager()->LoadOtherModelAsync(
       STR(ASSETS_FOLDER) "models/nanosuit/nanosuit.obj",
       STR(ASSETS_FOLDER) "models/nanosuit/",
         aiProcess_CalcTangentSpace |
@@ -88,10 +92,7 @@ void FPlusScene::DoInit() {
           aiProcess_Triangulate |
           aiProcess_JoinIdenticalVertices |
           aiProcess_ConvertToLeftHanded,
-      vertex_setup,
-      &nanosuit);
-
-  renderer_.RegisterModel(*nanosuit, vertex_setup);
+      *vertex_setup_);
 
   //Model *crate = nullptr;
   //model_manager()->LoadOtherModel(
@@ -114,6 +115,10 @@ void FPlusScene::DoInit() {
 }
 
 void FPlusScene::DoRender(float delta_time) {
+  if (!renderer_.has_registered_models()) {
+    return;
+  }
+
   renderer_.PreRender();
   renderer_.Render();
   renderer_.PostRender();
@@ -122,10 +127,24 @@ void FPlusScene::DoRender(float delta_time) {
 void FPlusScene::DoUpdate(float delta_time) {
   cam_controller_.Update(&cam_, delta_time);
 
+  model_manager()->UpdateAsyncLoads(vulkan()->device());
+  if (!nanosuit_registered_) {
+    Model *nanosuit = model_manager()->GetLoadedModel(nanosuit_load_);
+    if (nanosuit != nullptr) {
+      renderer_.RegisterModel(*nanosuit);
+      nanosuit_registered_ = true;
+    }
+  }
+
   // Reload shaders
   if (input_manager()->IsKeyPressed(GLFW_KEY_R)) {
     renderer_.ReloadAllShaders();
   }
+
+  // Print GPU memory usage
+  if (input_manager()->IsKeyPressed(GLFW_KEY_M)) {
+    memory_tracker()->LogReport(vulkan()->device());
+  }
 }
 
 void FPlusScene::DoShutdown() {
@@ -5,6 +5,9 @@
 #include <fplus_renderer.h>
 #include <camera.h>
 #include <camera_controller.h>
+#include <model_manager.h>
+#include <vertex_setup.h>
+#include <EASTL/unique_ptr.h>
 
 namespace vks {
 
@@ -24,6 +27,10 @@ class FPlusScene : public Scene {
   FPlusRenderer renderer_;
   szt::Camera cam_;
   szt::CameraController cam_controller_;
+  // Layout the models are loaded in, which is needed again to register them
+  eastl::unique_ptr<VertexSetup> vertex_setup_;
+  ModelLoadHandle nanosuit_load_;
+  bool nanosuit_registered_;
 
 }; // class FPlusScene
 
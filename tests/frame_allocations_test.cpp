@@ -0,0 +1,198 @@
+#include <base_system.h>
+#include <memory_allocators.h>
+#include <render_queue.h>
+#include <scene.h>
+#include <worker_pool.h>
+#include <vks_test.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <thread>
+
+// Enough frames past the warm-up ones for the per-frame work to settle
+static const uint32_t kFramesCount = 64U;
+static const uint32_t kMeshesCount = 1024U;
+// Workers for the parallel loops, whatever the machine has
+static const uint32_t kWorkerThreads = 3U;
+// Enough draws for the sort to be split across the workers
+static const uint32_t kDrawsCount = 16U * 1024U;
+
+/**
+ * @brief Does the per-frame CPU work of a scene which renders, headless:
+ *   scratch data in the frame arena, filled by a parallel loop.
+ */
+class FrameLoopScene : public vks::Scene {
+ public:
+  FrameLoopScene() : checksum_(0.f) {}
+
+  float checksum() const { return checksum_; }
+
+ private:
+  void DoInit() {}
+  void DoShutdown() {}
+
+  void DoUpdate(float delta_time) {
+    vks::FrameVector<glm::mat4> model_matxs(kMeshesCount);
+    glm::mat4 *matxs = model_matxs.data();
+    float scale = 2.f;
+    float offset = static_cast<float>(kMeshesCount);
+    // Captures more than a std::function holds without allocating
+    vks::worker_pool()->ParallelFor(
+        kMeshesCount,
+        64U,
+        [matxs, scale, offset, delta_time](uint32_t begin, uint32_t end) {
+      for (uint32_t i = begin; i < end; ++i) {
+        matxs[i] = glm::mat4(offset + delta_time +
+                             scale * static_cast<float>(i));
+      }
+    });
+    checksum_ += model_matxs[kMeshesCount - 1U][0U][0U];
+  }
+
+  void DoRender(float delta_time) {}
+
+  float checksum_;
+
+}; // class FrameLoopScene
+
+/**
+ * @brief Refills and sorts a render queue every frame, the way the renderer
+ *   orders its draws
+ */
+class SortingScene : public vks::Scene {
+ public:
+  SortingScene() : queue_(), frame_(0U), checksum_(0U) {}
+
+ private:
+  void DoInit() {}
+  void DoShutdown() {}
+
+  void DoUpdate(float delta_time) {
+    queue_.Clear();
+    vks::RenderQueueItem *items = queue_.Append(kDrawsCount);
+    for (uint32_t i = 0U; i < kDrawsCount; ++i) {
+      float depth = static_cast<float>((i * 7919U + frame_) % kDrawsCount);
+      items[i].key = vks::RenderQueue::MakeKey(
+          vks::DrawPassTypes::DEPTH_PREPASS, i % 3U, i % 61U, depth);
+      items[i].value = i;
+    }
+    queue_.Sort();
+    checksum_ += queue_.items()[0U].value;
+    ++frame_;
+  }
+
+  void DoRender(float delta_time) {}
+
+  vks::RenderQueue queue_;
+  uint32_t frame_;
+  uint32_t checksum_;
+
+}; // class SortingScene
+
+/**
+ * @brief Allocates from the heap every frame, but as one-off work which is
+ *   left out of the check
+ */
+class SkippingScene : public vks::Scene {
+ private:
+  void DoInit() {}
+  void DoShutdown() {}
+  void DoUpdate(float delta_time) {
+    vks::SkipFrameAllocationsCheck();
+    eastl::vector<float> values(kMeshesCount, delta_time);
+  }
+  void DoRender(float delta_time) {}
+
+}; // class SkippingScene
+
+/**
+ * @brief Has another thread allocate during every frame, like a model
+ *   loading in the background, which isn't counted against the frames
+ */
+class BackgroundLoadScene : public vks::Scene {
+ public:
+  BackgroundLoadScene()
+      : loader_(),
+        requested_(0U),
+        completed_(0U),
+        quit_(false) {}
+
+ private:
+  void DoInit() {
+    loader_ = std::thread(&BackgroundLoadScene::LoaderMain, this);
+  }
+
+  void DoShutdown() {
+    quit_.store(true);
+    loader_.join();
+  }
+
+  // Waits for the loader to allocate, so that it happens within the frame
+  void DoUpdate(float delta_time) {
+    uint32_t requested = requested_.fetch_add(1U) + 1U;
+    while (completed_.load() != requested) {
+      std::this_thread::yield();
+    }
+  }
+
+  void DoRender(float delta_time) {}
+
+  void LoaderMain() {
+    while (!quit_.load()) {
+      if (completed_.load() == requested_.load()) {
+        std::this_thread::yield();
+        continue;
+      }
+      eastl::vector<float> values(kMeshesCount);
+      completed_.fetch_add(1U);
+    }
+  }
+
+  std::thread loader_;
+  std::atomic<uint32_t> requested_;
+  std::atomic<uint32_t> completed_;
+  std::atomic<bool> quit_;
+
+}; // class BackgroundLoadScene
+
+#ifndef VKS_ASSERT_NO_FRAME_ALLOCATIONS
+/**
+ * @brief Allocates from the heap every frame, which the loop has to report
+ */
+class AllocatingScene : public vks::Scene {
+ private:
+  void DoInit() {}
+  void DoShutdown() {}
+  void DoUpdate(float delta_time) {
+    eastl::vector<float> values(kMeshesCount, delta_time);
+  }
+  void DoRender(float delta_time) {}
+
+}; // class AllocatingScene
+#endif
+
+int main() {
+  vks::InitHeadless(kWorkerThreads);
+
+  FrameLoopScene scene;
+  VKS_CHECK(vks::RunFrames(&scene, kFramesCount) == 0U);
+
+  SortingScene sorting_scene;
+  VKS_CHECK(vks::RunFrames(&sorting_scene, kFramesCount) == 0U);
+
+  SkippingScene skipping_scene;
+  VKS_CHECK(vks::RunFrames(&skipping_scene, kFramesCount) == 0U);
+
+  // Only the main thread's allocations count against its frames
+  BackgroundLoadScene background_load_scene;
+  VKS_CHECK(vks::RunFrames(&background_load_scene, kFramesCount) == 0U);
+
+#ifndef VKS_ASSERT_NO_FRAME_ALLOCATIONS
+  // Make sure that allocations are counted at all
+  AllocatingScene allocating_scene;
+  VKS_CHECK(vks::RunFrames(&allocating_scene, kFramesCount) != 0U);
+#endif
+
+  vks::ShutdownHeadless();
+
+  return VKS_TEST_RESULT();
+}
@@ -0,0 +1,89 @@
+#include <staging_ring.h>
+#include <vks_test.h>
+
+using vks::StagingRing;
+
+// The batches of the upload manager, which hand back what they took once
+// they complete
+struct Batch {
+  uint64_t end;
+  uint64_t consumed;
+}; // struct Batch
+
+static Batch Allocate(
+    StagingRing &ring,
+    uint64_t size,
+    uint64_t expected_offset) {
+  uint64_t offset = 0U;
+  Batch batch = {0U, 0U};
+  VKS_CHECK(ring.Allocate(size, 16U, &offset, &batch.consumed));
+  VKS_CHECK(offset == expected_offset);
+  batch.end = ring.head();
+  return batch;
+}
+
+static void TestWrap() {
+  StagingRing ring;
+  ring.Reset(1024U);
+
+  Batch a = Allocate(ring, 600U, 0U);
+  Batch b = Allocate(ring, 300U, 608U);
+  VKS_CHECK(b.consumed == 308U);
+  ring.Release(a.end, a.consumed);
+  VKS_CHECK(ring.tail() == 600U);
+  VKS_CHECK(ring.used() == 308U);
+
+  // Doesn't fit after b, but does before a's old space
+  Batch c = Allocate(ring, 200U, 0U);
+  VKS_CHECK(c.consumed == (1024U - 908U) + 200U);
+
+  // Only the space a gave back is free, until b completes
+  uint64_t offset = 0U;
+  uint64_t consumed = 0U;
+  VKS_CHECK(!ring.Allocate(500U, 16U, &offset, &consumed));
+  ring.Release(b.end, b.consumed);
+  Batch d = Allocate(ring, 500U, 208U);
+
+  ring.Release(c.end, c.consumed);
+  ring.Release(d.end, d.consumed);
+  VKS_CHECK(ring.used() == 0U);
+}
+
+static void TestReset() {
+  StagingRing ring;
+  ring.Reset(1024U);
+
+  Batch a = Allocate(ring, 100U, 0U);
+  ring.Release(a.end, a.consumed);
+
+  // An empty ring starts over from its start
+  Allocate(ring, 100U, 0U);
+  VKS_CHECK(ring.tail() == 0U);
+}
+
+static void TestEmptyBatch() {
+  StagingRing ring;
+  ring.Reset(1024U);
+
+  // The empty batch's head predates the ring being reset by b
+  Batch a = Allocate(ring, 100U, 0U);
+  Batch empty = {ring.head(), 0U};
+  ring.Release(a.end, a.consumed);
+  Batch b = Allocate(ring, 1000U, 0U);
+  ring.Release(empty.end, empty.consumed);
+  VKS_CHECK(ring.tail() == 0U);
+  VKS_CHECK(ring.used() == b.consumed);
+
+  // Which leaves no room to wrap into, over b's data
+  uint64_t offset = 0U;
+  uint64_t consumed = 0U;
+  VKS_CHECK(!ring.Allocate(50U, 16U, &offset, &consumed));
+}
+
+int main() {
+  TestWrap();
+  TestReset();
+  TestEmptyBatch();
+
+  return VKS_TEST_RESULT();
+}
@@ -0,0 +1,23 @@
+#ifndef VKS_TEST
+#define VKS_TEST
+
+#include <cstdio>
+#include <cstdlib>
+
+// Tests are plain executables run by ctest; failed checks are reported and
+// the test carries on, then exits with VKS_TEST_RESULT()
+static int vks_test_failures = 0;
+
+#define VKS_CHECK(expr)                                          \
+{                                                                \
+  if (!(expr)) {                                                 \
+    fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,       \
+            __LINE__, #expr);                                    \
+    ++vks_test_failures;                                         \
+  }                                                              \
+}
+
+#define VKS_TEST_RESULT() \
+  (vks_test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
+
+#endif